@@ -0,0 +1,41 @@
+#############################################################################
+# Copyright (c) 2024 One Identity LLC.
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As an additional exemption you are allowed to compile & link against the
+# OpenSSL libraries as published by the OpenSSL project. See the file
+# COPYING for details.
+#
+#############################################################################
+
+include(LibFindMacros)
+include(FindPackageHandleStandardArgs)
+
+find_package(PkgConfig)
+
+pkg_check_modules(PC_LIBZ zlib QUIET)
+find_path(LIBZ_INCLUDE_DIR NAMES zlib.h HINTS ${PC_LIBZ_INCLUDE_DIRS})
+find_library(LIBZ_LIBRARY  NAMES z         HINTS ${PC_LIBZ_LIBRARY_DIRS})
+
+add_library(libz INTERFACE)
+
+if (NOT PC_LIBZ_FOUND)
+ return()
+endif()
+
+target_include_directories(libz INTERFACE ${LIBZ_INCLUDE_DIR})
+target_link_libraries(libz INTERFACE ${LIBZ_LIBRARY})
+
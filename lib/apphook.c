@@ -30,6 +30,7 @@
 #include "stats/stats-registry.h"
 #include "healthcheck/healthcheck-stats.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-pool.h"
 #include "logsource.h"
 #include "logwriter.h"
 #include "afinter.h"
@@ -44,6 +45,7 @@
 #include "secret-storage/nondumpable-allocator.h"
 #include "secret-storage/secret-storage.h"
 #include "transport/transport-factory-id.h"
+#include "transport/tls-session.h"
 #include "timeutils/timeutils.h"
 #include "msg-stats.h"
 #include "timeutils/cache.h"
@@ -229,6 +231,7 @@ app_startup(void)
   healthcheck_stats_global_init();
   tzset();
   log_msg_global_init();
+  log_msg_pool_thread_init();
   log_tags_global_init();
   log_source_global_init();
   log_template_global_init();
@@ -238,6 +241,7 @@ app_startup(void)
   nondumpable_setlogger(nondumpable_allocator_msg_debug, nondumpable_allocator_msg_fatal);
   secret_storage_init();
   transport_factory_id_global_init();
+  tls_session_global_init();
   scratch_buffers_global_init();
   msg_stats_init();
   timeutils_global_init();
@@ -277,6 +281,7 @@ app_shutdown(void)
   value_pairs_global_deinit();
   log_template_global_deinit();
   log_tags_global_deinit();
+  log_msg_pool_thread_deinit();
   log_msg_global_deinit();
 
   afinter_global_deinit();
@@ -341,6 +346,7 @@ void
 app_thread_start(void)
 {
   scratch_buffers_allocator_init();
+  log_msg_pool_thread_init();
   dns_caching_thread_init();
   main_loop_call_thread_init();
   run_application_thread_init_hooks();
@@ -352,6 +358,7 @@ app_thread_stop(void)
   run_application_thread_deinit_hooks();
   main_loop_call_thread_deinit();
   dns_caching_thread_deinit();
+  log_msg_pool_thread_deinit();
   scratch_buffers_allocator_deinit();
   timeutils_cache_deinit();
 }
@@ -0,0 +1,745 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "compression.h"
+#include "messages.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#if SYSLOG_NG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#if SYSLOG_NG_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#if SYSLOG_NG_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+/* the output buffer is grown by this much while the compressor produces output */
+#define COMPRESSION_OUTPUT_CHUNK 16384
+
+struct _StreamCompressor
+{
+  CompressionAlgorithm algorithm;
+  gsize input_size;
+  /* sticky until the next reset, the stream is unusable after an error */
+  gboolean failed;
+#if SYSLOG_NG_HAVE_ZLIB
+  z_stream zlib;
+#endif
+#if SYSLOG_NG_HAVE_ZSTD
+  ZSTD_CCtx *zstd;
+#endif
+};
+
+static const gchar *compression_algorithm_names[] =
+{
+  [COMPRESSION_NONE] = "none",
+  [COMPRESSION_GZIP] = "gzip",
+  [COMPRESSION_DEFLATE] = "deflate",
+  [COMPRESSION_ZSTD] = "zstd",
+  [COMPRESSION_LZ4] = "lz4",
+};
+
+gboolean
+compression_algorithm_lookup(const gchar *name, CompressionAlgorithm *algorithm)
+{
+  for (gint i = 0; i < G_N_ELEMENTS(compression_algorithm_names); i++)
+    {
+      if (strcmp(compression_algorithm_names[i], name) == 0)
+        {
+          *algorithm = i;
+          return TRUE;
+        }
+    }
+  return FALSE;
+}
+
+const gchar *
+compression_algorithm_name(CompressionAlgorithm algorithm)
+{
+  g_assert(algorithm < G_N_ELEMENTS(compression_algorithm_names));
+  return compression_algorithm_names[algorithm];
+}
+
+gboolean
+compression_algorithm_is_supported(CompressionAlgorithm algorithm)
+{
+  switch (algorithm)
+    {
+    case COMPRESSION_NONE:
+      return TRUE;
+    case COMPRESSION_GZIP:
+    case COMPRESSION_DEFLATE:
+      return SYSLOG_NG_HAVE_ZLIB;
+    case COMPRESSION_ZSTD:
+      return SYSLOG_NG_HAVE_ZSTD;
+    case COMPRESSION_LZ4:
+      return SYSLOG_NG_HAVE_LZ4;
+    default:
+      g_assert_not_reached();
+    }
+}
+
+gboolean
+compression_algorithm_is_valid_level(CompressionAlgorithm algorithm, gint level)
+{
+  if (level == COMPRESSION_LEVEL_DEFAULT)
+    return TRUE;
+
+  switch (algorithm)
+    {
+    case COMPRESSION_GZIP:
+    case COMPRESSION_DEFLATE:
+      return level >= 0 && level <= 9;
+    case COMPRESSION_ZSTD:
+      return level >= 1 && level <= 22;
+    default:
+      return FALSE;
+    }
+}
+
+/* grows output by size bytes and returns the free space at its end */
+static inline gchar *
+_reserve_output(GString *output, gsize size, gsize *orig_len)
+{
+  *orig_len = output->len;
+  g_string_set_size(output, output->len + size);
+  return output->str + *orig_len;
+}
+
+#if SYSLOG_NG_HAVE_ZLIB
+
+static gboolean
+_zlib_init(StreamCompressor *self, gint level)
+{
+  /* 15 is the default window size, +16 selects the gzip wrapper */
+  gint window_bits = self->algorithm == COMPRESSION_GZIP ? 15 + 16 : 15;
+
+  if (deflateInit2(&self->zlib, level == COMPRESSION_LEVEL_DEFAULT ? Z_DEFAULT_COMPRESSION : level,
+                   Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+      msg_error("Error initializing zlib compressor",
+                evt_tag_str("algorithm", compression_algorithm_name(self->algorithm)),
+                evt_tag_str("error", self->zlib.msg ? : "unknown"));
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_zlib_compress(StreamCompressor *self, const gchar *data, gsize len, gint flush, GString *output)
+{
+  z_stream *zs = &self->zlib;
+
+  zs->next_in = (Bytef *) data;
+  zs->avail_in = len;
+
+  while (TRUE)
+    {
+      gsize orig_len;
+
+      zs->next_out = (Bytef *) _reserve_output(output, COMPRESSION_OUTPUT_CHUNK, &orig_len);
+      zs->avail_out = COMPRESSION_OUTPUT_CHUNK;
+
+      gint rc = deflate(zs, flush);
+      g_string_set_size(output, orig_len + COMPRESSION_OUTPUT_CHUNK - zs->avail_out);
+
+      if (rc == Z_STREAM_ERROR)
+        {
+          msg_error("Error compressing data",
+                    evt_tag_str("algorithm", compression_algorithm_name(self->algorithm)),
+                    evt_tag_str("error", zs->msg ? : "unknown"));
+          return FALSE;
+        }
+
+      if (flush == Z_FINISH)
+        {
+          if (rc == Z_STREAM_END)
+            return TRUE;
+        }
+      else if (zs->avail_in == 0 && zs->avail_out != 0)
+        {
+          return TRUE;
+        }
+    }
+}
+
+#endif
+
+#if SYSLOG_NG_HAVE_ZSTD
+
+static gboolean
+_zstd_init(StreamCompressor *self, gint level)
+{
+  self->zstd = ZSTD_createCCtx();
+  if (!self->zstd)
+    {
+      msg_error("Error initializing zstd compressor");
+      return FALSE;
+    }
+
+  if (level != COMPRESSION_LEVEL_DEFAULT)
+    ZSTD_CCtx_setParameter(self->zstd, ZSTD_c_compressionLevel, level);
+  return TRUE;
+}
+
+static gboolean
+_zstd_compress(StreamCompressor *self, const gchar *data, gsize len, ZSTD_EndDirective mode, GString *output)
+{
+  ZSTD_inBuffer input = { data, len, 0 };
+  gboolean finished;
+
+  do
+    {
+      gsize orig_len;
+      gchar *buffer = _reserve_output(output, COMPRESSION_OUTPUT_CHUNK, &orig_len);
+      ZSTD_outBuffer out = { buffer, COMPRESSION_OUTPUT_CHUNK, 0 };
+
+      gsize remaining = ZSTD_compressStream2(self->zstd, &out, &input, mode);
+      g_string_set_size(output, orig_len + out.pos);
+
+      if (ZSTD_isError(remaining))
+        {
+          msg_error("Error compressing data",
+                    evt_tag_str("algorithm", compression_algorithm_name(self->algorithm)),
+                    evt_tag_str("error", ZSTD_getErrorName(remaining)));
+          return FALSE;
+        }
+
+      finished = (mode == ZSTD_e_end) ? (remaining == 0) : (input.pos == input.size);
+    }
+  while (!finished);
+
+  return TRUE;
+}
+
+#endif
+
+gboolean
+stream_compressor_write(StreamCompressor *self, const gchar *data, gsize len, GString *output)
+{
+  self->input_size += len;
+  if (self->failed)
+    return FALSE;
+
+  gboolean success;
+  switch (self->algorithm)
+    {
+#if SYSLOG_NG_HAVE_ZLIB
+    case COMPRESSION_GZIP:
+    case COMPRESSION_DEFLATE:
+      success = _zlib_compress(self, data, len, Z_NO_FLUSH, output);
+      break;
+#endif
+#if SYSLOG_NG_HAVE_ZSTD
+    case COMPRESSION_ZSTD:
+      success = _zstd_compress(self, data, len, ZSTD_e_continue, output);
+      break;
+#endif
+    case COMPRESSION_NONE:
+      g_string_append_len(output, data, len);
+      success = TRUE;
+      break;
+    default:
+      g_assert_not_reached();
+    }
+
+  self->failed = !success;
+  return success;
+}
+
+gboolean
+stream_compressor_finish(StreamCompressor *self, GString *output)
+{
+  if (self->failed)
+    return FALSE;
+
+  gboolean success;
+  switch (self->algorithm)
+    {
+#if SYSLOG_NG_HAVE_ZLIB
+    case COMPRESSION_GZIP:
+    case COMPRESSION_DEFLATE:
+      success = _zlib_compress(self, NULL, 0, Z_FINISH, output);
+      break;
+#endif
+#if SYSLOG_NG_HAVE_ZSTD
+    case COMPRESSION_ZSTD:
+      success = _zstd_compress(self, NULL, 0, ZSTD_e_end, output);
+      break;
+#endif
+    case COMPRESSION_NONE:
+      success = TRUE;
+      break;
+    default:
+      g_assert_not_reached();
+    }
+
+  self->failed = !success;
+  return success;
+}
+
+void
+stream_compressor_reset(StreamCompressor *self)
+{
+  self->input_size = 0;
+  self->failed = FALSE;
+
+  switch (self->algorithm)
+    {
+#if SYSLOG_NG_HAVE_ZLIB
+    case COMPRESSION_GZIP:
+    case COMPRESSION_DEFLATE:
+      deflateReset(&self->zlib);
+      break;
+#endif
+#if SYSLOG_NG_HAVE_ZSTD
+    case COMPRESSION_ZSTD:
+      ZSTD_CCtx_reset(self->zstd, ZSTD_reset_session_only);
+      break;
+#endif
+    default:
+      break;
+    }
+}
+
+gsize
+stream_compressor_get_input_size(StreamCompressor *self)
+{
+  return self->input_size;
+}
+
+StreamCompressor *
+stream_compressor_new(CompressionAlgorithm algorithm, gint level)
+{
+  if (!compression_algorithm_is_supported(algorithm))
+    {
+      msg_error("Compression algorithm is not supported by this build of syslog-ng",
+                evt_tag_str("algorithm", compression_algorithm_name(algorithm)));
+      return NULL;
+    }
+
+  if (algorithm == COMPRESSION_LZ4)
+    {
+      msg_error("Compression algorithm cannot be used for streaming",
+                evt_tag_str("algorithm", compression_algorithm_name(algorithm)));
+      return NULL;
+    }
+
+  StreamCompressor *self = g_new0(StreamCompressor, 1);
+  gboolean success = TRUE;
+
+  self->algorithm = algorithm;
+  switch (algorithm)
+    {
+#if SYSLOG_NG_HAVE_ZLIB
+    case COMPRESSION_GZIP:
+    case COMPRESSION_DEFLATE:
+      success = _zlib_init(self, level);
+      break;
+#endif
+#if SYSLOG_NG_HAVE_ZSTD
+    case COMPRESSION_ZSTD:
+      success = _zstd_init(self, level);
+      break;
+#endif
+    default:
+      break;
+    }
+
+  if (!success)
+    {
+      g_free(self);
+      return NULL;
+    }
+  return self;
+}
+
+void
+stream_compressor_free(StreamCompressor *self)
+{
+  if (!self)
+    return;
+
+  switch (self->algorithm)
+    {
+#if SYSLOG_NG_HAVE_ZLIB
+    case COMPRESSION_GZIP:
+    case COMPRESSION_DEFLATE:
+      deflateEnd(&self->zlib);
+      break;
+#endif
+#if SYSLOG_NG_HAVE_ZSTD
+    case COMPRESSION_ZSTD:
+      ZSTD_freeCCtx(self->zstd);
+      break;
+#endif
+    default:
+      break;
+    }
+  g_free(self);
+}
+
+#if SYSLOG_NG_HAVE_ZLIB
+
+static CompressedFileState
+_zlib_check_file(gint fd, goffset *complete_len)
+{
+  z_stream zs = {0};
+  gchar input[COMPRESSION_OUTPUT_CHUNK];
+  gchar output[COMPRESSION_OUTPUT_CHUNK];
+  goffset offset = 0;
+  CompressedFileState state = COMPRESSED_FILE_COMPLETE;
+
+  if (inflateInit2(&zs, 15 + 16) != Z_OK)
+    return COMPRESSED_FILE_READ_ERROR;
+
+  while (state == COMPRESSED_FILE_COMPLETE)
+    {
+      gssize len = pread(fd, input, sizeof(input), offset);
+      if (len <= 0)
+        {
+          if (len < 0)
+            state = COMPRESSED_FILE_READ_ERROR;
+          break;
+        }
+
+      zs.next_in = (Bytef *) input;
+      zs.avail_in = len;
+      do
+        {
+          zs.next_out = (Bytef *) output;
+          zs.avail_out = sizeof(output);
+
+          gint rc = inflate(&zs, Z_NO_FLUSH);
+          if (rc == Z_STREAM_END)
+            {
+              *complete_len = offset + len - zs.avail_in;
+              inflateReset(&zs);
+            }
+          else if (rc != Z_OK && rc != Z_BUF_ERROR)
+            {
+              state = COMPRESSED_FILE_CORRUPTED;
+              break;
+            }
+        }
+      while (zs.avail_in > 0 || zs.avail_out == 0);
+      offset += len;
+    }
+  inflateEnd(&zs);
+
+  if (state == COMPRESSED_FILE_COMPLETE && *complete_len != offset)
+    state = COMPRESSED_FILE_TRUNCATED;
+  return state;
+}
+
+#endif
+
+#if SYSLOG_NG_HAVE_ZSTD
+
+static CompressedFileState
+_zstd_check_file(gint fd, goffset *complete_len)
+{
+  ZSTD_DCtx *dctx = ZSTD_createDCtx();
+  gchar input[COMPRESSION_OUTPUT_CHUNK];
+  gchar output[COMPRESSION_OUTPUT_CHUNK];
+  goffset offset = 0;
+  CompressedFileState state = COMPRESSED_FILE_COMPLETE;
+
+  if (!dctx)
+    return COMPRESSED_FILE_READ_ERROR;
+
+  while (state == COMPRESSED_FILE_COMPLETE)
+    {
+      gssize len = pread(fd, input, sizeof(input), offset);
+      if (len <= 0)
+        {
+          if (len < 0)
+            state = COMPRESSED_FILE_READ_ERROR;
+          break;
+        }
+
+      ZSTD_inBuffer in = { input, len, 0 };
+      gboolean output_full;
+      do
+        {
+          ZSTD_outBuffer out = { output, sizeof(output), 0 };
+
+          /* returns 0 once a frame is completely decoded and flushed */
+          gsize rc = ZSTD_decompressStream(dctx, &out, &in);
+          if (ZSTD_isError(rc))
+            {
+              state = COMPRESSED_FILE_CORRUPTED;
+              break;
+            }
+          if (rc == 0)
+            *complete_len = offset + in.pos;
+          output_full = out.pos == out.size;
+        }
+      while (in.pos < in.size || output_full);
+      offset += len;
+    }
+  ZSTD_freeDCtx(dctx);
+
+  if (state == COMPRESSED_FILE_COMPLETE && *complete_len != offset)
+    state = COMPRESSED_FILE_TRUNCATED;
+  return state;
+}
+
+#endif
+
+CompressedFileState
+compression_check_file(CompressionAlgorithm algorithm, gint fd, goffset *complete_len)
+{
+  *complete_len = 0;
+
+  switch (algorithm)
+    {
+#if SYSLOG_NG_HAVE_ZLIB
+    case COMPRESSION_GZIP:
+      return _zlib_check_file(fd, complete_len);
+#endif
+#if SYSLOG_NG_HAVE_ZSTD
+    case COMPRESSION_ZSTD:
+      return _zstd_check_file(fd, complete_len);
+#endif
+    default:
+      g_assert_not_reached();
+    }
+}
+
+struct _BlockCompressor
+{
+  CompressionAlgorithm algorithm;
+#if SYSLOG_NG_HAVE_ZSTD
+  ZSTD_CCtx *zstd_cctx;
+  ZSTD_DCtx *zstd_dctx;
+#endif
+};
+
+static void
+_block_error(BlockCompressor *self, const gchar *message, const gchar *error)
+{
+  msg_error(message,
+            evt_tag_str("algorithm", compression_algorithm_name(self->algorithm)),
+            evt_tag_str("error", error));
+}
+
+#if SYSLOG_NG_HAVE_LZ4
+
+static gboolean
+_lz4_compress_block(BlockCompressor *self, const gchar *data, gsize len, GString *output)
+{
+  if (len > LZ4_MAX_INPUT_SIZE)
+    {
+      _block_error(self, "Error compressing data", "block too large");
+      return FALSE;
+    }
+
+  gsize orig_len;
+  gint bound = LZ4_compressBound(len);
+  gchar *out = _reserve_output(output, bound, &orig_len);
+
+  gint compressed_len = LZ4_compress_default(data, out, len, bound);
+  if (compressed_len <= 0)
+    {
+      g_string_truncate(output, orig_len);
+      _block_error(self, "Error compressing data", "LZ4_compress_default() failed");
+      return FALSE;
+    }
+
+  g_string_truncate(output, orig_len + compressed_len);
+  return TRUE;
+}
+
+static gboolean
+_lz4_decompress_block(BlockCompressor *self, const gchar *data, gsize len, gsize uncompressed_len, GString *output)
+{
+  if (len > G_MAXINT || uncompressed_len > G_MAXINT)
+    {
+      _block_error(self, "Error decompressing data", "block too large");
+      return FALSE;
+    }
+
+  gsize orig_len;
+  gchar *out = _reserve_output(output, uncompressed_len, &orig_len);
+
+  gint decompressed_len = LZ4_decompress_safe(data, out, len, uncompressed_len);
+  if (decompressed_len < 0 || (gsize) decompressed_len != uncompressed_len)
+    {
+      g_string_truncate(output, orig_len);
+      _block_error(self, "Error decompressing data", "corrupted block");
+      return FALSE;
+    }
+  return TRUE;
+}
+
+#endif
+
+#if SYSLOG_NG_HAVE_ZSTD
+
+static gboolean
+_zstd_init_block(BlockCompressor *self, gint level)
+{
+  self->zstd_cctx = ZSTD_createCCtx();
+  self->zstd_dctx = ZSTD_createDCtx();
+  if (!self->zstd_cctx || !self->zstd_dctx)
+    {
+      msg_error("Error initializing zstd compressor");
+      return FALSE;
+    }
+
+  if (level != COMPRESSION_LEVEL_DEFAULT)
+    ZSTD_CCtx_setParameter(self->zstd_cctx, ZSTD_c_compressionLevel, level);
+  return TRUE;
+}
+
+static gboolean
+_zstd_compress_block(BlockCompressor *self, const gchar *data, gsize len, GString *output)
+{
+  gsize orig_len;
+  gsize bound = ZSTD_compressBound(len);
+  gchar *out = _reserve_output(output, bound, &orig_len);
+
+  gsize compressed_len = ZSTD_compress2(self->zstd_cctx, out, bound, data, len);
+  if (ZSTD_isError(compressed_len))
+    {
+      g_string_truncate(output, orig_len);
+      _block_error(self, "Error compressing data", ZSTD_getErrorName(compressed_len));
+      return FALSE;
+    }
+
+  g_string_truncate(output, orig_len + compressed_len);
+  return TRUE;
+}
+
+static gboolean
+_zstd_decompress_block(BlockCompressor *self, const gchar *data, gsize len, gsize uncompressed_len, GString *output)
+{
+  gsize orig_len;
+  gchar *out = _reserve_output(output, uncompressed_len, &orig_len);
+
+  gsize decompressed_len = ZSTD_decompressDCtx(self->zstd_dctx, out, uncompressed_len, data, len);
+  if (ZSTD_isError(decompressed_len) || decompressed_len != uncompressed_len)
+    {
+      g_string_truncate(output, orig_len);
+      _block_error(self, "Error decompressing data",
+                   ZSTD_isError(decompressed_len) ? ZSTD_getErrorName(decompressed_len) : "corrupted block");
+      return FALSE;
+    }
+  return TRUE;
+}
+
+#endif
+
+gboolean
+block_compressor_compress(BlockCompressor *self, const gchar *data, gsize len, GString *output)
+{
+  switch (self->algorithm)
+    {
+#if SYSLOG_NG_HAVE_LZ4
+    case COMPRESSION_LZ4:
+      return _lz4_compress_block(self, data, len, output);
+#endif
+#if SYSLOG_NG_HAVE_ZSTD
+    case COMPRESSION_ZSTD:
+      return _zstd_compress_block(self, data, len, output);
+#endif
+    default:
+      g_assert_not_reached();
+    }
+}
+
+gboolean
+block_compressor_decompress(BlockCompressor *self, const gchar *data, gsize len, gsize uncompressed_len,
+                            GString *output)
+{
+  switch (self->algorithm)
+    {
+#if SYSLOG_NG_HAVE_LZ4
+    case COMPRESSION_LZ4:
+      return _lz4_decompress_block(self, data, len, uncompressed_len, output);
+#endif
+#if SYSLOG_NG_HAVE_ZSTD
+    case COMPRESSION_ZSTD:
+      return _zstd_decompress_block(self, data, len, uncompressed_len, output);
+#endif
+    default:
+      g_assert_not_reached();
+    }
+}
+
+CompressionAlgorithm
+block_compressor_get_algorithm(BlockCompressor *self)
+{
+  return self->algorithm;
+}
+
+BlockCompressor *
+block_compressor_new(CompressionAlgorithm algorithm, gint level)
+{
+  if (algorithm != COMPRESSION_LZ4 && algorithm != COMPRESSION_ZSTD)
+    {
+      msg_error("Compression algorithm cannot be used for independent blocks",
+                evt_tag_str("algorithm", compression_algorithm_name(algorithm)));
+      return NULL;
+    }
+
+  if (!compression_algorithm_is_supported(algorithm))
+    {
+      msg_error("Compression algorithm is not supported by this build of syslog-ng",
+                evt_tag_str("algorithm", compression_algorithm_name(algorithm)));
+      return NULL;
+    }
+
+  BlockCompressor *self = g_new0(BlockCompressor, 1);
+
+  self->algorithm = algorithm;
+#if SYSLOG_NG_HAVE_ZSTD
+  if (algorithm == COMPRESSION_ZSTD && !_zstd_init_block(self, level))
+    {
+      block_compressor_free(self);
+      return NULL;
+    }
+#endif
+  return self;
+}
+
+void
+block_compressor_free(BlockCompressor *self)
+{
+  if (!self)
+    return;
+
+#if SYSLOG_NG_HAVE_ZSTD
+  ZSTD_freeCCtx(self->zstd_cctx);
+  ZSTD_freeDCtx(self->zstd_dctx);
+#endif
+  g_free(self);
+}
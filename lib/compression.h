@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#ifndef COMPRESSION_H_INCLUDED
+#define COMPRESSION_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Streaming compressor, used by destinations that compress their output
+ * (e.g. request bodies or files) as data is produced, instead of doing it
+ * in a separate pass.
+ *
+ * stream_compressor_write() appends whatever compressed output is available
+ * to the output buffer, the compressor may hold back some of its input
+ * until stream_compressor_finish() is called, which terminates the stream.
+ * stream_compressor_reset() starts a new, independent stream. Errors are
+ * sticky: once a write fails, the rest of the stream (including finish) fails
+ * as well, so it is enough to check the result of stream_compressor_finish().
+ *
+ * gzip and deflate (RFC 1950, zlib format, as used in HTTP
+ * Content-Encoding) need zlib, zstd needs libzstd. lz4 is only supported by
+ * the block compressor below.
+ */
+
+typedef enum
+{
+  COMPRESSION_NONE,
+  COMPRESSION_GZIP,
+  COMPRESSION_DEFLATE,
+  COMPRESSION_ZSTD,
+  COMPRESSION_LZ4,
+} CompressionAlgorithm;
+
+#define COMPRESSION_LEVEL_DEFAULT -1
+
+gboolean compression_algorithm_lookup(const gchar *name, CompressionAlgorithm *algorithm);
+const gchar *compression_algorithm_name(CompressionAlgorithm algorithm);
+gboolean compression_algorithm_is_supported(CompressionAlgorithm algorithm);
+gboolean compression_algorithm_is_valid_level(CompressionAlgorithm algorithm, gint level);
+
+typedef struct _StreamCompressor StreamCompressor;
+
+StreamCompressor *stream_compressor_new(CompressionAlgorithm algorithm, gint level);
+gboolean stream_compressor_write(StreamCompressor *self, const gchar *data, gsize len, GString *output);
+gboolean stream_compressor_finish(StreamCompressor *self, GString *output);
+void stream_compressor_reset(StreamCompressor *self);
+gsize stream_compressor_get_input_size(StreamCompressor *self);
+void stream_compressor_free(StreamCompressor *self);
+
+/*
+ * Checks a file that consists of concatenated gzip members or zstd frames
+ * (as written by a stream compressor that is reset after each batch) by
+ * decompressing it from the start.  *complete_len is set to the length of
+ * the data up to the end of the last complete frame, anything after that
+ * is either a frame that was cut short (TRUNCATED, e.g. by a crash or a
+ * full disk) or something that can't be decoded at all (CORRUPTED).
+ */
+typedef enum
+{
+  COMPRESSED_FILE_COMPLETE,
+  COMPRESSED_FILE_TRUNCATED,
+  COMPRESSED_FILE_CORRUPTED,
+  COMPRESSED_FILE_READ_ERROR,
+} CompressedFileState;
+
+CompressedFileState compression_check_file(CompressionAlgorithm algorithm, gint fd, goffset *complete_len);
+
+/*
+ * Block compressor, for data that is stored in small, independent pieces
+ * (e.g. disk-buffer records), each of which has to be decompressible on its
+ * own. Only lz4 (liblz4) and zstd are supported, the compression contexts
+ * are reused between blocks.
+ *
+ * block_compressor_compress() appends the compressed block to output,
+ * block_compressor_decompress() appends the original data, which has to be
+ * exactly uncompressed_len bytes long, otherwise the block is considered
+ * corrupted.
+ */
+
+typedef struct _BlockCompressor BlockCompressor;
+
+BlockCompressor *block_compressor_new(CompressionAlgorithm algorithm, gint level);
+gboolean block_compressor_compress(BlockCompressor *self, const gchar *data, gsize len, GString *output);
+gboolean block_compressor_decompress(BlockCompressor *self, const gchar *data, gsize len, gsize uncompressed_len,
+                                     GString *output);
+CompressionAlgorithm block_compressor_get_algorithm(BlockCompressor *self);
+void block_compressor_free(BlockCompressor *self);
+
+#endif
@@ -24,6 +24,7 @@
 
 #include "driver.h"
 #include "logqueue-fifo.h"
+#include "logqueue-fifo-ring.h"
 #include "afinter.h"
 #include "cfg-tree.h"
 #include "messages.h"
@@ -175,10 +176,10 @@ _log_src_driver_register_counters(LogSrcDriver *self)
   stats_lock();
   StatsClusterKey sc_key;
   stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_SOURCE | SCS_GROUP, self->super.group, NULL );
-  stats_register_counter(level, &sc_key, SC_TYPE_PROCESSED,
-                         &self->super.processed_group_messages);
+  stats_register_sharded_counter(level, &sc_key, SC_TYPE_PROCESSED,
+                                 &self->super.processed_group_messages);
   stats_cluster_logpipe_key_legacy_set(&sc_key,  SCS_CENTER, NULL, "received" );
-  stats_register_counter(level, &sc_key, SC_TYPE_PROCESSED, &self->received_global_messages);
+  stats_register_sharded_counter(level, &sc_key, SC_TYPE_PROCESSED, &self->received_global_messages);
   stats_unlock();
 }
 
@@ -238,6 +239,35 @@ log_src_driver_queue_method(LogPipe *s, LogMessage *msg, const LogPathOptions *p
   log_pipe_forward_msg(s, msg, path_options);
 }
 
+void
+log_src_driver_queue_batch_method(LogPipe *s, LogMessage **msgs, gint num_msgs, const LogPathOptions *path_options)
+{
+  LogSrcDriver *self = (LogSrcDriver *) s;
+  GlobalConfig *cfg = log_pipe_get_config(s);
+
+  /* queue() is overridden by a derived class */
+  if (s->queue != log_src_driver_queue_method)
+    {
+      log_pipe_queue_each(s, msgs, num_msgs, path_options);
+      return;
+    }
+
+  for (gint i = 0; i < num_msgs; i++)
+    {
+      LogMessage *msg = msgs[i];
+
+      /* $SOURCE */
+
+      if (msg->flags & LF_LOCAL)
+        afinter_postpone_mark(cfg->mark_freq);
+
+      log_msg_set_value(msg, LM_V_SOURCE, self->super.group, self->group_len);
+    }
+  stats_counter_add(self->super.processed_group_messages, num_msgs);
+  stats_counter_add(self->received_global_messages, num_msgs);
+  log_pipe_forward_msgs(s, msgs, num_msgs, path_options);
+}
+
 void
 log_src_driver_init_instance(LogSrcDriver *self, GlobalConfig *cfg)
 {
@@ -246,6 +276,7 @@ log_src_driver_init_instance(LogSrcDriver *self, GlobalConfig *cfg)
   self->super.super.init = log_src_driver_init_method;
   self->super.super.deinit = log_src_driver_deinit_method;
   self->super.super.queue = log_src_driver_queue_method;
+  self->super.super.queue_batch = log_src_driver_queue_batch_method;
   self->super.super.flags |= PIF_SOURCE;
 }
 
@@ -257,6 +288,26 @@ log_src_driver_free(LogPipe *s)
 
 /* LogDestDriver */
 
+gboolean
+log_dest_driver_set_log_fifo_type(LogDestDriver *self, const gchar *type)
+{
+  if (strcmp(type, "list") == 0)
+    self->log_fifo_type = LDD_FIFO_TYPE_LIST;
+  else if (strcmp(type, "ring") == 0)
+    self->log_fifo_type = LDD_FIFO_TYPE_RING;
+  else
+    return FALSE;
+  return TRUE;
+}
+
+static QueueType
+_get_memory_queue_type(LogDestDriver *self)
+{
+  if (self->log_fifo_type == LDD_FIFO_TYPE_RING)
+    return log_queue_fifo_ring_get_type();
+  return log_queue_fifo_get_type();
+}
+
 static LogQueue *
 _create_memory_queue(LogDestDriver *self, const gchar *persist_name, gint stats_level,
                      const StatsClusterKeyBuilder *driver_sck_builder, StatsClusterKeyBuilder *queue_sck_builder)
@@ -273,9 +324,14 @@ _create_memory_queue(LogDestDriver *self, const gchar *persist_name, gint stats_
                        "flags(flow-control) option set.) To enable the new behaviour, update the @version string in "
                        "your configuration and consider lowering the value of log-fifo-size().");
 
+      if (self->log_fifo_type == LDD_FIFO_TYPE_RING)
+        return log_queue_fifo_ring_legacy_new(log_fifo_size, persist_name, stats_level, driver_sck_builder,
+                                              queue_sck_builder);
       return log_queue_fifo_legacy_new(log_fifo_size, persist_name, stats_level, driver_sck_builder, queue_sck_builder);
     }
 
+  if (self->log_fifo_type == LDD_FIFO_TYPE_RING)
+    return log_queue_fifo_ring_new(log_fifo_size, persist_name, stats_level, driver_sck_builder, queue_sck_builder);
   return log_queue_fifo_new(log_fifo_size, persist_name, stats_level, driver_sck_builder, queue_sck_builder);
 }
 
@@ -291,7 +347,7 @@ log_dest_driver_acquire_memory_queue(LogDestDriver *self, const gchar *persist_n
   if (persist_name)
     queue = cfg_persist_config_fetch(cfg, persist_name);
 
-  if (queue && !log_queue_has_type(queue, log_queue_fifo_get_type()))
+  if (queue && !log_queue_has_type(queue, _get_memory_queue_type(self)))
     {
       log_queue_unref(queue);
       queue = NULL;
@@ -332,6 +388,23 @@ log_dest_driver_queue_method(LogPipe *s, LogMessage *msg, const LogPathOptions *
   log_pipe_forward_msg(s, msg, path_options);
 }
 
+void
+log_dest_driver_queue_batch_method(LogPipe *s, LogMessage **msgs, gint num_msgs, const LogPathOptions *path_options)
+{
+  LogDestDriver *self = (LogDestDriver *) s;
+
+  /* queue() is overridden by a derived class */
+  if (s->queue != log_dest_driver_queue_method)
+    {
+      log_pipe_queue_each(s, msgs, num_msgs, path_options);
+      return;
+    }
+
+  stats_counter_add(self->super.processed_group_messages, num_msgs);
+  stats_counter_add(self->queued_global_messages, num_msgs);
+  log_pipe_forward_msgs(s, msgs, num_msgs, path_options);
+}
+
 static gboolean
 log_dest_driver_pre_init_method(LogPipe *s)
 {
@@ -354,10 +427,10 @@ _log_dest_driver_register_counters(LogDestDriver *self)
   stats_lock();
   StatsClusterKey sc_key;
   stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_DESTINATION | SCS_GROUP, self->super.group, NULL );
-  stats_register_counter(level, &sc_key, SC_TYPE_PROCESSED,
-                         &self->super.processed_group_messages);
+  stats_register_sharded_counter(level, &sc_key, SC_TYPE_PROCESSED,
+                                 &self->super.processed_group_messages);
   stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_CENTER, NULL, "queued" );
-  stats_register_counter(level, &sc_key, SC_TYPE_PROCESSED, &self->queued_global_messages);
+  stats_register_sharded_counter(level, &sc_key, SC_TYPE_PROCESSED, &self->queued_global_messages);
   stats_unlock();
 }
 
@@ -421,9 +494,11 @@ log_dest_driver_init_instance(LogDestDriver *self, GlobalConfig *cfg)
   self->super.super.init = log_dest_driver_init_method;
   self->super.super.deinit = log_dest_driver_deinit_method;
   self->super.super.queue = log_dest_driver_queue_method;
+  self->super.super.queue_batch = log_dest_driver_queue_batch_method;
   self->acquire_queue = log_dest_driver_acquire_memory_queue;
   self->release_queue = log_dest_driver_release_queue_method;
   self->log_fifo_size = -1;
+  self->log_fifo_type = LDD_FIFO_TYPE_LIST;
   self->throttle = 0;
 }
 
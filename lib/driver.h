@@ -147,11 +147,19 @@ struct _LogSrcDriver
 gboolean log_src_driver_init_method(LogPipe *s);
 gboolean log_src_driver_deinit_method(LogPipe *s);
 void log_src_driver_queue_method(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options);
+void log_src_driver_queue_batch_method(LogPipe *s, LogMessage **msgs, gint num_msgs,
+                                       const LogPathOptions *path_options);
 void log_src_driver_init_instance(LogSrcDriver *self, GlobalConfig *cfg);
 void log_src_driver_free(LogPipe *s);
 
 /* destination driver class: LogDestDriver */
 
+typedef enum
+{
+  LDD_FIFO_TYPE_LIST,
+  LDD_FIFO_TYPE_RING,
+} LogDestDriverFifoType;
+
 typedef struct _LogDestDriver LogDestDriver;
 
 struct _LogDestDriver
@@ -168,6 +176,7 @@ struct _LogDestDriver
   GList *queues;
 
   gint log_fifo_size;
+  LogDestDriverFifoType log_fifo_type;
   gint throttle;
   StatsCounterItem *queued_global_messages;
 };
@@ -203,9 +212,12 @@ log_dest_driver_release_queue(LogDestDriver *self, LogQueue *q)
     }
 }
 
+gboolean log_dest_driver_set_log_fifo_type(LogDestDriver *self, const gchar *type);
 gboolean log_dest_driver_init_method(LogPipe *s);
 gboolean log_dest_driver_deinit_method(LogPipe *s);
 void log_dest_driver_queue_method(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options);
+void log_dest_driver_queue_batch_method(LogPipe *s, LogMessage **msgs, gint num_msgs,
+                                        const LogPathOptions *path_options);
 
 void log_dest_driver_init_instance(LogDestDriver *self, GlobalConfig *cfg);
 void log_dest_driver_free(LogPipe *s);
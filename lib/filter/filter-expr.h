@@ -42,6 +42,8 @@ struct _FilterExprNode
   gboolean (*init)(FilterExprNode *self, GlobalConfig *cfg);
   gboolean (*eval)(FilterExprNode *self, LogMessage **msg, gint num_msg, LogTemplateEvalOptions *options);
   FilterExprNode *(*clone)(FilterExprNode *self);
+  /* consumes the reference to self, returns the node to be used instead */
+  FilterExprNode *(*optimize)(FilterExprNode *self);
   void (*free_fn)(FilterExprNode *self);
   StatsCounterItem *matched;
   StatsCounterItem *not_matched;
@@ -56,6 +58,15 @@ filter_expr_init(FilterExprNode *self, GlobalConfig *cfg)
   return TRUE;
 }
 
+static inline FilterExprNode *
+filter_expr_optimize(FilterExprNode *self)
+{
+  if (self->optimize)
+    return self->optimize(self);
+
+  return self;
+}
+
 gboolean filter_expr_eval(FilterExprNode *self, LogMessage *msg);
 gboolean filter_expr_eval_with_context(FilterExprNode *self, LogMessage **msgs, gint num_msg,
                                        LogTemplateEvalOptions *options);
@@ -30,14 +30,265 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <arpa/inet.h>
+
+/*
+ * The list is loaded into one of two lookup structures when the
+ * configuration is parsed (thus reloading the configuration reloads the
+ * list as well):
+ *
+ *   - a hash set of strings, stored back to back in a single arena and
+ *     looked up with open addressing, which works on length-delimited
+ *     values, so the value in the message is never copied.
+ *
+ *   - if the list contains network ranges (e.g. 10.0.0.0/8), an array of
+ *     sorted and coalesced address ranges that is searched with binary
+ *     search. IPv4 addresses are stored as IPv4-mapped IPv6 addresses, so
+ *     both families fit into the same array.
+ */
+
+typedef struct _InListEntry
+{
+  guint32 offset;
+  guint32 len;
+  guint32 hash;
+} InListEntry;
+
+typedef struct _InListHashSet
+{
+  GString *arena;
+  GArray *entries;
+  /* index + 1 of the entry, 0 is an empty bucket */
+  guint32 *buckets;
+  guint32 mask;
+} InListHashSet;
+
+typedef struct _InListAddressRange
+{
+  guint8 start[16];
+  guint8 end[16];
+} InListAddressRange;
 
 typedef struct _FilterInList
 {
   FilterExprNode super;
   NVHandle value_handle;
-  GTree *tree;
+  InListHashSet strings;
+  GArray *ranges;
 } FilterInList;
 
+/* FNV-1a */
+static inline guint32
+_hash_value(const gchar *value, gsize len)
+{
+  guint32 hash = 2166136261U;
+
+  for (gsize i = 0; i < len; i++)
+    {
+      hash ^= (guchar) value[i];
+      hash *= 16777619U;
+    }
+  return hash;
+}
+
+static gboolean
+_hash_set_lookup(InListHashSet *self, const gchar *value, gsize len, guint32 hash)
+{
+  if (!self->buckets)
+    return FALSE;
+
+  for (guint32 i = hash & self->mask; self->buckets[i]; i = (i + 1) & self->mask)
+    {
+      InListEntry *entry = &g_array_index(self->entries, InListEntry, self->buckets[i] - 1);
+
+      if (entry->hash == hash && entry->len == len && memcmp(self->arena->str + entry->offset, value, len) == 0)
+        return TRUE;
+    }
+  return FALSE;
+}
+
+static inline gboolean
+_hash_set_contains(InListHashSet *self, const gchar *value, gsize len)
+{
+  return _hash_set_lookup(self, value, len, _hash_value(value, len));
+}
+
+static void
+_hash_set_add(InListHashSet *self, const gchar *value, gsize len)
+{
+  InListEntry entry =
+  {
+    .offset = self->arena->len,
+    .len = len,
+    .hash = _hash_value(value, len),
+  };
+
+  g_string_append_len(self->arena, value, len);
+  g_array_append_val(self->entries, entry);
+}
+
+/* the buckets are only built once all the entries are known, keeping the load factor at most 50% */
+static void
+_hash_set_build(InListHashSet *self)
+{
+  guint32 num_buckets = 16;
+
+  while (num_buckets < self->entries->len * 2)
+    num_buckets *= 2;
+
+  self->buckets = g_new0(guint32, num_buckets);
+  self->mask = num_buckets - 1;
+
+  for (guint32 i = 0; i < self->entries->len; i++)
+    {
+      InListEntry *entry = &g_array_index(self->entries, InListEntry, i);
+      guint32 bucket;
+
+      if (_hash_set_lookup(self, self->arena->str + entry->offset, entry->len, entry->hash))
+        continue;
+
+      for (bucket = entry->hash & self->mask; self->buckets[bucket]; bucket = (bucket + 1) & self->mask)
+        ;
+      self->buckets[bucket] = i + 1;
+    }
+}
+
+static void
+_hash_set_init(InListHashSet *self)
+{
+  self->arena = g_string_sized_new(4096);
+  self->entries = g_array_new(FALSE, FALSE, sizeof(InListEntry));
+}
+
+static void
+_hash_set_destroy(InListHashSet *self)
+{
+  g_string_free(self->arena, TRUE);
+  g_array_free(self->entries, TRUE);
+  g_free(self->buckets);
+}
+
+/* parses an IPv4 or IPv6 address into its IPv4-mapped IPv6 form */
+static gboolean
+_parse_address(const gchar *value, guint8 address[16], gint *prefix_offset)
+{
+  struct in_addr ipv4;
+
+  if (inet_pton(AF_INET, value, &ipv4) == 1)
+    {
+      static const guint8 ipv4_mapped_prefix[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+
+      memcpy(address, ipv4_mapped_prefix, sizeof(ipv4_mapped_prefix));
+      memcpy(address + 12, &ipv4, 4);
+      *prefix_offset = 96;
+      return TRUE;
+    }
+
+#if SYSLOG_NG_ENABLE_IPV6
+  if (inet_pton(AF_INET6, value, address) == 1)
+    {
+      *prefix_offset = 0;
+      return TRUE;
+    }
+#endif
+
+  return FALSE;
+}
+
+static gboolean
+_parse_address_range(const gchar *line, InListAddressRange *range)
+{
+  gchar address_str[64];
+  const gchar *slash = strchr(line, '/');
+  gsize address_len = slash ? slash - line : strlen(line);
+  gint prefix_offset;
+  gint prefix_len = 128;
+
+  if (address_len >= sizeof(address_str))
+    return FALSE;
+
+  memcpy(address_str, line, address_len);
+  address_str[address_len] = '\0';
+  if (!_parse_address(address_str, range->start, &prefix_offset))
+    return FALSE;
+
+  if (slash)
+    {
+      gchar *end;
+      glong bits = strtol(slash + 1, &end, 10);
+
+      if (end == slash + 1 || *end || bits < 0 || bits > 128 - prefix_offset)
+        return FALSE;
+      prefix_len = prefix_offset + bits;
+    }
+
+  memcpy(range->end, range->start, sizeof(range->end));
+  for (gint bit = prefix_len; bit < 128; bit++)
+    {
+      range->start[bit / 8] &= ~(0x80 >> (bit % 8));
+      range->end[bit / 8] |= 0x80 >> (bit % 8);
+    }
+  return TRUE;
+}
+
+static gint
+_compare_address_ranges(gconstpointer a, gconstpointer b)
+{
+  return memcmp(((const InListAddressRange *) a)->start, ((const InListAddressRange *) b)->start, 16);
+}
+
+/* sort and merge the overlapping ranges, so that at most one of them can contain an address */
+static void
+_coalesce_address_ranges(GArray *ranges)
+{
+  guint merged = 0;
+
+  g_array_sort(ranges, _compare_address_ranges);
+  for (guint i = 0; i < ranges->len; i++)
+    {
+      InListAddressRange *range = &g_array_index(ranges, InListAddressRange, i);
+      InListAddressRange *last = merged ? &g_array_index(ranges, InListAddressRange, merged - 1) : NULL;
+
+      if (last && memcmp(range->start, last->end, 16) <= 0)
+        {
+          if (memcmp(range->end, last->end, 16) > 0)
+            memcpy(last->end, range->end, 16);
+          continue;
+        }
+      g_array_index(ranges, InListAddressRange, merged++) = *range;
+    }
+  g_array_set_size(ranges, merged);
+}
+
+static gboolean
+_ranges_contain(GArray *ranges, const gchar *value, gsize len)
+{
+  gchar address_str[64];
+  guint8 address[16];
+  gint prefix_offset;
+
+  if (len >= sizeof(address_str))
+    return FALSE;
+
+  memcpy(address_str, value, len);
+  address_str[len] = '\0';
+  if (!_parse_address(address_str, address, &prefix_offset))
+    return FALSE;
+
+  /* find the last range that starts at or before the address */
+  gint lo = 0, hi = ranges->len - 1;
+  while (lo <= hi)
+    {
+      gint mid = lo + (hi - lo) / 2;
+
+      if (memcmp(g_array_index(ranges, InListAddressRange, mid).start, address, 16) <= 0)
+        lo = mid + 1;
+      else
+        hi = mid - 1;
+    }
+  return hi >= 0 && memcmp(address, g_array_index(ranges, InListAddressRange, hi).end, 16) <= 0;
+}
+
 static gboolean
 filter_in_list_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEvalOptions *options)
 {
@@ -45,13 +296,17 @@ filter_in_list_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTempl
   LogMessage *msg = msgs[num_msg - 1];
   const gchar *value;
   gssize len = 0;
+  gboolean result;
 
   value = log_msg_get_value(msg, self->value_handle, &len);
-  APPEND_ZERO(value, value, len);
 
-  gboolean result = (g_tree_lookup(self->tree, value) != NULL);
+  if (self->ranges)
+    result = _ranges_contain(self->ranges, value, len);
+  else
+    result = _hash_set_contains(&self->strings, value, len);
+
   msg_trace("in-list() evaluation started",
-            evt_tag_str("value", value),
+            evt_tag_mem("value", value, len),
             evt_tag_msg_reference(msg));
 
   return result ^ s->comp;
@@ -62,7 +317,36 @@ filter_in_list_free(FilterExprNode *s)
 {
   FilterInList *self = (FilterInList *)s;
 
-  g_tree_destroy(self->tree);
+  _hash_set_destroy(&self->strings);
+  if (self->ranges)
+    g_array_free(self->ranges, TRUE);
+}
+
+/* switch to range lookups if the list contains networks and all entries are addresses */
+static void
+_convert_to_address_ranges(FilterInList *self, gboolean has_network)
+{
+  GArray *ranges;
+
+  if (!has_network)
+    return;
+
+  ranges = g_array_sized_new(FALSE, FALSE, sizeof(InListAddressRange), self->strings.entries->len);
+  for (guint i = 0; i < self->strings.entries->len; i++)
+    {
+      InListEntry *entry = &g_array_index(self->strings.entries, InListEntry, i);
+      InListAddressRange range;
+
+      if (!_parse_address_range(self->strings.arena->str + entry->offset, &range))
+        {
+          g_array_free(ranges, TRUE);
+          return;
+        }
+      g_array_append_val(ranges, range);
+    }
+
+  _coalesce_address_ranges(ranges);
+  self->ranges = ranges;
 }
 
 FilterExprNode *
@@ -71,6 +355,7 @@ filter_in_list_new(const gchar *list_file, const gchar *property)
   FilterInList *self;
   FILE *stream;
   gchar line[16384];
+  gboolean has_network = FALSE;
 
   stream = fopen(list_file, "r");
   if (!stream)
@@ -84,16 +369,32 @@ filter_in_list_new(const gchar *list_file, const gchar *property)
   self = g_new0(FilterInList, 1);
   filter_expr_node_init_instance(&self->super);
   self->value_handle = log_msg_get_value_handle(property);
-  self->tree = g_tree_new_full((GCompareDataFunc)strcmp, NULL, g_free, NULL);
+  _hash_set_init(&self->strings);
 
   while (fgets(line, sizeof(line), stream) != NULL)
     {
-      line[strlen(line) - 1] = '\0';
-      if (line[0])
-        g_tree_insert(self->tree, g_strdup(line), GINT_TO_POINTER(1));
+      gsize len = strlen(line);
+
+      if (len > 0 && line[len - 1] == '\n')
+        line[--len] = '\0';
+      if (!len)
+        continue;
+
+      /* entries are stored NUL terminated, so that they can be parsed as addresses */
+      _hash_set_add(&self->strings, line, len);
+      g_string_append_c(self->strings.arena, '\0');
+      has_network |= (strchr(line, '/') != NULL);
     }
   fclose(stream);
 
+  _convert_to_address_ranges(self, has_network);
+  if (self->ranges)
+    {
+      _hash_set_destroy(&self->strings);
+      _hash_set_init(&self->strings);
+    }
+  _hash_set_build(&self->strings);
+
   self->super.eval = filter_in_list_eval;
   self->super.free_fn = filter_in_list_free;
   return &self->super;
@@ -0,0 +1,410 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "filter-netmask-set.h"
+#include "gsocket.h"
+#include "logmsg/logmsg.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+/*
+ * The networks are stored in a path-compressed binary trie (a.k.a.
+ * Patricia trie): each node stores a prefix and only exists if it is a
+ * network itself or if the networks below it diverge at that bit, so the
+ * depth of the trie is bounded by the number of distinct prefix lengths
+ * on a path instead of the 128 bits of the address.
+ *
+ * IPv4 addresses are stored as IPv4-mapped IPv6 addresses, so both
+ * families live in the same trie. The nodes are allocated from a single
+ * array and refer to each other by index, which keeps the trie compact.
+ */
+
+#define IPV4_MAPPED_PREFIX_LEN 96
+
+typedef struct _NetmaskSetNode
+{
+  guint8 key[16];
+  guint8 prefix_len;
+  guint8 is_network;
+  /* index + 1 of the child nodes, 0 means there is no child */
+  guint32 children[2];
+} NetmaskSetNode;
+
+typedef struct _FilterNetmaskSet
+{
+  FilterExprNode super;
+  /* 0 means the source address of the message */
+  NVHandle value_handle;
+  GArray *nodes;
+  guint32 root;
+} FilterNetmaskSet;
+
+static const guint8 ipv4_mapped_prefix[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+
+static inline NetmaskSetNode *
+_node(FilterNetmaskSet *self, guint32 ref)
+{
+  return &g_array_index(self->nodes, NetmaskSetNode, ref - 1);
+}
+
+static inline gint
+_bit(const guint8 *key, gint pos)
+{
+  return (key[pos / 8] >> (7 - pos % 8)) & 1;
+}
+
+/* number of leading bits a and b have in common, at most max_len */
+static inline gint
+_common_prefix_len(const guint8 *a, const guint8 *b, gint max_len)
+{
+  gint len = 0;
+
+  for (gint i = 0; len < max_len; i++, len += 8)
+    {
+      guint8 diff = a[i] ^ b[i];
+
+      if (diff)
+        {
+          len += __builtin_clz(diff) - (sizeof(guint) * 8 - 8);
+          break;
+        }
+    }
+  return MIN(len, max_len);
+}
+
+static void
+_mask_key(guint8 key[16], gint prefix_len)
+{
+  if (prefix_len % 8)
+    key[prefix_len / 8] &= 0xff << (8 - prefix_len % 8);
+  for (gint i = (prefix_len + 7) / 8; i < 16; i++)
+    key[i] = 0;
+}
+
+static guint32
+_new_node(FilterNetmaskSet *self, const guint8 key[16], gint prefix_len, gboolean is_network)
+{
+  NetmaskSetNode node = { .prefix_len = prefix_len, .is_network = is_network };
+
+  memcpy(node.key, key, sizeof(node.key));
+  _mask_key(node.key, prefix_len);
+  g_array_append_val(self->nodes, node);
+  return self->nodes->len;
+}
+
+static void
+_set_child(FilterNetmaskSet *self, guint32 parent, gint side, guint32 child)
+{
+  if (parent)
+    _node(self, parent)->children[side] = child;
+  else
+    self->root = child;
+}
+
+static void
+_insert_network(FilterNetmaskSet *self, const guint8 key[16], gint prefix_len)
+{
+  guint32 parent = 0;
+  guint32 current = self->root;
+  gint side = 0;
+
+  while (current)
+    {
+      NetmaskSetNode *node = _node(self, current);
+      gint common = _common_prefix_len(node->key, key, MIN(node->prefix_len, prefix_len));
+
+      if (common < node->prefix_len)
+        {
+          /* the new network diverges from (or contains) this node, insert a
+           * new node at the point of divergence */
+          gint current_side = _bit(node->key, common);
+          guint32 leaf = common < prefix_len ? _new_node(self, key, prefix_len, TRUE) : 0;
+          guint32 split = _new_node(self, key, common, !leaf);
+
+          _node(self, split)->children[current_side] = current;
+          if (leaf)
+            _node(self, split)->children[!current_side] = leaf;
+          _set_child(self, parent, side, split);
+          return;
+        }
+
+      if (node->prefix_len == prefix_len)
+        {
+          node->is_network = TRUE;
+          return;
+        }
+
+      parent = current;
+      side = _bit(key, node->prefix_len);
+      current = node->children[side];
+    }
+  _set_child(self, parent, side, _new_node(self, key, prefix_len, TRUE));
+}
+
+/* returns the length of the longest matching network prefix or -1 if none of them matches */
+static gint
+_lookup_longest_prefix(FilterNetmaskSet *self, const guint8 address[16])
+{
+  guint32 current = self->root;
+  gint longest = -1;
+
+  while (current)
+    {
+      NetmaskSetNode *node = _node(self, current);
+
+      if (_common_prefix_len(node->key, address, node->prefix_len) < node->prefix_len)
+        break;
+      if (node->is_network)
+        longest = node->prefix_len;
+      if (node->prefix_len == 128)
+        break;
+      current = node->children[_bit(address, node->prefix_len)];
+    }
+  return longest;
+}
+
+static void
+_map_ipv4_address(const struct in_addr *ipv4, guint8 address[16])
+{
+  memcpy(address, ipv4_mapped_prefix, sizeof(ipv4_mapped_prefix));
+  memcpy(address + 12, ipv4, 4);
+}
+
+static gboolean
+_parse_address(const gchar *value, guint8 address[16], gboolean *is_ipv4)
+{
+  struct in_addr ipv4;
+
+  if (inet_pton(AF_INET, value, &ipv4) == 1)
+    {
+      _map_ipv4_address(&ipv4, address);
+      *is_ipv4 = TRUE;
+      return TRUE;
+    }
+
+#if SYSLOG_NG_ENABLE_IPV6
+  if (inet_pton(AF_INET6, value, address) == 1)
+    {
+      *is_ipv4 = FALSE;
+      return TRUE;
+    }
+#endif
+
+  return FALSE;
+}
+
+static gboolean
+_parse_address_len(const gchar *value, gsize len, guint8 address[16])
+{
+  gchar address_str[64];
+  gboolean is_ipv4;
+
+  if (len >= sizeof(address_str))
+    return FALSE;
+
+  memcpy(address_str, value, len);
+  address_str[len] = '\0';
+  return _parse_address(address_str, address, &is_ipv4);
+}
+
+/* the IPv4 netmask is accepted both as a prefix length and in dotted decimal form, like in netmask() */
+static gboolean
+_parse_prefix_len(const gchar *value, gboolean is_ipv4, gint *prefix_len)
+{
+  if (is_ipv4 && strchr(value, '.'))
+    {
+      struct in_addr netmask;
+
+      if (inet_pton(AF_INET, value, &netmask) != 1)
+        return FALSE;
+
+      guint32 mask = ntohl(netmask.s_addr);
+      gint bits = 0;
+
+      while (bits < 32 && (mask & (0x80000000U >> bits)))
+        bits++;
+
+      /* non-contiguous netmasks cannot be expressed as a prefix */
+      if (bits < 32 && (mask << bits) != 0)
+        return FALSE;
+      *prefix_len = IPV4_MAPPED_PREFIX_LEN + bits;
+      return TRUE;
+    }
+
+  gchar *end;
+  glong bits = strtol(value, &end, 10);
+  gint max_bits = is_ipv4 ? 32 : 128;
+
+  if (end == value || *end || bits < 0 || bits > max_bits)
+    return FALSE;
+
+  *prefix_len = (is_ipv4 ? IPV4_MAPPED_PREFIX_LEN : 0) + bits;
+  return TRUE;
+}
+
+static gboolean
+_parse_network(gchar *line, guint8 key[16], gint *prefix_len)
+{
+  gchar *slash = strchr(line, '/');
+  gboolean is_ipv4;
+
+  if (slash)
+    *slash = '\0';
+
+  if (!_parse_address(line, key, &is_ipv4))
+    return FALSE;
+
+  if (!slash)
+    {
+      *prefix_len = 128;
+      return TRUE;
+    }
+  return _parse_prefix_len(slash + 1, is_ipv4, prefix_len);
+}
+
+static gboolean
+_load_networks(FilterNetmaskSet *self, const gchar *list_file)
+{
+  FILE *stream;
+  gchar line[256];
+  gint lineno = 0;
+  gboolean result = TRUE;
+
+  stream = fopen(list_file, "r");
+  if (!stream)
+    {
+      msg_error("Error opening netmask-set filter list file",
+                evt_tag_str("file", list_file),
+                evt_tag_error("errno"));
+      return FALSE;
+    }
+
+  while (fgets(line, sizeof(line), stream) != NULL)
+    {
+      gchar *network = g_strstrip(line);
+      guint8 key[16];
+      gint prefix_len;
+
+      lineno++;
+      if (!network[0] || network[0] == '#')
+        continue;
+
+      if (!_parse_network(network, key, &prefix_len))
+        {
+          msg_error("Invalid network in netmask-set filter list file",
+                    evt_tag_str("file", list_file),
+                    evt_tag_int("line", lineno),
+                    evt_tag_str("network", network));
+          result = FALSE;
+          break;
+        }
+      _insert_network(self, key, prefix_len);
+    }
+  fclose(stream);
+  return result;
+}
+
+static gboolean
+_extract_address(FilterNetmaskSet *self, LogMessage *msg, guint8 address[16])
+{
+  if (self->value_handle)
+    {
+      gssize len = 0;
+      const gchar *value = log_msg_get_value(msg, self->value_handle, &len);
+
+      return _parse_address_len(value, len, address);
+    }
+
+  if (!msg->saddr || msg->saddr->sa.sa_family == AF_UNIX)
+    {
+      struct in_addr loopback = { .s_addr = htonl(INADDR_LOOPBACK) };
+
+      _map_ipv4_address(&loopback, address);
+      return TRUE;
+    }
+
+  if (g_sockaddr_inet_check(msg->saddr))
+    {
+      _map_ipv4_address(&((struct sockaddr_in *) &msg->saddr->sa)->sin_addr, address);
+      return TRUE;
+    }
+
+#if SYSLOG_NG_ENABLE_IPV6
+  if (g_sockaddr_inet6_check(msg->saddr))
+    {
+      memcpy(address, g_sockaddr_inet6_get_address(msg->saddr), 16);
+      return TRUE;
+    }
+#endif
+
+  return FALSE;
+}
+
+static gboolean
+filter_netmask_set_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEvalOptions *options)
+{
+  FilterNetmaskSet *self = (FilterNetmaskSet *) s;
+  LogMessage *msg = msgs[num_msg - 1];
+  guint8 address[16];
+  gint prefix_len = -1;
+
+  if (_extract_address(self, msg, address))
+    prefix_len = _lookup_longest_prefix(self, address);
+
+  msg_trace("netmask-set() evaluation started",
+            evt_tag_int("matching_prefix_len", prefix_len),
+            evt_tag_msg_reference(msg));
+  return (prefix_len >= 0) ^ s->comp;
+}
+
+static void
+filter_netmask_set_free(FilterExprNode *s)
+{
+  FilterNetmaskSet *self = (FilterNetmaskSet *) s;
+
+  g_array_free(self->nodes, TRUE);
+}
+
+FilterExprNode *
+filter_netmask_set_new(const gchar *list_file, const gchar *property)
+{
+  FilterNetmaskSet *self = g_new0(FilterNetmaskSet, 1);
+
+  filter_expr_node_init_instance(&self->super);
+  self->super.eval = filter_netmask_set_eval;
+  self->super.free_fn = filter_netmask_set_free;
+  self->nodes = g_array_new(FALSE, FALSE, sizeof(NetmaskSetNode));
+  if (property)
+    self->value_handle = log_msg_get_value_handle(property);
+
+  if (!_load_networks(self, list_file))
+    {
+      filter_expr_unref(&self->super);
+      return NULL;
+    }
+  return &self->super;
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#ifndef FILTER_NETMASK_SET_H_INCLUDED
+#define FILTER_NETMASK_SET_H_INCLUDED
+
+#include "filter-expr.h"
+
+/*
+ * netmask-set() matches an address against a set of networks loaded from
+ * a file (one address or CIDR per line). The networks are stored in a
+ * path-compressed binary trie, so a single longest-prefix lookup decides
+ * the result, independently of the number of networks.
+ *
+ * If property is NULL, the source address of the message is used,
+ * otherwise the value of the given name-value pair is parsed as an
+ * address.
+ */
+FilterExprNode *filter_netmask_set_new(const gchar *list_file, const gchar *property);
+
+#endif
@@ -22,6 +22,7 @@
  *
  */
 #include "filter-op.h"
+#include "filter-re.h"
 
 typedef struct _FilterOp
 {
@@ -69,12 +70,23 @@ fop_clone(FilterExprNode *s)
   cloned_self->super.free_fn = fop_free;
   cloned_self->super.clone = fop_clone;
   cloned_self->super.eval = self->super.eval;
+  cloned_self->super.optimize = self->super.optimize;
   cloned_self->left = filter_expr_clone(self->left);
   cloned_self->right = filter_expr_clone(self->right);
   cloned_self->super.type = g_strdup(self->super.type);
   return &cloned_self->super;
 }
 
+static FilterExprNode *
+fop_optimize(FilterExprNode *s)
+{
+  FilterOp *self = (FilterOp *) s;
+
+  self->left = filter_expr_optimize(self->left);
+  self->right = filter_expr_optimize(self->right);
+  return s;
+}
+
 static void
 fop_init_instance(FilterOp *self)
 {
@@ -82,6 +94,7 @@ fop_init_instance(FilterOp *self)
   self->super.init = fop_init;
   self->super.free_fn = fop_free;
   self->super.clone = fop_clone;
+  self->super.optimize = fop_optimize;
 }
 
 static gboolean
@@ -93,6 +106,84 @@ fop_or_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEvalO
           || filter_expr_eval_with_context(self->right, msgs, num_msg, options)) ^ s->comp;
 }
 
+static gboolean
+_is_or_chain_link(FilterExprNode *s)
+{
+  return s->eval == fop_or_eval && !s->comp && s->ref_cnt == 1;
+}
+
+/* takes over the operands of the nested, non-negated OR nodes */
+static void
+_flatten_or_chain(FilterOp *self, GPtrArray *branches)
+{
+  FilterExprNode *operands[] = { self->left, self->right };
+
+  self->left = self->right = NULL;
+  for (gint i = 0; i < G_N_ELEMENTS(operands); i++)
+    {
+      if (_is_or_chain_link(operands[i]))
+        {
+          _flatten_or_chain((FilterOp *) operands[i], branches);
+          filter_expr_unref(operands[i]);
+        }
+      else
+        {
+          g_ptr_array_add(branches, filter_expr_optimize(operands[i]));
+        }
+    }
+}
+
+/* replaces consecutive regexp filters on the same value with a single node */
+static void
+_combine_regexp_branches(GPtrArray *branches)
+{
+  for (gint start = 0; start < branches->len; start++)
+    {
+      FilterExprNode **run = (FilterExprNode **) &branches->pdata[start];
+      gint run_len = 1;
+
+      while (start + run_len < branches->len && filter_re_can_combine(run[0], run[run_len]))
+        run_len++;
+
+      if (run_len < 2)
+        continue;
+
+      FilterExprNode *combined = filter_re_set_new(run, run_len);
+      if (!combined)
+        continue;
+
+      run[0] = combined;
+      g_ptr_array_remove_range(branches, start + 1, run_len - 1);
+    }
+}
+
+/*
+ * OR chains are evaluated one operand after the other, which is costly
+ * with hundreds of message("...") alternatives. Flatten the chain, merge
+ * the combinable regexp operands and rebuild it from what remains.
+ */
+static FilterExprNode *
+fop_or_optimize(FilterExprNode *s)
+{
+  FilterOp *self = (FilterOp *) s;
+
+  if (s->ref_cnt != 1)
+    return fop_optimize(s);
+
+  GPtrArray *branches = g_ptr_array_new();
+  _flatten_or_chain(self, branches);
+  _combine_regexp_branches(branches);
+
+  FilterExprNode *result = g_ptr_array_index(branches, 0);
+  for (gint i = 1; i < branches->len; i++)
+    result = fop_or_new(result, g_ptr_array_index(branches, i));
+  g_ptr_array_free(branches, TRUE);
+
+  result->comp = s->comp;
+  filter_expr_unref(s);
+  return result;
+}
+
 FilterExprNode *
 fop_or_new(FilterExprNode *e1, FilterExprNode *e2)
 {
@@ -100,6 +191,7 @@ fop_or_new(FilterExprNode *e1, FilterExprNode *e2)
 
   fop_init_instance(self);
   self->super.eval = fop_or_eval;
+  self->super.optimize = fop_or_optimize;
   self->left = e1;
   self->right = e2;
   self->super.type = g_strdup("OR");
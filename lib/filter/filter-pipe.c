@@ -35,6 +35,7 @@ log_filter_pipe_init(LogPipe *s)
   LogFilterPipe *self = (LogFilterPipe *) s;
   GlobalConfig *cfg = log_pipe_get_config(s);
 
+  self->expr = filter_expr_optimize(self->expr);
   if (!filter_expr_init(self->expr, cfg))
     return FALSE;
 
@@ -53,24 +54,23 @@ log_filter_pipe_init(LogPipe *s)
   return TRUE;
 }
 
-static void
-log_filter_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+static gboolean
+log_filter_pipe_eval(LogFilterPipe *self, LogMessage **pmsg, const LogPathOptions *path_options)
 {
-  LogFilterPipe *self = (LogFilterPipe *) s;
+  LogPipe *s = &self->super;
   gboolean res;
   gchar *filter_result;
 
   msg_trace(">>>>>> filter rule evaluation begin",
             evt_tag_str("rule", self->name),
             log_pipe_location_tag(s),
-            evt_tag_msg_reference(msg));
+            evt_tag_msg_reference(*pmsg));
 
-  res = filter_expr_eval_root(self->expr, &msg, path_options);
+  res = filter_expr_eval_root(self->expr, pmsg, path_options);
 
   if (res)
     {
       filter_result = "MATCH - Forwarding message to the next LogPipe";
-      log_pipe_forward_msg(s, msg, path_options);
       stats_counter_inc(self->matched);
     }
   else
@@ -78,14 +78,45 @@ log_filter_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_op
       filter_result = "UNMATCHED - Dropping message from LogPipe";
       if (path_options->matched)
         (*path_options->matched) = FALSE;
-      log_msg_drop(msg, path_options, AT_PROCESSED);
       stats_counter_inc(self->not_matched);
     }
   msg_trace("<<<<<< filter rule evaluation result",
             evt_tag_str("result", filter_result),
             evt_tag_str("rule", self->name),
             log_pipe_location_tag(s),
-            evt_tag_msg_reference(msg));
+            evt_tag_msg_reference(*pmsg));
+  return res;
+}
+
+static void
+log_filter_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogFilterPipe *self = (LogFilterPipe *) s;
+
+  if (log_filter_pipe_eval(self, &msg, path_options))
+    log_pipe_forward_msg(s, msg, path_options);
+  else
+    log_msg_drop(msg, path_options, AT_PROCESSED);
+}
+
+/* matching messages are compacted to the front of the batch and forwarded together */
+static void
+log_filter_pipe_queue_batch(LogPipe *s, LogMessage **msgs, gint num_msgs, const LogPathOptions *path_options)
+{
+  LogFilterPipe *self = (LogFilterPipe *) s;
+  gint num_matched = 0;
+
+  for (gint i = 0; i < num_msgs; i++)
+    {
+      LogMessage *msg = msgs[i];
+
+      if (log_filter_pipe_eval(self, &msg, path_options))
+        msgs[num_matched++] = msg;
+      else
+        log_msg_drop(msg, path_options, AT_PROCESSED);
+    }
+
+  log_pipe_forward_msgs(s, msgs, num_matched, path_options);
 }
 
 static LogPipe *
@@ -127,6 +158,7 @@ log_filter_pipe_new(FilterExprNode *expr, GlobalConfig *cfg)
   self->super.flags |= PIF_CONFIG_RELATED;
   self->super.init = log_filter_pipe_init;
   self->super.queue = log_filter_pipe_queue;
+  self->super.queue_batch = log_filter_pipe_queue_batch;
   self->super.free_fn = log_filter_pipe_free;
   self->super.clone = log_filter_pipe_clone;
   self->expr = expr;
@@ -26,6 +26,7 @@
 #include "str-utils.h"
 #include "messages.h"
 #include "scratch-buffers.h"
+#include "stats/stats-cluster-logpipe.h"
 #include <string.h>
 
 typedef struct _FilterRE
@@ -247,3 +248,184 @@ filter_match_new(void)
   self->super.super.free_fn = filter_match_free;
   return &self->super.super;
 }
+
+/*
+ * FilterRESet evaluates an OR chain of regexp filters on the same
+ * name-value pair with a single LogMultiMatcher. The original branches are
+ * kept around, each of them has its matched/not_matched counters
+ * registered (at stats level 3) labelled by the name-value pair and the
+ * pattern of the branch.
+ */
+typedef struct _FilterRESet
+{
+  FilterExprNode super;
+  NVHandle value_handle;
+  LogMultiMatcher *matcher;
+  GPtrArray *branches;
+  /* the node may be shared (e.g. via filter() references), so init() may be called more than once */
+  gboolean counters_registered;
+} FilterRESet;
+
+static gboolean
+_is_filter_re(FilterExprNode *s)
+{
+  return s->free_fn == filter_re_free || s->free_fn == filter_match_free;
+}
+
+/* value_handle is 0 for match() without value(), which evaluates a template */
+static NVHandle
+_get_combinable_value_handle(FilterExprNode *s)
+{
+  if (!_is_filter_re(s) || s->comp)
+    return 0;
+
+  FilterRE *self = (FilterRE *) s;
+  if (s->free_fn == filter_match_free && ((FilterMatch *) s)->template)
+    return 0;
+
+  return self->value_handle;
+}
+
+gboolean
+filter_re_can_combine(FilterExprNode *s, FilterExprNode *other)
+{
+  NVHandle value_handle = _get_combinable_value_handle(s);
+
+  if (!value_handle || value_handle != _get_combinable_value_handle(other))
+    return FALSE;
+
+  return log_matcher_can_combine(((FilterRE *) s)->matcher, ((FilterRE *) other)->matcher);
+}
+
+static gboolean
+filter_re_set_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEvalOptions *options)
+{
+  FilterRESet *self = (FilterRESet *) s;
+  LogMessage *msg = msgs[num_msg - 1];
+  gssize value_len;
+  const gchar *value = log_msg_get_value(msg, self->value_handle, &value_len);
+  gint matched_index;
+  gboolean result;
+
+  msg_trace("match() evaluation started against a name-value pair with a combined pattern",
+            evt_tag_msg_value_name("name", self->value_handle),
+            evt_tag_msg_value("value", msg, self->value_handle),
+            evt_tag_int("patterns", self->branches->len),
+            evt_tag_msg_reference(msg));
+
+  result = log_multi_matcher_match(self->matcher, value, value_len, &matched_index);
+  if (result)
+    {
+      if (matched_index >= 0 && matched_index < self->branches->len)
+        {
+          FilterExprNode *branch = g_ptr_array_index(self->branches, matched_index);
+          stats_counter_inc(branch->matched);
+        }
+    }
+  else
+    {
+      for (gint i = 0; i < self->branches->len; i++)
+        {
+          FilterExprNode *branch = g_ptr_array_index(self->branches, i);
+          stats_counter_inc(branch->not_matched);
+        }
+    }
+  return result ^ s->comp;
+}
+
+static void
+_branch_stats_key_set(FilterRESet *self, FilterExprNode *branch, StatsClusterKey *sc_key, StatsClusterLabel *labels)
+{
+  labels[0] = stats_cluster_label("value", log_msg_get_value_name(self->value_handle, NULL));
+  labels[1] = stats_cluster_label("pattern", ((FilterRE *) branch)->matcher->pattern);
+  stats_cluster_logpipe_key_set(sc_key, "filter_regexp_branch_events_total", labels, 2);
+}
+
+static gboolean
+filter_re_set_init(FilterExprNode *s, GlobalConfig *cfg)
+{
+  FilterRESet *self = (FilterRESet *) s;
+
+  if (self->counters_registered)
+    return TRUE;
+
+  stats_lock();
+  for (gint i = 0; i < self->branches->len; i++)
+    {
+      FilterExprNode *branch = g_ptr_array_index(self->branches, i);
+      StatsClusterKey sc_key;
+      StatsClusterLabel labels[2];
+
+      _branch_stats_key_set(self, branch, &sc_key, labels);
+      stats_register_counter(STATS_LEVEL3, &sc_key, SC_TYPE_MATCHED, &branch->matched);
+      stats_register_counter(STATS_LEVEL3, &sc_key, SC_TYPE_NOT_MATCHED, &branch->not_matched);
+    }
+  stats_unlock();
+
+  self->counters_registered = TRUE;
+  return TRUE;
+}
+
+static void
+filter_re_set_free(FilterExprNode *s)
+{
+  FilterRESet *self = (FilterRESet *) s;
+
+  stats_lock();
+  for (gint i = 0; i < self->branches->len; i++)
+    {
+      FilterExprNode *branch = g_ptr_array_index(self->branches, i);
+      StatsClusterKey sc_key;
+      StatsClusterLabel labels[2];
+
+      _branch_stats_key_set(self, branch, &sc_key, labels);
+      stats_unregister_counter(&sc_key, SC_TYPE_MATCHED, &branch->matched);
+      stats_unregister_counter(&sc_key, SC_TYPE_NOT_MATCHED, &branch->not_matched);
+    }
+  stats_unlock();
+
+  log_multi_matcher_free(self->matcher);
+  g_ptr_array_free(self->branches, TRUE);
+}
+
+/*
+ * Takes over the references to the branches on success. Returns NULL if
+ * the combined pattern cannot be compiled, in which case the branches
+ * should be evaluated one by one, as before.
+ */
+FilterExprNode *
+filter_re_set_new(FilterExprNode **branches, gint num_branches)
+{
+  LogMultiMatcher *matcher = log_multi_matcher_new();
+  GError *error = NULL;
+
+  for (gint i = 0; i < num_branches; i++)
+    {
+      g_assert(i == 0 || filter_re_can_combine(branches[0], branches[i]));
+      if (!log_multi_matcher_add(matcher, ((FilterRE *) branches[i])->matcher))
+        g_assert_not_reached();
+    }
+
+  if (!log_multi_matcher_compile(matcher, &error))
+    {
+      msg_debug("Unable to combine regexp filters, evaluating them one by one",
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+      log_multi_matcher_free(matcher);
+      return NULL;
+    }
+
+  FilterRESet *self = g_new0(FilterRESet, 1);
+  filter_expr_node_init_instance(&self->super);
+  self->super.init = filter_re_set_init;
+  self->super.eval = filter_re_set_eval;
+  self->super.free_fn = filter_re_set_free;
+  self->super.type = "regexp-set";
+  self->value_handle = ((FilterRE *) branches[0])->value_handle;
+  self->matcher = matcher;
+  self->branches = g_ptr_array_new_with_free_func((GDestroyNotify) filter_expr_unref);
+  for (gint i = 0; i < num_branches; i++)
+    g_ptr_array_add(self->branches, branches[i]);
+
+  return &self->super;
+}
@@ -39,4 +39,7 @@ void filter_match_set_value_handle(FilterExprNode *s, NVHandle value_handle);
 void filter_match_set_template_ref(FilterExprNode *s, LogTemplate *template);
 FilterExprNode *filter_match_new(void);
 
+gboolean filter_re_can_combine(FilterExprNode *s, FilterExprNode *other);
+FilterExprNode *filter_re_set_new(FilterExprNode **branches, gint num_branches);
+
 #endif
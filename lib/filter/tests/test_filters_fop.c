@@ -31,6 +31,7 @@
 #include "filter/filter-expr-parser.h"
 #include "cfg-lexer.h"
 #include "apphook.h"
+#include "stats/stats-cluster-logpipe.h"
 
 static FilterExprNode *
 _compile_standalone_filter(gchar *config_snippet)
@@ -104,4 +105,115 @@ Test(filter_op, cloned_filter_with_negation_should_behave_the_same)
   testcase(msg, cloned_filter, TRUE);
 }
 
+ParameterizedTestParameters(filter_op, test_optimized_or_chain_evaluation)
+{
+  static FilterParams test_data_list[] =
+  {
+    {.config_snippet = "message('PTHREAD') or message('nomatch') or message('nomatch2')", .expected_result = TRUE },
+    {.config_snippet = "message('nomatch') or message('nomatch2') or message('initialized$')", .expected_result = TRUE },
+    {.config_snippet = "message('nomatch') or message('nomatch2') or message('nomatch3')", .expected_result = FALSE },
+    {.config_snippet = "message('pthread' flags(ignore-case)) or message('nomatch')", .expected_result = TRUE },
+    {.config_snippet = "message('nomatch') or message('pthread')", .expected_result = FALSE },
+    {.config_snippet = "message('PTHREAD support' type(string) flags(prefix)) or message('nomatch')", .expected_result = TRUE },
+    {.config_snippet = "message('support' type(string) flags(prefix)) or message('nomatch')", .expected_result = FALSE },
+    {.config_snippet = "message('support' type(string) flags(substring)) or message('nomatch')", .expected_result = TRUE },
+    {.config_snippet = "message('x.y' type(string) flags(substring)) or message('nomatch')", .expected_result = FALSE },
+    {.config_snippet = "not (message('nomatch') or message('PTHREAD'))", .expected_result = FALSE },
+    {.config_snippet = "message('nomatch') or program('openvpn') or message('nomatch2')", .expected_result = TRUE },
+    {.config_snippet = "message('(a)\\1') or message('nomatch') or message('PTHREAD')", .expected_result = TRUE },
+    {.config_snippet = "message('PTHREAD(*COMMIT)x') or message('initialized')", .expected_result = TRUE },
+    {.config_snippet = "message('\\Qsupport') or message('nomatch')", .expected_result = TRUE },
+    {.config_snippet = "message('nomatch') or program('nomatch') or message('nomatch2')", .expected_result = FALSE },
+  };
+
+  return cr_make_param_array(FilterParams, test_data_list, G_N_ELEMENTS(test_data_list));
+}
+
+ParameterizedTest(FilterParams *params, filter_op, test_optimized_or_chain_evaluation)
+{
+  const gchar *msg = "<16> openvpn[2499]: PTHREAD support initialized";
+  FilterExprNode *filter = filter_expr_optimize(_compile_standalone_filter(params->config_snippet));
+  testcase(msg, filter, params->expected_result);
+}
+
+Test(filter_op, or_chain_of_regexps_on_the_same_value_is_combined)
+{
+  FilterExprNode *filter = filter_expr_optimize(_compile_standalone_filter(
+                                                  "message('a') or message('b') or message('c' type(string))"));
+  cr_assert_str_eq(filter->type, "regexp-set");
+  filter_expr_unref(filter);
+
+  filter = filter_expr_optimize(_compile_standalone_filter("message('a') or program('b') or message('c')"));
+  cr_assert_str_eq(filter->type, "OR");
+  filter_expr_unref(filter);
+
+  filter = filter_expr_optimize(_compile_standalone_filter("message('a' flags(store-matches)) or message('b')"));
+  cr_assert_str_eq(filter->type, "OR");
+  filter_expr_unref(filter);
+
+  filter = filter_expr_optimize(_compile_standalone_filter("message('a(*COMMIT)b') or message('c')"));
+  cr_assert_str_eq(filter->type, "OR");
+  filter_expr_unref(filter);
+
+  filter = filter_expr_optimize(_compile_standalone_filter("message('a(*SKIP)(*F)|b') or message('c')"));
+  cr_assert_str_eq(filter->type, "OR");
+  filter_expr_unref(filter);
+
+  filter = filter_expr_optimize(_compile_standalone_filter("message('a\\Qb.') or message('c')"));
+  cr_assert_str_eq(filter->type, "OR");
+  filter_expr_unref(filter);
+}
+
+static gsize
+_get_branch_counter(const gchar *pattern, gint type)
+{
+  StatsClusterKey sc_key;
+  StatsClusterLabel labels[] =
+  {
+    stats_cluster_label("value", "MESSAGE"),
+    stats_cluster_label("pattern", pattern),
+  };
+  gsize value;
+
+  stats_cluster_logpipe_key_set(&sc_key, "filter_regexp_branch_events_total", labels, G_N_ELEMENTS(labels));
+
+  stats_lock();
+  {
+    StatsCluster *sc = stats_get_cluster(&sc_key);
+    cr_assert(sc, "No counters registered for branch: %s", pattern);
+    value = stats_counter_get(stats_cluster_get_counter(sc, type));
+  }
+  stats_unlock();
+
+  return value;
+}
+
+Test(filter_op, combined_or_chain_accounts_the_matching_branch)
+{
+  configuration->stats_options.level = STATS_LEVEL3;
+  stats_reinit(&configuration->stats_options);
+
+  FilterExprNode *filter = filter_expr_optimize(_compile_standalone_filter(
+                                                  "message('nomatch') or message('PTHREAD') or message('nomatch2')"));
+  cr_assert_str_eq(filter->type, "regexp-set");
+  cr_assert(filter_expr_init(filter, configuration));
+
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_value(msg, LM_V_MESSAGE, "PTHREAD support initialized", -1);
+  cr_assert(filter_expr_eval(filter, msg));
+  cr_assert(filter_expr_eval(filter, msg));
+  log_msg_set_value(msg, LM_V_MESSAGE, "something else", -1);
+  cr_assert_not(filter_expr_eval(filter, msg));
+  log_msg_unref(msg);
+
+  cr_assert_eq(_get_branch_counter("nomatch", SC_TYPE_MATCHED), 0);
+  cr_assert_eq(_get_branch_counter("PTHREAD", SC_TYPE_MATCHED), 2);
+  cr_assert_eq(_get_branch_counter("nomatch2", SC_TYPE_MATCHED), 0);
+  cr_assert_eq(_get_branch_counter("nomatch", SC_TYPE_NOT_MATCHED), 1);
+  cr_assert_eq(_get_branch_counter("PTHREAD", SC_TYPE_NOT_MATCHED), 1);
+  cr_assert_eq(_get_branch_counter("nomatch2", SC_TYPE_NOT_MATCHED), 1);
+
+  filter_expr_unref(filter);
+}
+
 TestSuite(filter_op, .init = setup, .fini = teardown);
@@ -40,6 +40,9 @@
 #define MSG_1 "<15>Sep  4 15:03:55 localhost test-program[3086]: some random message"
 #define MSG_2 "<15>Sep  4 15:03:55 localhost foo[3086]: some random message"
 #define MSG_3 "<15>Sep  4 15:03:55 192.168.1.1 foo[3086]: some random message"
+#define MSG_4 "<15>Sep  4 15:03:55 10.20.30.40 foo[3086]: some random message"
+#define MSG_5 "<15>Sep  4 15:03:55 172.32.0.1 foo[3086]: some random message"
+#define MSG_6 "<15>Sep  4 15:03:55 2001:db8:1::5 foo[3086]: some random message"
 #define MSG_LONG "<15>Sep  4 15:03:55 test-hostAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA foo[3086]: some random message"
 
 #define LIST_FILE_DIR "%s/lib/filter/tests/filters-in-list/"
@@ -129,6 +132,36 @@ Test(template_filters, test_filter_with_long_line)
   g_free(list_file_with_long_line);
 }
 
+Test(template_filters, test_filter_with_network_ranges)
+{
+  gchar *list_file_with_networks = g_strdup_printf(LIST_FILE_DIR "cidr.list", top_srcdir);
+
+  cr_assert(evaluate_testcase(MSG_3, filter_in_list_new(list_file_with_networks, "HOST")),
+            "in-list filter should match a single address in a network list");
+  cr_assert(evaluate_testcase(MSG_4, filter_in_list_new(list_file_with_networks, "HOST")),
+            "in-list filter should match an address within a network");
+  cr_assert_not(evaluate_testcase(MSG_5, filter_in_list_new(list_file_with_networks, "HOST")),
+                "in-list filter matches an address outside of all networks");
+  cr_assert_not(evaluate_testcase(MSG_1, filter_in_list_new(list_file_with_networks, "HOST")),
+                "in-list filter matches a value which is not an address");
+  g_free(list_file_with_networks);
+}
+
+#if SYSLOG_NG_ENABLE_IPV6
+Test(template_filters, test_filter_with_ipv6_network_ranges)
+{
+  gchar *list_file_with_networks = g_strdup_printf(LIST_FILE_DIR "cidr6.list", top_srcdir);
+
+  cr_assert(evaluate_testcase(MSG_6, filter_in_list_new(list_file_with_networks, "HOST")),
+            "in-list filter should match an IPv6 address within a network");
+  cr_assert(evaluate_testcase(MSG_4, filter_in_list_new(list_file_with_networks, "HOST")),
+            "in-list filter should match an IPv4 address within a network");
+  cr_assert_not(evaluate_testcase(MSG_5, filter_in_list_new(list_file_with_networks, "HOST")),
+                "in-list filter matches an address outside of all networks");
+  g_free(list_file_with_networks);
+}
+#endif
+
 static void
 setup(void)
 {
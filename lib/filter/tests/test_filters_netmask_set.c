@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include <criterion/parameterized.h>
+#include "libtest/stopwatch.h"
+#include "test_filters_common.h"
+
+#include "filter/filter-netmask-set.h"
+#include "filter/filter-netmask.h"
+#include "filter/filter-op.h"
+#include "logmsg/logmsg.h"
+#include "gsockaddr.h"
+#include "cfg.h"
+
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define LIST_FILE_DIR TOP_SRCDIR "/lib/filter/tests/filters-netmask-set/"
+
+#define MSG_LOCALHOST "<15>Oct 15 16:19:01 localhost openvpn[2499]: PTHREAD support initialized"
+#define MSG_IP_HOST "<15>Oct 15 16:19:01 10.20.30.40 openvpn[2499]: PTHREAD support initialized"
+#define MSG_OTHER_IP_HOST "<15>Oct 15 16:19:01 172.32.0.1 openvpn[2499]: PTHREAD support initialized"
+
+TestSuite(filter, .init = setup, .fini = teardown);
+
+typedef struct _FilterParamNetmaskSet
+{
+  const gchar *list_file;
+  const gchar *sockaddr;
+  gboolean    expected_result;
+} FilterParamNetmaskSet;
+
+ParameterizedTestParameters(filter, test_filter_netmask_set_saddr)
+{
+  static FilterParamNetmaskSet test_data_list[] =
+  {
+    {.list_file = LIST_FILE_DIR "networks.list", .sockaddr = "10.10.0.1", .expected_result = TRUE},
+    {.list_file = LIST_FILE_DIR "networks.list", .sockaddr = "10.20.30.40", .expected_result = TRUE},
+    {.list_file = LIST_FILE_DIR "networks.list", .sockaddr = "172.31.255.255", .expected_result = TRUE},
+    {.list_file = LIST_FILE_DIR "networks.list", .sockaddr = "172.32.0.1", .expected_result = FALSE},
+    {.list_file = LIST_FILE_DIR "networks.list", .sockaddr = "192.168.1.1", .expected_result = TRUE},
+    {.list_file = LIST_FILE_DIR "networks.list", .sockaddr = "192.168.1.2", .expected_result = FALSE},
+    {.list_file = LIST_FILE_DIR "networks.list", .sockaddr = "8.8.8.8", .expected_result = FALSE},
+    {.list_file = LIST_FILE_DIR "networks.list", .sockaddr = NULL, .expected_result = TRUE},
+#if SYSLOG_NG_ENABLE_IPV6
+    {.list_file = LIST_FILE_DIR "networks6.list", .sockaddr = "2001:db8:1:ffff::1", .expected_result = TRUE},
+    {.list_file = LIST_FILE_DIR "networks6.list", .sockaddr = "2001:db8:2::1", .expected_result = FALSE},
+    {.list_file = LIST_FILE_DIR "networks6.list", .sockaddr = "::1", .expected_result = TRUE},
+    {.list_file = LIST_FILE_DIR "networks6.list", .sockaddr = "::2", .expected_result = FALSE},
+    {.list_file = LIST_FILE_DIR "networks6.list", .sockaddr = "::ffff:10.1.2.3", .expected_result = TRUE},
+    {.list_file = LIST_FILE_DIR "networks6.list", .sockaddr = "10.1.2.3", .expected_result = TRUE},
+    {.list_file = LIST_FILE_DIR "networks6.list", .sockaddr = "11.1.2.3", .expected_result = FALSE},
+#endif
+  };
+
+  return cr_make_param_array(FilterParamNetmaskSet, test_data_list, G_N_ELEMENTS(test_data_list));
+}
+
+ParameterizedTest(FilterParamNetmaskSet *param, filter, test_filter_netmask_set_saddr)
+{
+  testcase_with_socket(MSG_LOCALHOST, param->sockaddr, filter_netmask_set_new(param->list_file, NULL),
+                       param->expected_result);
+}
+
+Test(filter, test_filter_netmask_set_value)
+{
+  testcase(MSG_IP_HOST, filter_netmask_set_new(LIST_FILE_DIR "networks.list", "HOST"), TRUE);
+  testcase(MSG_OTHER_IP_HOST, filter_netmask_set_new(LIST_FILE_DIR "networks.list", "HOST"), FALSE);
+
+  /* values that are not addresses never match */
+  testcase(MSG_LOCALHOST, filter_netmask_set_new(LIST_FILE_DIR "networks.list", "HOST"), FALSE);
+}
+
+Test(filter, test_filter_netmask_set_with_invalid_list_file)
+{
+  cr_assert_null(filter_netmask_set_new(LIST_FILE_DIR "invalid.list", NULL));
+  cr_assert_null(filter_netmask_set_new(LIST_FILE_DIR "does-not-exist.list", NULL));
+}
+
+#define BENCHMARK_NUM_NETWORKS 1000
+#define BENCHMARK_NUM_MESSAGES 256
+#define BENCHMARK_ITERATIONS 100
+
+static gchar *
+_generate_networks(GRand *rand, guint32 *networks)
+{
+  GString *list = g_string_new("");
+
+  for (gint i = 0; i < BENCHMARK_NUM_NETWORKS; i++)
+    {
+      networks[i] = g_rand_int(rand) & 0xffffff00;
+      g_string_append_printf(list, "%u.%u.%u.0/24\n",
+                             networks[i] >> 24, (networks[i] >> 16) & 0xff, (networks[i] >> 8) & 0xff);
+    }
+  return g_string_free(list, FALSE);
+}
+
+static FilterExprNode *
+_create_netmask_or_chain(const gchar *networks)
+{
+  gchar **lines = g_strsplit(networks, "\n", -1);
+  FilterExprNode *chain = NULL;
+
+  for (gint i = 0; lines[i] && lines[i][0]; i++)
+    {
+      FilterExprNode *netmask = filter_netmask_new(lines[i]);
+      chain = chain ? fop_or_new(chain, netmask) : netmask;
+    }
+  g_strfreev(lines);
+  return chain;
+}
+
+static FilterExprNode *
+_create_netmask_set(const gchar *networks)
+{
+  gchar *list_file;
+  gint fd = g_file_open_tmp("netmask-set-XXXXXX.list", &list_file, NULL);
+
+  cr_assert(fd >= 0);
+  close(fd);
+  cr_assert(g_file_set_contents(list_file, networks, -1, NULL));
+
+  FilterExprNode *filter = filter_netmask_set_new(list_file, NULL);
+  g_unlink(list_file);
+  g_free(list_file);
+  return filter;
+}
+
+static void
+_generate_messages(GRand *rand, const guint32 *networks, LogMessage **msgs)
+{
+  for (gint i = 0; i < BENCHMARK_NUM_MESSAGES; i++)
+    {
+      /* every other message is sent from one of the networks */
+      guint32 address = (i % 2)
+                        ? networks[g_rand_int_range(rand, 0, BENCHMARK_NUM_NETWORKS)] | g_rand_int_range(rand, 1, 255)
+                        : g_rand_int(rand);
+      struct sockaddr_in sin = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(address) };
+
+      msgs[i] = log_msg_new_empty();
+      log_msg_set_saddr_ref(msgs[i], g_sockaddr_inet_new2(&sin));
+    }
+}
+
+static gint
+_perftest_filter(FilterExprNode *filter, LogMessage **msgs, const gchar *filter_name)
+{
+  gint matches = 0;
+
+  cr_assert(filter_expr_init(filter, configuration));
+
+  start_stopwatch();
+  for (gint i = 0; i < BENCHMARK_ITERATIONS; i++)
+    {
+      for (gint j = 0; j < BENCHMARK_NUM_MESSAGES; j++)
+        matches += filter_expr_eval(filter, msgs[j]);
+    }
+  stop_stopwatch_and_display_result(BENCHMARK_ITERATIONS * BENCHMARK_NUM_MESSAGES,
+                                    "%-13s matching against %d networks", filter_name, BENCHMARK_NUM_NETWORKS);
+
+  filter_expr_unref(filter);
+  return matches;
+}
+
+Test(filter, test_filter_netmask_set_performance_compared_to_netmask_or_chain)
+{
+  GRand *rand = g_rand_new_with_seed(0x5eed);
+  guint32 networks[BENCHMARK_NUM_NETWORKS];
+  LogMessage *msgs[BENCHMARK_NUM_MESSAGES];
+  gchar *network_list = _generate_networks(rand, networks);
+
+  _generate_messages(rand, networks, msgs);
+
+  gint or_chain_matches = _perftest_filter(_create_netmask_or_chain(network_list), msgs, "netmask() OR");
+  gint netmask_set_matches = _perftest_filter(_create_netmask_set(network_list), msgs, "netmask-set()");
+
+  cr_assert_eq(netmask_set_matches, or_chain_matches);
+  cr_assert_geq(netmask_set_matches, BENCHMARK_ITERATIONS * BENCHMARK_NUM_MESSAGES / 2);
+
+  for (gint i = 0; i < BENCHMARK_NUM_MESSAGES; i++)
+    log_msg_unref(msgs[i]);
+  g_free(network_list);
+  g_rand_free(rand);
+}
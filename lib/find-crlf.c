@@ -24,30 +24,76 @@
 #include "find-crlf.h"
 
 #include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define FIND_CRLF_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/*
+ * The set of characters we are looking for. The kernels always compare
+ * against three characters, unused slots repeat the first terminator.
+ */
+typedef struct _LineTerminators
+{
+  guchar chars[3];
+} LineTerminators;
+
+typedef gsize (*FindLineTerminatorsFunc)(const guchar *s, gsize n, const LineTerminators *terminators,
+                                         guint32 *positions, gsize max_positions);
+
+static inline void
+_line_terminators_init(LineTerminators *self, guint terminators)
+{
+  gint n = 0;
+
+  if (terminators & FIND_CRLF_CR)
+    self->chars[n++] = '\r';
+  if (terminators & FIND_CRLF_LF)
+    self->chars[n++] = '\n';
+  if (terminators & FIND_CRLF_NUL)
+    self->chars[n++] = '\0';
+
+  g_assert(n > 0);
+  for (; n < G_N_ELEMENTS(self->chars); n++)
+    self->chars[n] = self->chars[0];
+}
+
+static inline gboolean
+_is_line_terminator(guchar c, const LineTerminators *terminators)
+{
+  return c == terminators->chars[0] || c == terminators->chars[1] || c == terminators->chars[2];
+}
+
+static inline gboolean
+_longword_has_char(gulong longword, gulong charmask, gulong magic_bits)
+{
+  longword ^= charmask;
+  return (((longword + magic_bits) ^ ~longword) & ~magic_bits) != 0;
+}
+
 /**
- * This is an optimized version of finding either a CR or LF or NUL
+ * This is an optimized version of finding a line terminator (CR, LF or NUL)
  * character in a buffer.  It is used to find these line terminators in
  * syslog traffic.
  *
  * It uses an algorithm very similar to what there's in libc memchr/strchr.
  **/
-gchar *
-find_cr_or_lf_or_nul(gchar *s, gsize n)
+static const guchar *
+_find_first_scalar(const guchar *s, gsize n, const LineTerminators *terminators)
 {
-  gchar *char_ptr;
-  gulong *longword_ptr;
-  gulong longword, magic_bits, cr_charmask, lf_charmask;
-  const char CR = '\r';
-  const char LF = '\n';
+  const guchar *char_ptr;
+  const gulong *longword_ptr;
+  gulong longword, magic_bits, charmasks[3];
 
   /* align input to long boundary */
   for (char_ptr = s; n > 0 && ((gulong) char_ptr & (sizeof(longword) - 1)) != 0; ++char_ptr, n--)
     {
-      if (*char_ptr == CR || *char_ptr == LF || *char_ptr == 0)
+      if (_is_line_terminator(*char_ptr, terminators))
         return char_ptr;
     }
 
-  longword_ptr = (gulong *) char_ptr;
+  longword_ptr = (const gulong *) char_ptr;
 
 #if GLIB_SIZEOF_LONG == 8
   magic_bits = 0x7efefefefefefeffL;
@@ -56,23 +102,23 @@ find_cr_or_lf_or_nul(gchar *s, gsize n)
 #else
 #error "unknown architecture"
 #endif
-  memset(&cr_charmask, CR, sizeof(cr_charmask));
-  memset(&lf_charmask, LF, sizeof(lf_charmask));
+  for (gint i = 0; i < G_N_ELEMENTS(charmasks); i++)
+    memset(&charmasks[i], terminators->chars[i], sizeof(charmasks[i]));
 
   while (n > sizeof(longword))
     {
       longword = *longword_ptr++;
-      if ((((longword + magic_bits) ^ ~longword) & ~magic_bits) != 0 ||
-          ((((longword ^ cr_charmask) + magic_bits) ^ ~(longword ^ cr_charmask)) & ~magic_bits) != 0 ||
-          ((((longword ^ lf_charmask) + magic_bits) ^ ~(longword ^ lf_charmask)) & ~magic_bits) != 0)
+      if (_longword_has_char(longword, charmasks[0], magic_bits) ||
+          _longword_has_char(longword, charmasks[1], magic_bits) ||
+          _longword_has_char(longword, charmasks[2], magic_bits))
         {
           gint i;
 
-          char_ptr = (gchar *) (longword_ptr - 1);
+          char_ptr = (const guchar *) (longword_ptr - 1);
 
           for (i = 0; i < sizeof(longword); i++)
             {
-              if (*char_ptr == CR || *char_ptr == LF || *char_ptr == 0)
+              if (_is_line_terminator(*char_ptr, terminators))
                 return char_ptr;
               char_ptr++;
             }
@@ -80,14 +126,206 @@ find_cr_or_lf_or_nul(gchar *s, gsize n)
       n -= sizeof(longword);
     }
 
-  char_ptr = (gchar *) longword_ptr;
+  char_ptr = (const guchar *) longword_ptr;
 
   while (n-- > 0)
     {
-      if (*char_ptr == CR || *char_ptr == LF || *char_ptr == 0)
+      if (_is_line_terminator(*char_ptr, terminators))
         return char_ptr;
       ++char_ptr;
     }
 
   return NULL;
 }
+
+static gsize
+_find_all_scalar(const guchar *s, gsize n, const LineTerminators *terminators,
+                 guint32 *positions, gsize max_positions)
+{
+  const guchar *end = s + n;
+  const guchar *p = s;
+  gsize found = 0;
+
+  while (found < max_positions && (p = _find_first_scalar(p, end - p, terminators)))
+    {
+      positions[found++] = p - s;
+      p++;
+    }
+  return found;
+}
+
+#if FIND_CRLF_X86_SIMD
+
+/* finishes the last partial vector with the scalar code */
+static inline gsize
+_find_all_tail(const guchar *s, gsize n, gsize ofs, const LineTerminators *terminators,
+               guint32 *positions, gsize max_positions)
+{
+  gsize found = _find_all_scalar(s + ofs, n - ofs, terminators, positions, max_positions);
+
+  for (gsize i = 0; i < found; i++)
+    positions[i] += ofs;
+  return found;
+}
+
+__attribute__((target("sse2")))
+static gsize
+_find_all_sse2(const guchar *s, gsize n, const LineTerminators *terminators,
+               guint32 *positions, gsize max_positions)
+{
+  const __m128i c0 = _mm_set1_epi8(terminators->chars[0]);
+  const __m128i c1 = _mm_set1_epi8(terminators->chars[1]);
+  const __m128i c2 = _mm_set1_epi8(terminators->chars[2]);
+  gsize found = 0;
+  gsize i;
+
+  if (max_positions == 0)
+    return 0;
+
+  for (i = 0; i + sizeof(__m128i) <= n; i += sizeof(__m128i))
+    {
+      __m128i block = _mm_loadu_si128((const __m128i *) (s + i));
+      __m128i matches = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, c0), _mm_cmpeq_epi8(block, c1)),
+                                     _mm_cmpeq_epi8(block, c2));
+      guint32 mask = _mm_movemask_epi8(matches);
+
+      while (mask)
+        {
+          positions[found++] = i + __builtin_ctz(mask);
+          if (found == max_positions)
+            return found;
+          mask &= mask - 1;
+        }
+    }
+
+  return found + _find_all_tail(s, n, i, terminators, positions + found, max_positions - found);
+}
+
+__attribute__((target("avx2")))
+static gsize
+_find_all_avx2(const guchar *s, gsize n, const LineTerminators *terminators,
+               guint32 *positions, gsize max_positions)
+{
+  const __m256i c0 = _mm256_set1_epi8(terminators->chars[0]);
+  const __m256i c1 = _mm256_set1_epi8(terminators->chars[1]);
+  const __m256i c2 = _mm256_set1_epi8(terminators->chars[2]);
+  gsize found = 0;
+  gsize i;
+
+  if (max_positions == 0)
+    return 0;
+
+  for (i = 0; i + sizeof(__m256i) <= n; i += sizeof(__m256i))
+    {
+      __m256i block = _mm256_loadu_si256((const __m256i *) (s + i));
+      __m256i matches = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, c0), _mm256_cmpeq_epi8(block, c1)),
+                                        _mm256_cmpeq_epi8(block, c2));
+      guint32 mask = (guint32) _mm256_movemask_epi8(matches);
+
+      while (mask)
+        {
+          positions[found++] = i + __builtin_ctz(mask);
+          if (found == max_positions)
+            return found;
+          mask &= mask - 1;
+        }
+    }
+
+  return found + _find_all_tail(s, n, i, terminators, positions + found, max_positions - found);
+}
+
+#endif
+
+static FindLineTerminatorsFunc
+_lookup_implementation(FindCRLFImplementation impl)
+{
+#if FIND_CRLF_X86_SIMD
+  __builtin_cpu_init();
+  switch (impl)
+    {
+    case FIND_CRLF_IMPL_AUTO:
+      if (__builtin_cpu_supports("avx2"))
+        return _find_all_avx2;
+      if (__builtin_cpu_supports("sse2"))
+        return _find_all_sse2;
+      return _find_all_scalar;
+    case FIND_CRLF_IMPL_AVX2:
+      return __builtin_cpu_supports("avx2") ? _find_all_avx2 : NULL;
+    case FIND_CRLF_IMPL_SSE2:
+      return __builtin_cpu_supports("sse2") ? _find_all_sse2 : NULL;
+    default:
+      break;
+    }
+#else
+  if (impl == FIND_CRLF_IMPL_SSE2 || impl == FIND_CRLF_IMPL_AVX2)
+    return NULL;
+#endif
+  return _find_all_scalar;
+}
+
+static gsize _find_all_detect(const guchar *s, gsize n, const LineTerminators *terminators,
+                              guint32 *positions, gsize max_positions);
+
+static FindLineTerminatorsFunc find_all_impl = _find_all_detect;
+
+/* the first call picks the best implementation the CPU supports */
+static gsize
+_find_all_detect(const guchar *s, gsize n, const LineTerminators *terminators,
+                 guint32 *positions, gsize max_positions)
+{
+  FindLineTerminatorsFunc impl = _lookup_implementation(FIND_CRLF_IMPL_AUTO);
+
+  g_atomic_pointer_set(&find_all_impl, impl);
+  return impl(s, n, terminators, positions, max_positions);
+}
+
+static inline gsize
+_find_all(const guchar *s, gsize n, const LineTerminators *terminators, guint32 *positions, gsize max_positions)
+{
+  FindLineTerminatorsFunc impl = g_atomic_pointer_get(&find_all_impl);
+
+  return impl(s, n, terminators, positions, max_positions);
+}
+
+gboolean
+find_crlf_set_implementation(FindCRLFImplementation impl)
+{
+  FindLineTerminatorsFunc func = _lookup_implementation(impl);
+
+  if (!func)
+    return FALSE;
+
+  g_atomic_pointer_set(&find_all_impl, func);
+  return TRUE;
+}
+
+/*
+ * Collects the offsets (relative to s) of at most max_positions line
+ * terminators in a single pass, returns the number of offsets stored.
+ */
+gsize
+find_line_terminators(const gchar *s, gsize n, guint terminators, guint32 *positions, gsize max_positions)
+{
+  LineTerminators t;
+
+  _line_terminators_init(&t, terminators);
+  return _find_all((const guchar *) s, n, &t, positions, max_positions);
+}
+
+const gchar *
+find_line_terminator(const gchar *s, gsize n, guint terminators)
+{
+  LineTerminators t;
+  guint32 position;
+
+  _line_terminators_init(&t, terminators);
+  if (_find_all((const guchar *) s, n, &t, &position, 1) == 0)
+    return NULL;
+  return s + position;
+}
+
+gchar *
+find_cr_or_lf_or_nul(gchar *s, gsize n)
+{
+  return (gchar *) find_line_terminator(s, n, FIND_CRLF_CR | FIND_CRLF_LF | FIND_CRLF_NUL);
+}
@@ -26,6 +26,25 @@
 
 #include "syslog-ng.h"
 
+/* line terminators to look for, can be combined */
+#define FIND_CRLF_CR  0x01
+#define FIND_CRLF_LF  0x02
+#define FIND_CRLF_NUL 0x04
+
+typedef enum
+{
+  FIND_CRLF_IMPL_AUTO,
+  FIND_CRLF_IMPL_SCALAR,
+  FIND_CRLF_IMPL_SSE2,
+  FIND_CRLF_IMPL_AVX2,
+} FindCRLFImplementation;
+
 gchar *find_cr_or_lf_or_nul(gchar *s, gsize n);
 
+const gchar *find_line_terminator(const gchar *s, gsize n, guint terminators);
+gsize find_line_terminators(const gchar *s, gsize n, guint terminators, guint32 *positions, gsize max_positions);
+
+/* for tests and benchmarks, returns FALSE if the CPU lacks support */
+gboolean find_crlf_set_implementation(FindCRLFImplementation impl);
+
 #endif
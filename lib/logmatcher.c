@@ -30,6 +30,8 @@
 #include "compat/string.h"
 #include "compat/pcre.h"
 
+#include <stdlib.h>
+
 static void
 log_matcher_store_pattern(LogMatcher *self, const gchar *pattern)
 {
@@ -730,6 +732,205 @@ log_matcher_pcre_set_nv_prefix(LogMatcher *s, const gchar *prefix)
     }
 }
 
+/* multi-pattern matcher */
+
+/* flags that have to be the same for all the combined matchers */
+#define LOG_MULTI_MATCHER_COMPILE_FLAGS (LMF_NEWLINE | LMF_UTF8 | LMF_DISABLE_JIT | LMF_DUPNAMES)
+
+struct _LogMultiMatcher
+{
+  LogMatcher *combined;
+  GString *pattern;
+  gint num_matchers;
+  gint flags;
+};
+
+/* backreferences and subroutine calls would refer to the wrong group once
+ * the pattern is embedded into the alternation.  (*VERB)s anywhere in the
+ * pattern (e.g. (*SKIP), (*COMMIT) or (*MARK)) would interfere with the
+ * other alternatives and the marks we use to identify the matching one,
+ * and an unterminated \Q would quote the rest of the alternation.  The scan
+ * is conservative, it also refuses these sequences in character classes. */
+static gboolean
+_pcre_pattern_is_embeddable(const gchar *pattern)
+{
+  for (const gchar *p = pattern; *p; p++)
+    {
+      if (p[0] == '\\' && p[1])
+        {
+          if ((p[1] >= '1' && p[1] <= '9') || p[1] == 'g' || p[1] == 'k' || p[1] == 'Q')
+            return FALSE;
+          p++;
+        }
+      else if (p[0] == '(' && p[1] == '*')
+        {
+          return FALSE;
+        }
+      else if (p[0] == '(' && p[1] == '?')
+        {
+          const gchar *opt = p + 2;
+
+          if (g_ascii_isdigit(*opt) || (*opt && strchr("+R&", *opt)) ||
+              (*opt == '-' && g_ascii_isdigit(opt[1])) ||
+              strncmp(opt, "P=", 2) == 0 || strncmp(opt, "P>", 2) == 0)
+            return FALSE;
+
+          /* (?x) would turn the rest of the alternation into a comment after a '#' */
+          while (g_ascii_isalpha(*opt) || *opt == '-')
+            {
+              if (*opt == 'x')
+                return FALSE;
+              opt++;
+            }
+        }
+    }
+  return TRUE;
+}
+
+static gboolean
+_matcher_is_combinable(LogMatcher *s)
+{
+  if (s->flags & LMF_STORE_MATCHES)
+    return FALSE;
+
+  if (s->compile == log_matcher_string_compile)
+    return TRUE;
+
+  if (s->compile == log_matcher_pcre_re_compile)
+    return _pcre_pattern_is_embeddable(s->pattern);
+
+  return FALSE;
+}
+
+gboolean
+log_matcher_can_combine(LogMatcher *s, LogMatcher *other)
+{
+  return _matcher_is_combinable(s) && _matcher_is_combinable(other) &&
+         (s->flags & LOG_MULTI_MATCHER_COMPILE_FLAGS) == (other->flags & LOG_MULTI_MATCHER_COMPILE_FLAGS);
+}
+
+static void
+_append_escaped_literal(GString *result, const gchar *literal)
+{
+  for (const gchar *p = literal; *p; p++)
+    {
+      /* a backslash followed by a non-alphanumeric character matches that character */
+      if ((guchar) *p < 0x80 && !g_ascii_isalnum(*p))
+        g_string_append_c(result, '\\');
+      g_string_append_c(result, *p);
+    }
+}
+
+static void
+_append_string_matcher(GString *result, LogMatcher *matcher)
+{
+  if ((matcher->flags & LMF_SUBSTRING) == 0)
+    g_string_append(result, "\\A");
+
+  _append_escaped_literal(result, matcher->pattern);
+
+  if ((matcher->flags & (LMF_SUBSTRING | LMF_PREFIX)) == 0)
+    g_string_append(result, "\\z");
+}
+
+gboolean
+log_multi_matcher_add(LogMultiMatcher *self, LogMatcher *matcher)
+{
+  if (!_matcher_is_combinable(matcher))
+    return FALSE;
+
+  if (self->num_matchers == 0)
+    self->flags = matcher->flags & LOG_MULTI_MATCHER_COMPILE_FLAGS;
+  else if ((matcher->flags & LOG_MULTI_MATCHER_COMPILE_FLAGS) != self->flags)
+    return FALSE;
+
+  if (self->num_matchers > 0)
+    g_string_append_c(self->pattern, '|');
+
+  g_string_append(self->pattern, "(?:");
+  if (matcher->flags & LMF_ICASE)
+    g_string_append(self->pattern, "(?i)");
+
+  if (matcher->compile == log_matcher_string_compile)
+    _append_string_matcher(self->pattern, matcher);
+  else
+    g_string_append(self->pattern, matcher->pattern);
+
+  g_string_append_printf(self->pattern, ")(*MARK:%d)", self->num_matchers);
+  self->num_matchers++;
+  return TRUE;
+}
+
+gboolean
+log_multi_matcher_compile(LogMultiMatcher *self, GError **error)
+{
+  LogMatcherOptions options;
+
+  g_return_val_if_fail(self->combined == NULL, FALSE);
+
+  log_matcher_options_defaults(&options);
+  options.flags = self->flags;
+
+  self->combined = log_matcher_pcre_re_new(&options);
+  return log_matcher_compile(self->combined, self->pattern->str, error);
+}
+
+/*
+ * Returns TRUE if any of the matchers matched, in which case
+ * matched_index is set to the index of the matcher whose match starts
+ * first in value (the lowest index if several of them start at the same
+ * position).
+ */
+gboolean
+log_multi_matcher_match(LogMultiMatcher *self, const gchar *value, gssize value_len, gint *matched_index)
+{
+  LogMatcherPcreRe *re = (LogMatcherPcreRe *) self->combined;
+  pcre_extra extra = { 0 };
+  guchar *mark = NULL;
+  gint rc;
+
+  if (value_len == -1)
+    value_len = strlen(value);
+
+  /* pcre_extra is shared between threads, the mark is returned in our copy */
+  if (re->extra)
+    extra = *re->extra;
+  extra.flags |= PCRE_EXTRA_MARK;
+  extra.mark = &mark;
+
+  *matched_index = -1;
+  rc = pcre_exec(re->pattern, &extra, value, value_len, 0, re->match_options, NULL, 0);
+  if (rc < 0)
+    {
+      if (rc != PCRE_ERROR_NOMATCH)
+        msg_error("Error while matching regexp",
+                  evt_tag_int("error_code", rc));
+      return FALSE;
+    }
+
+  if (mark)
+    *matched_index = atoi((const gchar *) mark);
+  return TRUE;
+}
+
+LogMultiMatcher *
+log_multi_matcher_new(void)
+{
+  LogMultiMatcher *self = g_new0(LogMultiMatcher, 1);
+
+  self->pattern = g_string_new("");
+  return self;
+}
+
+void
+log_multi_matcher_free(LogMultiMatcher *self)
+{
+  if (self->combined)
+    log_matcher_unref(self->combined);
+  g_string_free(self->pattern, TRUE);
+  g_free(self);
+}
+
 typedef LogMatcher *(*LogMatcherConstructFunc)(const LogMatcherOptions *options);
 
 gboolean
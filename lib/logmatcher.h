@@ -130,4 +130,23 @@ void log_matcher_options_destroy(LogMatcherOptions *options);
 
 void log_matcher_pcre_set_nv_prefix(LogMatcher *s, const gchar *prefix);
 
+/*
+ * LogMultiMatcher combines a set of pcre and string matchers into a single
+ * PCRE alternation, so that a value is scanned once, instead of once per
+ * matcher. Each alternative is tagged with (*MARK), which tells which of
+ * the matchers matched.
+ *
+ * Only matchers that don't store matches and use the same compile
+ * flags (apart from icase) can be combined, see log_matcher_can_combine().
+ */
+typedef struct _LogMultiMatcher LogMultiMatcher;
+
+gboolean log_matcher_can_combine(LogMatcher *s, LogMatcher *other);
+
+LogMultiMatcher *log_multi_matcher_new(void);
+gboolean log_multi_matcher_add(LogMultiMatcher *self, LogMatcher *matcher);
+gboolean log_multi_matcher_compile(LogMultiMatcher *self, GError **error);
+gboolean log_multi_matcher_match(LogMultiMatcher *self, const gchar *value, gssize value_len, gint *matched_index);
+void log_multi_matcher_free(LogMultiMatcher *self);
+
 #endif
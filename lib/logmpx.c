@@ -58,6 +58,10 @@ log_multiplexer_init(LogPipe *s)
         {
           self->fallback_exists = TRUE;
         }
+      if (branch_head->flags & PIF_BRANCH_FINAL)
+        {
+          self->final_exists = TRUE;
+        }
     }
   return TRUE;
 }
@@ -175,6 +179,54 @@ log_multiplexer_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_op
   log_pipe_forward_msg(s, msg, path_options);
 }
 
+/*
+ * A batch is delivered to each branch in turn, instead of delivering each
+ * message to all branches.  Final and fallback branches need to know
+ * whether each message was matched, so with those the messages are queued
+ * one-by-one.  Delivery is not propagated either: the sender of a batch
+ * has no per-message "matched" state to report it to, see
+ * log_pipe_queue_batch().
+ */
+static void
+log_multiplexer_queue_batch(LogPipe *s, LogMessage **msgs, gint num_msgs, const LogPathOptions *path_options)
+{
+  LogMultiplexer *self = (LogMultiplexer *) s;
+  LogMessage *branch_msgs[LOG_PIPE_BATCH_MAX];
+  LogPathOptions local_options;
+  gboolean matched;
+
+  if (self->fallback_exists || self->final_exists)
+    {
+      for (gint i = 0; i < num_msgs; i++)
+        log_multiplexer_queue(s, msgs[i], path_options);
+      return;
+    }
+
+  log_path_options_push_junction(&local_options, &matched, path_options);
+  if (_has_multiple_arcs(self))
+    {
+      for (gint i = 0; i < num_msgs; i++)
+        log_msg_write_protect(msgs[i]);
+    }
+
+  for (gint i = 0; i < self->next_hops->len; i++)
+    {
+      LogPipe *next_hop = g_ptr_array_index(self->next_hops, i);
+
+      /* the branch is free to reuse the array, e.g. filters compact it */
+      for (gint j = 0; j < num_msgs; j++)
+        {
+          log_msg_add_ack(msgs[j], &local_options);
+          branch_msgs[j] = log_msg_ref(msgs[j]);
+        }
+
+      matched = TRUE;
+      log_pipe_queue_batch(next_hop, branch_msgs, num_msgs, &local_options);
+    }
+
+  log_pipe_forward_msgs(s, msgs, num_msgs, path_options);
+}
+
 static void
 log_multiplexer_free(LogPipe *s)
 {
@@ -217,6 +269,7 @@ log_multiplexer_new(GlobalConfig *cfg)
   self->super.init = log_multiplexer_init;
   self->super.deinit = log_multiplexer_deinit;
   self->super.queue = log_multiplexer_queue;
+  self->super.queue_batch = log_multiplexer_queue_batch;
   self->super.free_fn = log_multiplexer_free;
   self->next_hops = g_ptr_array_new();
   self->super.arcs = _arcs;
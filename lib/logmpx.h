@@ -41,6 +41,7 @@ typedef struct _LogMultiplexer
   LogPipe super;
   GPtrArray *next_hops;
   gboolean fallback_exists;
+  gboolean final_exists;
   gboolean delivery_propagation;
 } LogMultiplexer;
 
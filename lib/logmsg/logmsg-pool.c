@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logmsg/logmsg-pool.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "atomic.h"
+#include "tls-support.h"
+
+/*
+ * Each block is preceded by a LogMessagePoolBlock header, which records
+ * the pool it was allocated from (NULL if it comes straight from
+ * g_malloc()) and its size class.
+ *
+ * Ownership rules:
+ *   - a pool is owned by the thread that created it, only the owner
+ *     touches the local free lists
+ *   - any thread may push a block to the owner's remote_free list
+ *   - the pool holds a reference for each block that is handed out and
+ *     one for the owner thread, the pool is freed when the last of these
+ *     is dropped (e.g. when the last message allocated by an already
+ *     stopped thread is freed)
+ */
+
+#define LOG_MSG_POOL_NUM_CLASSES 5
+#define LOG_MSG_POOL_MIN_CLASS_SHIFT 9
+#define LOG_MSG_POOL_MAX_CACHED_BYTES_PER_CLASS (512 * 1024)
+#define LOG_MSG_POOL_STATS_FLUSH_INTERVAL 1024
+
+typedef struct _LogMessagePool LogMessagePool;
+
+typedef struct _LogMessagePoolBlock
+{
+  LogMessagePool *owner;
+  gint size_class;
+  gint __pad;
+} LogMessagePoolBlock;
+
+G_STATIC_ASSERT(sizeof(LogMessagePoolBlock) % 8 == 0);
+
+typedef struct _LogMessagePoolFreeBlock
+{
+  LogMessagePoolBlock header;
+  struct _LogMessagePoolFreeBlock *next;
+} LogMessagePoolFreeBlock;
+
+typedef struct _LogMessagePoolClass
+{
+  LogMessagePoolFreeBlock *free_list;
+  gint num_cached;
+} LogMessagePoolClass;
+
+struct _LogMessagePool
+{
+  GAtomicCounter ref_cnt;
+  LogMessagePoolClass classes[LOG_MSG_POOL_NUM_CLASSES];
+
+  /* blocks returned by other threads */
+  LogMessagePoolFreeBlock *volatile remote_free;
+
+  /* local stats, flushed to the global counters periodically */
+  gint ops_since_flush;
+  gssize hits;
+  gssize misses;
+  gssize cached_bytes;
+};
+
+TLS_BLOCK_START
+{
+  LogMessagePool *log_msg_pool;
+}
+TLS_BLOCK_END;
+
+#define log_msg_pool __tls_deref(log_msg_pool)
+
+static StatsCounterItem *count_pool_hits;
+static StatsCounterItem *count_pool_misses;
+static StatsCounterItem *count_pool_cached_bytes;
+
+static inline gsize
+_class_size(gint size_class)
+{
+  return ((gsize) 1) << (LOG_MSG_POOL_MIN_CLASS_SHIFT + size_class);
+}
+
+static inline gint
+_lookup_size_class(gsize size)
+{
+  for (gint i = 0; i < LOG_MSG_POOL_NUM_CLASSES; i++)
+    {
+      if (size <= _class_size(i))
+        return i;
+    }
+  return -1;
+}
+
+static inline gint
+_max_cached_blocks(gint size_class)
+{
+  return LOG_MSG_POOL_MAX_CACHED_BYTES_PER_CLASS / _class_size(size_class);
+}
+
+static void
+_flush_stats(LogMessagePool *self)
+{
+  stats_counter_add(count_pool_hits, self->hits);
+  stats_counter_add(count_pool_misses, self->misses);
+  stats_counter_add(count_pool_cached_bytes, self->cached_bytes);
+  self->hits = 0;
+  self->misses = 0;
+  self->cached_bytes = 0;
+  self->ops_since_flush = 0;
+}
+
+static inline void
+_account_op(LogMessagePool *self)
+{
+  if (++self->ops_since_flush >= LOG_MSG_POOL_STATS_FLUSH_INTERVAL)
+    _flush_stats(self);
+}
+
+static LogMessagePoolFreeBlock *
+_steal_remote_free_list(LogMessagePool *self)
+{
+  LogMessagePoolFreeBlock *head;
+
+  do
+    {
+      head = g_atomic_pointer_get(&self->remote_free);
+    }
+  while (head && !g_atomic_pointer_compare_and_exchange(&self->remote_free, head, NULL));
+  return head;
+}
+
+static void
+_push_remote_free_list(LogMessagePool *self, LogMessagePoolFreeBlock *block)
+{
+  LogMessagePoolFreeBlock *head;
+
+  do
+    {
+      head = g_atomic_pointer_get(&self->remote_free);
+      block->next = head;
+    }
+  while (!g_atomic_pointer_compare_and_exchange(&self->remote_free, head, block));
+}
+
+/* owner thread only */
+static void
+_cache_block(LogMessagePool *self, LogMessagePoolFreeBlock *block)
+{
+  gint size_class = block->header.size_class;
+  LogMessagePoolClass *cls = &self->classes[size_class];
+
+  if (cls->num_cached >= _max_cached_blocks(size_class))
+    {
+      g_free(block);
+      return;
+    }
+  block->next = cls->free_list;
+  cls->free_list = block;
+  cls->num_cached++;
+  self->cached_bytes += _class_size(size_class);
+}
+
+/* owner thread only, returns TRUE if anything was reclaimed */
+static gboolean
+_reclaim_remote_blocks(LogMessagePool *self)
+{
+  LogMessagePoolFreeBlock *block = _steal_remote_free_list(self);
+
+  if (!block)
+    return FALSE;
+
+  while (block)
+    {
+      LogMessagePoolFreeBlock *next = block->next;
+      _cache_block(self, block);
+      block = next;
+    }
+  return TRUE;
+}
+
+static void
+_free_cached_blocks(LogMessagePool *self)
+{
+  _reclaim_remote_blocks(self);
+  for (gint i = 0; i < LOG_MSG_POOL_NUM_CLASSES; i++)
+    {
+      LogMessagePoolClass *cls = &self->classes[i];
+
+      while (cls->free_list)
+        {
+          LogMessagePoolFreeBlock *next = cls->free_list->next;
+          g_free(cls->free_list);
+          cls->free_list = next;
+        }
+      self->cached_bytes -= cls->num_cached * _class_size(i);
+      cls->num_cached = 0;
+    }
+}
+
+static LogMessagePool *
+_pool_new(void)
+{
+  LogMessagePool *self = g_new0(LogMessagePool, 1);
+
+  g_atomic_counter_set(&self->ref_cnt, 1);
+  return self;
+}
+
+static void
+_pool_free(LogMessagePool *self)
+{
+  _free_cached_blocks(self);
+  _flush_stats(self);
+  g_free(self);
+}
+
+static inline void
+_pool_ref(LogMessagePool *self)
+{
+  g_atomic_counter_inc(&self->ref_cnt);
+}
+
+static inline void
+_pool_unref(LogMessagePool *self)
+{
+  if (g_atomic_counter_dec_and_test(&self->ref_cnt))
+    _pool_free(self);
+}
+
+static inline gpointer
+_block_to_user(LogMessagePoolBlock *block)
+{
+  return (gpointer) (block + 1);
+}
+
+static inline LogMessagePoolBlock *
+_user_to_block(gpointer user)
+{
+  return ((LogMessagePoolBlock *) user) - 1;
+}
+
+gpointer
+log_msg_pool_alloc(gsize size)
+{
+  LogMessagePool *self = log_msg_pool;
+  LogMessagePoolBlock *block;
+  gint size_class = _lookup_size_class(size + sizeof(LogMessagePoolBlock));
+
+  if (!self || size_class < 0)
+    {
+      block = g_malloc(sizeof(LogMessagePoolBlock) + size);
+      block->owner = NULL;
+      block->size_class = -1;
+      return _block_to_user(block);
+    }
+
+  LogMessagePoolClass *cls = &self->classes[size_class];
+  if (!cls->free_list)
+    _reclaim_remote_blocks(self);
+
+  if (cls->free_list)
+    {
+      LogMessagePoolFreeBlock *free_block = cls->free_list;
+
+      cls->free_list = free_block->next;
+      cls->num_cached--;
+      self->cached_bytes -= _class_size(size_class);
+      self->hits++;
+      block = &free_block->header;
+    }
+  else
+    {
+      block = g_malloc(_class_size(size_class));
+      block->size_class = size_class;
+      self->misses++;
+    }
+  block->owner = self;
+  _pool_ref(self);
+  _account_op(self);
+  return _block_to_user(block);
+}
+
+void
+log_msg_pool_free(gpointer user)
+{
+  LogMessagePoolBlock *block = _user_to_block(user);
+  LogMessagePool *owner = block->owner;
+
+  if (!owner)
+    {
+      g_free(block);
+      return;
+    }
+
+  if (owner == log_msg_pool)
+    {
+      _cache_block(owner, (LogMessagePoolFreeBlock *) block);
+      _account_op(owner);
+    }
+  else
+    {
+      /* cross-thread free, hand it back to the thread that allocated it */
+      _push_remote_free_list(owner, (LogMessagePoolFreeBlock *) block);
+    }
+  _pool_unref(owner);
+}
+
+void
+log_msg_pool_thread_init(void)
+{
+  if (log_msg_pool)
+    return;
+  log_msg_pool = _pool_new();
+}
+
+void
+log_msg_pool_thread_deinit(void)
+{
+  LogMessagePool *self = log_msg_pool;
+
+  if (!self)
+    return;
+
+  log_msg_pool = NULL;
+
+  /* messages allocated by this thread may still be alive, these will be
+   * pushed to the remote_free list and the pool is freed with the last one */
+  _free_cached_blocks(self);
+  _flush_stats(self);
+  _pool_unref(self);
+}
+
+void
+log_msg_pool_register_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "events_pool_hits", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias(&sc_key, SCS_GLOBAL, "msg_pool_hits", NULL);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_pool_hits);
+
+  stats_cluster_single_key_set(&sc_key, "events_pool_misses", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias(&sc_key, SCS_GLOBAL, "msg_pool_misses", NULL);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_pool_misses);
+
+  stats_cluster_single_key_set(&sc_key, "events_pool_cached_bytes", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias(&sc_key, SCS_GLOBAL, "msg_pool_cached_bytes", NULL);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_pool_cached_bytes);
+  stats_unlock();
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGMSG_POOL_H_INCLUDED
+#define LOGMSG_POOL_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Per-thread free-list allocator for LogMessage instances (including their
+ * embedded queue nodes and the initial NVTable).
+ *
+ * Blocks are rounded up to a small number of size classes and cached in
+ * the allocating thread. Blocks freed by another thread are handed back to
+ * the owner through a lock-free list and get recycled once the owner runs
+ * out of locally cached blocks.
+ *
+ * Threads that haven't called log_msg_pool_thread_init() and allocations
+ * larger than the biggest size class simply use g_malloc()/g_free().
+ */
+
+gpointer log_msg_pool_alloc(gsize size);
+void log_msg_pool_free(gpointer block);
+
+void log_msg_pool_thread_init(void);
+void log_msg_pool_thread_deinit(void);
+
+void log_msg_pool_register_stats(void);
+
+#endif
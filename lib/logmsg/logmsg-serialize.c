@@ -197,6 +197,7 @@ _deserialize_message_version_2x(LogMessageSerializationState *state)
   if (!_deserialize_sdata(state))
     return FALSE;
 
+  log_msg_drop_payload_hash_index(msg);
   nv_table_unref(msg->payload);
   msg->payload = _nv_table_deserialize_selector(state);
   if (!msg->payload)
@@ -30,6 +30,7 @@
 #include "timeutils/cache.h"
 #include "timeutils/misc.h"
 #include "logmsg/nvtable.h"
+#include "logmsg/logmsg-pool.h"
 #include "stats/stats-registry.h"
 #include "stats/stats-cluster-single.h"
 #include "template/templates.h"
@@ -118,8 +119,26 @@
  * counter becomes somewhat more complicated, therefore a g_atomic_int_add()
  * doesn't suffice.  We're using a CAS loop (compare-and-exchange) to do our
  * stuff, but that shouldn't have that much of an overhead.
+ *
+ * Producers that queue a batch of messages at once (see
+ * log_source_flush_batch()) can cache the ref/ack changes of all messages
+ * in the batch with log_msg_refcache_start_producer_batch() /
+ * log_msg_refcache_stop_batch().  Each message records its index in the
+ * per-thread batch in LogMessage->refcache_slot, the fast path checks that
+ * the slot of the current thread points back to the same message, so a
+ * stale or foreign slot value simply falls back to the atomic path.
  */
 
+typedef struct _LogMessageBatchRefCache
+{
+  LogMessage *msg;
+  gint refs;
+  gint acks;
+  gboolean abort;
+  gboolean suspend;
+  gboolean ack_needed;
+} LogMessageBatchRefCache;
+
 TLS_BLOCK_START
 {
   /* message that is being processed by the current thread. Its ack/ref changes are cached */
@@ -136,6 +155,10 @@ TLS_BLOCK_START
   gboolean logmsg_cached_abort;
   /* suspend flag in the current thread for acks */
   gboolean logmsg_cached_suspend;
+
+  /* messages of the batch being processed by the current thread */
+  LogMessageBatchRefCache logmsg_batch[LOGMSG_REFCACHE_BATCH_MAX];
+  gint logmsg_batch_len;
 }
 TLS_BLOCK_END;
 
@@ -145,6 +168,8 @@ TLS_BLOCK_END;
 #define logmsg_cached_ack_needed    __tls_deref(logmsg_cached_ack_needed)
 #define logmsg_cached_abort         __tls_deref(logmsg_cached_abort)
 #define logmsg_cached_suspend       __tls_deref(logmsg_cached_suspend)
+#define logmsg_batch                __tls_deref(logmsg_batch)
+#define logmsg_batch_len            __tls_deref(logmsg_batch_len)
 
 #define LOGMSG_REFCACHE_SUSPEND_SHIFT                 31 /* number of bits to shift to get the SUSPEND flag */
 #define LOGMSG_REFCACHE_SUSPEND_MASK          0x80000000 /* bit mask to extract the SUSPEND flag */
@@ -622,6 +647,7 @@ log_msg_set_value_with_type(LogMessage *self, NVHandle handle,
                 evt_tag_msg_reference(self));
     }
 
+  log_msg_drop_payload_hash_index(self);
   if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
     {
       self->payload = nv_table_clone(self->payload, name_len + value_len + 2);
@@ -671,6 +697,7 @@ log_msg_unset_value(LogMessage *self, NVHandle handle)
 {
   g_assert(!log_msg_is_write_protected(self));
 
+  log_msg_drop_payload_hash_index(self);
   if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
     {
       self->payload = nv_table_clone(self->payload, 0);
@@ -736,6 +763,7 @@ log_msg_set_value_indirect_with_type(LogMessage *self, NVHandle handle,
                 evt_tag_msg_reference(self));
     }
 
+  log_msg_drop_payload_hash_index(self);
   if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
     {
       self->payload = nv_table_clone(self->payload, name_len + 1);
@@ -1358,6 +1386,7 @@ log_msg_init(LogMessage *self)
 void
 log_msg_clear(LogMessage *self)
 {
+  log_msg_drop_payload_hash_index(self);
   if(log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
     nv_table_unref(self->payload);
   self->payload = nv_table_new(LM_V_MAX, 16, 256);
@@ -1414,7 +1443,7 @@ log_msg_alloc(gsize payload_size)
       payload_ofs = alloc_size;
       alloc_size += payload_space;
     }
-  msg = g_malloc(alloc_size);
+  msg = log_msg_pool_alloc(alloc_size);
 
   memset(msg, 0, sizeof(LogMessage));
 
@@ -1488,6 +1517,8 @@ log_msg_clone_cow(LogMessage *msg, const LogPathOptions *path_options)
 
   /* reference the original message */
   self->original = log_msg_ref(msg);
+  /* the payload is shared, but the hash index is owned by the original */
+  self->payload_hash_index = NULL;
   self->ack_and_ref_and_abort_and_suspended = LOGMSG_REFCACHE_REF_TO_VALUE(1) + LOGMSG_REFCACHE_ACK_TO_VALUE(
                                                 0) + LOGMSG_REFCACHE_ABORT_TO_VALUE(0);
   self->cur_node = 0;
@@ -1590,6 +1621,7 @@ log_msg_new_mark(void)
 static void
 log_msg_free(LogMessage *self)
 {
+  log_msg_drop_payload_hash_index(self);
   if (log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD) && self->payload)
     nv_table_unref(self->payload);
   if (log_msg_chk_flag(self, LF_STATE_OWN_TAGS) && self->tags && self->num_tags > 0)
@@ -1607,7 +1639,7 @@ log_msg_free(LogMessage *self)
 
   stats_counter_sub(count_allocated_bytes, self->allocated_bytes);
 
-  g_free(self);
+  log_msg_pool_free(self);
 }
 
 /**
@@ -1674,6 +1706,18 @@ log_msg_update_ack_and_ref(LogMessage *self, gint add_ref, gint add_ack)
   return log_msg_update_ack_and_ref_and_abort_and_suspended(self, add_ref, add_ack, 0, 0);
 }
 
+static inline LogMessageBatchRefCache *
+_lookup_batch_refcache(LogMessage *self)
+{
+  if (G_LIKELY(logmsg_batch_len == 0) || self->refcache_slot >= logmsg_batch_len)
+    return NULL;
+
+  LogMessageBatchRefCache *cache = &logmsg_batch[self->refcache_slot];
+  if (cache->msg != self)
+    return NULL;
+  return cache;
+}
+
 /**
  * log_msg_ref:
  * @self: LogMessage instance
@@ -1694,6 +1738,13 @@ log_msg_ref(LogMessage *self)
       return self;
     }
 
+  LogMessageBatchRefCache *cache = _lookup_batch_refcache(self);
+  if (cache)
+    {
+      cache->refs++;
+      return self;
+    }
+
   /* slow path, refcache is not used, do the ordinary way */
   old_value = log_msg_update_ack_and_ref(self, 1, 0);
   g_assert(LOGMSG_REFCACHE_VALUE_TO_REF(old_value) >= 1);
@@ -1720,6 +1771,13 @@ log_msg_unref(LogMessage *self)
       return;
     }
 
+  LogMessageBatchRefCache *cache = _lookup_batch_refcache(self);
+  if (cache)
+    {
+      cache->refs--;
+      return;
+    }
+
   old_value = log_msg_update_ack_and_ref(self, -1, 0);
   g_assert(LOGMSG_REFCACHE_VALUE_TO_REF(old_value) >= 1);
 
@@ -1749,6 +1807,14 @@ log_msg_add_ack(LogMessage *self, const LogPathOptions *path_options)
           logmsg_cached_ack_needed = TRUE;
           return;
         }
+
+      LogMessageBatchRefCache *cache = _lookup_batch_refcache(self);
+      if (cache)
+        {
+          cache->acks++;
+          cache->ack_needed = TRUE;
+          return;
+        }
       log_msg_update_ack_and_ref(self, 0, 1);
     }
 }
@@ -1780,6 +1846,15 @@ log_msg_ack(LogMessage *self, const LogPathOptions *path_options, AckType ack_ty
           logmsg_cached_suspend |= IS_ACK_SUSPENDED(ack_type);
           return;
         }
+
+      LogMessageBatchRefCache *cache = _lookup_batch_refcache(self);
+      if (cache)
+        {
+          cache->acks--;
+          cache->abort |= IS_ACK_ABORTED(ack_type);
+          cache->suspend |= IS_ACK_SUSPENDED(ack_type);
+          return;
+        }
       old_value = log_msg_update_ack_and_ref_and_abort_and_suspended(self, 0, -1, IS_ACK_ABORTED(ack_type),
                   IS_ACK_SUSPENDED(ack_type));
       if (LOGMSG_REFCACHE_VALUE_TO_ACK(old_value) == 1)
@@ -1830,12 +1905,9 @@ log_msg_break_ack(LogMessage *msg, const LogPathOptions *path_options, LogPathOp
  * threads.
  *
  */
-void
-log_msg_refcache_start_producer(LogMessage *self)
+static void
+_add_producer_bias(LogMessage *self)
 {
-  g_assert(logmsg_current == NULL);
-
-  logmsg_current = self;
   /* we're the producer of said message, and thus we want to inhibit
    * freeing/acking it due to our cached refs, add a bias large enough
    * to cover any possible unrefs/acks of the consumer side */
@@ -1848,6 +1920,15 @@ log_msg_refcache_start_producer(LogMessage *self)
   self->ack_and_ref_and_abort_and_suspended = (self->ack_and_ref_and_abort_and_suspended & ~LOGMSG_REFCACHE_ACK_MASK) +
                                               LOGMSG_REFCACHE_ACK_TO_VALUE((LOGMSG_REFCACHE_VALUE_TO_ACK(self->ack_and_ref_and_abort_and_suspended) +
                                                   LOGMSG_REFCACHE_BIAS));
+}
+
+void
+log_msg_refcache_start_producer(LogMessage *self)
+{
+  g_assert(logmsg_current == NULL);
+
+  logmsg_current = self;
+  _add_producer_bias(self);
 
   logmsg_cached_refs = -LOGMSG_REFCACHE_BIAS;
   logmsg_cached_acks = -LOGMSG_REFCACHE_BIAS;
@@ -1989,6 +2070,99 @@ log_msg_refcache_stop(void)
   logmsg_current = NULL;
 }
 
+/*
+ * Start caching ref/unref/ack/add-ack operations in the current thread for
+ * all messages in @msgs, which are about to be queued as a single batch.
+ * The same rules apply as with log_msg_refcache_start_producer(), but
+ * for each message separately.
+ */
+void
+log_msg_refcache_start_producer_batch(LogMessage **msgs, gint num_msgs)
+{
+  g_assert(logmsg_batch_len == 0);
+  g_assert(num_msgs <= LOGMSG_REFCACHE_BATCH_MAX);
+
+  for (gint i = 0; i < num_msgs; i++)
+    {
+      LogMessageBatchRefCache *cache = &logmsg_batch[i];
+
+      _add_producer_bias(msgs[i]);
+      msgs[i]->refcache_slot = i;
+
+      cache->msg = msgs[i];
+      cache->refs = -LOGMSG_REFCACHE_BIAS;
+      cache->acks = -LOGMSG_REFCACHE_BIAS;
+      cache->abort = FALSE;
+      cache->suspend = FALSE;
+      cache->ack_needed = TRUE;
+    }
+  logmsg_batch_len = num_msgs;
+}
+
+/* same as log_msg_refcache_stop(), see the steps there */
+static void
+_refcache_stop_batch_entry(LogMessageBatchRefCache *cache)
+{
+  LogMessage *msg = cache->msg;
+  gint old_value;
+
+  g_assert((cache->acks < LOGMSG_REFCACHE_BIAS - 1) && (cache->acks >= -LOGMSG_REFCACHE_BIAS));
+  g_assert((cache->refs < LOGMSG_REFCACHE_BIAS - 1) && (cache->refs >= -LOGMSG_REFCACHE_BIAS));
+
+  log_msg_ref(msg);
+
+  gint current_cached_acks = cache->acks;
+  gboolean current_cached_abort = cache->abort;
+  gboolean current_cached_suspend = cache->suspend;
+  cache->acks = 0;
+  cache->abort = FALSE;
+  cache->suspend = FALSE;
+
+  old_value = log_msg_update_ack_and_ref_and_abort_and_suspended(msg, 0, current_cached_acks,
+              current_cached_abort, current_cached_suspend);
+
+  if ((LOGMSG_REFCACHE_VALUE_TO_ACK(old_value) == -current_cached_acks) && cache->ack_needed)
+    {
+      AckType ack_type_cumulated = _ack_and_ref_and_abort_and_suspend_to_acktype(old_value);
+
+      if (current_cached_suspend)
+        ack_type_cumulated = AT_SUSPENDED;
+      else if (current_cached_abort)
+        ack_type_cumulated = AT_ABORTED;
+
+      msg->ack_func(msg, ack_type_cumulated);
+      g_assert(cache->acks == 0);
+    }
+
+  log_msg_unref(msg);
+
+  old_value = log_msg_update_ack_and_ref(msg, cache->refs, 0);
+
+  /* the message may be freed below and its address reused by a message
+   * allocated in a later ack callback, so it must not match anymore */
+  cache->msg = NULL;
+  if (LOGMSG_REFCACHE_VALUE_TO_REF(old_value) == -cache->refs)
+    log_msg_free(msg);
+  cache->refs = 0;
+}
+
+/*
+ * Stop caching ref/unref/ack/add-ack operations for the batch started by
+ * log_msg_refcache_start_producer_batch(). The messages are folded back in
+ * the order they were queued, so acks are delivered in order as well.
+ */
+void
+log_msg_refcache_stop_batch(void)
+{
+  gint num_msgs = logmsg_batch_len;
+
+  g_assert(num_msgs > 0);
+
+  for (gint i = 0; i < num_msgs; i++)
+    _refcache_stop_batch_entry(&logmsg_batch[i]);
+  logmsg_batch_len = 0;
+}
+
 void
 log_msg_registry_init(void)
 {
@@ -2053,6 +2227,8 @@ log_msg_register_stats(void)
   stats_cluster_single_key_add_legacy_alias(&sc_key, SCS_GLOBAL, "msg_allocated_bytes", NULL);
   stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_allocated_bytes);
   stats_unlock();
+
+  log_msg_pool_register_stats();
 }
 
 void
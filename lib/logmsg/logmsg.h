@@ -219,6 +219,11 @@ struct _LogMessage
   LMAckFunc ack_func;
   LogMessage *original;
 
+  /* lookup accelerator for wide payloads, owned by this LogMessage (it is
+   * not part of the NVTable), dropped whenever the payload changes, see
+   * nv_table_get_value_with_hash_index() */
+  NVTableHashIndex *payload_hash_index;
+
   /* message parts */
 
   /* the contents of the members below is directly copied into another
@@ -260,6 +265,10 @@ struct _LogMessage
   guint8 cur_node;
   guint8 write_protected;
 
+  /* index of this message in the producer's batch refcache, only valid
+   * while the batch is being processed, see logmsg.c */
+  guint8 refcache_slot;
+
 
   /* preallocated LogQueueNodes used to insert this message into a LogQueue */
   LogMessageQueueNode nodes[0];
@@ -354,6 +363,18 @@ const gchar *log_msg_get_match_if_set_with_type(const LogMessage *self, gint ind
 
 
 
+/* must be called before the payload is changed or replaced, the writer has
+ * exclusive access to the message, so no atomic operations are needed */
+static inline void
+log_msg_drop_payload_hash_index(LogMessage *self)
+{
+  if (self->payload_hash_index)
+    {
+      nv_table_hash_index_free(self->payload_hash_index);
+      self->payload_hash_index = NULL;
+    }
+}
+
 static inline const gchar *
 log_msg_get_value_if_set_with_type(const LogMessage *self, NVHandle handle,
                                    gssize *value_len,
@@ -365,7 +386,8 @@ log_msg_get_value_if_set_with_type(const LogMessage *self, NVHandle handle,
   if (G_UNLIKELY((flags & LM_VF_MACRO)))
     return log_msg_get_macro_value(self, flags >> 8, value_len, type);
   else
-    return nv_table_get_value(self->payload, handle, value_len, type);
+    return nv_table_get_value_with_hash_index(self->payload, handle, &((LogMessage *) self)->payload_hash_index,
+                                              value_len, type);
 }
 
 static inline const gchar *
@@ -514,6 +536,12 @@ void log_msg_refcache_start_producer(LogMessage *self);
 void log_msg_refcache_start_consumer(LogMessage *self, const LogPathOptions *path_options);
 void log_msg_refcache_stop(void);
 
+/* must fit into LogMessage->refcache_slot */
+#define LOGMSG_REFCACHE_BATCH_MAX 64
+
+void log_msg_refcache_start_producer_batch(LogMessage **msgs, gint num_msgs);
+void log_msg_refcache_stop_batch(void);
+
 void log_msg_registry_init(void);
 void log_msg_registry_deinit(void);
 void log_msg_global_init(void);
@@ -276,6 +276,109 @@ _find_index_entry(NVIndexEntry *index_table, gint index_size, NVHandle handle, N
   return NULL;
 }
 
+/*
+ * NVTableHashIndex: open-addressing (linear probing) hash over the sorted
+ * dynamic index.  Slots store the position of the NVIndexEntry in the
+ * sorted index (plus one, zero marks an empty slot), so overwriting a value
+ * in place (which only changes the offset stored in the NVIndexEntry)
+ * doesn't invalidate it, only inserting a new NVIndexEntry does.  The owner
+ * drops it on any change anyway, as it can't tell the two apart.
+ *
+ * The load factor is kept under 50%, index_size is a guint16, so positions
+ * always fit into the slots.  The index records the table it was built
+ * for, so a stale index is never used for a different NVTable.
+ */
+#define NV_TABLE_HASH_INDEX_MIN_CAPACITY 64
+
+struct _NVTableHashIndex
+{
+  NVTable *table;
+  guint16 index_size;
+  guint32 mask;
+  guint16 slots[];
+};
+
+static inline guint32
+_hash_index_slot(NVTableHashIndex *hash_index, NVHandle handle)
+{
+  guint32 h = handle * 0x9E3779B1;
+
+  return (h ^ (h >> 16)) & hash_index->mask;
+}
+
+static NVTableHashIndex *
+_hash_index_new(NVTable *self)
+{
+  NVIndexEntry *index_table = nv_table_get_index(self);
+  NVTableHashIndex *hash_index;
+  guint32 capacity = NV_TABLE_HASH_INDEX_MIN_CAPACITY;
+
+  while (capacity < 2 * (guint32) self->index_size)
+    capacity <<= 1;
+
+  hash_index = g_malloc0(sizeof(NVTableHashIndex) + capacity * sizeof(hash_index->slots[0]));
+  hash_index->table = self;
+  hash_index->index_size = self->index_size;
+  hash_index->mask = capacity - 1;
+
+  for (gint i = 0; i < self->index_size; i++)
+    {
+      guint32 slot = _hash_index_slot(hash_index, index_table[i].handle);
+
+      while (hash_index->slots[slot])
+        slot = (slot + 1) & hash_index->mask;
+      hash_index->slots[slot] = i + 1;
+    }
+  return hash_index;
+}
+
+/* NVTable instances shared between messages are read concurrently from
+ * multiple threads, so the index is published atomically: if another
+ * thread beats us to it, we drop our copy and use theirs.  Writers have
+ * exclusive access to the NVTable and its owner so they simply drop it.  */
+static NVTableHashIndex *
+_get_hash_index(NVTable *self, NVTableHashIndex **hash_index_location)
+{
+  NVTableHashIndex *hash_index = g_atomic_pointer_get(hash_index_location);
+
+  if (G_LIKELY(hash_index))
+    {
+      g_assert(hash_index->table == self && hash_index->index_size == self->index_size);
+      return hash_index;
+    }
+
+  hash_index = _hash_index_new(self);
+  if (!g_atomic_pointer_compare_and_exchange(hash_index_location, NULL, hash_index))
+    {
+      g_free(hash_index);
+      hash_index = g_atomic_pointer_get(hash_index_location);
+    }
+  return hash_index;
+}
+
+NVEntry *
+nv_table_get_entry_hashed(NVTable *self, NVHandle handle, NVTableHashIndex **hash_index_location)
+{
+  NVTableHashIndex *hash_index = _get_hash_index(self, hash_index_location);
+  NVIndexEntry *index_table = nv_table_get_index(self);
+  guint32 slot = _hash_index_slot(hash_index, handle);
+  guint16 pos;
+
+  while ((pos = hash_index->slots[slot]) != 0)
+    {
+      if (index_table[pos - 1].handle == handle)
+        return nv_table_get_entry_at_ofs(self, index_table[pos - 1].ofs);
+      slot = (slot + 1) & hash_index->mask;
+    }
+  return NULL;
+}
+
+void
+nv_table_hash_index_free(NVTableHashIndex *hash_index)
+{
+  g_free(hash_index);
+}
+
 /* slow path for nv_table_get_entry(), i.e.  we need to perform the lookup
  * for handle in the sorted index_table by implementing a binary search.
  *
@@ -32,6 +32,7 @@ typedef struct _NVTable NVTable;
 typedef struct _NVRegistry NVRegistry;
 typedef struct _NVIndexEntry NVIndexEntry;
 typedef struct _NVEntry NVEntry;
+typedef struct _NVTableHashIndex NVTableHashIndex;
 typedef guint32 NVHandle;
 typedef guint8 NVType;
 typedef gboolean (*NVTableForeachFunc)(NVHandle handle, const gchar *name,
@@ -230,6 +231,13 @@ nv_entry_get_name(NVEntry *self)
  * Dynamic values:
  *   - a dynamically sized NVIndexEntry array (contains ID + offset)
  *   - dynamic values are sorted by the global ID to make handle->entry lookups fast
+ *   - once the number of dynamic values reaches NV_TABLE_HASH_INDEX_THRESHOLD,
+ *     readers may use an open-addressing hash index (NVTableHashIndex)
+ *     instead of the binary search.  The hash index is not part of the
+ *     NVTable (so the layout above and the serialized format are unchanged),
+ *     it is owned by the user of the table (e.g. LogMessage), built lazily
+ *     by nv_table_get_value_with_hash_index() and has to be dropped by the
+ *     owner whenever the table is changed or replaced.
  *
  * Memory allocation
  * =================
@@ -295,6 +303,9 @@ struct _NVTable
  * static values */
 #define NV_TABLE_MIN_BYTES  128
 
+/* number of dynamic entries above which lookups use the hash index */
+#define NV_TABLE_HASH_INDEX_THRESHOLD 32
+
 gboolean nv_table_add_value(NVTable *self, NVHandle handle,
                             const gchar *name, gsize name_len,
                             const gchar *value, gsize value_len,
@@ -316,6 +327,8 @@ NVTable *nv_table_clone(NVTable *self, gint additional_space);
 NVTable *nv_table_ref(NVTable *self);
 void nv_table_unref(NVTable *self);
 
+void nv_table_hash_index_free(NVTableHashIndex *hash_index);
+
 static inline gboolean
 nv_table_is_handle_static(NVTable *self, NVHandle handle)
 {
@@ -366,6 +379,7 @@ nv_table_alloc_check(NVTable *self, gsize alloc_size)
 
 /* private declarations for inline functions */
 NVEntry *nv_table_get_entry_slow(NVTable *self, NVHandle handle, NVIndexEntry **index_entry, NVIndexEntry **index_slot);
+NVEntry *nv_table_get_entry_hashed(NVTable *self, NVHandle handle, NVTableHashIndex **hash_index);
 const gchar *nv_table_resolve_indirect(NVTable *self, NVEntry *entry, gssize *len);
 
 
@@ -416,11 +430,8 @@ nv_table_is_value_set(NVTable *self, NVHandle handle)
 }
 
 static inline const gchar *
-nv_table_get_value(NVTable *self, NVHandle handle, gssize *length, NVType *type)
+__nv_table_get_entry_value(NVTable *self, NVEntry *entry, gssize *length, NVType *type)
 {
-  NVEntry *entry;
-
-  entry = nv_table_get_entry(self, handle, NULL, NULL);
   if (!entry || entry->unset)
     {
       if (length)
@@ -439,6 +450,29 @@ nv_table_get_value(NVTable *self, NVHandle handle, gssize *length, NVType *type)
   return nv_table_resolve_indirect(self, entry, length);
 }
 
+static inline const gchar *
+nv_table_get_value(NVTable *self, NVHandle handle, gssize *length, NVType *type)
+{
+  return __nv_table_get_entry_value(self, nv_table_get_entry(self, handle, NULL, NULL), length, type);
+}
+
+/* same as nv_table_get_value(), but wide tables are looked up via the hash
+ * index stored at @hash_index, which is built on demand.  The caller owns
+ * the hash index and must drop it (nv_table_hash_index_free()) whenever
+ * @self is changed or replaced.  */
+static inline const gchar *
+nv_table_get_value_with_hash_index(NVTable *self, NVHandle handle, NVTableHashIndex **hash_index,
+                                   gssize *length, NVType *type)
+{
+  NVEntry *entry;
+
+  if (G_UNLIKELY(!nv_table_is_handle_static(self, handle) && self->index_size >= NV_TABLE_HASH_INDEX_THRESHOLD))
+    entry = nv_table_get_entry_hashed(self, handle, hash_index);
+  else
+    entry = nv_table_get_entry(self, handle, NULL, NULL);
+  return __nv_table_get_entry_value(self, entry, length, type);
+}
+
 static inline NVIndexEntry *
 nv_table_get_index(NVTable *self)
 {
@@ -930,3 +930,67 @@ Test(log_message, test_cow_unset_value)
   log_msg_unref(orig_msg);
   log_msg_unref(msg);
 }
+
+static void
+_set_numbered_values(LogMessage *msg, const gchar *prefix, gint num_values)
+{
+  for (gint i = 0; i < num_values; i++)
+    {
+      gchar name[32], value[32];
+
+      g_snprintf(name, sizeof(name), "%s%d", prefix, i);
+      g_snprintf(value, sizeof(value), "value%d", i);
+      log_msg_set_value_by_name(msg, name, value, -1);
+    }
+}
+
+static void
+_assert_numbered_values(LogMessage *msg, const gchar *prefix, gint num_values)
+{
+  for (gint i = 0; i < num_values; i++)
+    {
+      gchar name[32], value[32];
+
+      g_snprintf(name, sizeof(name), "%s%d", prefix, i);
+      g_snprintf(value, sizeof(value), "value%d", i);
+      cr_assert_str_eq(log_msg_get_value_by_name(msg, name, NULL), value);
+    }
+}
+
+Test(log_message, test_payload_hash_index_follows_payload_changes)
+{
+  gint num_values = NV_TABLE_HASH_INDEX_THRESHOLD * 2;
+  LogMessage *msg = _construct_log_message();
+
+  _set_numbered_values(msg, "wide", num_values);
+  _assert_numbered_values(msg, "wide", num_values);
+  cr_assert_not_null(msg->payload_hash_index);
+
+  /* new values shift the index (and may reallocate the payload) */
+  _set_numbered_values(msg, "wider", num_values);
+  cr_assert_null(msg->payload_hash_index);
+  _assert_numbered_values(msg, "wide", num_values);
+  _assert_numbered_values(msg, "wider", num_values);
+
+  log_msg_unset_value_by_name(msg, "wide0");
+  cr_assert_null(msg->payload_hash_index);
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, "wide0", NULL), "");
+  _assert_numbered_values(msg, "wider", num_values);
+
+  /* clones share the payload, but not the hash index */
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+  cr_assert_null(cloned->payload_hash_index);
+  _assert_numbered_values(cloned, "wider", num_values);
+  cr_assert_not_null(cloned->payload_hash_index);
+  cr_assert_neq(cloned->payload_hash_index, msg->payload_hash_index);
+
+  log_msg_set_value_by_name(cloned, "wide0", "cloned", -1);
+  cr_assert_str_eq(log_msg_get_value_by_name(cloned, "wide0", NULL), "cloned");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, "wide0", NULL), "");
+  _assert_numbered_values(cloned, "wider", num_values);
+  _assert_numbered_values(msg, "wider", num_values);
+
+  log_msg_unref(cloned);
+  log_msg_unref(msg);
+}
@@ -131,6 +131,64 @@ Test(msg_ack, clone_ack)
   ack_record_free(t);
 }
 
+Test(msg_ack, batch_ack)
+{
+  AckRecord *t[3];
+  LogMessage *msgs[3];
+
+  for (gint i = 0; i < G_N_ELEMENTS(t); i++)
+    {
+      t[i] = ack_record_new();
+      msgs[i] = log_msg_ref(t[i]->original);
+    }
+
+  log_msg_refcache_start_producer_batch(msgs, G_N_ELEMENTS(msgs));
+  for (gint i = 0; i < G_N_ELEMENTS(t); i++)
+    {
+      log_msg_add_ack(msgs[i], &t[i]->path_options);
+      log_msg_ref(msgs[i]);
+    }
+
+  for (gint i = G_N_ELEMENTS(t) - 1; i >= 0; i--)
+    {
+      log_msg_drop(msgs[i], &t[i]->path_options, AT_PROCESSED);
+      cr_assert_not(t[i]->acked, "Acks should be delayed until the batch is stopped");
+    }
+
+  log_msg_refcache_stop_batch();
+
+  for (gint i = 0; i < G_N_ELEMENTS(t); i++)
+    {
+      cr_assert(t[i]->acked);
+      ack_record_free(t[i]);
+    }
+}
+
+Test(msg_ack, batch_refcache_does_not_cache_other_messages)
+{
+  AckRecord *in_batch = ack_record_new();
+  AckRecord *other = ack_record_new();
+  LogMessage *msg = log_msg_ref(in_batch->original);
+
+  log_msg_refcache_start_producer_batch(&msg, 1);
+  log_msg_add_ack(msg, &in_batch->path_options);
+
+  /* same slot, different message */
+  other->original->refcache_slot = msg->refcache_slot;
+  log_msg_add_ack(other->original, &other->path_options);
+  log_msg_ack(other->original, &other->path_options, AT_PROCESSED);
+  cr_assert(other->acked);
+
+  log_msg_ack(msg, &in_batch->path_options, AT_PROCESSED);
+  cr_assert_not(in_batch->acked);
+
+  log_msg_refcache_stop_batch();
+  cr_assert(in_batch->acked);
+
+  ack_record_free(in_batch);
+  ack_record_free(other);
+}
+
 struct nv_pair
 {
   const gchar *name;
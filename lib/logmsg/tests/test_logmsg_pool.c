@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+#include "logmsg/logmsg-pool.h"
+#include "logmsg/logmsg.h"
+#include "apphook.h"
+
+#define NUM_MESSAGES 1000
+
+Test(logmsg_pool, freed_blocks_are_recycled_in_the_same_thread)
+{
+  gpointer first = log_msg_pool_alloc(600);
+  memset(first, 'x', 600);
+  log_msg_pool_free(first);
+
+  gpointer second = log_msg_pool_alloc(700);
+  cr_assert_eq(first, second, "Block of the same size class was not recycled");
+  log_msg_pool_free(second);
+}
+
+Test(logmsg_pool, large_blocks_bypass_the_pool)
+{
+  gpointer block = log_msg_pool_alloc(1024 * 1024);
+  memset(block, 'x', 1024 * 1024);
+  log_msg_pool_free(block);
+}
+
+static gpointer
+_free_messages_in_other_thread(gpointer user_data)
+{
+  GPtrArray *messages = (GPtrArray *) user_data;
+
+  app_thread_start();
+  for (guint i = 0; i < messages->len; i++)
+    log_msg_unref((LogMessage *) g_ptr_array_index(messages, i));
+  app_thread_stop();
+  return NULL;
+}
+
+static gboolean
+_array_contains(GPtrArray *array, gpointer item)
+{
+  for (guint i = 0; i < array->len; i++)
+    {
+      if (g_ptr_array_index(array, i) == item)
+        return TRUE;
+    }
+  return FALSE;
+}
+
+Test(logmsg_pool, blocks_freed_in_other_threads_are_returned_to_the_owner)
+{
+  GPtrArray *messages = g_ptr_array_new();
+
+  for (gint i = 0; i < NUM_MESSAGES; i++)
+    g_ptr_array_add(messages, log_msg_new_empty());
+
+  GThread *thread = g_thread_new(NULL, _free_messages_in_other_thread, messages);
+  g_thread_join(thread);
+
+  /* all blocks are now on the remote free list, the next allocation
+   * reclaims them */
+  LogMessage *msg = log_msg_new_empty();
+  cr_assert(_array_contains(messages, msg), "Cross-thread freed block was not reused");
+  log_msg_unref(msg);
+
+  g_ptr_array_free(messages, TRUE);
+}
+
+static gpointer
+_allocate_messages_and_exit(gpointer user_data)
+{
+  GPtrArray *messages = (GPtrArray *) user_data;
+
+  app_thread_start();
+  for (gint i = 0; i < NUM_MESSAGES; i++)
+    g_ptr_array_add(messages, log_msg_new_empty());
+  app_thread_stop();
+  return NULL;
+}
+
+Test(logmsg_pool, messages_survive_the_thread_that_allocated_them)
+{
+  GPtrArray *messages = g_ptr_array_new();
+
+  GThread *thread = g_thread_new(NULL, _allocate_messages_and_exit, messages);
+  g_thread_join(thread);
+
+  for (guint i = 0; i < messages->len; i++)
+    {
+      LogMessage *msg = (LogMessage *) g_ptr_array_index(messages, i);
+
+      log_msg_set_value(msg, LM_V_MESSAGE, "foo", -1);
+      log_msg_unref(msg);
+    }
+  g_ptr_array_free(messages, TRUE);
+}
+
+TestSuite(logmsg_pool, .init = app_startup, .fini = app_shutdown);
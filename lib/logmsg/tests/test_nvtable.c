@@ -25,8 +25,10 @@
 #include <criterion/criterion.h>
 
 #include "logmsg/nvtable.h"
+#include "logmsg/nvtable-serialize.h"
 #include "apphook.h"
 #include "logmsg/logmsg.h"
+#include "libtest/stopwatch.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -1166,3 +1168,190 @@ Test(nvtable, test_nvtable_compact_skips_unset_values)
 
   nv_table_unref(tab2);
 }
+
+static NVTable *
+_create_wide_nvtable(gint num_entries)
+{
+  NVTable *tab = nv_table_new(STATIC_VALUES, num_entries, num_entries * 64);
+
+  /* add the values in reverse order, so the sorted index is shuffled around */
+  for (gint i = num_entries - 1; i >= 0; i--)
+    {
+      gchar name[32], value[32];
+
+      g_snprintf(name, sizeof(name), "VAL%d", DYN_HANDLE + i);
+      g_snprintf(value, sizeof(value), "value%d", i);
+      cr_assert(nv_table_add_value(tab, DYN_HANDLE + i, name, strlen(name), value, strlen(value), 0, NULL));
+    }
+  return tab;
+}
+
+static void
+_assert_wide_nvtable(NVTable *tab, gint num_entries)
+{
+  for (gint i = 0; i < num_entries; i++)
+    {
+      gchar value[32];
+
+      g_snprintf(value, sizeof(value), "value%d", i);
+      assert_nvtable(tab, DYN_HANDLE + i, value, strlen(value));
+    }
+  cr_assert_not(nv_table_is_value_set(tab, DYN_HANDLE + num_entries));
+  cr_assert_not(nv_table_is_value_set(tab, DYN_HANDLE + num_entries * 2));
+}
+
+static void
+_assert_wide_nvtable_with_hash_index(NVTable *tab, NVTableHashIndex **hash_index, gint num_entries)
+{
+  for (gint i = 0; i < num_entries; i++)
+    {
+      gchar expected_value[32];
+      const gchar *value;
+      gssize length;
+
+      g_snprintf(expected_value, sizeof(expected_value), "value%d", i);
+      value = nv_table_get_value_with_hash_index(tab, DYN_HANDLE + i, hash_index, &length, NULL);
+      cr_assert_not_null(value);
+      cr_assert_eq(length, strlen(expected_value));
+      cr_assert(strncmp(value, expected_value, length) == 0);
+    }
+  cr_assert_null(nv_table_get_value_with_hash_index(tab, DYN_HANDLE + num_entries, hash_index, NULL, NULL));
+  cr_assert_null(nv_table_get_value_with_hash_index(tab, DYN_HANDLE + num_entries * 2, hash_index, NULL, NULL));
+}
+
+Test(nvtable, test_nvtable_hash_index_is_built_above_threshold)
+{
+  NVTableHashIndex *hash_index = NULL;
+  NVTable *tab = _create_wide_nvtable(NV_TABLE_HASH_INDEX_THRESHOLD - 1);
+
+  _assert_wide_nvtable_with_hash_index(tab, &hash_index, NV_TABLE_HASH_INDEX_THRESHOLD - 1);
+  cr_assert_null(hash_index);
+  nv_table_unref(tab);
+
+  tab = _create_wide_nvtable(NV_TABLE_HASH_INDEX_THRESHOLD * 4);
+  _assert_wide_nvtable(tab, NV_TABLE_HASH_INDEX_THRESHOLD * 4);
+  cr_assert_null(hash_index);
+  _assert_wide_nvtable_with_hash_index(tab, &hash_index, NV_TABLE_HASH_INDEX_THRESHOLD * 4);
+  cr_assert_not_null(hash_index);
+  nv_table_hash_index_free(hash_index);
+  nv_table_unref(tab);
+}
+
+Test(nvtable, test_nvtable_hash_index_is_rebuilt_after_it_is_dropped)
+{
+  gint num_entries = NV_TABLE_HASH_INDEX_THRESHOLD * 4;
+  NVTableHashIndex *hash_index = NULL;
+  NVTable *tab = _create_wide_nvtable(num_entries);
+
+  _assert_wide_nvtable_with_hash_index(tab, &hash_index, num_entries);
+  cr_assert_not_null(hash_index);
+
+  /* a new entry shifts the sorted index, the owner drops the hash index */
+  cr_assert(nv_table_add_value(tab, DYN_HANDLE + num_entries, "new", 3, "value", 5, 0, NULL));
+  nv_table_hash_index_free(hash_index);
+  hash_index = NULL;
+
+  cr_assert_str_eq(nv_table_get_value_with_hash_index(tab, DYN_HANDLE + num_entries, &hash_index, NULL, NULL),
+                   "value");
+  cr_assert_not_null(hash_index);
+  _assert_wide_nvtable_with_hash_index(tab, &hash_index, num_entries);
+  nv_table_hash_index_free(hash_index);
+  nv_table_unref(tab);
+}
+
+Test(nvtable, test_nvtable_hash_index_is_not_part_of_the_nvtable)
+{
+  /* the header of NVTable is part of the serialized format, see the
+   * memory layout comment in nvtable.h */
+  cr_assert_eq(G_STRUCT_OFFSET(NVTable, static_entries), 12);
+  cr_assert_eq(G_STRUCT_OFFSET(NVTable, data), 12);
+}
+
+/* writes @tab in the NVT2 format with the size of the table recomputed for
+ * a 12 byte header and no free space between the index and the payload,
+ * as written by versions that predate the hash index. */
+static void
+_serialize_nvtable_in_old_layout(SerializeArchive *sa, NVTable *tab)
+{
+  guint32 size = 12 + tab->num_static_entries * sizeof(guint32) + tab->index_size * sizeof(NVIndexEntry) + tab->used;
+  guint32 magic;
+
+  memcpy(&magic, NV_TABLE_MAGIC_V2, 4);
+  serialize_write_uint32(sa, magic);
+  serialize_write_uint8(sa, (G_BYTE_ORDER == G_BIG_ENDIAN ? NVT_SF_BE : 0) | NVT_SUPPORTS_UNSET);
+  serialize_write_uint32(sa, size);
+  serialize_write_uint32(sa, tab->used);
+  serialize_write_uint16(sa, tab->index_size);
+  serialize_write_uint8(sa, tab->num_static_entries);
+  serialize_write_uint32_array(sa, tab->static_entries, tab->num_static_entries);
+  serialize_write_uint32_array(sa, (guint32 *) nv_table_get_index(tab), tab->index_size * 2);
+  serialize_write_blob(sa, nv_table_get_bottom(tab), tab->used);
+}
+
+Test(nvtable, test_nvtable_deserialize_old_layout_with_hash_index)
+{
+  gint num_entries = NV_TABLE_HASH_INDEX_THRESHOLD * 4;
+  NVTable *tab = _create_wide_nvtable(num_entries);
+  NVTableHashIndex *hash_index = NULL;
+  GString *stream = g_string_new("");
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+  LogMessageSerializationState state = { 0 };
+
+  cr_assert(nv_table_add_value(tab, STATIC_HANDLE, STATIC_NAME, strlen(STATIC_NAME), "static-foo", 10, 0, NULL));
+  _serialize_nvtable_in_old_layout(sa, tab);
+  nv_table_unref(tab);
+
+  state.sa = sa;
+  tab = nv_table_deserialize(&state);
+  cr_assert_not_null(tab, "NVTable in the old layout could not be deserialized");
+  cr_assert_eq(tab->index_size, num_entries);
+
+  assert_nvtable(tab, STATIC_HANDLE, "static-foo", 10);
+  _assert_wide_nvtable(tab, num_entries);
+  _assert_wide_nvtable_with_hash_index(tab, &hash_index, num_entries);
+  cr_assert_not_null(hash_index);
+  nv_table_hash_index_free(hash_index);
+
+  /* and back again, the serialized form stays the same */
+  GString *stream2 = g_string_new("");
+  SerializeArchive *sa2 = serialize_string_archive_new(stream2);
+  LogMessageSerializationState state2 = { .sa = sa2 };
+
+  cr_assert(nv_table_serialize(&state2, tab));
+  cr_assert_eq(stream2->len, stream->len);
+  cr_assert(memcmp(stream2->str, stream->str, stream->len) == 0);
+
+  serialize_archive_free(sa2);
+  g_string_free(stream2, TRUE);
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+  nv_table_unref(tab);
+}
+
+static void
+_measure_dynamic_lookups(gint num_entries)
+{
+  NVTable *tab = _create_wide_nvtable(num_entries);
+  NVTableHashIndex *hash_index = NULL;
+  const gint iterations = 1000000;
+  gssize length, sum = 0;
+
+  start_stopwatch();
+  for (gint i = 0; i < iterations; i++)
+    {
+      nv_table_get_value_with_hash_index(tab, DYN_HANDLE + (i % num_entries), &hash_index, &length, NULL);
+      sum += length;
+    }
+  stop_stopwatch_and_display_result(iterations, "looking up %d dynamic values in a %d entry NVTable took",
+                                    iterations, num_entries);
+  cr_assert_gt(sum, 0);
+  nv_table_hash_index_free(hash_index);
+  nv_table_unref(tab);
+}
+
+Test(nvtable, test_nvtable_lookup_performance)
+{
+  _measure_dynamic_lookups(10);
+  _measure_dynamic_lookups(100);
+  _measure_dynamic_lookups(1000);
+}
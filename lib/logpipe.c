@@ -79,6 +79,7 @@ log_pipe_init_instance(LogPipe *self, GlobalConfig *cfg)
    * inlined (than to use an indirect call) for performance. */
 
   self->queue = NULL;
+  self->queue_batch = NULL;
   self->free_fn = log_pipe_free_method;
   self->arcs = _arcs;
 }
@@ -265,6 +265,8 @@ struct _LogPipe
   gint32 flags;
 
   void (*queue)(LogPipe *self, LogMessage *msg, const LogPathOptions *path_options);
+  /* optional, see log_pipe_queue_batch() */
+  void (*queue_batch)(LogPipe *self, LogMessage **msgs, gint num_msgs, const LogPathOptions *path_options);
 
   GlobalConfig *cfg;
   LogExprNode *expr_node;
@@ -409,6 +411,30 @@ log_pipe_forward_msg(LogPipe *self, LogMessage *msg, const LogPathOptions *path_
     }
 }
 
+static inline const LogPathOptions *
+_log_pipe_apply_path_flags(LogPipe *s, const LogPathOptions *path_options, LogPathOptions *local_path_options)
+{
+  if (G_UNLIKELY(s->flags & (PIF_HARD_FLOW_CONTROL | PIF_JUNCTION_END | PIF_CONDITIONAL_MIDPOINT)))
+    {
+      *local_path_options = *path_options;
+      if (s->flags & PIF_HARD_FLOW_CONTROL)
+        {
+          local_path_options->flow_control_requested = 1;
+          msg_trace("Requesting flow control", log_pipe_location_tag(s));
+        }
+      if (s->flags & PIF_JUNCTION_END)
+        {
+          log_path_options_pop_junction(local_path_options);
+        }
+      if (s->flags & PIF_CONDITIONAL_MIDPOINT)
+        {
+          log_path_options_pop_conditional(local_path_options);
+        }
+      return local_path_options;
+    }
+  return path_options;
+}
+
 static inline void
 log_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
 {
@@ -424,24 +450,7 @@ log_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
         }
     }
 
-  if (G_UNLIKELY(s->flags & (PIF_HARD_FLOW_CONTROL | PIF_JUNCTION_END | PIF_CONDITIONAL_MIDPOINT)))
-    {
-      local_path_options = *path_options;
-      if (s->flags & PIF_HARD_FLOW_CONTROL)
-        {
-          local_path_options.flow_control_requested = 1;
-          msg_trace("Requesting flow control", log_pipe_location_tag(s));
-        }
-      if (s->flags & PIF_JUNCTION_END)
-        {
-          log_path_options_pop_junction(&local_path_options);
-        }
-      if (s->flags & PIF_CONDITIONAL_MIDPOINT)
-        {
-          log_path_options_pop_conditional(&local_path_options);
-        }
-      path_options = &local_path_options;
-    }
+  path_options = _log_pipe_apply_path_flags(s, path_options, &local_path_options);
 
   if (s->queue)
     {
@@ -454,6 +463,84 @@ log_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
 
 }
 
+#define LOG_PIPE_BATCH_MAX 64
+
+/*
+ * Batched message ingestion
+ *
+ *   log_pipe_queue_batch() passes a batch of messages to a LogPipe with a
+ *   single call, sharing the same path options.  Pipes that implement
+ *   queue_batch() process the batch as a whole (and forward whatever
+ *   remains of it with log_pipe_forward_msgs()), all other pipes get their
+ *   queue() method called for each message, so implementing queue_batch()
+ *   is an optimization, never a requirement.  Pipes with neither method
+ *   pass the batch on to pipe_next as is.
+ *
+ *   A batch holds at most LOG_PIPE_BATCH_MAX messages.  The msgs array
+ *   is owned by the receiving pipe until it returns, it may reorder or
+ *   overwrite its elements (e.g. to drop messages from the batch).
+ *
+ *   As the path options are shared, the per-message "matched" result is
+ *   not available to the sender of a batch.  Pipes that need it (e.g.
+ *   LogMultiplexer with final or fallback branches) have to queue the
+ *   messages one-by-one.
+ *
+ *   A queue_batch() implementation of a class whose queue() method may be
+ *   overridden by derived classes has to check for that and use
+ *   log_pipe_queue_each() instead, so the override is not bypassed.
+ */
+
+static inline void
+log_pipe_queue_each(LogPipe *s, LogMessage **msgs, gint num_msgs, const LogPathOptions *path_options)
+{
+  for (gint i = 0; i < num_msgs; i++)
+    s->queue(s, msgs[i], path_options);
+}
+
+static inline void
+log_pipe_queue_batch(LogPipe *s, LogMessage **msgs, gint num_msgs, const LogPathOptions *path_options);
+
+static inline void
+log_pipe_forward_msgs(LogPipe *self, LogMessage **msgs, gint num_msgs, const LogPathOptions *path_options)
+{
+  if (self->pipe_next)
+    {
+      log_pipe_queue_batch(self->pipe_next, msgs, num_msgs, path_options);
+    }
+  else
+    {
+      for (gint i = 0; i < num_msgs; i++)
+        log_msg_drop(msgs[i], path_options, AT_PROCESSED);
+    }
+}
+
+static inline void
+log_pipe_queue_batch(LogPipe *s, LogMessage **msgs, gint num_msgs, const LogPathOptions *path_options)
+{
+  LogPathOptions local_path_options;
+
+  if (num_msgs == 0)
+    return;
+
+  g_assert(num_msgs <= LOG_PIPE_BATCH_MAX);
+
+  if (G_UNLIKELY(pipe_single_step_hook) || (s->queue && !s->queue_batch))
+    {
+      for (gint i = 0; i < num_msgs; i++)
+        log_pipe_queue(s, msgs[i], path_options);
+      return;
+    }
+
+  g_assert((s->flags & PIF_INITIALIZED) != 0);
+
+  path_options = _log_pipe_apply_path_flags(s, path_options, &local_path_options);
+
+  if (s->queue_batch)
+    s->queue_batch(s, msgs, num_msgs, path_options);
+  else
+    log_pipe_forward_msgs(s, msgs, num_msgs, path_options);
+}
+
 static inline LogPipe *
 log_pipe_clone(LogPipe *self)
 {
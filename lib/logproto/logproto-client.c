@@ -76,11 +76,18 @@ log_proto_client_options_get_timeout(LogProtoClientOptions *options)
   return options->timeout;
 }
 
+void
+log_proto_client_options_set_send_batch_size(LogProtoClientOptions *options, gint send_batch_size)
+{
+  options->send_batch_size = send_batch_size;
+}
+
 void
 log_proto_client_options_defaults(LogProtoClientOptions *options)
 {
   options->drop_input = FALSE;
   options->timeout = 0;
+  options->send_batch_size = 1;
 }
 
 void
@@ -36,6 +36,7 @@ typedef struct _LogProtoClientOptions
 {
   gboolean drop_input;
   gint timeout;
+  gint send_batch_size;
 } LogProtoClientOptions;
 
 typedef union _LogProtoClientOptionsStorage
@@ -57,6 +58,7 @@ typedef struct
 void log_proto_client_options_set_drop_input(LogProtoClientOptions *options, gboolean drop_input);
 void log_proto_client_options_set_timeout(LogProtoClientOptions *options, gint timeout);
 gint log_proto_client_options_get_timeout(LogProtoClientOptions *options);
+void log_proto_client_options_set_send_batch_size(LogProtoClientOptions *options, gint send_batch_size);
 
 void log_proto_client_options_defaults(LogProtoClientOptions *options);
 void log_proto_client_options_init(LogProtoClientOptions *options, GlobalConfig *cfg);
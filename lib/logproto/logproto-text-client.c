@@ -25,6 +25,8 @@
 #include "messages.h"
 
 #include <errno.h>
+#include <string.h>
+#include <limits.h>
 
 static gboolean
 log_proto_text_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond, gint *timeout)
@@ -38,7 +40,7 @@ log_proto_text_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond, g
   if (*cond == 0)
     *cond = G_IO_OUT;
 
-  const gboolean pending_write = self->partial != NULL;
+  const gboolean pending_write = self->partial != NULL || self->batch.num_chunks > 0;
 
   if (!pending_write && s->options->timeout > 0)
     *timeout = s->options->timeout;
@@ -73,12 +75,102 @@ log_proto_text_client_drop_input(LogProtoClient *s)
   return LPS_SUCCESS;
 }
 
+static void
+_batch_add_chunk(LogProtoTextClient *self, gpointer data, gsize len, GDestroyNotify data_free,
+                 gboolean completes_message)
+{
+  gint i = self->batch.num_chunks++;
+
+  self->batch.chunks[i].data = data;
+  self->batch.chunks[i].data_free = data_free;
+  self->batch.chunks[i].completes_message = completes_message;
+  self->batch.iov[i].iov_base = data;
+  self->batch.iov[i].iov_len = len;
+}
+
+static void
+_batch_free_chunk(LogProtoTextClientBatchChunk *chunk)
+{
+  if (chunk->data_free)
+    chunk->data_free(chunk->data);
+  chunk->data = NULL;
+  chunk->data_free = NULL;
+}
+
+static void
+_batch_reset(LogProtoTextClient *self)
+{
+  self->batch.num_messages = 0;
+  self->batch.num_chunks = 0;
+  self->batch.pos = 0;
+  self->batch.pending = FALSE;
+}
+
+/*
+ * Writes the not yet written part of the batch. Completely written chunks
+ * are released and the messages they complete are acked, the first
+ * partially written chunk is adjusted to point to its remaining part.
+ */
+static LogProtoStatus
+log_proto_text_client_flush_batch(LogProtoTextClient *self)
+{
+  if (self->batch.pos == self->batch.num_chunks)
+    return LPS_SUCCESS;
+
+  gssize rc = log_transport_writev(self->super.transport, &self->batch.iov[self->batch.pos],
+                                   self->batch.num_chunks - self->batch.pos);
+  if (rc < 0)
+    {
+      if (errno != EAGAIN && errno != EINTR)
+        {
+          msg_error("I/O error occurred while writing",
+                    evt_tag_int("fd", self->super.transport->fd),
+                    evt_tag_error(EVT_TAG_OSERROR));
+          return LPS_ERROR;
+        }
+      self->batch.pending = TRUE;
+      return LPS_SUCCESS;
+    }
+
+  gsize written = rc;
+  gint num_acked = 0;
+  while (self->batch.pos < self->batch.num_chunks && written >= self->batch.iov[self->batch.pos].iov_len)
+    {
+      LogProtoTextClientBatchChunk *chunk = &self->batch.chunks[self->batch.pos];
+
+      written -= self->batch.iov[self->batch.pos].iov_len;
+      if (chunk->completes_message)
+        num_acked++;
+      _batch_free_chunk(chunk);
+      self->batch.pos++;
+    }
+
+  if (num_acked > 0)
+    log_proto_client_msg_ack(&self->super, num_acked);
+
+  if (self->batch.pos < self->batch.num_chunks)
+    {
+      struct iovec *iov = &self->batch.iov[self->batch.pos];
+
+      iov->iov_base = (guchar *) iov->iov_base + written;
+      iov->iov_len -= written;
+      self->batch.pending = TRUE;
+      return LPS_PARTIAL;
+    }
+
+  _batch_reset(self);
+  return LPS_SUCCESS;
+}
+
 static LogProtoStatus
 log_proto_text_client_flush(LogProtoClient *s)
 {
   LogProtoTextClient *self = (LogProtoTextClient *) s;
   gint rc;
 
+  if (log_proto_text_client_is_batching(self))
+    return log_proto_text_client_flush_batch(self);
+
   if (!self->partial)
     {
       return LPS_SUCCESS;
@@ -136,6 +228,55 @@ log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len
   return log_proto_text_client_flush(s);
 }
 
+/*
+ * log_proto_text_client_post_batched:
+ * @header: optional data to be sent in front of @msg (e.g. the frame header), copied by this function
+ * @header_len: length of @header, at most LOG_PROTO_TEXT_CLIENT_MAX_HEADER_LEN
+ *
+ * Adds the message to the batch, which is written out when it becomes full
+ * or when the client is flushed (e.g. at the end of the LogWriter flush
+ * round). While a previous batch has not been written out completely, no
+ * new messages are accepted, just like in the case of a partial write in
+ * unbatched mode.
+ **/
+LogProtoStatus
+log_proto_text_client_post_batched(LogProtoClient *s, const guchar *header, gsize header_len,
+                                   guchar *msg, gsize msg_len, gboolean *consumed)
+{
+  LogProtoTextClient *self = (LogProtoTextClient *) s;
+  gint num_chunks = header_len > 0 ? 2 : 1;
+
+  g_assert(header_len <= LOG_PROTO_TEXT_CLIENT_MAX_HEADER_LEN);
+
+  *consumed = FALSE;
+  if (self->batch.pending ||
+      self->batch.num_messages == self->batch.max_messages ||
+      self->batch.num_chunks + num_chunks > self->batch.max_chunks)
+    {
+      const LogProtoStatus status = log_proto_text_client_flush_batch(self);
+      if (status == LPS_ERROR)
+        return status;
+
+      if (self->batch.num_chunks > 0)
+        return LPS_PARTIAL;
+    }
+
+  if (header_len > 0)
+    {
+      LogProtoTextClientBatchChunk *chunk = &self->batch.chunks[self->batch.num_chunks];
+
+      memcpy(chunk->header, header, header_len);
+      _batch_add_chunk(self, chunk->header, header_len, NULL, FALSE);
+    }
+  _batch_add_chunk(self, msg, msg_len, (GDestroyNotify) g_free, TRUE);
+  self->batch.num_messages++;
+  *consumed = TRUE;
+
+  if (self->batch.num_messages == self->batch.max_messages)
+    return log_proto_text_client_flush_batch(self);
+
+  return LPS_SUCCESS;
+}
 
 /*
  * log_proto_text_client_post:
@@ -153,6 +294,9 @@ log_proto_text_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg, g
 {
   LogProtoTextClient *self = (LogProtoTextClient *) s;
 
+  if (log_proto_text_client_is_batching(self))
+    return log_proto_text_client_post_batched(s, NULL, 0, msg, msg_len, consumed);
+
   /* try to flush already buffered data */
   *consumed = FALSE;
   const LogProtoStatus status = log_proto_text_client_flush(s);
@@ -189,6 +333,12 @@ log_proto_text_client_free(LogProtoClient *s)
   if (self->partial_free)
     self->partial_free(self->partial);
   self->partial = NULL;
+
+  for (gint i = self->batch.pos; i < self->batch.num_chunks; i++)
+    _batch_free_chunk(&self->batch.chunks[i]);
+  g_free(self->batch.iov);
+  g_free(self->batch.chunks);
+
   log_proto_client_free_method(s);
 };
 
@@ -204,6 +354,18 @@ log_proto_text_client_init(LogProtoTextClient *self, LogTransport *transport, co
   self->super.free_fn = log_proto_text_client_free;
   self->super.transport = transport;
   self->next_state = -1;
+
+  if (options->send_batch_size > 1)
+    {
+      /* room for an optional header chunk in front of each message */
+      self->batch.max_chunks = options->send_batch_size * 2;
+#ifdef IOV_MAX
+      self->batch.max_chunks = MIN(self->batch.max_chunks, IOV_MAX);
+#endif
+      self->batch.max_messages = MIN(options->send_batch_size, self->batch.max_chunks);
+      self->batch.iov = g_new0(struct iovec, self->batch.max_chunks);
+      self->batch.chunks = g_new0(LogProtoTextClientBatchChunk, self->batch.max_chunks);
+    }
 }
 
 LogProtoClient *
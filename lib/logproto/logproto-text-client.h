@@ -26,6 +26,18 @@
 
 #include "logproto-client.h"
 
+#include <sys/uio.h>
+
+#define LOG_PROTO_TEXT_CLIENT_MAX_HEADER_LEN 16
+
+typedef struct _LogProtoTextClientBatchChunk
+{
+  gpointer data;
+  GDestroyNotify data_free;
+  gboolean completes_message;
+  guchar header[LOG_PROTO_TEXT_CLIENT_MAX_HEADER_LEN];
+} LogProtoTextClientBatchChunk;
+
 typedef struct _LogProtoTextClient
 {
   LogProtoClient super;
@@ -33,10 +45,33 @@ typedef struct _LogProtoTextClient
   guchar *partial;
   GDestroyNotify partial_free;
   gsize partial_len, partial_pos;
+
+  /* batched mode: the messages posted until the next flush are written with one writev() */
+  struct
+  {
+    gint max_messages;
+    gint max_chunks;
+    gint num_messages;
+    gint num_chunks;
+    /* the first chunk that has not been written out completely */
+    gint pos;
+    /* a write was attempted, but the batch could not be sent fully */
+    gboolean pending;
+    struct iovec *iov;
+    LogProtoTextClientBatchChunk *chunks;
+  } batch;
 } LogProtoTextClient;
 
+static inline gboolean
+log_proto_text_client_is_batching(LogProtoTextClient *self)
+{
+  return self->batch.max_messages > 1;
+}
+
 LogProtoStatus log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len,
                                                   GDestroyNotify msg_free, gint next_state);
+LogProtoStatus log_proto_text_client_post_batched(LogProtoClient *s, const guchar *header, gsize header_len,
+                                                  guchar *msg, gsize msg_len, gboolean *consumed);
 void log_proto_text_client_init(LogProtoTextClient *self, LogTransport *transport,
                                 const LogProtoClientOptions *options);
 LogProtoClient *log_proto_text_client_new(LogTransport *transport, const LogProtoClientOptions *options);
@@ -23,6 +23,7 @@
  */
 #include "logproto-text-server.h"
 #include "messages.h"
+#include "find-crlf.h"
 
 #include <string.h>
 
@@ -40,6 +41,61 @@ log_proto_text_server_prepare_method(LogProtoServer *s, GIOCondition *cond, gint
   return avail ? LPPA_FORCE_SCHEDULE_FETCH : LPPA_POLL_IO;
 }
 
+static const guchar *
+log_proto_text_server_scan_eol_batch(LogProtoTextServer *self, guint32 from, guint32 to)
+{
+  LogProtoTextServerEolBatch *batch = &self->eol_batch;
+
+  batch->count = self->find_eoms(self->super.buffer + from, to - from,
+                                 batch->positions, LOG_PROTO_TEXT_SERVER_EOL_BATCH_SIZE);
+  for (gint i = 0; i < batch->count; i++)
+    batch->positions[i] += from;
+
+  batch->next = 0;
+  batch->scan_start = from;
+  if (batch->count == LOG_PROTO_TEXT_SERVER_EOL_BATCH_SIZE)
+    batch->scan_end = batch->positions[batch->count - 1] + 1;
+  else
+    batch->scan_end = to;
+  batch->valid = TRUE;
+
+  return batch->count > 0 ? self->super.buffer + batch->positions[0] : NULL;
+}
+
+/* returns the first EOL in the [from, to) range of the buffer, using the
+ * boundaries collected by the last scan whenever possible */
+static const guchar *
+log_proto_text_server_find_eol(LogProtoTextServer *self, guint32 from, guint32 to)
+{
+  LogProtoTextServerEolBatch *batch = &self->eol_batch;
+
+  if (!self->find_eoms)
+    return self->find_eom(self->super.buffer + from, to - from);
+
+  if (!batch->valid || from < batch->scan_start)
+    return log_proto_text_server_scan_eol_batch(self, from, to);
+
+  while (batch->next < batch->count && batch->positions[batch->next] < from)
+    batch->next++;
+
+  if (batch->next < batch->count)
+    {
+      guint32 eol_pos = batch->positions[batch->next];
+      return eol_pos < to ? self->super.buffer + eol_pos : NULL;
+    }
+
+  /* the scanned range had no further EOL, only new data needs to be looked at */
+  if (batch->scan_end >= to)
+    return NULL;
+  return log_proto_text_server_scan_eol_batch(self, MAX(from, batch->scan_end), to);
+}
+
+static inline void
+log_proto_text_server_invalidate_eol_batch(LogProtoTextServer *self)
+{
+  self->eol_batch.valid = FALSE;
+}
+
 static gint
 log_proto_text_server_accumulate_line(LogProtoTextServer *self, const guchar *msg, gsize msg_len,
                                       gssize consumed_len)
@@ -75,7 +131,7 @@ log_proto_text_server_try_extract(LogProtoTextServer *self, LogProtoBufferedServ
        * read further data, or the buffer already contains a
        * complete line */
 
-      eom = self->find_eom(self->super.buffer + next_line_pos, state->pending_buffer_end - next_line_pos);
+      eom = log_proto_text_server_find_eol(self, next_line_pos, state->pending_buffer_end);
       if (eom)
         next_eol_pos = eom - self->super.buffer;
     }
@@ -214,7 +270,8 @@ log_proto_text_server_locate_next_eol(LogProtoTextServer *self, LogProtoBuffered
     }
   else
     {
-      eol = self->find_eom(buffer_start + self->consumed_len + 1, buffer_bytes - self->consumed_len - 1);
+      eol = log_proto_text_server_find_eol(self, buffer_start + self->consumed_len + 1 - self->super.buffer,
+                                           buffer_start + buffer_bytes - self->super.buffer);
     }
   return eol;
 }
@@ -269,6 +326,11 @@ log_proto_text_server_fetch_from_buffer(LogProtoBufferedServer *s, const guchar
 
   gboolean result = _fetch_msg_from_buffer(self, state, buffer_start, buffer_bytes, msg, msg_len);
 
+  /* the buffer is either split or reused from its beginning from here on,
+   * the EOL offsets collected so far become stale */
+  if (!result || state->pending_buffer_pos == state->pending_buffer_end)
+    log_proto_text_server_invalidate_eol_batch(self);
+
   log_proto_buffered_server_put_state(&self->super);
   return result;
 }
@@ -279,6 +341,7 @@ log_proto_text_server_flush(LogProtoBufferedServer *s)
   LogProtoTextServer *self = (LogProtoTextServer *) s;
   self->consumed_len = -1;
   self->cached_eol_pos = 0;
+  log_proto_text_server_invalidate_eol_batch(self);
 }
 
 void
@@ -300,6 +363,12 @@ log_proto_text_server_free(LogProtoServer *s)
   log_proto_buffered_server_free_method(&self->super.super);
 }
 
+static gsize
+_find_nl_or_nul_as_eoms(const guchar *s, gsize n, guint32 *positions, gsize max_positions)
+{
+  return find_line_terminators((const gchar *) s, n, FIND_CRLF_LF | FIND_CRLF_NUL, positions, max_positions);
+}
+
 void
 log_proto_text_server_init(LogProtoTextServer *self, LogTransport *transport, const LogProtoServerOptions *options)
 {
@@ -309,6 +378,7 @@ log_proto_text_server_init(LogProtoTextServer *self, LogTransport *transport, co
   self->super.fetch_from_buffer = log_proto_text_server_fetch_from_buffer;
   self->super.flush = log_proto_text_server_flush;
   self->find_eom = find_eom;
+  self->find_eoms = _find_nl_or_nul_as_eoms;
   self->super.stream_based = TRUE;
   self->consumed_len = -1;
 }
@@ -328,6 +398,12 @@ _find_nl_as_eom(const guchar *s, gsize n)
   return memchr(s, '\n', n);
 }
 
+static gsize
+_find_nl_as_eoms(const guchar *s, gsize n, guint32 *positions, gsize max_positions)
+{
+  return find_line_terminators((const gchar *) s, n, FIND_CRLF_LF, positions, max_positions);
+}
+
 LogProtoServer *
 log_proto_text_with_nuls_server_new(LogTransport *transport, const LogProtoServerOptions *options)
 {
@@ -335,5 +411,6 @@ log_proto_text_with_nuls_server_new(LogTransport *transport, const LogProtoServe
 
   log_proto_text_server_init(self, transport, options);
   self->find_eom = _find_nl_as_eom;
+  self->find_eoms = _find_nl_as_eoms;
   return &self->super.super;
 }
@@ -27,6 +27,20 @@
 #include "logproto-buffered-server.h"
 #include "multi-line/multi-line-logic.h"
 
+#define LOG_PROTO_TEXT_SERVER_EOL_BATCH_SIZE 64
+
+/* EOL offsets (relative to the buffer) collected by a single scan of the
+ * buffer, covering the [scan_start, scan_end) range */
+typedef struct _LogProtoTextServerEolBatch
+{
+  guint32 positions[LOG_PROTO_TEXT_SERVER_EOL_BATCH_SIZE];
+  gint next;
+  gint count;
+  guint32 scan_start;
+  guint32 scan_end;
+  gboolean valid;
+} LogProtoTextServerEolBatch;
+
 typedef struct _LogProtoTextServer LogProtoTextServer;
 struct _LogProtoTextServer
 {
@@ -34,6 +48,9 @@ struct _LogProtoTextServer
   MultiLineLogic *multi_line;
 
   const guchar *(*find_eom)(const guchar *s, gsize n);
+  /* if set, line boundaries are looked up in batches instead of using find_eom() */
+  gsize (*find_eoms)(const guchar *s, gsize n, guint32 *positions, gsize max_positions);
+  LogProtoTextServerEolBatch eol_batch;
   gint32 consumed_len;
   gint32 cached_eol_pos;
 };
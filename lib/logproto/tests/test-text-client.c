@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include <criterion/criterion.h>
+#include "libtest/mock-transport.h"
+
+#include "logproto/logproto-text-client.h"
+#include "logproto/logproto-framed-client.h"
+
+static gint num_acked;
+
+static void
+_ack_callback(gint num_msg_acked, gpointer user_data)
+{
+  num_acked += num_msg_acked;
+}
+
+static LogProtoClient *
+_construct_batched_client(LogProtoClient *(*construct)(LogTransport *, const LogProtoClientOptions *),
+                          LogProtoClientOptionsStorage *options, gint send_batch_size, LogTransport **transport)
+{
+  LogProtoClientFlowControlFuncs flow_control_funcs =
+  {
+    .ack_callback = _ack_callback,
+  };
+
+  memset(options, 0, sizeof(*options));
+  log_proto_client_options_set_send_batch_size(&options->super, send_batch_size);
+
+  *transport = log_transport_mock_stream_new(LTM_EOF);
+  LogProtoClient *proto = construct(*transport, &options->super);
+  log_proto_client_set_client_flow_control(proto, &flow_control_funcs);
+  num_acked = 0;
+  return proto;
+}
+
+static LogProtoStatus
+_post(LogProtoClient *proto, const gchar *msg, gboolean *consumed)
+{
+  guchar *buf = (guchar *) g_strdup(msg);
+  LogProtoStatus status = log_proto_client_post(proto, NULL, buf, strlen(msg), consumed);
+
+  if (!*consumed)
+    g_free(buf);
+  return status;
+}
+
+static void
+_assert_post_consumed(LogProtoClient *proto, const gchar *msg, LogProtoStatus expected_status)
+{
+  gboolean consumed = FALSE;
+
+  cr_assert_eq(_post(proto, msg, &consumed), expected_status);
+  cr_assert(consumed, "message was expected to be consumed: %s", msg);
+}
+
+static void
+_assert_written(LogTransport *transport, const gchar *expected)
+{
+  gchar buf[256] = {0};
+  gssize len = log_transport_mock_read_from_write_buffer((LogTransportMock *) transport, buf, sizeof(buf) - 1);
+
+  cr_assert_eq(len, strlen(expected));
+  cr_assert_str_eq(buf, expected);
+}
+
+Test(log_proto, test_log_proto_text_client_batch_is_written_on_flush)
+{
+  LogProtoClientOptionsStorage options;
+  LogTransport *transport;
+  LogProtoClient *proto = _construct_batched_client(log_proto_text_client_new, &options, 4, &transport);
+
+  _assert_post_consumed(proto, "foo\n", LPS_SUCCESS);
+  _assert_post_consumed(proto, "bar\n", LPS_SUCCESS);
+  _assert_written(transport, "");
+  cr_assert_eq(num_acked, 0);
+
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+  _assert_written(transport, "foo\nbar\n");
+  cr_assert_eq(num_acked, 2);
+
+  log_proto_client_free(proto);
+}
+
+Test(log_proto, test_log_proto_text_client_full_batch_is_written_immediately)
+{
+  LogProtoClientOptionsStorage options;
+  LogTransport *transport;
+  LogProtoClient *proto = _construct_batched_client(log_proto_text_client_new, &options, 2, &transport);
+
+  _assert_post_consumed(proto, "foo\n", LPS_SUCCESS);
+  _assert_post_consumed(proto, "bar\n", LPS_SUCCESS);
+  _assert_written(transport, "foo\nbar\n");
+  cr_assert_eq(num_acked, 2);
+
+  log_proto_client_free(proto);
+}
+
+Test(log_proto, test_log_proto_text_client_batch_partial_write_acks_complete_messages_only)
+{
+  LogProtoClientOptionsStorage options;
+  LogTransport *transport;
+  LogProtoClient *proto = _construct_batched_client(log_proto_text_client_new, &options, 4, &transport);
+  gboolean consumed;
+
+  log_transport_mock_set_write_chunk_limit((LogTransportMock *) transport, 6);
+
+  _assert_post_consumed(proto, "foo\n", LPS_SUCCESS);
+  _assert_post_consumed(proto, "bar\n", LPS_SUCCESS);
+  _assert_post_consumed(proto, "baz\n", LPS_SUCCESS);
+
+  cr_assert_eq(log_proto_client_flush(proto), LPS_PARTIAL);
+  _assert_written(transport, "foo\nba");
+  cr_assert_eq(num_acked, 1);
+
+  /* the rest of the pending batch is written first, then the message is accepted */
+  _assert_post_consumed(proto, "qux\n", LPS_SUCCESS);
+  _assert_written(transport, "r\nbaz\n");
+  cr_assert_eq(num_acked, 3);
+
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+  _assert_written(transport, "qux\n");
+  cr_assert_eq(num_acked, 4);
+
+  /* no new messages are accepted while the batch is still pending */
+  log_transport_mock_set_write_chunk_limit((LogTransportMock *) transport, 1);
+  _assert_post_consumed(proto, "ab\n", LPS_SUCCESS);
+  cr_assert_eq(log_proto_client_flush(proto), LPS_PARTIAL);
+  cr_assert_eq(_post(proto, "cd\n", &consumed), LPS_PARTIAL);
+  cr_assert_not(consumed);
+  cr_assert_eq(num_acked, 4);
+
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+  _assert_written(transport, "ab\n");
+  cr_assert_eq(num_acked, 5);
+
+  log_proto_client_free(proto);
+}
+
+Test(log_proto, test_log_proto_framed_client_batch_contains_frame_headers)
+{
+  LogProtoClientOptionsStorage options;
+  LogTransport *transport;
+  LogProtoClient *proto = _construct_batched_client(log_proto_framed_client_new, &options, 4, &transport);
+
+  _assert_post_consumed(proto, "hello", LPS_SUCCESS);
+  _assert_post_consumed(proto, "world!", LPS_SUCCESS);
+
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+  _assert_written(transport, "5 hello6 world!");
+  cr_assert_eq(num_acked, 2);
+
+  log_proto_client_free(proto);
+}
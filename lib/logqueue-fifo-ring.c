@@ -0,0 +1,771 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logqueue-fifo-ring.h"
+#include "logpipe.h"
+#include "messages.h"
+#include "atomic-gssize.h"
+#include "mainloop-worker.h"
+
+#include <iv_list.h>
+
+QueueType log_queue_fifo_ring_type = "FIFO-RING";
+
+/*
+ * LogQueueFifoRing is an alternative to LogQueueFifo, it has the same
+ * log_fifo_size(), backlog and flow-control semantics, but messages travel
+ * from the producers to the consumer through a bounded, lock-free
+ * multi-producer/single-consumer ring instead of linked lists:
+ *
+ *    ring (lock-free, MPSC) -> output queue (single-threaded)
+ *                 \
+ *                  overflow queue (locked, only used when the ring is full)
+ *
+ * Fastpath is:
+ *   - input threads claim a slot in the ring with a single CAS and publish
+ *     the message by bumping the slot's sequence number (lockless)
+ *   - the output thread consumes published slots in order (lockless)
+ *
+ * Slowpath:
+ *   - the ring is full: the message is appended to the overflow queue
+ *     under LogQueue->lock. As long as the overflow queue is not empty,
+ *     producers keep appending to it, so that the per-producer ordering of
+ *     messages is retained.
+ *
+ *   - the output thread drains the overflow queue (under the lock) once
+ *     the ring becomes empty, including cells that are claimed but not
+ *     published yet.
+ *
+ * The LogQueue->lock is only taken to wake up the consumer, once per
+ * worker batch (see log_queue_fifo_ring_notify_batch()).
+ *
+ * The ring itself is based on Dmitry Vyukov's bounded MPMC queue, the
+ * consumer side is simplified as there's only one consumer.
+ *
+ * Threading assumptions:
+ *   - the head of the queue is only manipulated from the output thread
+ *   - the tail of the queue is only manipulated from the input threads
+ *
+ */
+
+#define LOG_QUEUE_FIFO_RING_CACHE_LINE_SIZE 64
+
+typedef struct _RingCell
+{
+  atomic_gssize sequence;
+  LogMessage *msg;
+  gboolean ack_needed:1, flow_control_requested:1;
+} RingCell;
+
+typedef struct _RingPosition
+{
+  atomic_gssize value;
+  gchar __pad[LOG_QUEUE_FIFO_RING_CACHE_LINE_SIZE - sizeof(atomic_gssize)];
+} RingPosition;
+
+typedef struct _InputNotifier
+{
+  WorkerBatchCallback cb;
+  gboolean finish_cb_registered;
+  gchar __pad[LOG_QUEUE_FIFO_RING_CACHE_LINE_SIZE - sizeof(WorkerBatchCallback) - sizeof(gboolean)];
+} InputNotifier;
+
+typedef struct _OverflowQueue
+{
+  struct iv_list_head items;
+  gint len;
+  gint non_flow_controlled_len;
+} OverflowQueue;
+
+typedef struct _LogQueueFifoRing
+{
+  LogQueue super;
+
+  /* producer side, written by input threads */
+  RingPosition enqueue_pos;
+
+  /* number of elements in the ring + the overflow queue, updated by both
+   * the producers and the consumer */
+  RingPosition len;
+  RingPosition non_flow_controlled_len;
+  RingPosition overflow_len;
+
+  /* consumer side, only touched by the output thread */
+  gsize dequeue_pos;
+  OverflowQueue output_queue;
+  OverflowQueue backlog_queue; /* entries that were sent but not acked yet */
+
+  /* protected by super.lock */
+  OverflowQueue overflow_queue;
+
+  gint log_fifo_size;
+
+  /* legacy: flow-controlled messages are included in the log_fifo_size limit */
+  gboolean use_legacy_fifo_size;
+
+  gsize mask;
+  RingCell *cells;
+
+  gint num_input_notifiers;
+  InputNotifier input_notifiers[0];
+} LogQueueFifoRing;
+
+static gsize
+_calculate_ring_capacity(gint log_fifo_size)
+{
+  gsize capacity = LOG_QUEUE_FIFO_RING_MIN_CAPACITY;
+
+  while (capacity < (gsize) log_fifo_size && capacity < LOG_QUEUE_FIFO_RING_MAX_CAPACITY)
+    capacity <<= 1;
+  return capacity;
+}
+
+/* can be called from any thread, claims a cell and publishes @msg in it */
+static gboolean
+_ring_try_enqueue(LogQueueFifoRing *self, LogMessage *msg, const LogPathOptions *path_options)
+{
+  gsize pos = atomic_gssize_get_unsigned(&self->enqueue_pos.value);
+  RingCell *cell;
+
+  while (TRUE)
+    {
+      cell = &self->cells[pos & self->mask];
+      gssize diff = (gssize) (atomic_gssize_get_unsigned(&cell->sequence) - pos);
+
+      if (diff == 0)
+        {
+          if (atomic_gssize_compare_and_exchange(&self->enqueue_pos.value, pos, pos + 1))
+            break;
+          pos = atomic_gssize_get_unsigned(&self->enqueue_pos.value);
+        }
+      else if (diff < 0)
+        {
+          /* the consumer hasn't freed up this cell yet, the ring is full */
+          return FALSE;
+        }
+      else
+        {
+          pos = atomic_gssize_get_unsigned(&self->enqueue_pos.value);
+        }
+    }
+
+  cell->msg = msg;
+  cell->ack_needed = path_options->ack_needed;
+  cell->flow_control_requested = path_options->flow_control_requested;
+  atomic_gssize_set(&cell->sequence, pos + 1);
+  return TRUE;
+}
+
+/* output thread only */
+static gboolean
+_ring_try_dequeue(LogQueueFifoRing *self, LogMessage **msg, gboolean *ack_needed, gboolean *flow_control_requested)
+{
+  gsize pos = self->dequeue_pos;
+  RingCell *cell = &self->cells[pos & self->mask];
+  gssize diff = (gssize) (atomic_gssize_get_unsigned(&cell->sequence) - (pos + 1));
+
+  /* either empty, or a producer has claimed this cell but hasn't published
+   * it yet. In the latter case the producer will wake us up once its batch
+   * is complete. */
+  if (diff < 0)
+    return FALSE;
+
+  *msg = cell->msg;
+  *ack_needed = cell->ack_needed;
+  *flow_control_requested = cell->flow_control_requested;
+  cell->msg = NULL;
+
+  atomic_gssize_set(&cell->sequence, pos + self->mask + 1);
+  self->dequeue_pos = pos + 1;
+  return TRUE;
+}
+
+/* output thread only, TRUE if the ring has a cell claimed by a producer
+ * that isn't published yet, after _ring_try_dequeue() failed this can
+ * only be the cell at the head */
+static inline gboolean
+_ring_has_unpublished_cell(LogQueueFifoRing *self)
+{
+  return atomic_gssize_get_unsigned(&self->enqueue_pos.value) != self->dequeue_pos;
+}
+
+static inline void
+_shared_len_inc(LogQueueFifoRing *self, gboolean flow_control_requested)
+{
+  atomic_gssize_inc(&self->len.value);
+  if (!flow_control_requested)
+    atomic_gssize_inc(&self->non_flow_controlled_len.value);
+}
+
+static inline void
+_shared_len_dec(LogQueueFifoRing *self, gboolean flow_control_requested)
+{
+  atomic_gssize_dec(&self->len.value);
+  if (!flow_control_requested)
+    atomic_gssize_dec(&self->non_flow_controlled_len.value);
+}
+
+/* NOTE: this is inherently racy, the same way as LogQueueFifo's get_length */
+static gint64
+log_queue_fifo_ring_get_length(LogQueue *s)
+{
+  LogQueueFifoRing *self = (LogQueueFifoRing *) s;
+
+  return MAX(0, atomic_gssize_get(&self->len.value)) + self->output_queue.len;
+}
+
+static gint64
+log_queue_fifo_ring_get_non_flow_controlled_length(LogQueueFifoRing *self)
+{
+  return MAX(0, atomic_gssize_get(&self->non_flow_controlled_len.value)) + self->output_queue.non_flow_controlled_len;
+}
+
+static gboolean
+log_queue_fifo_ring_is_empty_racy(LogQueue *s)
+{
+  LogQueueFifoRing *self = (LogQueueFifoRing *) s;
+  gboolean has_message_in_queue = FALSE;
+
+  g_mutex_lock(&self->super.lock);
+  if (log_queue_fifo_ring_get_length(s) > 0)
+    {
+      has_message_in_queue = TRUE;
+    }
+  else
+    {
+      for (gint i = 0; i < self->num_input_notifiers && !has_message_in_queue; i++)
+        has_message_in_queue |= self->input_notifiers[i].finish_cb_registered;
+    }
+  g_mutex_unlock(&self->super.lock);
+  return !has_message_in_queue;
+}
+
+/* NOTE: this is inherently racy, can only be called if log processing is suspended (e.g. reload time) */
+static gboolean
+log_queue_fifo_ring_keep_on_reload(LogQueue *s)
+{
+  LogQueueFifoRing *self = (LogQueueFifoRing *) s;
+  return log_queue_fifo_ring_get_length(s) > 0 || self->backlog_queue.len > 0;
+}
+
+/*
+ * Registered as a batch callback in the input threads, wakes up the
+ * consumer once per batch instead of once per message.
+ */
+static gpointer
+log_queue_fifo_ring_notify_batch(gpointer user_data)
+{
+  LogQueueFifoRing *self = (LogQueueFifoRing *) user_data;
+  gint thread_index;
+
+  thread_index = main_loop_worker_get_thread_index();
+  g_assert(thread_index >= 0);
+
+  g_mutex_lock(&self->super.lock);
+  log_queue_push_notify(&self->super);
+  self->input_notifiers[thread_index].finish_cb_registered = FALSE;
+  g_mutex_unlock(&self->super.lock);
+  log_queue_unref(&self->super);
+  return NULL;
+}
+
+static inline gboolean
+_message_has_to_be_dropped(LogQueueFifoRing *self, const LogPathOptions *path_options)
+{
+  /* since we're in the input thread, the lengths are racy, see the
+   * comment in log_queue_fifo_calculate_num_of_messages_to_drop() on why
+   * this is acceptable. */
+  if (G_UNLIKELY(self->use_legacy_fifo_size))
+    return log_queue_fifo_ring_get_length(&self->super) >= self->log_fifo_size;
+
+  return !path_options->flow_control_requested
+         && log_queue_fifo_ring_get_non_flow_controlled_length(self) >= self->log_fifo_size;
+}
+
+static inline void
+_drop_message(LogMessage *msg, const LogPathOptions *path_options)
+{
+  if (path_options->flow_control_requested)
+    {
+      log_msg_drop(msg, path_options, AT_SUSPENDED);
+      return;
+    }
+
+  log_msg_drop(msg, path_options, AT_PROCESSED);
+}
+
+/* lock must be held */
+static void
+_push_to_overflow_queue(LogQueueFifoRing *self, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogMessageQueueNode *node = log_msg_alloc_queue_node(msg, path_options);
+
+  iv_list_add_tail(&node->list, &self->overflow_queue.items);
+  self->overflow_queue.len++;
+  if (!path_options->flow_control_requested)
+    self->overflow_queue.non_flow_controlled_len++;
+  atomic_gssize_inc(&self->overflow_len.value);
+
+  /* the node holds a reference from now on */
+  log_msg_unref(msg);
+}
+
+static void
+_register_notifier(LogQueueFifoRing *self, gint thread_index)
+{
+  InputNotifier *notifier = &self->input_notifiers[thread_index];
+
+  if (notifier->finish_cb_registered)
+    return;
+
+  /* One reference should be held, while the callback is registered
+   * avoiding use-after-free situation */
+  main_loop_worker_register_batch_callback(&notifier->cb);
+  notifier->finish_cb_registered = TRUE;
+  log_queue_ref(&self->super);
+}
+
+/*
+ * Can be called from any thread. If the thread_index cannot be
+ * determined, the consumer is notified right away, otherwise at the end
+ * of the worker batch.
+ *
+ * NOTE: It consumes the reference passed by the caller.
+ */
+static void
+log_queue_fifo_ring_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueFifoRing *self = (LogQueueFifoRing *) s;
+  gint thread_index;
+  gsize msg_size;
+
+  thread_index = main_loop_worker_get_thread_index();
+  if (thread_index >= self->num_input_notifiers)
+    thread_index = -1;
+
+  if (_message_has_to_be_dropped(self, path_options))
+    {
+      log_queue_dropped_messages_inc(&self->super);
+      _drop_message(msg, path_options);
+
+      msg_debug("Destination queue full, dropping message",
+                evt_tag_int("queue_len", log_queue_fifo_ring_get_length(&self->super)),
+                evt_tag_int("log_fifo_size", self->log_fifo_size),
+                evt_tag_str("persist_name", self->super.persist_name));
+      return;
+    }
+
+  log_msg_write_protect(msg);
+  msg_size = log_msg_get_size(msg);
+  log_queue_queued_messages_inc(&self->super);
+  log_queue_memory_usage_add(&self->super, msg_size);
+
+  if (atomic_gssize_get(&self->overflow_len.value) > 0 || !_ring_try_enqueue(self, msg, path_options))
+    {
+      /* slow path, the ring is full (or was full recently and the consumer
+       * hasn't caught up yet) */
+      g_mutex_lock(&self->super.lock);
+      _push_to_overflow_queue(self, msg, path_options);
+      _shared_len_inc(self, path_options->flow_control_requested);
+      if (thread_index < 0)
+        log_queue_push_notify(&self->super);
+      g_mutex_unlock(&self->super.lock);
+    }
+  else
+    {
+      /* the ring owns the reference we got from the caller */
+      _shared_len_inc(self, path_options->flow_control_requested);
+
+      if (thread_index < 0)
+        {
+          g_mutex_lock(&self->super.lock);
+          log_queue_push_notify(&self->super);
+          g_mutex_unlock(&self->super.lock);
+        }
+    }
+
+  if (thread_index >= 0)
+    _register_notifier(self, thread_index);
+}
+
+/*
+ * Put an item back to the front of the queue.
+ *
+ * This is assumed to be called only from the output thread.
+ *
+ * NOTE: It consumes the reference passed by the caller.
+ */
+static void
+log_queue_fifo_ring_push_head(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueFifoRing *self = (LogQueueFifoRing *) s;
+  LogMessageQueueNode *node;
+
+  /* we don't check limits when putting items "in-front", as it
+   * normally happens when we start processing an item, but at the end
+   * can't deliver it. No checks, no drops either. */
+
+  log_msg_write_protect(msg);
+  node = log_msg_alloc_dynamic_queue_node(msg, path_options);
+  iv_list_add(&node->list, &self->output_queue.items);
+  self->output_queue.len++;
+
+  if (!path_options->flow_control_requested)
+    self->output_queue.non_flow_controlled_len++;
+
+  log_msg_unref(msg);
+
+  log_queue_queued_messages_inc(&self->super);
+  log_queue_memory_usage_add(&self->super, log_msg_get_size(msg));
+}
+
+/* output thread only, moves the overflow queue after the output queue */
+static void
+_drain_overflow_queue(LogQueueFifoRing *self)
+{
+  if (atomic_gssize_get(&self->overflow_len.value) == 0)
+    return;
+
+  g_mutex_lock(&self->super.lock);
+  iv_list_splice_tail_init(&self->overflow_queue.items, &self->output_queue.items);
+  self->output_queue.len += self->overflow_queue.len;
+  self->output_queue.non_flow_controlled_len += self->overflow_queue.non_flow_controlled_len;
+
+  atomic_gssize_sub(&self->len.value, self->overflow_queue.len);
+  atomic_gssize_sub(&self->non_flow_controlled_len.value, self->overflow_queue.non_flow_controlled_len);
+  atomic_gssize_sub(&self->overflow_len.value, self->overflow_queue.len);
+
+  self->overflow_queue.len = 0;
+  self->overflow_queue.non_flow_controlled_len = 0;
+  g_mutex_unlock(&self->super.lock);
+}
+
+static LogMessage *
+_pop_from_output_queue(LogQueueFifoRing *self, LogPathOptions *path_options,
+                       LogMessageQueueNode **backlog_node, gboolean *flow_control_requested)
+{
+  LogMessageQueueNode *node = iv_list_entry(self->output_queue.items.next, LogMessageQueueNode, list);
+  LogMessage *msg = node->msg;
+
+  path_options->ack_needed = node->ack_needed;
+  *flow_control_requested = node->flow_control_requested;
+  self->output_queue.len--;
+
+  if (!node->flow_control_requested)
+    self->output_queue.non_flow_controlled_len--;
+
+  if (!self->super.use_backlog)
+    {
+      iv_list_del(&node->list);
+      log_msg_free_queue_node(node);
+    }
+  else
+    {
+      iv_list_del_init(&node->list);
+      *backlog_node = node;
+    }
+  return msg;
+}
+
+/*
+ * Can only run from the output thread.
+ *
+ * NOTE: this returns a reference which the caller must take care to free.
+ */
+static LogMessage *
+log_queue_fifo_ring_pop_head(LogQueue *s, LogPathOptions *path_options)
+{
+  LogQueueFifoRing *self = (LogQueueFifoRing *) s;
+  LogMessageQueueNode *node = NULL;
+  LogMessage *msg = NULL;
+  gboolean flow_control_requested;
+
+  if (self->output_queue.len > 0)
+    {
+      msg = _pop_from_output_queue(self, path_options, &node, &flow_control_requested);
+    }
+  else
+    {
+      gboolean ack_needed;
+
+      if (_ring_try_dequeue(self, &msg, &ack_needed, &flow_control_requested))
+        {
+          _shared_len_dec(self, flow_control_requested);
+          path_options->ack_needed = ack_needed;
+
+          if (self->super.use_backlog)
+            {
+              LogPathOptions node_path_options = LOG_PATH_OPTIONS_INIT;
+
+              node_path_options.ack_needed = ack_needed;
+              node_path_options.flow_control_requested = flow_control_requested;
+              node = log_msg_alloc_dynamic_queue_node(msg, &node_path_options);
+
+              /* the node took its own reference */
+              log_msg_unref(msg);
+            }
+        }
+      else
+        {
+          /* A producer has claimed the cell at the head of the ring, but
+           * hasn't published it yet. Messages behind it in the ring may
+           * precede the ones in the overflow queue, so the overflow queue
+           * must not be drained before the ring is consumed. The producer
+           * notifies us at the end of its batch. */
+          if (_ring_has_unpublished_cell(self))
+            return NULL;
+
+          /* slow path, ring is empty, get some elements from the overflow queue */
+          _drain_overflow_queue(self);
+
+          if (self->output_queue.len == 0)
+            return NULL;
+          msg = _pop_from_output_queue(self, path_options, &node, &flow_control_requested);
+        }
+    }
+
+  log_queue_queued_messages_dec(&self->super);
+  log_queue_memory_usage_sub(&self->super, log_msg_get_size(msg));
+
+  if (self->super.use_backlog)
+    {
+      log_msg_ref(msg);
+      iv_list_add_tail(&node->list, &self->backlog_queue.items);
+      self->backlog_queue.len++;
+
+      if (!flow_control_requested)
+        self->backlog_queue.non_flow_controlled_len++;
+    }
+
+  return msg;
+}
+
+/*
+ * Can only run from the output thread.
+ */
+static void
+log_queue_fifo_ring_ack_backlog(LogQueue *s, gint rewind_count)
+{
+  LogQueueFifoRing *self = (LogQueueFifoRing *) s;
+  LogMessage *msg;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint pos;
+
+  for (pos = 0; pos < rewind_count && self->backlog_queue.len > 0; pos++)
+    {
+      LogMessageQueueNode *node;
+      node = iv_list_entry(self->backlog_queue.items.next, LogMessageQueueNode, list);
+      msg = node->msg;
+
+      iv_list_del(&node->list);
+      self->backlog_queue.len--;
+
+      if (!node->flow_control_requested)
+        self->backlog_queue.non_flow_controlled_len--;
+
+      path_options.ack_needed = node->ack_needed;
+      log_msg_ack(msg, &path_options, AT_PROCESSED);
+      log_msg_free_queue_node(node);
+      log_msg_unref(msg);
+    }
+}
+
+static void
+_update_msg_size(LogQueueFifoRing *self, struct iv_list_head *head)
+{
+  struct iv_list_head *ilh;
+
+  iv_list_for_each(ilh, head)
+  {
+    LogMessage *msg = iv_list_entry(ilh, LogMessageQueueNode, list)->msg;
+    log_queue_memory_usage_add(&self->super, log_msg_get_size(msg));
+  }
+}
+
+/*
+ * Move items on our backlog back to the front of the output queue.
+ *
+ * NOTE: this is assumed to be called from the output thread.
+ */
+static void
+log_queue_fifo_ring_rewind_backlog_all(LogQueue *s)
+{
+  LogQueueFifoRing *self = (LogQueueFifoRing *) s;
+
+  _update_msg_size(self, &self->backlog_queue.items);
+
+  /* the backlog contains older items than anything on the output queue */
+  iv_list_splice_init(&self->backlog_queue.items, &self->output_queue.items);
+
+  self->output_queue.len += self->backlog_queue.len;
+  self->output_queue.non_flow_controlled_len += self->backlog_queue.non_flow_controlled_len;
+  log_queue_queued_messages_add(&self->super, self->backlog_queue.len);
+  self->backlog_queue.len = 0;
+  self->backlog_queue.non_flow_controlled_len = 0;
+}
+
+static void
+log_queue_fifo_ring_rewind_backlog(LogQueue *s, guint rewind_count)
+{
+  LogQueueFifoRing *self = (LogQueueFifoRing *) s;
+  guint pos;
+
+  if (rewind_count > self->backlog_queue.len)
+    rewind_count = self->backlog_queue.len;
+
+  for (pos = 0; pos < rewind_count; pos++)
+    {
+      LogMessageQueueNode *node = iv_list_entry(self->backlog_queue.items.prev, LogMessageQueueNode, list);
+
+      iv_list_del_init(&node->list);
+      iv_list_add(&node->list, &self->output_queue.items);
+
+      self->backlog_queue.len--;
+      self->output_queue.len++;
+
+      if (!node->flow_control_requested)
+        {
+          self->backlog_queue.non_flow_controlled_len--;
+          self->output_queue.non_flow_controlled_len++;
+        }
+
+      log_queue_queued_messages_inc(&self->super);
+      log_queue_memory_usage_add(&self->super, log_msg_get_size(node->msg));
+    }
+}
+
+static void
+log_queue_fifo_ring_free_queue(struct iv_list_head *q)
+{
+  while (!iv_list_empty(q))
+    {
+      LogMessageQueueNode *node;
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+      LogMessage *msg;
+
+      node = iv_list_entry(q->next, LogMessageQueueNode, list);
+      iv_list_del(&node->list);
+
+      path_options.ack_needed = node->ack_needed;
+      msg = node->msg;
+      log_msg_free_queue_node(node);
+      log_msg_ack(msg, &path_options, AT_ABORTED);
+      log_msg_unref(msg);
+    }
+}
+
+static void
+log_queue_fifo_ring_free_ring(LogQueueFifoRing *self)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg;
+  gboolean ack_needed, flow_control_requested;
+
+  while (_ring_try_dequeue(self, &msg, &ack_needed, &flow_control_requested))
+    {
+      path_options.ack_needed = ack_needed;
+      log_msg_ack(msg, &path_options, AT_ABORTED);
+      log_msg_unref(msg);
+    }
+}
+
+static void
+log_queue_fifo_ring_free(LogQueue *s)
+{
+  LogQueueFifoRing *self = (LogQueueFifoRing *) s;
+
+  for (gint i = 0; i < self->num_input_notifiers; i++)
+    g_assert(self->input_notifiers[i].finish_cb_registered == FALSE);
+
+  log_queue_fifo_ring_free_queue(&self->output_queue.items);
+  log_queue_fifo_ring_free_ring(self);
+  log_queue_fifo_ring_free_queue(&self->overflow_queue.items);
+  log_queue_fifo_ring_free_queue(&self->backlog_queue.items);
+  g_free(self->cells);
+  log_queue_free_method(s);
+}
+
+LogQueue *
+log_queue_fifo_ring_new(gint log_fifo_size, const gchar *persist_name, gint stats_level,
+                        const StatsClusterKeyBuilder *driver_sck_builder, StatsClusterKeyBuilder *queue_sck_builder)
+{
+  LogQueueFifoRing *self;
+
+  gint max_threads = main_loop_worker_get_max_number_of_threads();
+  self = g_malloc0(sizeof(LogQueueFifoRing) + max_threads * sizeof(self->input_notifiers[0]));
+
+  if (queue_sck_builder)
+    stats_cluster_key_builder_set_name_prefix(queue_sck_builder, "memory_queue_");
+
+  log_queue_init_instance(&self->super, persist_name, stats_level, driver_sck_builder, queue_sck_builder);
+  self->super.type = log_queue_fifo_ring_type;
+  self->super.use_backlog = FALSE;
+  self->super.get_length = log_queue_fifo_ring_get_length;
+  self->super.is_empty_racy = log_queue_fifo_ring_is_empty_racy;
+  self->super.keep_on_reload = log_queue_fifo_ring_keep_on_reload;
+  self->super.push_tail = log_queue_fifo_ring_push_tail;
+  self->super.push_head = log_queue_fifo_ring_push_head;
+  self->super.pop_head = log_queue_fifo_ring_pop_head;
+  self->super.ack_backlog = log_queue_fifo_ring_ack_backlog;
+  self->super.rewind_backlog = log_queue_fifo_ring_rewind_backlog;
+  self->super.rewind_backlog_all = log_queue_fifo_ring_rewind_backlog_all;
+
+  self->super.free_fn = log_queue_fifo_ring_free;
+
+  gsize capacity = _calculate_ring_capacity(log_fifo_size);
+  self->mask = capacity - 1;
+  self->cells = g_new0(RingCell, capacity);
+  for (gsize i = 0; i < capacity; i++)
+    atomic_gssize_racy_set(&self->cells[i].sequence, i);
+
+  self->num_input_notifiers = max_threads;
+  for (gint i = 0; i < self->num_input_notifiers; i++)
+    {
+      worker_batch_callback_init(&self->input_notifiers[i].cb);
+      self->input_notifiers[i].cb.func = log_queue_fifo_ring_notify_batch;
+      self->input_notifiers[i].cb.user_data = self;
+    }
+  INIT_IV_LIST_HEAD(&self->overflow_queue.items);
+  INIT_IV_LIST_HEAD(&self->output_queue.items);
+  INIT_IV_LIST_HEAD(&self->backlog_queue.items);
+
+  self->log_fifo_size = log_fifo_size;
+  return &self->super;
+}
+
+LogQueue *
+log_queue_fifo_ring_legacy_new(gint log_fifo_size, const gchar *persist_name, gint stats_level,
+                               const StatsClusterKeyBuilder *driver_sck_builder,
+                               StatsClusterKeyBuilder *queue_sck_builder)
+{
+  LogQueueFifoRing *self = (LogQueueFifoRing *) log_queue_fifo_ring_new(log_fifo_size, persist_name, stats_level,
+                                                                        driver_sck_builder, queue_sck_builder);
+  self->use_legacy_fifo_size = TRUE;
+  return &self->super;
+}
+
+QueueType
+log_queue_fifo_ring_get_type(void)
+{
+  return log_queue_fifo_ring_type;
+}
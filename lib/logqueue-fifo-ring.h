@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGQUEUE_FIFO_RING_H_INCLUDED
+#define LOGQUEUE_FIFO_RING_H_INCLUDED
+
+#include "logqueue.h"
+
+#define LOG_QUEUE_FIFO_RING_MIN_CAPACITY 256
+#define LOG_QUEUE_FIFO_RING_MAX_CAPACITY 65536
+
+LogQueue *log_queue_fifo_ring_new(gint log_fifo_size, const gchar *persist_name, gint stats_level,
+                                  const StatsClusterKeyBuilder *driver_sck_builder,
+                                  StatsClusterKeyBuilder *queue_sck_builder);
+LogQueue *log_queue_fifo_ring_legacy_new(gint log_fifo_size, const gchar *persist_name, gint stats_level,
+                                         const StatsClusterKeyBuilder *driver_sck_builder,
+                                         StatsClusterKeyBuilder *queue_sck_builder);
+
+QueueType log_queue_fifo_ring_get_type(void);
+
+#endif
@@ -473,16 +473,17 @@ log_reader_handle_line(LogReader *self, const guchar *line, gint length, LogTran
         }
       m->proto = aux->proto;
     }
-  log_msg_refcache_start_producer(m);
-
   log_transport_aux_data_foreach(aux, _add_aux_nvpair, m);
 
-  log_source_post(&self->super, m);
-  log_msg_refcache_stop();
+  log_source_post_batched(&self->super, m);
   return log_source_free_to_send(&self->super);
 }
 
-/* returns: notify_code (NC_XXXX) or 0 for success */
+/* returns: notify_code (NC_XXXX) or 0 for success
+ *
+ * NOTE: the messages fetched in a single run are sent out as a batch,
+ * see log_source_post_batched()
+ */
 static gint
 log_reader_fetch_log(LogReader *self)
 {
@@ -525,9 +526,11 @@ log_reader_fetch_log(LogReader *self)
         {
         case LPS_EOF:
           log_transport_aux_data_destroy(aux);
+          log_source_flush_batch(&self->super);
           return NC_CLOSE;
         case LPS_ERROR:
           log_transport_aux_data_destroy(aux);
+          log_source_flush_batch(&self->super);
           return NC_READ_ERROR;
         case LPS_SUCCESS:
           break;
@@ -555,6 +558,7 @@ log_reader_fetch_log(LogReader *self)
         }
     }
   log_transport_aux_data_destroy(aux);
+  log_source_flush_batch(&self->super);
 
   if (msg_count == self->options->fetch_limit)
     self->immediate_check = TRUE;
@@ -501,7 +501,7 @@ _register_counters(LogSource *self)
   stats_cluster_single_key_set(&sc_key, "input_events_total", labels, G_N_ELEMENTS(labels));
   stats_cluster_single_key_add_legacy_alias_with_name(&sc_key, self->options->stats_source | SCS_SOURCE, self->stats_id,
                                                       self->stats_instance, "processed");
-  stats_register_counter(level, &sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.recvd_messages);
+  stats_register_sharded_counter(level, &sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.recvd_messages);
 
   stats_cluster_logpipe_key_legacy_set(&sc_key, self->options->stats_source | SCS_SOURCE, self->stats_id,
                                        self->stats_instance);
@@ -566,6 +566,8 @@ gboolean
 log_source_deinit(LogPipe *s)
 {
   LogSource *self = (LogSource *) s;
+
+  g_assert(self->batch_len == 0);
   ack_tracker_deinit(self->ack_tracker);
 
   _unregister_counters(self);
@@ -573,18 +575,15 @@ log_source_deinit(LogPipe *s)
   return TRUE;
 }
 
-void
-log_source_post(LogSource *self, LogMessage *msg)
+static void
+_take_window_slot(LogSource *self, LogMessage *msg, const LogPathOptions *path_options)
 {
-  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
   gint old_window_size;
 
   ack_tracker_track_msg(self->ack_tracker, msg);
 
-  /* NOTE: we start by enabling flow-control, thus we need an acknowledgement */
-  path_options.ack_needed = TRUE;
   log_msg_ref(msg);
-  log_msg_add_ack(msg, &path_options);
+  log_msg_add_ack(msg, path_options);
   msg->ack_func = log_source_msg_ack;
 
   old_window_size = window_size_counter_sub(&self->window_size, 1, NULL);
@@ -606,6 +605,16 @@ log_source_post(LogSource *self, LogMessage *msg)
    */
 
   g_assert(old_window_size > 0);
+}
+
+void
+log_source_post(LogSource *self, LogMessage *msg)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  /* NOTE: we start by enabling flow-control, thus we need an acknowledgement */
+  path_options.ack_needed = TRUE;
+  _take_window_slot(self, msg, &path_options);
 
   ScratchBuffersMarker mark;
   scratch_buffers_mark(&mark);
@@ -613,6 +622,56 @@ log_source_post(LogSource *self, LogMessage *msg)
   scratch_buffers_reclaim_marked(mark);
 }
 
+/*
+ * Same as log_source_post(), except that the message is only sent out by
+ * the next log_source_flush_batch() (or when the batch becomes full),
+ * together with the other messages posted since, using
+ * log_pipe_queue_batch().  The message takes its window slot right away,
+ * so log_source_free_to_send() works the same way as with
+ * log_source_post().
+ *
+ * The caller must not start a refcache for the message, the flush does
+ * that for the whole batch. Sources using this have to flush at the end of
+ * each fetch round, the batch must be empty by the time the source is
+ * deinitialized.
+ */
+G_STATIC_ASSERT(LOG_PIPE_BATCH_MAX <= LOGMSG_REFCACHE_BATCH_MAX);
+
+void
+log_source_post_batched(LogSource *self, LogMessage *msg)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  path_options.ack_needed = TRUE;
+  _take_window_slot(self, msg, &path_options);
+
+  self->batch[self->batch_len++] = msg;
+  if (self->batch_len == LOG_PIPE_BATCH_MAX)
+    log_source_flush_batch(self);
+}
+
+void
+log_source_flush_batch(LogSource *self)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint num_msgs = self->batch_len;
+
+  if (num_msgs == 0)
+    return;
+
+  path_options.ack_needed = TRUE;
+  self->batch_len = 0;
+
+  log_msg_refcache_start_producer_batch(self->batch, num_msgs);
+
+  ScratchBuffersMarker mark;
+  scratch_buffers_mark(&mark);
+  log_pipe_queue_batch(&self->super, self->batch, num_msgs, &path_options);
+  scratch_buffers_reclaim_marked(mark);
+
+  log_msg_refcache_stop_batch();
+}
+
 static gboolean
 _invoke_mangle_callbacks(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
 {
@@ -669,10 +728,11 @@ _get_pid_string(void)
   return pid_string;
 }
 
-static void
-log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+/* returns FALSE if the message was dropped */
+static gboolean
+log_source_process_msg(LogSource *self, LogMessage *msg, const LogPathOptions *path_options)
 {
-  LogSource *self = (LogSource *) s;
+  LogPipe *s = &self->super;
   gint i;
 
   msg_set_context(msg);
@@ -701,7 +761,7 @@ log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options
 
 
   if (!_invoke_mangle_callbacks(s, msg, path_options))
-    return;
+    return FALSE;
 
   if (self->options->host_override)
     log_source_override_host(self, msg);
@@ -716,8 +776,12 @@ log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options
   stats_counter_inc(self->metrics.recvd_messages);
   stats_counter_set(self->metrics.last_message_seen, msg->timestamps[LM_TS_RECVD].ut_sec);
   stats_byte_counter_add(&self->metrics.recvd_bytes, msg->recvd_rawmsg_size);
-  log_pipe_forward_msg(s, msg, path_options);
+  return TRUE;
+}
 
+static void
+log_source_wait_for_window(LogSource *self)
+{
   if (accurate_nanosleep && self->threaded && self->window_full_sleep_nsec > 0 && !log_source_free_to_send(self))
     {
       struct timespec ts;
@@ -727,6 +791,19 @@ log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options
       ts.tv_nsec = self->window_full_sleep_nsec;
       nanosleep(&ts, NULL);
     }
+}
+
+static void
+log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogSource *self = (LogSource *) s;
+
+  if (!log_source_process_msg(self, msg, path_options))
+    return;
+
+  log_pipe_forward_msg(s, msg, path_options);
+
+  log_source_wait_for_window(self);
   msg_diagnostics("<<<<<< Source side message processing finish",
                   evt_tag_str("instance", self->stats_instance ? self->stats_instance : "internal"),
                   log_pipe_location_tag(s),
@@ -735,6 +812,35 @@ log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options
   msg_set_context(NULL);
 }
 
+static void
+log_source_queue_batch(LogPipe *s, LogMessage **msgs, gint num_msgs, const LogPathOptions *path_options)
+{
+  LogSource *self = (LogSource *) s;
+  gint num_accepted = 0;
+
+  /* queue() is overridden by a derived class */
+  if (s->queue != log_source_queue)
+    {
+      log_pipe_queue_each(s, msgs, num_msgs, path_options);
+      return;
+    }
+
+  for (gint i = 0; i < num_msgs; i++)
+    {
+      if (log_source_process_msg(self, msgs[i], path_options))
+        msgs[num_accepted++] = msgs[i];
+    }
+  msg_set_context(NULL);
+
+  log_pipe_forward_msgs(s, msgs, num_accepted, path_options);
+
+  log_source_wait_for_window(self);
+  msg_diagnostics("<<<<<< Source side batch processing finish",
+                  evt_tag_str("instance", self->stats_instance ? self->stats_instance : "internal"),
+                  log_pipe_location_tag(s),
+                  evt_tag_int("messages", num_accepted));
+}
+
 static void
 _initialize_window(LogSource *self, gint init_window_size)
 {
@@ -795,6 +901,7 @@ log_source_init_instance(LogSource *self, GlobalConfig *cfg)
 {
   log_pipe_init_instance(&self->super, cfg);
   self->super.queue = log_source_queue;
+  self->super.queue_batch = log_source_queue_batch;
   self->super.free_fn = log_source_free;
   self->super.init = log_source_init;
   self->super.deinit = log_source_deinit;
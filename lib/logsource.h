@@ -100,6 +100,10 @@ struct _LogSource
   AckTrackerFactory *ack_tracker_factory;
   AckTracker *ack_tracker;
 
+  /* messages posted by log_source_post_batched(), not yet sent */
+  LogMessage *batch[LOG_PIPE_BATCH_MAX];
+  gint batch_len;
+
   void (*wakeup)(LogSource *s);
   void (*schedule_dynamic_window_realloc)(LogSource *s);
 };
@@ -128,6 +132,8 @@ gboolean log_source_init(LogPipe *s);
 gboolean log_source_deinit(LogPipe *s);
 
 void log_source_post(LogSource *self, LogMessage *msg);
+void log_source_post_batched(LogSource *self, LogMessage *msg);
+void log_source_flush_batch(LogSource *self);
 
 void log_source_set_options(LogSource *self, LogSourceOptions *options, const gchar *stats_id,
                             const gchar *stats_instance, gboolean threaded, LogExprNode *expr_node);
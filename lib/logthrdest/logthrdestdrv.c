@@ -466,6 +466,11 @@ _message_became_available_callback(gpointer user_data)
 static void
 _schedule_restart_on_suspend_timeout(LogThreadedDestWorker *self)
 {
+  /* a batch in flight may fail while _perform_work() is running or while
+   * we are idle, either of them might have already scheduled us */
+  if (iv_timer_registered(&self->timer_reopen))
+    iv_timer_unregister(&self->timer_reopen);
+
   iv_validate_now();
   self->timer_reopen.expires  = iv_now;
   self->timer_reopen.expires.tv_sec += self->time_reopen;
@@ -600,6 +605,81 @@ log_threaded_dest_worker_wakeup_when_suspended(LogThreadedDestWorker *self)
     _perform_work(self);
 }
 
+/*
+ * In-flight batches: drivers that keep more than one batch outstanding
+ * (e.g. pipelined requests) hand over the current batch with
+ * log_threaded_dest_worker_mark_batch_in_flight() from flush() and return
+ * LTR_EXPLICIT_ACK_MGMT.  The batches are still in the backlog, in the
+ * order they were handed over, and have to be completed in that order:
+ *
+ *   - log_threaded_dest_worker_ack_in_flight() acks the oldest one
+ *   - log_threaded_dest_worker_fail_in_flight() rewinds everything that was
+ *     sent after the oldest one (including the open batch), and processes
+ *     the oldest batch just like a regular flush() result would be
+ *     (retry/drop/suspend)
+ *
+ * Messages that were delivered in a batch that is newer than a failed one
+ * are going to be resent (at-least-once delivery).
+ *
+ * These may be called both from flush() and from the driver's own I/O
+ * callbacks running in the worker thread.
+ */
+void
+log_threaded_dest_worker_mark_batch_in_flight(LogThreadedDestWorker *self)
+{
+  self->in_flight_size += self->batch_size;
+  self->batch_size = 0;
+}
+
+void
+log_threaded_dest_worker_ack_in_flight(LogThreadedDestWorker *self, gint batch_size)
+{
+  g_assert(batch_size <= self->in_flight_size);
+
+  log_queue_ack_backlog(self->queue, batch_size);
+  stats_counter_add(self->owner->metrics.written_messages, batch_size);
+  self->retries_on_error_counter = 0;
+  self->in_flight_size -= batch_size;
+}
+
+void
+log_threaded_dest_worker_fail_in_flight(LogThreadedDestWorker *self, gint batch_size, LogThreadedResult result)
+{
+  g_assert(batch_size <= self->in_flight_size);
+
+  gint newer_messages = self->in_flight_size - batch_size + self->batch_size;
+
+  log_queue_rewind_backlog(self->queue, newer_messages);
+  self->in_flight_size = 0;
+  self->batch_size = batch_size;
+  _process_result(self, result);
+
+  if (self->rewound_batch_size)
+    self->rewound_batch_size += newer_messages;
+
+  if (self->suspended)
+    {
+      /* we might be idle, waiting for the queue */
+      log_queue_reset_parallel_push(self->queue);
+      _stop_watches(self);
+      _schedule_restart_on_suspend_timeout(self);
+    }
+  else
+    {
+      /* the rewound messages do not trigger the parallel push callback */
+      iv_event_post(&self->wake_up_event);
+    }
+}
+
+/* used on shutdown/reload, when the pending batches are abandoned */
+void
+log_threaded_dest_worker_rewind_in_flight(LogThreadedDestWorker *self)
+{
+  log_queue_rewind_backlog(self->queue, self->in_flight_size + self->batch_size);
+  self->in_flight_size = 0;
+  self->batch_size = 0;
+}
+
 static void
 _flush_timer_cb(gpointer data)
 {
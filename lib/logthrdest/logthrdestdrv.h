@@ -81,6 +81,8 @@ struct _LogThreadedDestWorker
   gboolean connected;
   gint batch_size;
   gint rewound_batch_size;
+  /* messages of batches handed over to the destination, not yet acked/rewound */
+  gint in_flight_size;
   gint retries_on_error_counter;
   guint retries_counter;
   gint32 seq_num;
@@ -241,6 +243,10 @@ void log_threaded_dest_worker_ack_messages(LogThreadedDestWorker *self, gint bat
 void log_threaded_dest_worker_drop_messages(LogThreadedDestWorker *self, gint batch_size);
 void log_threaded_dest_worker_rewind_messages(LogThreadedDestWorker *self, gint batch_size);
 void log_threaded_dest_worker_wakeup_when_suspended(LogThreadedDestWorker *self);
+void log_threaded_dest_worker_mark_batch_in_flight(LogThreadedDestWorker *self);
+void log_threaded_dest_worker_ack_in_flight(LogThreadedDestWorker *self, gint batch_size);
+void log_threaded_dest_worker_fail_in_flight(LogThreadedDestWorker *self, gint batch_size, LogThreadedResult result);
+void log_threaded_dest_worker_rewind_in_flight(LogThreadedDestWorker *self);
 gboolean log_threaded_dest_worker_init_method(LogThreadedDestWorker *self);
 void log_threaded_dest_worker_deinit_method(LogThreadedDestWorker *self);
 void log_threaded_dest_worker_init_instance(LogThreadedDestWorker *self,
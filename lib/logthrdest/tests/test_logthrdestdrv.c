@@ -39,6 +39,8 @@ typedef struct TestThreadedDestDriver
   gint failure_counter;
   gint prev_flush_size;
   gint flush_size;
+  GQueue in_flight_batches;
+  gint max_in_flight_batches;
 } TestThreadedDestDriver;
 
 static const gchar *
@@ -805,6 +807,106 @@ Test(logthrdestdrv, test_explicit_ack_accept)
   cr_assert(dd->super.shared_seq_num == 11, "%d", dd->super.shared_seq_num);
 }
 
+/* keeps up to two batches in flight, the oldest one is completed (or
+ * failed) when the third one is sent, the rest when the queue becomes empty */
+#define MAX_IN_FLIGHT_BATCHES 2
+
+static LogThreadedResult
+_insert_in_flight_message(LogThreadedDestDriver *s, LogMessage *msg)
+{
+  TestThreadedDestDriver *self = (TestThreadedDestDriver *) s;
+
+  self->insert_counter++;
+  return LTR_QUEUED;
+}
+
+static LogThreadedResult
+_flush_in_flight_batches(LogThreadedDestDriver *s)
+{
+  TestThreadedDestDriver *self = (TestThreadedDestDriver *) s;
+  LogThreadedDestWorker *worker = &s->worker.instance;
+
+  if (worker->batch_size == 0)
+    {
+      /* let the batches pile up until the failure is injected */
+      if (self->failure_counter > 0)
+        return LTR_EXPLICIT_ACK_MGMT;
+
+      while (!g_queue_is_empty(&self->in_flight_batches))
+        log_threaded_dest_worker_ack_in_flight(worker, GPOINTER_TO_INT(g_queue_pop_head(&self->in_flight_batches)));
+      cr_assert(worker->in_flight_size == 0);
+      return LTR_EXPLICIT_ACK_MGMT;
+    }
+
+  self->flush_size += worker->batch_size;
+  if (g_queue_get_length(&self->in_flight_batches) == MAX_IN_FLIGHT_BATCHES)
+    {
+      gint oldest_batch = GPOINTER_TO_INT(g_queue_pop_head(&self->in_flight_batches));
+
+      if (self->failure_counter > 0)
+        {
+          self->failure_counter--;
+          g_queue_clear(&self->in_flight_batches);
+          log_threaded_dest_worker_fail_in_flight(worker, oldest_batch, LTR_DROP);
+          cr_assert(worker->in_flight_size == 0);
+          cr_assert(worker->batch_size == 0);
+          return LTR_EXPLICIT_ACK_MGMT;
+        }
+      log_threaded_dest_worker_ack_in_flight(worker, oldest_batch);
+    }
+
+  g_queue_push_tail(&self->in_flight_batches, GINT_TO_POINTER(worker->batch_size));
+  log_threaded_dest_worker_mark_batch_in_flight(worker);
+  self->max_in_flight_batches = MAX(self->max_in_flight_batches, g_queue_get_length(&self->in_flight_batches));
+  return LTR_EXPLICIT_ACK_MGMT;
+}
+
+Test(logthrdestdrv, in_flight_batches_are_acked_in_order)
+{
+  dd->super.worker.insert = _insert_in_flight_message;
+  dd->super.worker.flush = _flush_in_flight_batches;
+  dd->super.batch_lines = 5;
+
+  _generate_messages_and_wait_for_processing(dd, 20, dd->super.metrics.written_messages);
+  cr_assert(dd->insert_counter == 20, "%d", dd->insert_counter);
+  cr_assert(dd->flush_size == 20, "%d", dd->flush_size);
+  cr_assert(dd->max_in_flight_batches <= MAX_IN_FLIGHT_BATCHES, "%d", dd->max_in_flight_batches);
+
+  cr_assert(stats_counter_get(dd->super.metrics.written_messages) == 20);
+  cr_assert(stats_counter_get(dd->super.metrics.dropped_messages) == 0);
+  cr_assert(stats_counter_get(dd->super.worker.instance.queue->metrics.shared.queued_messages) == 0);
+  cr_assert(stats_counter_get(dd->super.worker.instance.queue->metrics.shared.memory_usage) == 0);
+}
+
+Test(logthrdestdrv, failed_in_flight_batch_rewinds_the_batches_sent_after_it)
+{
+  dd->super.worker.insert = _insert_in_flight_message;
+  dd->super.worker.flush = _flush_in_flight_batches;
+  dd->super.worker.instance.time_reopen = 0;
+  dd->super.batch_lines = 5;
+  dd->failure_counter = 1;
+
+  start_grabbing_messages();
+  _generate_messages(dd, 20, TRUE);
+
+  gint c = 0;
+  while (stats_counter_get(dd->super.metrics.written_messages) +
+         stats_counter_get(dd->super.metrics.dropped_messages) != 20 && c++ < MAX_SPIN_ITERATIONS)
+    _sleep_msec(1);
+
+  gssize dropped = stats_counter_get(dd->super.metrics.dropped_messages);
+  gssize written = stats_counter_get(dd->super.metrics.written_messages);
+
+  cr_assert(dropped > 0 && dropped <= 5, "%" G_GSSIZE_FORMAT, dropped);
+  cr_assert(written + dropped == 20, "%" G_GSSIZE_FORMAT, written);
+
+  /* the batches sent after the failed one are sent again */
+  cr_assert(dd->insert_counter > 20, "%d", dd->insert_counter);
+  cr_assert(dd->flush_size == dd->insert_counter, "%d", dd->flush_size);
+  cr_assert(stats_counter_get(dd->super.worker.instance.queue->metrics.shared.queued_messages) == 0);
+  assert_grabbed_log_contains("dropped while sending");
+}
+
 MainLoopOptions main_loop_options = {0};
 
 static void
@@ -840,46 +840,96 @@ log_writer_mark_timeout(void *cookie)
   log_writer_postpone_mark_timer(self);
 }
 
-/* NOTE: runs in the reader thread */
-static void
-log_writer_queue(LogPipe *s, LogMessage *lm, const LogPathOptions *path_options)
+static inline gboolean
+log_writer_needs_early_ack(LogWriter *self, const LogPathOptions *path_options)
 {
-  LogWriter *self = (LogWriter *) s;
-  LogPathOptions local_options;
-  gint mark_mode = self->options->mark_mode;
+  /* NOTE: this code ACKs the message back if there's a write error in
+   * order not to hang the client in case of a disk full */
 
-  if (!path_options->flow_control_requested &&
-      ((self->proto == NULL || self->suspended) || !(self->flags & LW_SOFT_FLOW_CONTROL)))
-    {
-      /* NOTE: this code ACKs the message back if there's a write error in
-       * order not to hang the client in case of a disk full */
-
-      path_options = log_msg_break_ack(lm, path_options, &local_options);
-    }
+  return !path_options->flow_control_requested &&
+         ((self->proto == NULL || self->suspended) || !(self->flags & LW_SOFT_FLOW_CONTROL));
+}
 
+/* returns FALSE if the message was dropped */
+static gboolean
+log_writer_accept_msg(LogWriter *self, LogMessage *lm, const LogPathOptions *path_options)
+{
   if (log_writer_is_msg_suppressed(self, lm))
     {
       log_msg_drop(lm, path_options, AT_PROCESSED);
-      return;
+      return FALSE;
     }
 
-  if (mark_mode != MM_INTERNAL && (lm->flags & LF_INTERNAL) && (lm->flags & LF_MARK))
+  if (self->options->mark_mode != MM_INTERNAL && (lm->flags & LF_INTERNAL) && (lm->flags & LF_MARK))
     {
       /* drop MARK messages generated by internal() in case our mark-mode != internal */
       log_msg_drop(lm, path_options, AT_PROCESSED);
-      return;
+      return FALSE;
     }
+  return TRUE;
+}
 
-  if (mark_mode == MM_DST_IDLE || (mark_mode == MM_HOST_IDLE && !(lm->flags & LF_LOCAL)))
-    {
-      /* in dst-idle and host-idle most, messages postpone the MARK itself */
-      log_writer_postpone_mark_timer(self);
-    }
+static inline gboolean
+log_writer_msg_postpones_mark(LogWriter *self, LogMessage *lm)
+{
+  gint mark_mode = self->options->mark_mode;
+
+  /* in dst-idle and host-idle most, messages postpone the MARK itself */
+  return mark_mode == MM_DST_IDLE || (mark_mode == MM_HOST_IDLE && !(lm->flags & LF_LOCAL));
+}
+
+/* NOTE: runs in the reader thread */
+static void
+log_writer_queue(LogPipe *s, LogMessage *lm, const LogPathOptions *path_options)
+{
+  LogWriter *self = (LogWriter *) s;
+  LogPathOptions local_options;
+
+  if (log_writer_needs_early_ack(self, path_options))
+    path_options = log_msg_break_ack(lm, path_options, &local_options);
+
+  if (!log_writer_accept_msg(self, lm, path_options))
+    return;
+
+  if (log_writer_msg_postpones_mark(self, lm))
+    log_writer_postpone_mark_timer(self);
 
   stats_counter_inc(self->metrics.processed_messages);
   log_queue_push_tail(self->queue, lm, path_options);
 }
 
+/* NOTE: runs in the reader thread, the MARK timer is postponed and the
+ * counters are updated once per batch */
+static void
+log_writer_queue_batch(LogPipe *s, LogMessage **msgs, gint num_msgs, const LogPathOptions *path_options)
+{
+  LogWriter *self = (LogWriter *) s;
+  LogPathOptions local_options;
+  gboolean early_ack = log_writer_needs_early_ack(self, path_options);
+  gboolean postpone_mark = FALSE;
+  gint num_queued = 0;
+
+  for (gint i = 0; i < num_msgs; i++)
+    {
+      LogMessage *lm = msgs[i];
+      const LogPathOptions *msg_path_options = path_options;
+
+      if (early_ack)
+        msg_path_options = log_msg_break_ack(lm, path_options, &local_options);
+
+      if (!log_writer_accept_msg(self, lm, msg_path_options))
+        continue;
+
+      postpone_mark |= log_writer_msg_postpones_mark(self, lm);
+      log_queue_push_tail(self->queue, lm, msg_path_options);
+      num_queued++;
+    }
+
+  if (postpone_mark)
+    log_writer_postpone_mark_timer(self);
+  stats_counter_add(self->metrics.processed_messages, num_queued);
+}
+
 static void
 log_writer_append_value(GString *result, LogMessage *lm, NVHandle handle, gboolean use_nil, gboolean append_space)
 {
@@ -1834,6 +1884,7 @@ log_writer_new(guint32 flags, GlobalConfig *cfg)
   self->super.init = log_writer_init;
   self->super.deinit = log_writer_deinit;
   self->super.queue = log_writer_queue;
+  self->super.queue_batch = log_writer_queue_batch;
   self->super.free_fn = log_writer_free;
   self->flags = flags;
   self->line_buffer = g_string_sized_new(128);
@@ -26,8 +26,33 @@
 
 #include "syslog-ng.h"
 #include "atomic-gssize.h"
+#include "mainloop-worker.h"
+
+#include <stdlib.h>
 
 #define STATS_COUNTER_MAX_VALUE G_MAXSIZE
+#define STATS_COUNTER_SHARD_SIZE 64
+
+/*
+ * Sharded counters
+ *
+ * Counters that are updated by many worker threads at the same time (e.g.
+ * global received/queued counters) can be registered as sharded. In that
+ * case each worker thread updates its own cache line sized slot, indexed
+ * by main_loop_worker_get_thread_index(), and the value is summed up when
+ * the counter is read.
+ *
+ * Threads without an index (or with an index beyond the number of shards
+ * allocated at registration time) use the shared value, so correctness
+ * does not depend on the thread estimation.
+ */
+typedef struct _StatsCounterShard
+{
+  atomic_gssize value;
+  gchar __pad[STATS_COUNTER_SHARD_SIZE - sizeof(atomic_gssize)];
+} StatsCounterShard;
+
+G_STATIC_ASSERT(sizeof(StatsCounterShard) == STATS_COUNTER_SHARD_SIZE);
 
 typedef struct _StatsCounterItem
 {
@@ -36,6 +61,8 @@ typedef struct _StatsCounterItem
     atomic_gssize value;
     atomic_gssize *value_ref;
   };
+  StatsCounterShard *shards;
+  gint num_shards;
   gchar *name;
   gint type;
   gboolean external;
@@ -48,13 +75,28 @@ stats_counter_read_only(StatsCounterItem *counter)
   return counter->external;
 }
 
+static inline atomic_gssize *
+_stats_counter_get_slot(StatsCounterItem *counter)
+{
+  StatsCounterShard *shards = g_atomic_pointer_get(&counter->shards);
+
+  if (shards)
+    {
+      gint thread_index = main_loop_worker_get_thread_index();
+
+      if (thread_index >= 0 && thread_index < counter->num_shards)
+        return &shards[thread_index].value;
+    }
+  return &counter->value;
+}
+
 static inline void
 stats_counter_add(StatsCounterItem *counter, gssize add)
 {
   if (counter)
     {
       g_assert(!stats_counter_read_only(counter));
-      atomic_gssize_add(&counter->value, add);
+      atomic_gssize_add(_stats_counter_get_slot(counter), add);
     }
 }
 
@@ -64,7 +106,7 @@ stats_counter_sub(StatsCounterItem *counter, gssize sub)
   if (counter)
     {
       g_assert(!stats_counter_read_only(counter));
-      atomic_gssize_sub(&counter->value, sub);
+      atomic_gssize_sub(_stats_counter_get_slot(counter), sub);
     }
 }
 
@@ -74,7 +116,7 @@ stats_counter_inc(StatsCounterItem *counter)
   if (counter)
     {
       g_assert(!stats_counter_read_only(counter));
-      atomic_gssize_inc(&counter->value);
+      atomic_gssize_inc(_stats_counter_get_slot(counter));
     }
 }
 
@@ -84,7 +126,7 @@ stats_counter_dec(StatsCounterItem *counter)
   if (counter)
     {
       g_assert(!stats_counter_read_only(counter));
-      atomic_gssize_dec(&counter->value);
+      atomic_gssize_dec(_stats_counter_get_slot(counter));
     }
 }
 
@@ -93,7 +135,11 @@ stats_counter_set(StatsCounterItem *counter, gsize value)
 {
   if (counter && !stats_counter_read_only(counter))
     {
+      StatsCounterShard *shards = g_atomic_pointer_get(&counter->shards);
+
       atomic_gssize_set(&counter->value, value);
+      for (gint i = 0; shards && i < counter->num_shards; i++)
+        atomic_gssize_set(&shards[i].value, 0);
     }
 }
 
@@ -108,6 +154,10 @@ stats_counter_get(StatsCounterItem *counter)
         result = atomic_gssize_get_unsigned(&counter->value);
       else
         result = atomic_gssize_get_unsigned(counter->value_ref);
+
+      StatsCounterShard *shards = g_atomic_pointer_get(&counter->shards);
+      for (gint i = 0; shards && i < counter->num_shards; i++)
+        result += atomic_gssize_get_unsigned(&shards[i].value);
     }
   return result;
 }
@@ -124,6 +174,9 @@ static inline void
 stats_counter_free(StatsCounterItem *counter)
 {
   g_free(counter->name);
+  free(counter->shards);
+  counter->shards = NULL;
+  counter->num_shards = 0;
 }
 
 #endif
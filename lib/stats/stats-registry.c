@@ -213,6 +213,50 @@ stats_register_counter(gint stats_level, const StatsClusterKey *sc_key, gint typ
   return _register_counter(stats_level, sc_key, type, FALSE, counter);
 }
 
+/**
+ * stats_shard_counter:
+ * @counter: a counter returned by one of the registration functions
+ *
+ * Splits the counter into per worker thread slots, so that threads
+ * updating it concurrently do not contend on the same cache line, reading
+ * the counter becomes more expensive. The number of slots is determined by
+ * the number of worker threads at the time the counter is first sharded,
+ * other threads update the shared value.
+ *
+ * Use it for counters that are updated from a lot of threads at once.
+ **/
+void
+stats_shard_counter(StatsCounterItem *counter)
+{
+  gint num_shards = MIN(main_loop_worker_get_max_number_of_threads(), MAIN_LOOP_MAX_WORKER_THREADS);
+  gpointer shards;
+
+  g_assert(stats_locked);
+
+  if (!counter || counter->external || counter->shards || num_shards <= 0)
+    return;
+
+  if (posix_memalign(&shards, STATS_COUNTER_SHARD_SIZE, num_shards * sizeof(StatsCounterShard)) != 0)
+    return;
+  memset(shards, 0, num_shards * sizeof(StatsCounterShard));
+
+  /* the counter might already be in use by other threads, publish the
+   * shards only after num_shards is set */
+  counter->num_shards = num_shards;
+  g_atomic_pointer_set(&counter->shards, shards);
+}
+
+/* same as stats_register_counter() followed by stats_shard_counter() */
+StatsCluster *
+stats_register_sharded_counter(gint stats_level, const StatsClusterKey *sc_key, gint type,
+                               StatsCounterItem **counter)
+{
+  StatsCluster *sc = _register_counter(stats_level, sc_key, type, FALSE, counter);
+
+  stats_shard_counter(*counter);
+  return sc;
+}
+
 StatsCluster *
 stats_register_external_counter(gint stats_level, const StatsClusterKey *sc_key, gint type,
                                 atomic_gssize *external_counter)
@@ -223,6 +267,8 @@ stats_register_external_counter(gint stats_level, const StatsClusterKey *sc_key,
 StatsCluster *
 stats_register_alias_counter(gint level, const StatsClusterKey *sc_key, gint type, StatsCounterItem *aliased_counter)
 {
+  /* an alias only sees the shared value */
+  g_assert(!aliased_counter->shards);
   return stats_register_external_counter(level, sc_key, type, &aliased_counter->value);
 }
 
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "apphook.h"
+#include "mainloop-worker.h"
+#include "stats/stats-cluster-single.h"
+#include "stats/stats-counter.h"
+#include "stats/stats-registry.h"
+
+#define NUM_THREADS 8
+#define NUM_INCREMENTS 100000
+
+typedef struct _CounterThreadArgs
+{
+  StatsCounterItem *counter;
+  gint increments;
+  gboolean worker;
+} CounterThreadArgs;
+
+static gpointer
+_increment_thread(gpointer user_data)
+{
+  CounterThreadArgs *args = user_data;
+
+  if (args->worker)
+    main_loop_worker_thread_start(MLW_ASYNC_WORKER);
+
+  for (gint i = 0; i < args->increments; i++)
+    stats_counter_inc(args->counter);
+
+  if (args->worker)
+    main_loop_worker_thread_stop();
+  return NULL;
+}
+
+static void
+_run_threads(StatsCounterItem *counter, gint increments, gboolean worker)
+{
+  GThread *threads[NUM_THREADS];
+  CounterThreadArgs args = { .counter = counter, .increments = increments, .worker = worker };
+
+  for (gint i = 0; i < NUM_THREADS; i++)
+    threads[i] = g_thread_new(NULL, _increment_thread, &args);
+
+  for (gint i = 0; i < NUM_THREADS; i++)
+    g_thread_join(threads[i]);
+}
+
+static StatsCounterItem *
+_register_counter(const gchar *name, gboolean sharded)
+{
+  StatsCounterItem *counter = NULL;
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, name, NULL, 0);
+  if (sharded)
+    stats_register_sharded_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &counter);
+  else
+    stats_register_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &counter);
+  stats_unlock();
+
+  return counter;
+}
+
+static void
+_unregister_counter(const gchar *name, StatsCounterItem **counter)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, name, NULL, 0);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, counter);
+  stats_unlock();
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  main_loop_worker_allocate_thread_space(NUM_THREADS);
+  main_loop_worker_finalize_thread_space();
+}
+
+TestSuite(stats_sharded_counter, .init = setup, .fini = app_shutdown);
+
+Test(stats_sharded_counter, updates_from_worker_threads_are_aggregated_on_read)
+{
+  StatsCounterItem *counter = _register_counter("test_sharded", TRUE);
+
+  cr_assert_not_null(counter->shards);
+  cr_assert_eq(counter->num_shards, NUM_THREADS);
+
+  stats_counter_add(counter, 5);
+  _run_threads(counter, NUM_INCREMENTS, TRUE);
+  cr_expect_eq(stats_counter_get(counter), NUM_THREADS * NUM_INCREMENTS + 5);
+
+  stats_counter_set(counter, 3);
+  cr_expect_eq(stats_counter_get(counter), 3);
+
+  _unregister_counter("test_sharded", &counter);
+}
+
+Test(stats_sharded_counter, threads_without_index_use_the_shared_value)
+{
+  StatsCounterItem *counter = _register_counter("test_sharded_no_index", TRUE);
+
+  _run_threads(counter, NUM_INCREMENTS, FALSE);
+  cr_expect_eq(atomic_gssize_get(&counter->value), NUM_THREADS * NUM_INCREMENTS);
+  cr_expect_eq(stats_counter_get(counter), NUM_THREADS * NUM_INCREMENTS);
+
+  _unregister_counter("test_sharded_no_index", &counter);
+}
+
+Test(stats_sharded_counter, sharding_an_already_registered_counter_keeps_its_value)
+{
+  StatsCounterItem *counter = _register_counter("test_sharded_late", FALSE);
+
+  cr_assert_null(counter->shards);
+  stats_counter_add(counter, 10);
+
+  StatsCounterItem *second_user = _register_counter("test_sharded_late", TRUE);
+  cr_assert_eq(counter, second_user);
+  cr_assert_not_null(counter->shards);
+
+  _run_threads(counter, NUM_INCREMENTS, TRUE);
+  cr_expect_eq(stats_counter_get(counter), NUM_THREADS * NUM_INCREMENTS + 10);
+
+  _unregister_counter("test_sharded_late", &second_user);
+  _unregister_counter("test_sharded_late", &counter);
+}
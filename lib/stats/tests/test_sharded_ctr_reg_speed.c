@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "apphook.h"
+#include "mainloop-worker.h"
+#include "stats/stats-cluster-single.h"
+#include "stats/stats-counter.h"
+#include "stats/stats-registry.h"
+#include "libtest/stopwatch.h"
+
+#define NUM_THREADS 8
+#define BENCHMARK_INCREMENTS 2000000
+
+static gpointer
+_increment_thread(gpointer user_data)
+{
+  StatsCounterItem *counter = user_data;
+
+  main_loop_worker_thread_start(MLW_ASYNC_WORKER);
+  for (gint i = 0; i < BENCHMARK_INCREMENTS; i++)
+    stats_counter_inc(counter);
+  main_loop_worker_thread_stop();
+  return NULL;
+}
+
+static void
+_benchmark(gboolean sharded)
+{
+  const gchar *name = sharded ? "benchmark_sharded" : "benchmark_plain";
+  GThread *threads[NUM_THREADS];
+  StatsCounterItem *counter = NULL;
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, name, NULL, 0);
+  if (sharded)
+    stats_register_sharded_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &counter);
+  else
+    stats_register_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &counter);
+  stats_unlock();
+
+  start_stopwatch();
+  for (gint i = 0; i < NUM_THREADS; i++)
+    threads[i] = g_thread_new(NULL, _increment_thread, counter);
+  for (gint i = 0; i < NUM_THREADS; i++)
+    g_thread_join(threads[i]);
+  stop_stopwatch_and_display_result(NUM_THREADS * BENCHMARK_INCREMENTS,
+                                    "%-7s counter incremented from %d threads", sharded ? "sharded" : "plain",
+                                    NUM_THREADS);
+  cr_expect_eq(stats_counter_get(counter), NUM_THREADS * BENCHMARK_INCREMENTS);
+
+  stats_lock();
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &counter);
+  stats_unlock();
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  main_loop_worker_allocate_thread_space(NUM_THREADS);
+  main_loop_worker_finalize_thread_space();
+}
+
+TestSuite(stats_sharded_counter, .init = setup, .fini = app_shutdown);
+
+Test(stats_sharded_counter, plain_vs_sharded_counter_increments)
+{
+  _benchmark(FALSE);
+  _benchmark(TRUE);
+}
@@ -0,0 +1,380 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "str-scan.h"
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define STR_SCAN_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+typedef struct _StrScanFuncs
+{
+  gsize (*span)(const guchar *s, const CharClass *cls);
+  const guchar *(*find_char)(const guchar *s, guchar c);
+} StrScanFuncs;
+
+static void
+_char_class_update_ranges(CharClass *self)
+{
+  guint c, first;
+
+  self->num_ranges = 0;
+  for (c = 1; c < 256; c++)
+    {
+      if (!char_class_contains(self, c))
+        continue;
+
+      first = c;
+      while (c + 1 < 256 && char_class_contains(self, c + 1))
+        c++;
+
+      if (self->num_ranges < CHAR_CLASS_MAX_RANGES)
+        {
+          self->range_first[self->num_ranges] = first;
+          self->range_last[self->num_ranges] = c;
+        }
+      self->num_ranges++;
+    }
+}
+
+static inline void
+_char_class_set(CharClass *self, guchar c)
+{
+  if (c != '\0')
+    self->bitmap[c / 32] |= 1U << (c % 32);
+}
+
+void
+char_class_init(CharClass *self)
+{
+  memset(self, 0, sizeof(*self));
+}
+
+void
+char_class_add_range(CharClass *self, guchar first, guchar last)
+{
+  for (guint c = first; c <= last; c++)
+    _char_class_set(self, c);
+  _char_class_update_ranges(self);
+}
+
+void
+char_class_add_chars(CharClass *self, const gchar *chars)
+{
+  for (const guchar *c = (const guchar *) chars; *c; c++)
+    _char_class_set(self, *c);
+  _char_class_update_ranges(self);
+}
+
+void
+char_class_add_alnum(CharClass *self)
+{
+  char_class_add_range(self, '0', '9');
+  char_class_add_range(self, 'A', 'Z');
+  char_class_add_range(self, 'a', 'z');
+}
+
+static gsize
+_span_scalar(const guchar *s, const CharClass *cls)
+{
+  gsize n = 0;
+
+  while (char_class_contains(cls, s[n]))
+    n++;
+  return n;
+}
+
+static const guchar *
+_find_char_scalar(const guchar *s, guchar c)
+{
+  return (const guchar *) strchr((const gchar *) s, c);
+}
+
+static const StrScanFuncs scalar_funcs =
+{
+  .span = _span_scalar,
+  .find_char = _find_char_scalar,
+};
+
+#if STR_SCAN_X86_SIMD
+
+/*
+ * The vector code loads aligned blocks, starting with the one that contains
+ * the first character and masking out the bytes before it.  An aligned
+ * block never crosses a page boundary, so reading the bytes after the
+ * terminating NUL in the same block is safe.
+ *
+ * The length of the string is not known in advance, so the loads can't be
+ * bounded the way find-crlf does it.  AddressSanitizer would report the
+ * bytes around the string as out of bounds, so these functions are not
+ * instrumented.  The bytes we return are still checked by the callers.
+ */
+#if defined(__has_attribute)
+#if __has_attribute(no_sanitize_address)
+#define STR_SCAN_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#endif
+#endif
+
+#ifndef STR_SCAN_NO_SANITIZE_ADDRESS
+#define STR_SCAN_NO_SANITIZE_ADDRESS
+#endif
+
+__attribute__((target("sse2")))
+static inline __m128i
+_class_members_sse2(__m128i block, const __m128i *first, const __m128i *width, gint num_ranges)
+{
+  __m128i members = _mm_setzero_si128();
+
+  for (gint i = 0; i < num_ranges; i++)
+    {
+      /* c - first <= last - first, as unsigned */
+      __m128i offset = _mm_sub_epi8(block, first[i]);
+      members = _mm_or_si128(members, _mm_cmpeq_epi8(_mm_min_epu8(offset, width[i]), offset));
+    }
+  return members;
+}
+
+__attribute__((target("sse2"))) STR_SCAN_NO_SANITIZE_ADDRESS
+static gsize
+_span_sse2(const guchar *s, const CharClass *cls)
+{
+  __m128i first[CHAR_CLASS_MAX_RANGES], width[CHAR_CLASS_MAX_RANGES];
+  gint num_ranges = cls->num_ranges;
+  const guchar *p = (const guchar *) ((gsize) s & ~(sizeof(__m128i) - 1));
+  guint32 mask;
+
+  if (num_ranges > CHAR_CLASS_MAX_RANGES)
+    return _span_scalar(s, cls);
+
+  for (gint i = 0; i < num_ranges; i++)
+    {
+      first[i] = _mm_set1_epi8(cls->range_first[i]);
+      width[i] = _mm_set1_epi8(cls->range_last[i] - cls->range_first[i]);
+    }
+
+  /* the bits of the characters that end the span: non-members, including NUL */
+  mask = ~_mm_movemask_epi8(_class_members_sse2(_mm_load_si128((const __m128i *) p), first, width, num_ranges));
+  mask &= 0xffff & (~0U << (s - p));
+  while (!mask)
+    {
+      p += sizeof(__m128i);
+      mask = ~_mm_movemask_epi8(_class_members_sse2(_mm_load_si128((const __m128i *) p), first, width, num_ranges));
+      mask &= 0xffff;
+    }
+  return p + __builtin_ctz(mask) - s;
+}
+
+__attribute__((target("sse2"))) STR_SCAN_NO_SANITIZE_ADDRESS
+static const guchar *
+_find_char_sse2(const guchar *s, guchar c)
+{
+  const __m128i needle = _mm_set1_epi8(c);
+  const __m128i zero = _mm_setzero_si128();
+  const guchar *p = (const guchar *) ((gsize) s & ~(sizeof(__m128i) - 1));
+  __m128i block = _mm_load_si128((const __m128i *) p);
+  guint32 mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, needle), _mm_cmpeq_epi8(block, zero)));
+
+  mask &= 0xffff << (s - p);
+  while (!mask)
+    {
+      p += sizeof(__m128i);
+      block = _mm_load_si128((const __m128i *) p);
+      mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, needle), _mm_cmpeq_epi8(block, zero)));
+    }
+
+  p += __builtin_ctz(mask);
+  return *p == c ? p : NULL;
+}
+
+static const StrScanFuncs sse2_funcs =
+{
+  .span = _span_sse2,
+  .find_char = _find_char_sse2,
+};
+
+__attribute__((target("avx2")))
+static inline __m256i
+_class_members_avx2(__m256i block, const __m256i *first, const __m256i *width, gint num_ranges)
+{
+  __m256i members = _mm256_setzero_si256();
+
+  for (gint i = 0; i < num_ranges; i++)
+    {
+      __m256i offset = _mm256_sub_epi8(block, first[i]);
+      members = _mm256_or_si256(members, _mm256_cmpeq_epi8(_mm256_min_epu8(offset, width[i]), offset));
+    }
+  return members;
+}
+
+__attribute__((target("avx2"))) STR_SCAN_NO_SANITIZE_ADDRESS
+static gsize
+_span_avx2(const guchar *s, const CharClass *cls)
+{
+  __m256i first[CHAR_CLASS_MAX_RANGES], width[CHAR_CLASS_MAX_RANGES];
+  gint num_ranges = cls->num_ranges;
+  const guchar *p = (const guchar *) ((gsize) s & ~(sizeof(__m256i) - 1));
+  guint32 mask;
+
+  if (num_ranges > CHAR_CLASS_MAX_RANGES)
+    return _span_scalar(s, cls);
+
+  for (gint i = 0; i < num_ranges; i++)
+    {
+      first[i] = _mm256_set1_epi8(cls->range_first[i]);
+      width[i] = _mm256_set1_epi8(cls->range_last[i] - cls->range_first[i]);
+    }
+
+  mask = ~(guint32) _mm256_movemask_epi8(_class_members_avx2(_mm256_load_si256((const __m256i *) p),
+                                                             first, width, num_ranges));
+  mask &= ~0U << (s - p);
+  while (!mask)
+    {
+      p += sizeof(__m256i);
+      mask = ~(guint32) _mm256_movemask_epi8(_class_members_avx2(_mm256_load_si256((const __m256i *) p),
+                                                                 first, width, num_ranges));
+    }
+  return p + __builtin_ctz(mask) - s;
+}
+
+__attribute__((target("avx2"))) STR_SCAN_NO_SANITIZE_ADDRESS
+static const guchar *
+_find_char_avx2(const guchar *s, guchar c)
+{
+  const __m256i needle = _mm256_set1_epi8(c);
+  const __m256i zero = _mm256_setzero_si256();
+  const guchar *p = (const guchar *) ((gsize) s & ~(sizeof(__m256i) - 1));
+  __m256i block = _mm256_load_si256((const __m256i *) p);
+  guint32 mask = (guint32) _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(block, needle),
+                                                                 _mm256_cmpeq_epi8(block, zero)));
+
+  mask &= ~0U << (s - p);
+  while (!mask)
+    {
+      p += sizeof(__m256i);
+      block = _mm256_load_si256((const __m256i *) p);
+      mask = (guint32) _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(block, needle),
+                                                            _mm256_cmpeq_epi8(block, zero)));
+    }
+
+  p += __builtin_ctz(mask);
+  return *p == c ? p : NULL;
+}
+
+static const StrScanFuncs avx2_funcs =
+{
+  .span = _span_avx2,
+  .find_char = _find_char_avx2,
+};
+
+#endif
+
+static const StrScanFuncs *
+_lookup_implementation(StrScanImplementation impl)
+{
+#if STR_SCAN_X86_SIMD
+  __builtin_cpu_init();
+  switch (impl)
+    {
+    case STR_SCAN_IMPL_AUTO:
+      if (__builtin_cpu_supports("avx2"))
+        return &avx2_funcs;
+      if (__builtin_cpu_supports("sse2"))
+        return &sse2_funcs;
+      return &scalar_funcs;
+    case STR_SCAN_IMPL_AVX2:
+      return __builtin_cpu_supports("avx2") ? &avx2_funcs : NULL;
+    case STR_SCAN_IMPL_SSE2:
+      return __builtin_cpu_supports("sse2") ? &sse2_funcs : NULL;
+    default:
+      break;
+    }
+#else
+  if (impl == STR_SCAN_IMPL_SSE2 || impl == STR_SCAN_IMPL_AVX2)
+    return NULL;
+#endif
+  return &scalar_funcs;
+}
+
+static const StrScanFuncs *scan_funcs;
+
+/* the first call picks the best implementation the CPU supports */
+static inline const StrScanFuncs *
+_get_funcs(void)
+{
+  const StrScanFuncs *funcs = g_atomic_pointer_get(&scan_funcs);
+
+  if (G_UNLIKELY(!funcs))
+    {
+      funcs = _lookup_implementation(STR_SCAN_IMPL_AUTO);
+      g_atomic_pointer_set(&scan_funcs, funcs);
+    }
+  return funcs;
+}
+
+gboolean
+str_scan_set_implementation(StrScanImplementation impl)
+{
+  const StrScanFuncs *funcs = _lookup_implementation(impl);
+
+  if (!funcs)
+    return FALSE;
+
+  g_atomic_pointer_set(&scan_funcs, funcs);
+  return TRUE;
+}
+
+/* returns the length of the initial segment of s consisting of members of cls */
+gsize
+str_scan_span(const gchar *s, const CharClass *cls)
+{
+  return _get_funcs()->span((const guchar *) s, cls);
+}
+
+/* same as strchr() */
+const gchar *
+str_scan_find_char(const gchar *s, gchar c)
+{
+  return (const gchar *) _get_funcs()->find_char((const guchar *) s, c);
+}
+
+/* same as strstr(), with the length of needle known in advance */
+const gchar *
+str_scan_find_str(const gchar *s, const gchar *needle, gsize needle_len)
+{
+  const StrScanFuncs *funcs = _get_funcs();
+  const guchar *candidate;
+
+  if (needle_len == 0)
+    return s;
+
+  for (candidate = funcs->find_char((const guchar *) s, needle[0]);
+       candidate;
+       candidate = funcs->find_char(candidate + 1, needle[0]))
+    {
+      if (strncmp((const gchar *) candidate, needle, needle_len) == 0)
+        return (const gchar *) candidate;
+    }
+  return NULL;
+}
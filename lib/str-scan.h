@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef STR_SCAN_H_INCLUDED
+#define STR_SCAN_H_INCLUDED 1
+
+#include "syslog-ng.h"
+
+/*
+ * Scanning primitives for NUL terminated strings, used by parsers that
+ * tokenize their input character by character (e.g. the db-parser radix
+ * parsers).  They have SSE2/AVX2 implementations, selected at runtime
+ * based on the CPU, and a scalar fallback, which all behave the same.
+ *
+ * The vector implementations never read across an aligned block boundary
+ * beyond the terminating NUL, so they are safe at the end of a page.
+ */
+
+typedef enum
+{
+  STR_SCAN_IMPL_AUTO,
+  STR_SCAN_IMPL_SCALAR,
+  STR_SCAN_IMPL_SSE2,
+  STR_SCAN_IMPL_AVX2,
+} StrScanImplementation;
+
+/* the number of ranges the vector implementations can check at once */
+#define CHAR_CLASS_MAX_RANGES 8
+
+/*
+ * A set of characters, kept both as a bitmap (for the scalar code) and as
+ * a list of inclusive ranges (for the vector code).  Classes with more than
+ * CHAR_CLASS_MAX_RANGES ranges are always scanned by the scalar code.  NUL
+ * is never a member, so spans always stop at the end of the string.
+ */
+typedef struct _CharClass
+{
+  guint32 bitmap[256 / 32];
+  guint8 num_ranges;
+  guchar range_first[CHAR_CLASS_MAX_RANGES];
+  guchar range_last[CHAR_CLASS_MAX_RANGES];
+} CharClass;
+
+void char_class_init(CharClass *self);
+void char_class_add_range(CharClass *self, guchar first, guchar last);
+void char_class_add_chars(CharClass *self, const gchar *chars);
+void char_class_add_alnum(CharClass *self);
+
+static inline gboolean
+char_class_contains(const CharClass *self, guchar c)
+{
+  return (self->bitmap[c / 32] >> (c % 32)) & 1;
+}
+
+gsize str_scan_span(const gchar *s, const CharClass *cls);
+const gchar *str_scan_find_char(const gchar *s, gchar c);
+const gchar *str_scan_find_str(const gchar *s, const gchar *needle, gsize needle_len);
+
+/* for tests and benchmarks, returns FALSE if the CPU lacks support */
+gboolean str_scan_set_implementation(StrScanImplementation impl);
+
+#endif
@@ -52,14 +52,75 @@ _should_render(const gchar *value, LogMessageValueType value_type, LogMessageVal
   return !!value[0];
 }
 
+static inline void
+_eval_value(LogTemplate *self, const LogTemplateInstr *instr, LogMessage *msg, GString *result,
+            LogMessageValueType *t)
+{
+  const gchar *value = NULL;
+  gssize value_len = -1;
+  LogMessageValueType value_type = LM_VT_NONE;
+
+  value = log_msg_get_value_with_type(msg, instr->value.handle, &value_len, &value_type);
+  if (value && _should_render(value, value_type, self->type_hint))
+    {
+      result_append(result, value, value_len, self->escape);
+    }
+  else if (instr->value.default_value)
+    {
+      result_append(result, instr->value.default_value, -1, self->escape);
+      value_type = LM_VT_STRING;
+    }
+  else if (value_type == LM_VT_BYTES || value_type == LM_VT_PROTOBUF)
+    {
+      value_type = LM_VT_NULL;
+    }
+  *t = _propagate_type(*t, value_type);
+}
+
+static inline void
+_eval_macro(LogTemplate *self, const LogTemplateInstr *instr, LogTemplateEvalOptions *options, LogMessage *msg,
+            GString *result, LogMessageValueType *t)
+{
+  gint len = result->len;
+  LogMessageValueType value_type = LM_VT_NONE;
+
+  log_macro_expand(instr->macro.id, self->escape, options, msg, result, &value_type);
+  if (len == result->len && instr->macro.default_value)
+    g_string_append(result, instr->macro.default_value);
+  *t = _propagate_type(*t, value_type);
+}
+
+static inline void
+_eval_func(const LogTemplateInstr *instr, LogMessage **messages, gint num_messages, gint msg_ndx,
+           LogTemplateEvalOptions *options, GString *result, LogMessageValueType *t)
+{
+  LogTemplateInvokeArgs args =
+  {
+    instr->msg_ref ? &messages[msg_ndx] : messages,
+    instr->msg_ref ? 1 : num_messages,
+    options,
+  };
+  LogMessageValueType value_type = LM_VT_NONE;
+
+  /* if a function call is called with an msg_ref, we only
+   * pass that given logmsg to argument resolution, otherwise
+   * we pass the whole set so the arguments can individually
+   * specify which message they want to resolve from
+   */
+  if (instr->func.ops->eval)
+    instr->func.ops->eval(instr->func.ops, instr->func.state, &args);
+  instr->func.ops->call(instr->func.ops, instr->func.state, &args, result, &value_type);
+  *t = _propagate_type(*t, value_type);
+}
+
 void
 log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMessage **messages, gint num_messages,
                                                        LogTemplateEvalOptions *options,
                                                        GString *result, LogMessageValueType *type)
 {
-  LogTemplateElem *e;
   LogMessageValueType t = LM_VT_NONE;
-  gboolean first_elem = TRUE;
+  const LogTemplateInstr *instrs = self->program ? self->program->instrs : NULL;
+  gint num_instrs = self->program ? self->program->len : 0;
 
   if (!options->opts)
     options->opts = &self->cfg->template_options;
@@ -67,25 +128,25 @@ log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMes
   if (self->escape)
     t = LM_VT_STRING;
 
-  for (GList *p = self->compiled_template; p; p = g_list_next(p), first_elem = FALSE)
+  for (gint pc = 0; pc < num_instrs; pc++)
     {
+      const LogTemplateInstr *instr = &instrs[pc];
       gint msg_ndx;
 
-      if (!first_elem)
+      if (pc > 0)
         {
-          /* this is the 2nd elem in the compiled template, we are
-           * concatenating multiple elements, convert the value to string */
+          /* we are concatenating multiple elements, convert the value to
+           * string.  Only the expansion of a template consisting of a
+           * single element (without literal text) retains its type */
 
           t = LM_VT_STRING;
         }
 
-      e = (LogTemplateElem *) p->data;
-      if (e->text)
+      if (instr->opcode == LTI_LITERAL)
         {
-          g_string_append_len(result, e->text, e->text_len);
-          /* concatenating literal text */
-          if (e->text_len)
-            t = LM_VT_STRING;
+          g_string_append_len(result, instr->literal.text, instr->literal.text_len);
+          t = LM_VT_STRING;
+          continue;
         }
 
       /* NOTE: msg_ref is 1 larger than the index specified by the user in
@@ -94,79 +155,29 @@ log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMes
        *
        * msg_ref == 0 means that the user didn't specify msg_ref
        * msg_ref >= 1 means that the user supplied the given msg_ref, 1 is equal to @0 */
-      if (e->msg_ref > num_messages)
+      if (instr->msg_ref > num_messages)
         {
           /* msg_ref out of range, we expand to empty string without evaluating the element */
           t = LM_VT_STRING;
           continue;
         }
-      msg_ndx = num_messages - e->msg_ref;
+      msg_ndx = num_messages - instr->msg_ref;
 
       /* value and macro can't understand a context, assume that no msg_ref means @0 */
-      if (e->msg_ref == 0)
+      if (instr->msg_ref == 0)
         msg_ndx--;
 
-      switch (e->type)
+      switch (instr->opcode)
         {
-        case LTE_VALUE:
-        {
-          const gchar *value = NULL;
-          gssize value_len = -1;
-          LogMessageValueType value_type = LM_VT_NONE;
-
-          value = log_msg_get_value_with_type(messages[msg_ndx], e->value_handle, &value_len, &value_type);
-          if (value && _should_render(value, value_type, self->type_hint))
-            {
-              result_append(result, value, value_len, self->escape);
-            }
-          else if (e->default_value)
-            {
-              result_append(result, e->default_value, -1, self->escape);
-              value_type = LM_VT_STRING;
-            }
-          else if (value_type == LM_VT_BYTES || value_type == LM_VT_PROTOBUF)
-            {
-              value_type = LM_VT_NULL;
-            }
-          t = _propagate_type(t, value_type);
+        case LTI_VALUE:
+          _eval_value(self, instr, messages[msg_ndx], result, &t);
           break;
-        }
-        case LTE_MACRO:
-        {
-          gint len = result->len;
-          LogMessageValueType value_type = LM_VT_NONE;
-
-          if (e->macro)
-            {
-              log_macro_expand(e->macro, self->escape, options, messages[msg_ndx], result, &value_type);
-              if (len == result->len && e->default_value)
-                g_string_append(result, e->default_value);
-              t = _propagate_type(t, value_type);
-            }
+        case LTI_MACRO:
+          _eval_macro(self, instr, options, messages[msg_ndx], result, &t);
           break;
-        }
-        case LTE_FUNC:
-        {
-          LogTemplateInvokeArgs args =
-          {
-            e->msg_ref ? &messages[msg_ndx] : messages,
-            e->msg_ref ? 1 : num_messages,
-            options,
-          };
-          LogMessageValueType value_type = LM_VT_NONE;
-
-
-          /* if a function call is called with an msg_ref, we only
-           * pass that given logmsg to argument resolution, otherwise
-           * we pass the whole set so the arguments can individually
-           * specify which message they want to resolve from
-           */
-          if (e->func.ops->eval)
-            e->func.ops->eval(e->func.ops, e->func.state, &args);
-          e->func.ops->call(e->func.ops, e->func.state, &args, result, &value_type);
-          t = _propagate_type(t, value_type);
+        case LTI_FUNC:
+          _eval_func(instr, messages, num_messages, msg_ndx, options, result, &t);
           break;
-        }
         default:
           g_assert_not_reached();
           break;
@@ -174,7 +185,7 @@ log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMes
     }
   if (type)
     {
-      if (first_elem && t == LM_VT_NONE)
+      if (t == LM_VT_NONE)
         {
           /* empty template string, use LM_VT_STRING before applying the type-cast */
           t = LM_VT_STRING;
@@ -182,3 +182,109 @@ log_template_elem_free_list(GList *l)
     }
   g_list_free(l);
 }
+
+static inline gboolean
+_elem_has_expansion(const LogTemplateElem *e)
+{
+  return !log_template_elem_is_literal_string(e);
+}
+
+static void
+_calculate_program_size(GList *compiled_template, gint *num_instrs, gsize *literals_len)
+{
+  gboolean last_is_literal = FALSE;
+
+  *num_instrs = 0;
+  *literals_len = 0;
+  for (GList *p = compiled_template; p; p = p->next)
+    {
+      LogTemplateElem *e = (LogTemplateElem *) p->data;
+
+      if (e->text_len)
+        {
+          if (!last_is_literal)
+            (*num_instrs)++;
+          *literals_len += e->text_len;
+          last_is_literal = TRUE;
+        }
+      if (_elem_has_expansion(e))
+        {
+          (*num_instrs)++;
+          last_is_literal = FALSE;
+        }
+    }
+}
+
+static void
+_emit_expansion(LogTemplateInstr *instr, const LogTemplateElem *e)
+{
+  instr->msg_ref = e->msg_ref;
+  switch (e->type)
+    {
+    case LTE_MACRO:
+      instr->opcode = LTI_MACRO;
+      instr->macro.id = e->macro;
+      instr->macro.default_value = e->default_value;
+      break;
+    case LTE_VALUE:
+      instr->opcode = LTI_VALUE;
+      instr->value.handle = e->value_handle;
+      instr->value.default_value = e->default_value;
+      break;
+    case LTE_FUNC:
+      instr->opcode = LTI_FUNC;
+      instr->func.ops = e->func.ops;
+      instr->func.state = e->func.state;
+      break;
+    default:
+      g_assert_not_reached();
+    }
+}
+
+LogTemplateProgram *
+log_template_program_new(GList *compiled_template)
+{
+  LogTemplateProgram *self;
+  LogTemplateInstr *instr = NULL;
+  gint num_instrs;
+  gsize literals_len;
+  gchar *literals;
+
+  _calculate_program_size(compiled_template, &num_instrs, &literals_len);
+
+  self = g_malloc0(sizeof(LogTemplateProgram) + num_instrs * sizeof(LogTemplateInstr) + literals_len);
+  self->len = num_instrs;
+  literals = (gchar *) &self->instrs[num_instrs];
+
+  for (GList *p = compiled_template; p; p = p->next)
+    {
+      LogTemplateElem *e = (LogTemplateElem *) p->data;
+
+      if (e->text_len)
+        {
+          if (!instr || instr->opcode != LTI_LITERAL)
+            {
+              instr = instr ? instr + 1 : &self->instrs[0];
+              instr->opcode = LTI_LITERAL;
+              instr->literal.text = literals;
+              instr->literal.text_len = 0;
+            }
+          memcpy(literals, e->text, e->text_len);
+          literals += e->text_len;
+          instr->literal.text_len += e->text_len;
+        }
+      if (_elem_has_expansion(e))
+        {
+          instr = instr ? instr + 1 : &self->instrs[0];
+          _emit_expansion(instr, e);
+        }
+    }
+  g_assert(instr == NULL ? num_instrs == 0 : instr == &self->instrs[num_instrs - 1]);
+  return self;
+}
+
+void
+log_template_program_free(LogTemplateProgram *self)
+{
+  g_free(self);
+}
@@ -70,5 +70,61 @@ log_template_elem_is_literal_string(const LogTemplateElem *self)
 
 void log_template_elem_free_list(GList *el);
 
+/*
+ * LogTemplateProgram: the list of LogTemplateElem instances flattened into
+ * a contiguous instruction array, this is what the evaluator executes.
+ *
+ * Literal prefixes of the elements are split off into LTI_LITERAL
+ * instructions, adjacent literals are merged and literal-only elements
+ * produce no expansion instruction.  The program borrows function state and
+ * default values from the element list, so it has to be freed before that.
+ */
+enum
+{
+  LTI_LITERAL,
+  LTI_MACRO,
+  LTI_VALUE,
+  LTI_FUNC,
+};
+
+typedef struct _LogTemplateInstr
+{
+  guint8 opcode;
+  guint16 msg_ref;
+  union
+  {
+    struct
+    {
+      const gchar *text;
+      gsize text_len;
+    } literal;
+    struct
+    {
+      guint id;
+      const gchar *default_value;
+    } macro;
+    struct
+    {
+      NVHandle handle;
+      const gchar *default_value;
+    } value;
+    struct
+    {
+      LogTemplateFunction *ops;
+      gpointer state;
+    } func;
+  };
+} LogTemplateInstr;
+
+struct _LogTemplateProgram
+{
+  gint len;
+  /* followed by the merged literal texts */
+  LogTemplateInstr instrs[];
+};
+
+LogTemplateProgram *log_template_program_new(GList *compiled_template);
+void log_template_program_free(LogTemplateProgram *self);
+
 
 #endif
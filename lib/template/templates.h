@@ -58,6 +58,8 @@ struct _LogTemplate
   gchar *name;
   gchar *template_str;
   GList *compiled_template;
+  /* compiled_template flattened for evaluation, see repr.h */
+  LogTemplateProgram *program;
   GlobalConfig *cfg;
   guint escape:1, def_inline:1, trivial:1, literal:1;
 
@@ -376,6 +376,57 @@ Test(template_compile, test_unknown_function)
                            type = LTE_MACRO, msg_ref = 0);
 }
 
+static void
+assert_program_literal(const LogTemplateInstr *instr, const gchar *expected)
+{
+  cr_assert_eq(instr->opcode, LTI_LITERAL);
+  cr_assert_eq(instr->literal.text_len, strlen(expected));
+  cr_assert(strncmp(instr->literal.text, expected, instr->literal.text_len) == 0,
+            "Bad literal in program: %.*s, expected: %s",
+            (gint) instr->literal.text_len, instr->literal.text, expected);
+}
+
+Test(template_compile, test_program_is_flattened_with_literals_merged)
+{
+  GList *elems = NULL;
+
+  elems = g_list_append(elems, log_template_elem_new_macro("foo", M_NONE, NULL, 0));
+  elems = g_list_append(elems, log_template_elem_new_macro("bar", M_MESSAGE, NULL, 0));
+  elems = g_list_append(elems, log_template_elem_new_macro("baz", M_NONE, NULL, 0));
+  elems = g_list_append(elems, log_template_elem_new_macro("bat", M_NONE, NULL, 0));
+  elems = g_list_append(elems, log_template_elem_new_value("", g_strdup("VALUE"), g_strdup("default"), 2));
+
+  LogTemplateProgram *program = log_template_program_new(elems);
+
+  cr_assert_eq(program->len, 4);
+  assert_program_literal(&program->instrs[0], "foobar");
+  cr_assert_eq(program->instrs[1].opcode, LTI_MACRO);
+  cr_assert_eq(program->instrs[1].macro.id, M_MESSAGE);
+  assert_program_literal(&program->instrs[2], "bazbat");
+  cr_assert_eq(program->instrs[3].opcode, LTI_VALUE);
+  cr_assert_eq(program->instrs[3].value.handle, log_msg_get_value_handle("VALUE"));
+  cr_assert_str_eq(program->instrs[3].value.default_value, "default");
+  cr_assert_eq(program->instrs[3].msg_ref, 2);
+
+  log_template_program_free(program);
+  log_template_elem_free_list(elems);
+}
+
+Test(template_compile, test_compiled_template_has_a_program)
+{
+  assert_template_compile("${MESSAGE}@@12");
+  cr_assert_eq(template->program->len, 2);
+  cr_assert_eq(template->program->instrs[0].opcode, LTI_MACRO);
+  assert_program_literal(&template->program->instrs[1], "@12");
+
+  cr_assert(log_template_compile(template, "", NULL));
+  cr_assert_eq(template->program->len, 0);
+
+  log_template_compile_literal_string(template, "literal");
+  cr_assert_eq(template->program->len, 1);
+  assert_program_literal(&template->program->instrs[0], "literal");
+}
+
 static void
 setup(void)
 {
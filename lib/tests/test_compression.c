@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "compression.h"
+#include <string.h>
+
+#if SYSLOG_NG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#if SYSLOG_NG_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define NUM_LINES 10000
+
+static GString *
+_compress_lines(StreamCompressor *compressor, GString *expected)
+{
+  GString *compressed = g_string_new("");
+
+  for (gint i = 0; i < NUM_LINES; i++)
+    {
+      gchar line[128];
+      gint len = g_snprintf(line, sizeof(line), "<13>Jan  1 00:00:00 localhost prog[%d]: message number %d\n", i % 7, i);
+
+      cr_assert(stream_compressor_write(compressor, line, len, compressed));
+      g_string_append_len(expected, line, len);
+    }
+  cr_assert(stream_compressor_finish(compressor, compressed));
+  cr_assert_eq(stream_compressor_get_input_size(compressor), expected->len);
+  cr_assert_lt(compressed->len, expected->len);
+
+  return compressed;
+}
+
+#if SYSLOG_NG_HAVE_ZLIB
+
+static GString *
+_inflate(GString *compressed, gint window_bits)
+{
+  GString *result = g_string_new("");
+  z_stream zs = {0};
+  gchar buffer[4096];
+  gint rc;
+
+  cr_assert_eq(inflateInit2(&zs, window_bits), Z_OK);
+  zs.next_in = (Bytef *) compressed->str;
+  zs.avail_in = compressed->len;
+  do
+    {
+      zs.next_out = (Bytef *) buffer;
+      zs.avail_out = sizeof(buffer);
+      rc = inflate(&zs, Z_NO_FLUSH);
+      cr_assert(rc == Z_OK || rc == Z_STREAM_END, "inflate() failed: %d", rc);
+      g_string_append_len(result, buffer, sizeof(buffer) - zs.avail_out);
+    }
+  while (rc != Z_STREAM_END);
+  inflateEnd(&zs);
+
+  return result;
+}
+
+static void
+_assert_zlib_round_trip(CompressionAlgorithm algorithm, gint window_bits)
+{
+  StreamCompressor *compressor = stream_compressor_new(algorithm, COMPRESSION_LEVEL_DEFAULT);
+  cr_assert_not_null(compressor);
+
+  /* the second stream after a reset has to be independent of the first one */
+  for (gint i = 0; i < 2; i++)
+    {
+      GString *expected = g_string_new("");
+      GString *compressed = _compress_lines(compressor, expected);
+      GString *decompressed = _inflate(compressed, window_bits);
+
+      cr_assert_str_eq(decompressed->str, expected->str);
+
+      g_string_free(decompressed, TRUE);
+      g_string_free(compressed, TRUE);
+      g_string_free(expected, TRUE);
+      stream_compressor_reset(compressor);
+    }
+  stream_compressor_free(compressor);
+}
+
+Test(compression, gzip_round_trip)
+{
+  _assert_zlib_round_trip(COMPRESSION_GZIP, 15 + 16);
+}
+
+Test(compression, deflate_round_trip)
+{
+  _assert_zlib_round_trip(COMPRESSION_DEFLATE, 15);
+}
+
+#endif
+
+#if SYSLOG_NG_HAVE_ZSTD
+
+Test(compression, zstd_round_trip)
+{
+  StreamCompressor *compressor = stream_compressor_new(COMPRESSION_ZSTD, COMPRESSION_LEVEL_DEFAULT);
+  cr_assert_not_null(compressor);
+
+  for (gint i = 0; i < 2; i++)
+    {
+      GString *expected = g_string_new("");
+      GString *compressed = _compress_lines(compressor, expected);
+      gchar *decompressed = g_malloc(expected->len);
+
+      gsize len = ZSTD_decompress(decompressed, expected->len, compressed->str, compressed->len);
+      cr_assert_not(ZSTD_isError(len), "ZSTD_decompress() failed: %s", ZSTD_getErrorName(len));
+      cr_assert_eq(len, expected->len);
+      cr_assert_arr_eq(decompressed, expected->str, len);
+
+      g_free(decompressed);
+      g_string_free(compressed, TRUE);
+      g_string_free(expected, TRUE);
+      stream_compressor_reset(compressor);
+    }
+  stream_compressor_free(compressor);
+}
+
+#endif
+
+Test(compression, none_passes_data_through)
+{
+  StreamCompressor *compressor = stream_compressor_new(COMPRESSION_NONE, COMPRESSION_LEVEL_DEFAULT);
+  GString *output = g_string_new("");
+
+  cr_assert(stream_compressor_write(compressor, "foo", 3, output));
+  cr_assert(stream_compressor_write(compressor, "bar", 3, output));
+  cr_assert(stream_compressor_finish(compressor, output));
+  cr_assert_str_eq(output->str, "foobar");
+  cr_assert_eq(stream_compressor_get_input_size(compressor), 6);
+
+  g_string_free(output, TRUE);
+  stream_compressor_free(compressor);
+}
+
+#if SYSLOG_NG_HAVE_LZ4 || SYSLOG_NG_HAVE_ZSTD
+
+static void
+_assert_block_round_trip(CompressionAlgorithm algorithm)
+{
+  BlockCompressor *compressor = block_compressor_new(algorithm, COMPRESSION_LEVEL_DEFAULT);
+  cr_assert(compressor);
+  cr_assert_eq(block_compressor_get_algorithm(compressor), algorithm);
+
+  for (gint i = 0; i < 100; i++)
+    {
+      gchar block[256];
+      gint len = g_snprintf(block, sizeof(block),
+                            "<13>Jan  1 00:00:00 localhost prog[%d]: message number %d, message number %d", i, i, i);
+
+      /* output is appended to, the prefix must be kept */
+      GString *compressed = g_string_new("prefix");
+      cr_assert(block_compressor_compress(compressor, block, len, compressed));
+      cr_assert(strncmp(compressed->str, "prefix", 6) == 0);
+
+      GString *decompressed = g_string_new("");
+      cr_assert(block_compressor_decompress(compressor, compressed->str + 6, compressed->len - 6, len, decompressed));
+      cr_assert_eq(decompressed->len, len);
+      cr_assert_arr_eq(decompressed->str, block, len);
+
+      /* wrong uncompressed length means a corrupted block */
+      g_string_truncate(decompressed, 0);
+      cr_assert_not(block_compressor_decompress(compressor, compressed->str + 6, compressed->len - 6, len + 1,
+                                                decompressed));
+      cr_assert_eq(decompressed->len, 0);
+
+      g_string_free(decompressed, TRUE);
+      g_string_free(compressed, TRUE);
+    }
+
+  block_compressor_free(compressor);
+}
+
+#endif
+
+#if SYSLOG_NG_HAVE_LZ4
+Test(compression, lz4_block_round_trip)
+{
+  _assert_block_round_trip(COMPRESSION_LZ4);
+}
+#endif
+
+#if SYSLOG_NG_HAVE_ZSTD
+Test(compression, zstd_block_round_trip)
+{
+  _assert_block_round_trip(COMPRESSION_ZSTD);
+}
+#endif
+
+Test(compression, block_compressor_only_supports_lz4_and_zstd)
+{
+  cr_assert_null(block_compressor_new(COMPRESSION_NONE, COMPRESSION_LEVEL_DEFAULT));
+  cr_assert_null(block_compressor_new(COMPRESSION_GZIP, COMPRESSION_LEVEL_DEFAULT));
+  cr_assert_null(stream_compressor_new(COMPRESSION_LZ4, COMPRESSION_LEVEL_DEFAULT));
+}
+
+Test(compression, algorithm_names)
+{
+  CompressionAlgorithm algorithm;
+
+  cr_assert(compression_algorithm_lookup("gzip", &algorithm));
+  cr_assert_eq(algorithm, COMPRESSION_GZIP);
+  cr_assert(compression_algorithm_lookup("deflate", &algorithm));
+  cr_assert_eq(algorithm, COMPRESSION_DEFLATE);
+  cr_assert(compression_algorithm_lookup("zstd", &algorithm));
+  cr_assert_eq(algorithm, COMPRESSION_ZSTD);
+  cr_assert(compression_algorithm_lookup("lz4", &algorithm));
+  cr_assert_eq(algorithm, COMPRESSION_LZ4);
+  cr_assert(compression_algorithm_lookup("none", &algorithm));
+  cr_assert_eq(algorithm, COMPRESSION_NONE);
+  cr_assert_not(compression_algorithm_lookup("brotli", &algorithm));
+
+  cr_assert_str_eq(compression_algorithm_name(COMPRESSION_GZIP), "gzip");
+  cr_assert(compression_algorithm_is_supported(COMPRESSION_NONE));
+}
+
+Test(compression, valid_levels)
+{
+  cr_assert(compression_algorithm_is_valid_level(COMPRESSION_GZIP, COMPRESSION_LEVEL_DEFAULT));
+  cr_assert(compression_algorithm_is_valid_level(COMPRESSION_GZIP, 0));
+  cr_assert(compression_algorithm_is_valid_level(COMPRESSION_GZIP, 9));
+  cr_assert_not(compression_algorithm_is_valid_level(COMPRESSION_GZIP, 10));
+  cr_assert_not(compression_algorithm_is_valid_level(COMPRESSION_ZSTD, 0));
+  cr_assert(compression_algorithm_is_valid_level(COMPRESSION_ZSTD, 19));
+  cr_assert_not(compression_algorithm_is_valid_level(COMPRESSION_NONE, 1));
+  cr_assert_not(compression_algorithm_is_valid_level(COMPRESSION_LZ4, 1));
+}
@@ -165,3 +165,72 @@ ParameterizedTest(struct findcrlf_params *params, findcrlf, test)
                 "EOM is at wrong location. msg=%s, eom_ofs=%d, eom=%s\n",
                 params->msg, (gint) params->eom_ofs, eom);
 }
+
+static gsize
+_collect_terminators_bytewise(const gchar *s, gsize n, guint32 *positions)
+{
+  gsize found = 0;
+
+  for (gsize i = 0; i < n; i++)
+    {
+      if (s[i] == '\r' || s[i] == '\n' || s[i] == '\0')
+        positions[found++] = i;
+    }
+  return found;
+}
+
+static void
+_assert_all_terminators_found(FindCRLFImplementation impl)
+{
+  gchar buffer[300];
+  guint32 expected[sizeof(buffer)];
+  guint32 positions[sizeof(buffer)];
+  const gchar alphabet[] = "ab\r\n\0cdefghijklmnopqrstuvwxyz";
+
+  if (!find_crlf_set_implementation(impl))
+    return;
+
+  for (gint i = 0; i < sizeof(buffer); i++)
+    buffer[i] = alphabet[(i * 7 + i / 13) % (sizeof(alphabet) - 1)];
+
+  /* all offsets and lengths, to cover the vector tails and unaligned starts */
+  for (gint start = 0; start < 40; start++)
+    {
+      gsize len = sizeof(buffer) - start;
+      gsize num_expected = _collect_terminators_bytewise(buffer + start, len, expected);
+      gsize num_found = find_line_terminators(buffer + start, len, FIND_CRLF_CR | FIND_CRLF_LF | FIND_CRLF_NUL,
+                                              positions, G_N_ELEMENTS(positions));
+
+      cr_assert_eq(num_found, num_expected, "impl=%d, start=%d", impl, start);
+      cr_assert_arr_eq(positions, expected, num_found * sizeof(positions[0]), "impl=%d, start=%d", impl, start);
+
+      cr_assert_eq(find_line_terminators(buffer + start, len, FIND_CRLF_CR | FIND_CRLF_LF | FIND_CRLF_NUL,
+                                         positions, 3), MIN(num_expected, 3));
+      cr_assert_eq(find_cr_or_lf_or_nul(buffer + start, len), num_expected ? buffer + start + expected[0] : NULL);
+    }
+
+  find_crlf_set_implementation(FIND_CRLF_IMPL_AUTO);
+}
+
+Test(findcrlf, test_all_implementations_find_the_same_terminators)
+{
+  _assert_all_terminators_found(FIND_CRLF_IMPL_SCALAR);
+  _assert_all_terminators_found(FIND_CRLF_IMPL_SSE2);
+  _assert_all_terminators_found(FIND_CRLF_IMPL_AVX2);
+}
+
+Test(findcrlf, test_terminator_set_is_honoured)
+{
+  const gchar msg[] = "abc\rdef\0ghi\njkl";
+  guint32 positions[4];
+
+  cr_assert_eq(find_line_terminators(msg, sizeof(msg) - 1, FIND_CRLF_LF, positions, 4), 1);
+  cr_assert_eq(positions[0], 11);
+
+  cr_assert_eq(find_line_terminators(msg, sizeof(msg) - 1, FIND_CRLF_LF | FIND_CRLF_NUL, positions, 4), 2);
+  cr_assert_eq(positions[0], 7);
+  cr_assert_eq(positions[1], 11);
+
+  cr_assert_eq(find_line_terminator(msg, sizeof(msg) - 1, FIND_CRLF_CR), msg + 3);
+  cr_assert_null(find_line_terminator(msg, 3, FIND_CRLF_CR | FIND_CRLF_LF | FIND_CRLF_NUL));
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/stopwatch.h"
+
+#include "find-crlf.h"
+#include <stdio.h>
+
+#define BENCHMARK_BUFFER_SIZE (1024 * 1024)
+#define BENCHMARK_ITERATIONS 64
+
+static gchar *
+_generate_lines(gsize line_len)
+{
+  gchar *buffer = g_malloc(BENCHMARK_BUFFER_SIZE);
+
+  for (gsize i = 0; i < BENCHMARK_BUFFER_SIZE; i++)
+    buffer[i] = ((i + 1) % line_len) == 0 ? '\n' : 'a' + i % 26;
+  return buffer;
+}
+
+static gsize
+_scan_all_lines(const gchar *buffer)
+{
+  guint32 positions[64];
+  gsize num_lines = 0;
+  gsize pos = 0;
+
+  while (pos < BENCHMARK_BUFFER_SIZE)
+    {
+      gsize found = find_line_terminators(buffer + pos, BENCHMARK_BUFFER_SIZE - pos,
+                                          FIND_CRLF_CR | FIND_CRLF_LF | FIND_CRLF_NUL,
+                                          positions, G_N_ELEMENTS(positions));
+      if (found == 0)
+        break;
+      num_lines += found;
+      pos += positions[found - 1] + 1;
+    }
+  return num_lines;
+}
+
+static void
+_perftest_find_crlf(FindCRLFImplementation impl, const gchar *impl_name, gsize line_len)
+{
+  gchar *buffer = _generate_lines(line_len);
+  gsize num_lines = 0;
+
+  if (!find_crlf_set_implementation(impl))
+    {
+      printf("%s is not supported by this CPU, skipping\n", impl_name);
+      g_free(buffer);
+      return;
+    }
+
+  start_stopwatch();
+  for (gint i = 0; i < BENCHMARK_ITERATIONS; i++)
+    num_lines += _scan_all_lines(buffer);
+  stop_stopwatch_and_display_result(BENCHMARK_ITERATIONS, "%-6s scanning 1MiB of %5" G_GSIZE_FORMAT " byte lines",
+                                    impl_name, line_len);
+
+  cr_assert_eq(num_lines, BENCHMARK_ITERATIONS * (BENCHMARK_BUFFER_SIZE / line_len));
+  find_crlf_set_implementation(FIND_CRLF_IMPL_AUTO);
+  g_free(buffer);
+}
+
+Test(findcrlf_speed, test_scalar_and_vector_implementations)
+{
+  for (gsize line_len = 64; line_len <= 65536; line_len *= 4)
+    {
+      _perftest_find_crlf(FIND_CRLF_IMPL_SCALAR, "scalar", line_len);
+      _perftest_find_crlf(FIND_CRLF_IMPL_SSE2, "sse2", line_len);
+      _perftest_find_crlf(FIND_CRLF_IMPL_AVX2, "avx2", line_len);
+    }
+}
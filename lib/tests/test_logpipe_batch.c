@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "logpipe.h"
+#include "logmpx.h"
+#include "filter/filter-pipe.h"
+#include "filter/filter-pri.h"
+#include "cfg.h"
+#include "apphook.h"
+
+#include <syslog.h>
+
+#define NUM_TEST_MESSAGES 8
+
+GlobalConfig *cfg;
+static gint acked_messages;
+
+typedef struct _RecorderPipe
+{
+  LogPipe super;
+  GPtrArray *msgs;
+  gint queue_calls;
+  gint batch_calls;
+} RecorderPipe;
+
+static void
+_record_msg(RecorderPipe *self, LogMessage *msg, const LogPathOptions *path_options)
+{
+  g_ptr_array_add(self->msgs, log_msg_ref(msg));
+  log_msg_drop(msg, path_options, AT_PROCESSED);
+}
+
+static void
+_recorder_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  RecorderPipe *self = (RecorderPipe *) s;
+
+  self->queue_calls++;
+  _record_msg(self, msg, path_options);
+}
+
+static void
+_recorder_queue_batch(LogPipe *s, LogMessage **msgs, gint num_msgs, const LogPathOptions *path_options)
+{
+  RecorderPipe *self = (RecorderPipe *) s;
+
+  self->batch_calls++;
+  for (gint i = 0; i < num_msgs; i++)
+    _record_msg(self, msgs[i], path_options);
+}
+
+static void
+_recorder_free(LogPipe *s)
+{
+  RecorderPipe *self = (RecorderPipe *) s;
+
+  g_ptr_array_free(self->msgs, TRUE);
+  log_pipe_free_method(s);
+}
+
+static RecorderPipe *
+recorder_pipe_new(gboolean batch_support)
+{
+  RecorderPipe *self = g_new0(RecorderPipe, 1);
+
+  log_pipe_init_instance(&self->super, cfg);
+  self->super.queue = _recorder_queue;
+  if (batch_support)
+    self->super.queue_batch = _recorder_queue_batch;
+  self->super.free_fn = _recorder_free;
+  self->msgs = g_ptr_array_new_with_free_func((GDestroyNotify) log_msg_unref);
+  return self;
+}
+
+static void
+_count_ack(LogMessage *msg, AckType ack_type)
+{
+  acked_messages++;
+}
+
+static void
+_create_messages(LogMessage **msgs, gint num_msgs)
+{
+  for (gint i = 0; i < num_msgs; i++)
+    {
+      msgs[i] = log_msg_new_empty();
+      msgs[i]->pri = LOG_USER | (i % 2 ? LOG_ERR : LOG_DEBUG);
+      msgs[i]->ack_func = _count_ack;
+    }
+}
+
+static void
+_queue_batch(LogPipe *pipe, LogMessage **msgs, gint num_msgs)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  for (gint i = 0; i < num_msgs; i++)
+    log_msg_add_ack(msgs[i], &path_options);
+  log_pipe_queue_batch(pipe, msgs, num_msgs, &path_options);
+}
+
+static void
+_assert_recorded(RecorderPipe *recorder, LogMessage **expected, gint num_expected)
+{
+  cr_assert_eq(recorder->msgs->len, num_expected);
+  for (gint i = 0; i < num_expected; i++)
+    cr_assert_eq(g_ptr_array_index(recorder->msgs, i), expected[i], "Message order mismatch at index %d", i);
+}
+
+static void
+_destroy_pipe(LogPipe *pipe)
+{
+  log_pipe_deinit(pipe);
+  log_pipe_unref(pipe);
+}
+
+Test(logpipe_batch, pipe_without_queue_batch_gets_messages_one_by_one)
+{
+  RecorderPipe *recorder = recorder_pipe_new(FALSE);
+  LogMessage *msgs[NUM_TEST_MESSAGES], *sent[NUM_TEST_MESSAGES];
+
+  cr_assert(log_pipe_init(&recorder->super));
+
+  _create_messages(msgs, NUM_TEST_MESSAGES);
+  memcpy(sent, msgs, sizeof(msgs));
+  _queue_batch(&recorder->super, msgs, NUM_TEST_MESSAGES);
+
+  cr_assert_eq(recorder->queue_calls, NUM_TEST_MESSAGES);
+  _assert_recorded(recorder, sent, NUM_TEST_MESSAGES);
+  cr_assert_eq(acked_messages, NUM_TEST_MESSAGES);
+
+  _destroy_pipe(&recorder->super);
+}
+
+Test(logpipe_batch, pipe_without_queue_method_forwards_the_batch)
+{
+  LogPipe *forwarder = log_pipe_new(cfg);
+  RecorderPipe *recorder = recorder_pipe_new(TRUE);
+  LogMessage *msgs[NUM_TEST_MESSAGES], *sent[NUM_TEST_MESSAGES];
+
+  log_pipe_append(forwarder, &recorder->super);
+  cr_assert(log_pipe_init(forwarder));
+  cr_assert(log_pipe_init(&recorder->super));
+
+  _create_messages(msgs, NUM_TEST_MESSAGES);
+  memcpy(sent, msgs, sizeof(msgs));
+  _queue_batch(forwarder, msgs, NUM_TEST_MESSAGES);
+
+  cr_assert_eq(recorder->batch_calls, 1);
+  cr_assert_eq(recorder->queue_calls, 0);
+  _assert_recorded(recorder, sent, NUM_TEST_MESSAGES);
+  cr_assert_eq(acked_messages, NUM_TEST_MESSAGES);
+
+  _destroy_pipe(forwarder);
+  _destroy_pipe(&recorder->super);
+}
+
+Test(logpipe_batch, multiplexer_delivers_the_batch_to_each_branch)
+{
+  LogMultiplexer *mpx = log_multiplexer_new(cfg);
+  RecorderPipe *branches[2] = { recorder_pipe_new(TRUE), recorder_pipe_new(TRUE) };
+  LogMessage *msgs[NUM_TEST_MESSAGES], *sent[NUM_TEST_MESSAGES];
+
+  for (gint i = 0; i < G_N_ELEMENTS(branches); i++)
+    {
+      log_multiplexer_add_next_hop(mpx, &branches[i]->super);
+      cr_assert(log_pipe_init(&branches[i]->super));
+    }
+  cr_assert(log_pipe_init(&mpx->super));
+
+  _create_messages(msgs, NUM_TEST_MESSAGES);
+  memcpy(sent, msgs, sizeof(msgs));
+  _queue_batch(&mpx->super, msgs, NUM_TEST_MESSAGES);
+
+  for (gint i = 0; i < G_N_ELEMENTS(branches); i++)
+    {
+      cr_assert_eq(branches[i]->batch_calls, 1);
+      _assert_recorded(branches[i], sent, NUM_TEST_MESSAGES);
+    }
+  cr_assert_eq(acked_messages, NUM_TEST_MESSAGES, "Each message should be acked once, when all branches are done");
+
+  _destroy_pipe(&mpx->super);
+  for (gint i = 0; i < G_N_ELEMENTS(branches); i++)
+    _destroy_pipe(&branches[i]->super);
+}
+
+Test(logpipe_batch, multiplexer_with_final_branch_queues_one_by_one)
+{
+  LogMultiplexer *mpx = log_multiplexer_new(cfg);
+  RecorderPipe *final_branch = recorder_pipe_new(TRUE);
+  RecorderPipe *skipped_branch = recorder_pipe_new(TRUE);
+  LogMessage *msgs[NUM_TEST_MESSAGES], *sent[NUM_TEST_MESSAGES];
+
+  final_branch->super.flags |= PIF_BRANCH_FINAL;
+  log_multiplexer_add_next_hop(mpx, &final_branch->super);
+  log_multiplexer_add_next_hop(mpx, &skipped_branch->super);
+  cr_assert(log_pipe_init(&final_branch->super));
+  cr_assert(log_pipe_init(&skipped_branch->super));
+  cr_assert(log_pipe_init(&mpx->super));
+
+  _create_messages(msgs, NUM_TEST_MESSAGES);
+  memcpy(sent, msgs, sizeof(msgs));
+  _queue_batch(&mpx->super, msgs, NUM_TEST_MESSAGES);
+
+  cr_assert_eq(final_branch->batch_calls, 0);
+  cr_assert_eq(final_branch->queue_calls, NUM_TEST_MESSAGES);
+  _assert_recorded(final_branch, sent, NUM_TEST_MESSAGES);
+  cr_assert_eq(skipped_branch->msgs->len, 0, "Messages matched by a final branch should not reach later branches");
+  cr_assert_eq(acked_messages, NUM_TEST_MESSAGES);
+
+  _destroy_pipe(&mpx->super);
+  _destroy_pipe(&final_branch->super);
+  _destroy_pipe(&skipped_branch->super);
+}
+
+Test(logpipe_batch, filter_pipe_forwards_matching_messages_as_a_batch)
+{
+  FilterExprNode *expr = filter_severity_new(1 << LOG_ERR);
+  LogPipe *filter = log_filter_pipe_new(expr, cfg);
+  RecorderPipe *recorder = recorder_pipe_new(TRUE);
+  LogMessage *msgs[NUM_TEST_MESSAGES], *matching[NUM_TEST_MESSAGES / 2];
+
+  log_pipe_append(filter, &recorder->super);
+  cr_assert(log_pipe_init(filter));
+  cr_assert(log_pipe_init(&recorder->super));
+
+  _create_messages(msgs, NUM_TEST_MESSAGES);
+  for (gint i = 0; i < G_N_ELEMENTS(matching); i++)
+    matching[i] = msgs[2 * i + 1];
+  _queue_batch(filter, msgs, NUM_TEST_MESSAGES);
+
+  cr_assert_eq(recorder->batch_calls, 1);
+  _assert_recorded(recorder, matching, G_N_ELEMENTS(matching));
+  cr_assert_eq(stats_counter_get(((LogFilterPipe *) filter)->matched), G_N_ELEMENTS(matching));
+  cr_assert_eq(stats_counter_get(((LogFilterPipe *) filter)->not_matched), NUM_TEST_MESSAGES - G_N_ELEMENTS(matching));
+  cr_assert_eq(acked_messages, NUM_TEST_MESSAGES, "Unmatched messages should be acked as well");
+
+  _destroy_pipe(filter);
+  _destroy_pipe(&recorder->super);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  cfg = cfg_new_snippet();
+  cfg->stats_options.level = 1;
+  acked_messages = 0;
+}
+
+static void
+teardown(void)
+{
+  cfg_free(cfg);
+  app_shutdown();
+}
+
+TestSuite(logpipe_batch, .init = setup, .fini = teardown);
@@ -28,6 +28,7 @@
 
 #include "logqueue.h"
 #include "logqueue-fifo.h"
+#include "logqueue-fifo-ring.h"
 #include "logpipe.h"
 #include "apphook.h"
 #include "plugin.h"
@@ -450,3 +451,143 @@ Test(logqueue, log_queue_fifo_multiple_queues)
 
   stats_cluster_key_builder_free(driver_sck_builder);
 }
+
+Test(logqueue, log_queue_fifo_ring_rewind_all_and_memory_usage)
+{
+  StatsClusterKeyBuilder *driver_sck_builder = stats_cluster_key_builder_new();
+  StatsClusterKeyBuilder *queue_sck_builder = stats_cluster_key_builder_new();
+  LogQueue *q = log_queue_fifo_ring_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, driver_sck_builder, queue_sck_builder);
+  stats_cluster_key_builder_free(driver_sck_builder);
+  stats_cluster_key_builder_free(queue_sck_builder);
+  log_queue_set_use_backlog(q, TRUE);
+
+  feed_some_messages(q, 1);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), 1);
+  gint size_when_single_msg = stats_counter_get(q->metrics.shared.memory_usage);
+  cr_assert_neq(size_when_single_msg, 0);
+
+  feed_some_messages(q, 9);
+  cr_assert_eq(log_queue_get_length(q), 10);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.memory_usage), 10*size_when_single_msg);
+
+  send_some_messages(q, 10);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.memory_usage), 0);
+  log_queue_rewind_backlog_all(q);
+  cr_assert_eq(log_queue_get_length(q), 10);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.memory_usage), 10*size_when_single_msg);
+
+  log_queue_unref(q);
+}
+
+Test(logqueue, log_queue_fifo_ring_spills_to_overflow_queue_in_order)
+{
+  const gint num_messages = LOG_QUEUE_FIFO_RING_MIN_CAPACITY * 3;
+  LogPathOptions flow_controlled_path = LOG_PATH_OPTIONS_INIT;
+  flow_controlled_path.flow_control_requested = TRUE;
+
+  LogQueue *q = log_queue_fifo_ring_new(1, NULL, STATS_LEVEL0, NULL, NULL);
+
+  for (gint i = 0; i < num_messages; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+      msg->rcptid = i;
+      log_queue_push_tail(q, msg, &flow_controlled_path);
+    }
+  cr_assert_eq(log_queue_get_length(q), num_messages);
+
+  for (gint i = 0; i < num_messages; i++)
+    {
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+      LogMessage *msg = log_queue_pop_head(q, &path_options);
+
+      cr_assert_not_null(msg);
+      cr_assert_eq(msg->rcptid, i, "Messages are out of order, expected: %d, got: %d", i, (gint) msg->rcptid);
+      log_msg_unref(msg);
+    }
+  cr_assert_eq(log_queue_get_length(q), 0);
+
+  log_queue_unref(q);
+}
+
+static gpointer
+_ring_flow_control_feed_thread(gpointer args)
+{
+  LogQueue *q = args;
+  gint fifo_size = 5;
+  LogPathOptions flow_controlled_path = LOG_PATH_OPTIONS_INIT;
+  flow_controlled_path.flow_control_requested = TRUE;
+
+  LogPathOptions non_flow_controlled_path = LOG_PATH_OPTIONS_INIT;
+  non_flow_controlled_path.flow_control_requested = FALSE;
+
+  main_loop_worker_thread_start(MLW_ASYNC_WORKER);
+
+  feed_empty_messages(q, &flow_controlled_path, fifo_size);
+  feed_empty_messages(q, &non_flow_controlled_path, fifo_size);
+
+  feed_empty_messages(q, &non_flow_controlled_path, 1);
+  feed_empty_messages(q, &flow_controlled_path, fifo_size);
+  feed_empty_messages(q, &non_flow_controlled_path, 2);
+  feed_empty_messages(q, &flow_controlled_path, fifo_size);
+
+  main_loop_worker_invoke_batch_callbacks();
+  main_loop_worker_thread_stop();
+  return NULL;
+}
+
+Test(logqueue, log_queue_fifo_ring_should_drop_only_non_flow_controlled_messages_threaded)
+{
+  gint fifo_size = 5;
+
+  main_loop_worker_allocate_thread_space(1);
+  main_loop_worker_finalize_thread_space();
+
+  StatsClusterKeyBuilder *driver_sck_builder = stats_cluster_key_builder_new();
+  StatsClusterKeyBuilder *queue_sck_builder = stats_cluster_key_builder_new();
+  LogQueue *q = log_queue_fifo_ring_new(fifo_size, NULL, STATS_LEVEL0, driver_sck_builder, queue_sck_builder);
+  stats_cluster_key_builder_free(driver_sck_builder);
+  stats_cluster_key_builder_free(queue_sck_builder);
+  log_queue_set_use_backlog(q, TRUE);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  GThread *thread = g_thread_new(NULL, _ring_flow_control_feed_thread, q);
+  g_thread_join(thread);
+
+  cr_assert_eq(stats_counter_get(q->metrics.shared.dropped_messages), 3);
+  cr_assert(log_queue_is_empty_racy(q) == FALSE);
+
+  gint queued_messages = stats_counter_get(q->metrics.shared.queued_messages);
+  send_some_messages(q, queued_messages);
+  log_queue_ack_backlog(q, queued_messages);
+
+  cr_assert_eq(fed_messages, acked_messages,
+               "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d",
+               fed_messages, acked_messages);
+
+  log_queue_unref(q);
+}
+
+Test(logqueue, log_queue_fifo_ring_with_threads)
+{
+  LogQueue *q;
+  GThread *thread_feed[FEEDERS], *thread_consume;
+  gint j;
+
+  main_loop_worker_allocate_thread_space(FEEDERS);
+  main_loop_worker_finalize_thread_space();
+
+  q = log_queue_fifo_ring_new(MESSAGES_SUM, NULL, STATS_LEVEL0, NULL, NULL);
+  log_queue_set_use_backlog(q, TRUE);
+
+  for (j = 0; j < FEEDERS; j++)
+    thread_feed[j] = g_thread_new(NULL, _threaded_feed, q);
+
+  thread_consume = g_thread_new(NULL, _threaded_consume, q);
+
+  for (j = 0; j < FEEDERS; j++)
+    g_thread_join(thread_feed[j]);
+  cr_assert_null(g_thread_join(thread_consume));
+
+  log_queue_unref(q);
+}
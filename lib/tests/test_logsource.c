@@ -309,6 +309,62 @@ Test(log_source, test_suspend)
   test_source_destroy(source);
 }
 
+static void
+_post_messages_batched(LogSource *source, gsize messages_to_send)
+{
+  for (gsize i = 0; i < messages_to_send; ++i)
+    {
+      LogMessage *msg = log_msg_new_empty();
+      log_source_post_batched(source, msg);
+    }
+}
+
+Test(log_source, test_post_batched)
+{
+  source_options.init_window_size = 3;
+
+  LogSource *source = test_source_init(&source_options);
+  TestPipe *next_pipe = test_pipe_init();
+  log_pipe_append(&source->super, &next_pipe->super);
+
+  _post_messages_batched(source, 3);
+  cr_assert_eq(next_pipe->messages_count, 0, "Batched messages should only be sent when the batch is flushed");
+  cr_assert_not(log_source_free_to_send(source));
+
+  log_source_flush_batch(source);
+  cr_assert_eq(next_pipe->messages_count, 3);
+
+  test_pipe_ack_messages(next_pipe, 3);
+  cr_assert(log_source_free_to_send(source));
+
+  log_source_flush_batch(source);
+  cr_assert_eq(next_pipe->messages_count, 0);
+
+  test_pipe_destroy(next_pipe);
+  test_source_destroy(source);
+}
+
+Test(log_source, test_full_batch_is_flushed_automatically)
+{
+  source_options.init_window_size = LOG_PIPE_BATCH_MAX + 1;
+
+  LogSource *source = test_source_init(&source_options);
+  TestPipe *next_pipe = test_pipe_init();
+  log_pipe_append(&source->super, &next_pipe->super);
+
+  _post_messages_batched(source, LOG_PIPE_BATCH_MAX + 1);
+  cr_assert_eq(next_pipe->messages_count, LOG_PIPE_BATCH_MAX);
+
+  log_source_flush_batch(source);
+  cr_assert_eq(next_pipe->messages_count, LOG_PIPE_BATCH_MAX + 1);
+
+  test_pipe_ack_messages(next_pipe, LOG_PIPE_BATCH_MAX + 1);
+  cr_assert(log_source_free_to_send(source));
+
+  test_pipe_destroy(next_pipe);
+  test_source_destroy(source);
+}
+
 Test(log_source, test_wakeup)
 {
   source_options.init_window_size = 3;
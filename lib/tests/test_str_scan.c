@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "str-scan.h"
+#include <string.h>
+
+#define TEST_BUFFER_SIZE 300
+
+static const StrScanImplementation implementations[] =
+{
+  STR_SCAN_IMPL_SCALAR,
+  STR_SCAN_IMPL_SSE2,
+  STR_SCAN_IMPL_AVX2,
+};
+
+static void
+_fill_buffer(gchar *buffer, const gchar *alphabet)
+{
+  gsize alphabet_len = strlen(alphabet);
+
+  for (gint i = 0; i < TEST_BUFFER_SIZE - 1; i++)
+    buffer[i] = alphabet[(i * 7 + i / 13) % alphabet_len];
+  buffer[TEST_BUFFER_SIZE - 1] = '\0';
+}
+
+static gsize
+_span_bytewise(const gchar *s, const CharClass *cls)
+{
+  gsize n = 0;
+
+  while (s[n] && char_class_contains(cls, s[n]))
+    n++;
+  return n;
+}
+
+static void
+_assert_spans_match_bytewise(const CharClass *cls, const gchar *alphabet)
+{
+  gchar buffer[TEST_BUFFER_SIZE];
+
+  _fill_buffer(buffer, alphabet);
+
+  /* all starting offsets and string lengths, to cover unaligned starts and the vector tails */
+  for (gint end = TEST_BUFFER_SIZE - 1; end > TEST_BUFFER_SIZE - 70; end--)
+    {
+      buffer[end] = '\0';
+      for (gint start = 0; start < 40; start++)
+        {
+          for (gint i = 0; i < G_N_ELEMENTS(implementations); i++)
+            {
+              if (!str_scan_set_implementation(implementations[i]))
+                continue;
+
+              cr_assert_eq(str_scan_span(buffer + start, cls), _span_bytewise(buffer + start, cls),
+                           "impl=%d, start=%d, end=%d", implementations[i], start, end);
+            }
+        }
+    }
+
+  str_scan_set_implementation(STR_SCAN_IMPL_AUTO);
+}
+
+Test(str_scan, test_span_stops_at_the_first_non_member)
+{
+  CharClass cls;
+
+  char_class_init(&cls);
+  char_class_add_alnum(&cls);
+  char_class_add_chars(&cls, "-_");
+
+  cr_assert_eq(str_scan_span("abc-123_x y", &cls), 9);
+  cr_assert_eq(str_scan_span(" abc", &cls), 0);
+  cr_assert_eq(str_scan_span("", &cls), 0);
+  cr_assert_not(char_class_contains(&cls, '\0'));
+  cr_assert_eq(cls.num_ranges, 5);
+}
+
+Test(str_scan, test_all_implementations_span_the_same)
+{
+  CharClass cls;
+
+  /* a few ranges, scanned by the vector code */
+  char_class_init(&cls);
+  char_class_add_range(&cls, '0', '9');
+  char_class_add_chars(&cls, ".:");
+  _assert_spans_match_bytewise(&cls, "0123.45:6789.::0");
+  _assert_spans_match_bytewise(&cls, "0123.45:6789.::0a");
+
+  /* too many ranges for the vector code */
+  char_class_init(&cls);
+  char_class_add_chars(&cls, "acegikmoqsuwy");
+  cr_assert_gt(cls.num_ranges, CHAR_CLASS_MAX_RANGES);
+  _assert_spans_match_bytewise(&cls, "acegikmoqsuwyacegikmoqsuwy");
+  _assert_spans_match_bytewise(&cls, "acegikmoqsuwyacegikmoqsuwyb");
+
+  /* high bit characters */
+  char_class_init(&cls);
+  char_class_add_range(&cls, 0x80, 0xff);
+  _assert_spans_match_bytewise(&cls, "\xc3\xa1\xc3\xa9\xff\x80");
+  _assert_spans_match_bytewise(&cls, "\xc3\xa1\xc3\xa9\xff\x80\x7f");
+
+  char_class_init(&cls);
+  _assert_spans_match_bytewise(&cls, "abc");
+}
+
+Test(str_scan, test_all_implementations_find_the_same_characters)
+{
+  gchar buffer[TEST_BUFFER_SIZE];
+
+  _fill_buffer(buffer, "abcdefghijklmnopqrstuvwxyz");
+  buffer[150] = '@';
+  buffer[200] = '@';
+  for (gint i = 0; i < G_N_ELEMENTS(implementations); i++)
+    {
+      if (!str_scan_set_implementation(implementations[i]))
+        continue;
+
+      for (gint start = 0; start < 200; start++)
+        {
+          cr_assert_eq(str_scan_find_char(buffer + start, '@'), strchr(buffer + start, '@'),
+                       "impl=%d, start=%d", implementations[i], start);
+          cr_assert_eq(str_scan_find_char(buffer + start, 'q'), strchr(buffer + start, 'q'),
+                       "impl=%d, start=%d", implementations[i], start);
+        }
+      cr_assert_null(str_scan_find_char(buffer, '#'));
+      cr_assert_null(str_scan_find_char(buffer + 201, '@'));
+    }
+
+  str_scan_set_implementation(STR_SCAN_IMPL_AUTO);
+}
+
+Test(str_scan, test_find_str_works_like_strstr)
+{
+  const gchar *haystack = "foo=bar, baz=:bar;; qux=::end";
+
+  for (gint i = 0; i < G_N_ELEMENTS(implementations); i++)
+    {
+      if (!str_scan_set_implementation(implementations[i]))
+        continue;
+
+      cr_assert_eq(str_scan_find_str(haystack, ", ", 2), strstr(haystack, ", "));
+      cr_assert_eq(str_scan_find_str(haystack, ";;", 2), strstr(haystack, ";;"));
+      cr_assert_eq(str_scan_find_str(haystack, "::end", 5), strstr(haystack, "::end"));
+      cr_assert_eq(str_scan_find_str(haystack, "=:", 2), strstr(haystack, "=:"));
+      cr_assert_null(str_scan_find_str(haystack, "::end!", 6));
+      cr_assert_eq(str_scan_find_str(haystack, "", 0), haystack);
+    }
+
+  str_scan_set_implementation(STR_SCAN_IMPL_AUTO);
+}
+
+/* exactly sized heap allocations, the vector code reads past their end
+ * within the aligned block, which must not trip AddressSanitizer */
+Test(str_scan, test_scanning_exactly_sized_heap_strings)
+{
+  CharClass cls;
+
+  char_class_init(&cls);
+  char_class_add_range(&cls, 'a', 'z');
+  for (gint i = 0; i < G_N_ELEMENTS(implementations); i++)
+    {
+      if (!str_scan_set_implementation(implementations[i]))
+        continue;
+
+      for (gsize len = 0; len < 70; len++)
+        {
+          gchar *s = g_malloc(len + 1);
+
+          memset(s, 'x', len);
+          s[len] = '\0';
+          cr_assert_eq(str_scan_span(s, &cls), len, "impl=%d, len=%" G_GSIZE_FORMAT, implementations[i], len);
+          cr_assert_null(str_scan_find_char(s, '@'), "impl=%d, len=%" G_GSIZE_FORMAT, implementations[i], len);
+          g_free(s);
+        }
+    }
+
+  str_scan_set_implementation(STR_SCAN_IMPL_AUTO);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/stopwatch.h"
+
+#include "str-scan.h"
+#include <stdio.h>
+
+#define BENCHMARK_BUFFER_SIZE (1024 * 1024)
+#define BENCHMARK_ITERATIONS 64
+
+static gchar *
+_generate_tokens(gsize token_len)
+{
+  gchar *buffer = g_malloc(BENCHMARK_BUFFER_SIZE + 1);
+
+  for (gsize i = 0; i < BENCHMARK_BUFFER_SIZE; i++)
+    buffer[i] = ((i + 1) % token_len) == 0 ? ' ' : 'a' + i % 26;
+  buffer[BENCHMARK_BUFFER_SIZE] = '\0';
+  return buffer;
+}
+
+static gsize
+_span_all_tokens(const gchar *buffer, const CharClass *cls)
+{
+  gsize num_tokens = 0;
+  const gchar *p = buffer;
+
+  while (*p)
+    {
+      p += str_scan_span(p, cls);
+      if (*p)
+        p++;
+      num_tokens++;
+    }
+  return num_tokens;
+}
+
+static gsize
+_find_all_separators(const gchar *buffer)
+{
+  gsize num_separators = 0;
+  const gchar *p = buffer;
+
+  while ((p = str_scan_find_char(p, ' ')) != NULL)
+    {
+      p++;
+      num_separators++;
+    }
+  return num_separators;
+}
+
+static void
+_perftest_str_scan(StrScanImplementation impl, const gchar *impl_name, gsize token_len)
+{
+  gchar *buffer = _generate_tokens(token_len);
+  gsize num_tokens = 0, num_separators = 0;
+  CharClass cls;
+
+  if (!str_scan_set_implementation(impl))
+    {
+      printf("%s is not supported by this CPU, skipping\n", impl_name);
+      g_free(buffer);
+      return;
+    }
+
+  char_class_init(&cls);
+  char_class_add_alnum(&cls);
+  char_class_add_chars(&cls, "-_.");
+
+  start_stopwatch();
+  for (gint i = 0; i < BENCHMARK_ITERATIONS; i++)
+    num_tokens += _span_all_tokens(buffer, &cls);
+  stop_stopwatch_and_display_result(BENCHMARK_ITERATIONS, "%-6s spanning 1MiB of %5" G_GSIZE_FORMAT " byte tokens",
+                                    impl_name, token_len);
+
+  start_stopwatch();
+  for (gint i = 0; i < BENCHMARK_ITERATIONS; i++)
+    num_separators += _find_all_separators(buffer);
+  stop_stopwatch_and_display_result(BENCHMARK_ITERATIONS, "%-6s searching 1MiB of %5" G_GSIZE_FORMAT " byte tokens",
+                                    impl_name, token_len);
+
+  cr_assert_eq(num_separators, BENCHMARK_ITERATIONS * (BENCHMARK_BUFFER_SIZE / token_len));
+  cr_assert_geq(num_tokens, num_separators);
+  str_scan_set_implementation(STR_SCAN_IMPL_AUTO);
+  g_free(buffer);
+}
+
+Test(str_scan_speed, test_scalar_and_vector_implementations)
+{
+  for (gsize token_len = 8; token_len <= 8192; token_len *= 4)
+    {
+      _perftest_str_scan(STR_SCAN_IMPL_SCALAR, "scalar", token_len);
+      _perftest_str_scan(STR_SCAN_IMPL_SSE2, "sse2", token_len);
+      _perftest_str_scan(STR_SCAN_IMPL_AVX2, "avx2", token_len);
+    }
+}
@@ -38,11 +38,37 @@ log_transport_free_method(LogTransport *s)
     }
 }
 
+/*
+ * Writes the chunks one by one, stopping at the first short write. Errors
+ * are only reported if nothing could be written, otherwise they surface at
+ * the next write attempt.
+ */
+gssize
+log_transport_writev_emulated(LogTransport *self, struct iovec *iov, gint iov_count)
+{
+  gssize written = 0;
+
+  for (gint i = 0; i < iov_count; i++)
+    {
+      gssize rc = log_transport_write(self, iov[i].iov_base, iov[i].iov_len);
+
+      if (rc < 0)
+        return written > 0 ? written : rc;
+
+      written += rc;
+      if ((gsize) rc != iov[i].iov_len)
+        break;
+    }
+  return written;
+}
+
 void
 log_transport_init_instance(LogTransport *self, gint fd)
 {
   self->fd = fd;
   self->cond = 0;
+  self->writev = NULL;
+  self->has_pending_input = NULL;
   self->free_fn = log_transport_free_method;
 }
 
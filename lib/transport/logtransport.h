@@ -37,7 +37,11 @@ struct _LogTransport
   const gchar *name;
   gssize (*read)(LogTransport *self, gpointer buf, gsize count, LogTransportAuxData *aux);
   gssize (*write)(LogTransport *self, const gpointer buf, gsize count);
+  /* optional, emulated with write() calls if missing, datagram transports
+   * send each chunk as a separate datagram */
   gssize (*writev)(LogTransport *self, struct iovec *iov, gint iov_count);
+  /* optional, TRUE if input was already received from the kernel and can be read without polling the fd */
+  gboolean (*has_pending_input)(LogTransport *self);
   void (*free_fn)(LogTransport *self);
 };
 
@@ -47,9 +51,13 @@ log_transport_write(LogTransport *self, const gpointer buf, gsize count)
   return self->write(self, buf, count);
 }
 
+gssize log_transport_writev_emulated(LogTransport *self, struct iovec *iov, gint iov_count);
+
 static inline gssize
 log_transport_writev(LogTransport *self, struct iovec *iov, gint iov_count)
 {
+  if (!self->writev)
+    return log_transport_writev_emulated(self, iov, iov_count);
   return self->writev(self, iov, iov_count);
 }
 
@@ -59,6 +67,12 @@ log_transport_read(LogTransport *self, gpointer buf, gsize count, LogTransportAu
   return self->read(self, buf, count, aux);
 }
 
+static inline gboolean
+log_transport_has_pending_input(LogTransport *self)
+{
+  return self->has_pending_input && self->has_pending_input(self);
+}
+
 void log_transport_init_instance(LogTransport *s, gint fd);
 void log_transport_free_method(LogTransport *s);
 void log_transport_free(LogTransport *s);
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include <criterion/criterion.h>
+
+#include "transport/transport-socket.h"
+#include "apphook.h"
+#include "fdhelpers.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#if defined(SYSLOG_NG_HAVE_RECVMMSG)
+
+static gint sender_fd;
+static LogTransport *transport;
+
+static void
+_send_datagram(const gchar *data)
+{
+  cr_assert_eq(send(sender_fd, data, strlen(data), 0), strlen(data));
+}
+
+static void
+_assert_next_datagram(const gchar *expected)
+{
+  gchar buf[64];
+  LogTransportAuxData aux;
+
+  log_transport_aux_data_init(&aux);
+  gssize rc = log_transport_read(transport, buf, sizeof(buf), &aux);
+  log_transport_aux_data_destroy(&aux);
+
+  cr_assert_eq(rc, strlen(expected));
+  cr_assert_arr_eq(buf, expected, rc);
+}
+
+static void
+_setup_batched_transport(gint batch_size)
+{
+  gint fds[2];
+
+  cr_assert_eq(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+  g_fd_set_nonblock(fds[1], TRUE);
+  sender_fd = fds[0];
+  transport = log_transport_dgram_socket_new(fds[1]);
+  log_transport_dgram_socket_set_receive_batch((LogTransportSocket *) transport, batch_size, NULL, NULL);
+}
+
+Test(transport_socket, batched_dgram_read_returns_datagrams_in_order)
+{
+  _setup_batched_transport(4);
+
+  _send_datagram("first");
+  _send_datagram("second");
+  _send_datagram("third");
+
+  cr_assert_not(log_transport_has_pending_input(transport));
+  _assert_next_datagram("first");
+  cr_assert(log_transport_has_pending_input(transport));
+  _assert_next_datagram("second");
+  cr_assert(log_transport_has_pending_input(transport));
+  _assert_next_datagram("third");
+  cr_assert_not(log_transport_has_pending_input(transport));
+}
+
+Test(transport_socket, batched_dgram_read_refills_when_the_batch_is_consumed)
+{
+  gchar buf[64];
+
+  _setup_batched_transport(2);
+
+  _send_datagram("first");
+  _send_datagram("second");
+  _send_datagram("third");
+
+  _assert_next_datagram("first");
+  _assert_next_datagram("second");
+  cr_assert_not(log_transport_has_pending_input(transport));
+  _assert_next_datagram("third");
+
+  cr_assert_eq(log_transport_read(transport, buf, sizeof(buf), NULL), -1);
+  cr_assert_eq(errno, EAGAIN);
+}
+
+Test(transport_socket, batch_size_of_one_keeps_single_datagram_reads)
+{
+  _setup_batched_transport(1);
+
+  _send_datagram("first");
+  _send_datagram("second");
+
+  _assert_next_datagram("first");
+  cr_assert_not(log_transport_has_pending_input(transport));
+  _assert_next_datagram("second");
+}
+
+static void
+setup(void)
+{
+  app_startup();
+}
+
+static void
+teardown(void)
+{
+  log_transport_free(transport);
+  close(sender_fd);
+  app_shutdown();
+}
+
+TestSuite(transport_socket, .init = setup, .fini = teardown);
+
+#endif
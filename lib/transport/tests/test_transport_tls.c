@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include <criterion/criterion.h>
+
+#include "transport/transport-tls.h"
+#include "transport/tls-context.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "apphook.h"
+#include "cfg.h"
+#include "fdhelpers.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#define CERT_DIR TOP_SRCDIR "/tests/light/shared_files"
+
+typedef struct
+{
+  TLSContext *client_ctx;
+  TLSContext *server_ctx;
+  LogTransport *client;
+  LogTransport *server;
+  TLSSession *client_session;
+  TLSSession *server_session;
+} TLSConnection;
+
+static TLSConnection conn;
+
+static TLSContext *
+_create_tls_context(TLSMode mode, gboolean ktls)
+{
+  TLSContext *ctx = tls_context_new(mode, "test");
+
+  tls_context_set_verify_mode(ctx, TVM_OPTIONAL | TVM_UNTRUSTED);
+  if (mode == TM_SERVER)
+    {
+      tls_context_set_key_file(ctx, CERT_DIR "/server.key");
+      tls_context_set_cert_file(ctx, CERT_DIR "/server.crt");
+    }
+  cr_assert(tls_context_set_ktls(ctx, ktls, NULL));
+  cr_assert_eq(tls_context_setup_context(ctx), TLS_CONTEXT_SETUP_OK);
+
+  return ctx;
+}
+
+static void
+_tcp_socketpair(gint fds[2])
+{
+  struct sockaddr_in addr = { .sin_family = AF_INET };
+  socklen_t addrlen = sizeof(addr);
+
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  gint listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  cr_assert_geq(listen_fd, 0);
+  cr_assert_eq(bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)), 0);
+  cr_assert_eq(listen(listen_fd, 1), 0);
+  cr_assert_eq(getsockname(listen_fd, (struct sockaddr *) &addr, &addrlen), 0);
+
+  fds[0] = socket(AF_INET, SOCK_STREAM, 0);
+  cr_assert_geq(fds[0], 0);
+  cr_assert_eq(connect(fds[0], (struct sockaddr *) &addr, sizeof(addr)), 0);
+  fds[1] = accept(listen_fd, NULL, NULL);
+  cr_assert_geq(fds[1], 0);
+
+  close(listen_fd);
+}
+
+static gboolean
+_handshake_step(TLSSession *session)
+{
+  gint rc = SSL_do_handshake(session->ssl);
+
+  if (rc == 1)
+    return TRUE;
+
+  gint ssl_error = SSL_get_error(session->ssl, rc);
+  cr_assert(ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE,
+            "TLS handshake failed, ssl_error: %d", ssl_error);
+  return FALSE;
+}
+
+static void
+_connect(gint fds[2], gboolean ktls)
+{
+  conn.client_ctx = _create_tls_context(TM_CLIENT, ktls);
+  conn.server_ctx = _create_tls_context(TM_SERVER, ktls);
+
+  g_fd_set_nonblock(fds[0], TRUE);
+  g_fd_set_nonblock(fds[1], TRUE);
+
+  conn.client_session = tls_context_setup_session(conn.client_ctx);
+  conn.server_session = tls_context_setup_session(conn.server_ctx);
+  conn.client = log_transport_tls_new(conn.client_session, fds[0]);
+  conn.server = log_transport_tls_new(conn.server_session, fds[1]);
+
+  gboolean client_done = FALSE;
+  gboolean server_done = FALSE;
+  for (gint i = 0; i < 1000 && !(client_done && server_done); i++)
+    {
+      if (!client_done)
+        client_done = _handshake_step(conn.client_session);
+      if (!server_done)
+        server_done = _handshake_step(conn.server_session);
+    }
+  cr_assert(client_done && server_done, "TLS handshake did not finish");
+}
+
+static void
+_assert_received(LogTransport *transport, const gchar *expected)
+{
+  gsize expected_len = strlen(expected);
+  gchar buf[256];
+  gsize received = 0;
+
+  cr_assert_lt(expected_len, sizeof(buf));
+  while (received < expected_len)
+    {
+      LogTransportAuxData aux;
+
+      log_transport_aux_data_init(&aux);
+      gssize rc = log_transport_read(transport, buf + received, sizeof(buf) - received, &aux);
+      log_transport_aux_data_destroy(&aux);
+
+      if (rc < 0 && errno == EAGAIN)
+        {
+          struct pollfd pfd = { .fd = transport->fd, .events = POLLIN };
+          cr_assert_eq(poll(&pfd, 1, 5000), 1, "Timed out waiting for data");
+          continue;
+        }
+
+      cr_assert_gt(rc, 0, "Reading from the TLS transport failed, errno: %d", errno);
+      received += rc;
+    }
+
+  cr_assert_eq(received, expected_len);
+  cr_assert_arr_eq(buf, expected, expected_len);
+}
+
+static void
+_assert_transfer_is_intact(void)
+{
+  const gchar *first = "first message\n";
+  cr_assert_eq(log_transport_write(conn.client, (gpointer) first, strlen(first)), strlen(first));
+  _assert_received(conn.server, first);
+
+  /* the second write goes through the direct socket path when TX is offloaded */
+  gchar batch[][16] = { "second message\n", "third message\n" };
+  struct iovec iov[] =
+  {
+    { .iov_base = batch[0], .iov_len = strlen(batch[0]) },
+    { .iov_base = batch[1], .iov_len = strlen(batch[1]) },
+  };
+
+  cr_assert_eq(log_transport_writev(conn.client, iov, G_N_ELEMENTS(iov)), iov[0].iov_len + iov[1].iov_len);
+  _assert_received(conn.server, "second message\nthird message\n");
+}
+
+static gsize
+_get_counter_value(const gchar *name, StatsClusterLabel *labels, gsize labels_len)
+{
+  StatsClusterKey sc_key;
+  gsize value = 0;
+
+  stats_cluster_single_key_set(&sc_key, name, labels, labels_len);
+
+  stats_lock();
+  {
+    StatsCluster *cluster = stats_get_cluster(&sc_key);
+    cr_assert(cluster, "Counter is not registered: %s", name);
+    value = stats_counter_get(stats_cluster_get_counter(cluster, SC_TYPE_SINGLE_VALUE));
+  }
+  stats_unlock();
+
+  return value;
+}
+
+Test(transport_tls, ktls_option_depends_on_openssl_support)
+{
+  TLSContext *ctx = tls_context_new(TM_CLIENT, "test");
+  GError *error = NULL;
+
+  cr_assert(tls_context_set_ktls(ctx, FALSE, &error));
+  cr_assert_null(error);
+  cr_assert_not(ctx->ktls);
+
+#ifdef SSL_OP_ENABLE_KTLS
+  cr_assert(tls_context_set_ktls(ctx, TRUE, &error));
+  cr_assert_null(error);
+  cr_assert(ctx->ktls);
+
+  cr_assert_eq(tls_context_setup_context(ctx), TLS_CONTEXT_SETUP_OK);
+
+  TLSSession *session = tls_context_setup_session(ctx);
+  cr_assert(SSL_get_options(session->ssl) & SSL_OP_ENABLE_KTLS);
+  tls_session_free(session);
+#else
+  cr_assert_not(tls_context_set_ktls(ctx, TRUE, &error));
+  cr_assert(g_error_matches(error, TLSCONTEXT_ERROR, TLSCONTEXT_UNSUPPORTED));
+  cr_assert_not(ctx->ktls);
+  g_clear_error(&error);
+#endif
+
+  tls_context_unref(ctx);
+}
+
+#ifdef SSL_OP_ENABLE_KTLS
+
+Test(transport_tls, ktls_falls_back_to_userspace_when_the_kernel_refuses_tcp_ulp)
+{
+  gint fds[2];
+  StatsClusterLabel tx_labels[] = { stats_cluster_label("direction", "tx") };
+
+  /* TCP_ULP is refused on anything but TCP sockets */
+  cr_assert_eq(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  _connect(fds, TRUE);
+
+  cr_assert(conn.client_session->ktls.checked);
+  cr_assert_not(conn.client_session->ktls.tx);
+  cr_assert_not(conn.client_session->ktls.rx);
+  cr_assert(conn.server_session->ktls.checked);
+  cr_assert_not(conn.server_session->ktls.tx);
+  cr_assert_not(conn.server_session->ktls.rx);
+
+  cr_assert_eq(_get_counter_value("tls_ktls_fallback_connections_total", NULL, 0), 2);
+  cr_assert_eq(_get_counter_value("tls_ktls_offloaded_connections_total", tx_labels, G_N_ELEMENTS(tx_labels)), 0);
+
+  _assert_transfer_is_intact();
+}
+
+Test(transport_tls, loopback_transfer_with_ktls)
+{
+  gint fds[2];
+
+  _tcp_socketpair(fds);
+  _connect(fds, TRUE);
+
+  /* whether the kernel takes over depends on the tls module and the cipher */
+  cr_assert(conn.client_session->ktls.checked);
+  cr_assert(conn.server_session->ktls.checked);
+
+  _assert_transfer_is_intact();
+}
+
+#endif
+
+Test(transport_tls, loopback_transfer_without_ktls)
+{
+  gint fds[2];
+
+  _tcp_socketpair(fds);
+  _connect(fds, FALSE);
+
+  cr_assert_not(conn.client_session->ktls.tx);
+  cr_assert_not(conn.client_session->ktls.rx);
+  cr_assert_not(conn.server_session->ktls.tx);
+  cr_assert_not(conn.server_session->ktls.rx);
+
+  _assert_transfer_is_intact();
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+  configuration->stats_options.level = STATS_LEVEL1;
+  stats_reinit(&configuration->stats_options);
+  app_running();
+}
+
+static void
+teardown(void)
+{
+  if (conn.client)
+    log_transport_free(conn.client);
+  if (conn.server)
+    log_transport_free(conn.server);
+  if (conn.client_ctx)
+    tls_context_unref(conn.client_ctx);
+  if (conn.server_ctx)
+    tls_context_unref(conn.server_ctx);
+
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(transport_tls, .init = setup, .fini = teardown);
@@ -605,6 +605,12 @@ tls_context_setup_session(TLSContext *self)
       g_assert(ocsp_enabled);
     }
 
+#ifdef SSL_OP_ENABLE_KTLS
+  /* libssl falls back to userspace encryption if the kernel or the cipher does not support it */
+  if (self->ktls)
+    SSL_set_options(ssl, SSL_OP_ENABLE_KTLS);
+#endif
+
   TLSSession *session = tls_session_new(ssl, self);
   if (!session)
     {
@@ -849,6 +855,22 @@ tls_context_set_ocsp_stapling_verify(TLSContext *self, gboolean ocsp_stapling_ve
   self->ocsp_stapling_verify = ocsp_stapling_verify;
 }
 
+gboolean
+tls_context_set_ktls(TLSContext *self, gboolean ktls, GError **error)
+{
+#ifdef SSL_OP_ENABLE_KTLS
+  self->ktls = ktls;
+  return TRUE;
+#else
+  if (!ktls)
+    return TRUE;
+
+  g_set_error(error, TLSCONTEXT_ERROR, TLSCONTEXT_UNSUPPORTED,
+              "Kernel TLS offload is not supported with the OpenSSL version syslog-ng was compiled with");
+  return FALSE;
+#endif
+}
+
 /* NOTE: location is a string description where this tls context was defined, e.g. the location in the config */
 TLSContext *
 tls_context_new(TLSMode mode, const gchar *location)
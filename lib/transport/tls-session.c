@@ -23,6 +23,9 @@
 #include "transport/tls-session.h"
 #include "transport/tls-context.h"
 #include "str-utils.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "apphook.h"
 
 #include <glib/gstdio.h>
 #include <openssl/x509_vfy.h>
@@ -34,6 +37,10 @@
 
 /* TLSSession */
 
+static StatsCounterItem *ktls_tx_connections;
+static StatsCounterItem *ktls_rx_connections;
+static StatsCounterItem *ktls_fallback_connections;
+
 void
 tls_session_configure_allow_compress(TLSSession *tls_session, gboolean allow_compress)
 {
@@ -511,10 +518,49 @@ tls_session_set_verifier(TLSSession *self, TLSVerifier *verifier)
   self->verifier = verifier ? tls_verifier_ref(verifier) : NULL;
 }
 
+static void
+tls_session_check_ktls(TLSSession *self)
+{
+  self->ktls.checked = TRUE;
+  if (!self->ctx->ktls)
+    return;
+
+#ifdef SSL_OP_ENABLE_KTLS
+  self->ktls.tx = BIO_get_ktls_send(SSL_get_wbio(self->ssl));
+  self->ktls.rx = BIO_get_ktls_recv(SSL_get_rbio(self->ssl));
+#endif
+
+  if (self->ktls.tx)
+    stats_counter_inc(ktls_tx_connections);
+  if (self->ktls.rx)
+    stats_counter_inc(ktls_rx_connections);
+
+  if (self->ktls.tx || self->ktls.rx)
+    {
+      msg_debug("TLS record layer offloaded to the kernel",
+                evt_tag_int("ktls_tx", self->ktls.tx),
+                evt_tag_int("ktls_rx", self->ktls.rx),
+                evt_tag_str("cipher", SSL_get_cipher_name(self->ssl)),
+                evt_tag_str("version", SSL_get_version(self->ssl)),
+                tls_context_format_location_tag(self->ctx));
+    }
+  else
+    {
+      stats_counter_inc(ktls_fallback_connections);
+      msg_verbose("Kernel TLS offload is not available for this connection, using userspace encryption",
+                  evt_tag_str("cipher", SSL_get_cipher_name(self->ssl)),
+                  evt_tag_str("version", SSL_get_version(self->ssl)),
+                  tls_context_format_location_tag(self->ctx));
+    }
+}
+
 void
 tls_session_info_callback(const SSL *ssl, int where, int ret)
 {
   TLSSession *self = (TLSSession *)SSL_get_app_data(ssl);
+
+  if (!self->ktls.checked && (where & SSL_CB_HANDSHAKE_DONE))
+    tls_session_check_ktls(self);
   if( !self->peer_info.found && where == (SSL_ST_ACCEPT|SSL_CB_LOOP) )
     {
       X509 *cert = SSL_get_peer_certificate(ssl);
@@ -575,6 +621,32 @@ tls_session_new(SSL *ssl, TLSContext *ctx)
   return self;
 }
 
+static void
+_register_ktls_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  StatsClusterLabel tx_labels[] = { stats_cluster_label("direction", "tx") };
+  stats_cluster_single_key_set(&sc_key, "tls_ktls_offloaded_connections_total", tx_labels, G_N_ELEMENTS(tx_labels));
+  stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &ktls_tx_connections);
+
+  StatsClusterLabel rx_labels[] = { stats_cluster_label("direction", "rx") };
+  stats_cluster_single_key_set(&sc_key, "tls_ktls_offloaded_connections_total", rx_labels, G_N_ELEMENTS(rx_labels));
+  stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &ktls_rx_connections);
+
+  stats_cluster_single_key_set(&sc_key, "tls_ktls_fallback_connections_total", NULL, 0);
+  stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &ktls_fallback_connections);
+  stats_unlock();
+}
+
+void
+tls_session_global_init(void)
+{
+  /* the stats subsystem is not operational yet */
+  register_application_hook(AH_RUNNING, (ApplicationHookFunc) _register_ktls_stats, NULL, AHM_RUN_ONCE);
+}
+
 void
 tls_session_free(TLSSession *self)
 {
@@ -42,6 +42,13 @@ typedef struct _TLSSession
     gchar ou[X509_MAX_OU_LEN];
     gchar cn[X509_MAX_CN_LEN];
   } peer_info;
+  /* set once the handshake is done, if the kernel took over the record layer */
+  struct
+  {
+    gboolean checked;
+    gboolean tx;
+    gboolean rx;
+  } ktls;
 } TLSSession;
 
 void tls_session_configure_allow_compress(TLSSession *tls_session, gboolean allow_compress);
@@ -55,4 +62,6 @@ int tls_session_ocsp_client_verify_callback(SSL *ssl, void *user_data);
 TLSSession *tls_session_new(SSL *ssl, TLSContext *ctx);
 void tls_session_free(TLSSession *self);
 
+void tls_session_global_init(void);
+
 #endif
@@ -22,10 +22,12 @@
  */
 
 #include "transport-socket.h"
+#include "messages.h"
 
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 static gint
 _determine_address_family(gint fd)
@@ -198,12 +200,27 @@ log_transport_socket_write_method(LogTransport *s, const gpointer buf, gsize buf
   return rc;
 }
 
+static gssize
+log_transport_socket_writev_method(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  gint rc;
+
+  do
+    {
+      rc = writev(self->super.fd, iov, iov_count);
+    }
+  while (rc == -1 && errno == EINTR);
+  return rc;
+}
+
 static void
 log_transport_socket_init_instance(LogTransportSocket *self, gint fd)
 {
   log_transport_init_instance(&self->super, fd);
   self->super.read = log_transport_socket_read_method;
   self->super.write = log_transport_socket_write_method;
+  self->super.writev = log_transport_socket_writev_method;
   self->address_family = _determine_address_family(fd);
   self->proto = _determine_proto(fd, self->address_family);
   self->parse_cmsg = log_transport_socket_parse_cmsg_method;
@@ -211,10 +228,177 @@ log_transport_socket_init_instance(LogTransportSocket *self, gint fd)
   _setup_fd(self, fd);
 }
 
+#if defined(SYSLOG_NG_HAVE_RECVMMSG)
+
+#define RECEIVE_BATCH_CTLBUF_SIZE 64
+
+/*
+ * Each datagram in the batch has its own slot (of the size of the buffer
+ * the first read was called with), its own peer address and control
+ * buffer, so the aux data can be extracted when the datagram is returned.
+ */
+struct _LogTransportSocketReceiveBatch
+{
+  gint size;
+  gint count;
+  gint next;
+  gsize slot_size;
+  gchar *slots;
+  struct mmsghdr *msgs;
+  struct iovec *iov;
+  struct sockaddr_storage *addrs;
+  gchar (*ctlbufs)[RECEIVE_BATCH_CTLBUF_SIZE];
+  StatsCounterItem *batches;
+  StatsCounterItem *batched_datagrams;
+};
+
+static LogTransportSocketReceiveBatch *
+_receive_batch_new(gint size)
+{
+  LogTransportSocketReceiveBatch *self = g_new0(LogTransportSocketReceiveBatch, 1);
+
+  self->size = size;
+  self->msgs = g_new0(struct mmsghdr, size);
+  self->iov = g_new0(struct iovec, size);
+  self->addrs = g_new0(struct sockaddr_storage, size);
+  self->ctlbufs = g_malloc0(size * RECEIVE_BATCH_CTLBUF_SIZE);
+  return self;
+}
+
+static void
+_receive_batch_free(LogTransportSocketReceiveBatch *self)
+{
+  g_free(self->slots);
+  g_free(self->msgs);
+  g_free(self->iov);
+  g_free(self->addrs);
+  g_free(self->ctlbufs);
+  g_free(self);
+}
+
+static void
+_receive_batch_setup_slots(LogTransportSocketReceiveBatch *self, gsize slot_size)
+{
+  if (self->slot_size != slot_size)
+    {
+      g_free(self->slots);
+      self->slots = g_malloc(self->size * slot_size);
+      self->slot_size = slot_size;
+    }
+
+  /* the kernel updates the lengths, so these have to be reset before each call */
+  for (gint i = 0; i < self->size; i++)
+    {
+      struct msghdr *msg = &self->msgs[i].msg_hdr;
+
+      self->iov[i].iov_base = self->slots + i * slot_size;
+      self->iov[i].iov_len = slot_size;
+
+      msg->msg_name = &self->addrs[i];
+      msg->msg_namelen = sizeof(self->addrs[i]);
+      msg->msg_iov = &self->iov[i];
+      msg->msg_iovlen = 1;
+#if defined(SYSLOG_NG_HAVE_CTRLBUF_IN_MSGHDR)
+      msg->msg_control = self->ctlbufs[i];
+      msg->msg_controllen = RECEIVE_BATCH_CTLBUF_SIZE;
+#endif
+      msg->msg_flags = 0;
+    }
+}
+
+static gint
+_receive_batch_fill(LogTransportSocket *self, gsize slot_size)
+{
+  LogTransportSocketReceiveBatch *batch = self->receive_batch;
+  gint rc;
+
+  _receive_batch_setup_slots(batch, slot_size);
+  do
+    {
+      rc = recvmmsg(self->super.fd, batch->msgs, batch->size, 0, NULL);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  if (rc <= 0)
+    return rc;
+
+  batch->count = rc;
+  batch->next = 0;
+  stats_counter_inc(batch->batches);
+  stats_counter_add(batch->batched_datagrams, rc);
+  return rc;
+}
+
+static gssize
+_read_from_receive_batch(LogTransportSocket *self, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  LogTransportSocketReceiveBatch *batch = self->receive_batch;
+
+  if (batch->next == batch->count)
+    {
+      gint rc = _receive_batch_fill(self, buflen);
+      if (rc <= 0)
+        return rc;
+    }
+
+  struct mmsghdr *datagram = &batch->msgs[batch->next++];
+  gsize len = MIN(datagram->msg_len, buflen);
+
+  memcpy(buf, datagram->msg_hdr.msg_iov->iov_base, len);
+  if (len > 0)
+    _extract_from_msghdr_method(self, &datagram->msg_hdr, aux);
+  return len;
+}
+
+static gboolean
+log_transport_dgram_socket_has_pending_input(LogTransport *s)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+
+  return self->receive_batch && self->receive_batch->next < self->receive_batch->count;
+}
+
+void
+log_transport_dgram_socket_set_receive_batch(LogTransportSocket *self, gint batch_size,
+                                             StatsCounterItem *batches, StatsCounterItem *batched_datagrams)
+{
+  g_assert(!self->receive_batch);
+
+  if (batch_size < 2)
+    return;
+
+  self->receive_batch = _receive_batch_new(batch_size);
+  self->receive_batch->batches = batches;
+  self->receive_batch->batched_datagrams = batched_datagrams;
+  self->super.has_pending_input = log_transport_dgram_socket_has_pending_input;
+}
+
+#else
+
+void
+log_transport_dgram_socket_set_receive_batch(LogTransportSocket *self, gint batch_size,
+                                             StatsCounterItem *batches, StatsCounterItem *batched_datagrams)
+{
+  if (batch_size > 1)
+    msg_warning("WARNING: recvmmsg() is not available on this platform, receive-batch-size() is ignored",
+                evt_tag_int("receive_batch_size", batch_size));
+}
+
+#endif
+
 static gssize
 log_transport_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 {
-  gssize rc = log_transport_socket_read_method(s, buf, buflen, aux);
+  gssize rc;
+
+#if defined(SYSLOG_NG_HAVE_RECVMMSG)
+  LogTransportSocket *self = (LogTransportSocket *) s;
+
+  if (self->receive_batch)
+    rc = _read_from_receive_batch(self, buf, buflen, aux);
+  else
+#endif
+    rc = log_transport_socket_read_method(s, buf, buflen, aux);
   if (rc == 0)
     {
       /* DGRAM sockets should never return EOF, they just need to be read again */
@@ -245,12 +429,65 @@ log_transport_dgram_socket_write_method(LogTransport *s, const gpointer buf, gsi
   return rc;
 }
 
+#define DGRAM_SEND_BATCH_MAX 64
+
+/* each chunk is sent as a separate datagram, returns the length of the datagrams sent */
+static gssize
+log_transport_dgram_socket_writev_method(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+#if defined(SYSLOG_NG_HAVE_SENDMMSG)
+  struct mmsghdr msgs[DGRAM_SEND_BATCH_MAX];
+  gint rc;
+
+  /* sending less than requested is a short write, the caller retries the rest */
+  iov_count = MIN(iov_count, DGRAM_SEND_BATCH_MAX);
+  memset(msgs, 0, iov_count * sizeof(msgs[0]));
+  for (gint i = 0; i < iov_count; i++)
+    {
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+  do
+    {
+      rc = sendmmsg(s->fd, msgs, iov_count, 0);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  /* see the ENOBUFS note in log_transport_dgram_socket_write_method(),
+   * sendmmsg() only fails if the first datagram could not be sent */
+  if (rc < 0)
+    return errno == ENOBUFS ? iov[0].iov_len : rc;
+
+  gssize sent = 0;
+  for (gint i = 0; i < rc; i++)
+    sent += iov[i].iov_len;
+  return sent;
+#else
+  return log_transport_writev_emulated(s, iov, iov_count);
+#endif
+}
+
+void
+log_transport_dgram_socket_free_method(LogTransport *s)
+{
+#if defined(SYSLOG_NG_HAVE_RECVMMSG)
+  LogTransportSocket *self = (LogTransportSocket *) s;
+
+  if (self->receive_batch)
+    _receive_batch_free(self->receive_batch);
+#endif
+  log_transport_free_method(s);
+}
+
 void
 log_transport_dgram_socket_init_instance(LogTransportSocket *self, gint fd)
 {
   log_transport_socket_init_instance(self, fd);
   self->super.read = log_transport_dgram_socket_read_method;
   self->super.write = log_transport_dgram_socket_write_method;
+  self->super.writev = log_transport_dgram_socket_writev_method;
+  self->super.free_fn = log_transport_dgram_socket_free_method;
 }
 
 LogTransport *
@@ -26,21 +26,38 @@
 #define TRANSPORT_TRANSPORT_SOCKET_H_INCLUDED 1
 
 #include "logtransport.h"
+#include "stats/stats-counter.h"
 
 typedef struct _LogTransportSocket LogTransportSocket;
+typedef struct _LogTransportSocketReceiveBatch LogTransportSocketReceiveBatch;
+
 struct _LogTransportSocket
 {
   LogTransport super;
   gint address_family;
   gint proto;
+  LogTransportSocketReceiveBatch *receive_batch;
   void (*parse_cmsg)(LogTransportSocket *self, struct cmsghdr *cmsg, LogTransportAuxData *aux);
 };
 
 void log_transport_socket_parse_cmsg_method(LogTransportSocket *s, struct cmsghdr *cmsg, LogTransportAuxData *aux);
 
 void log_transport_dgram_socket_init_instance(LogTransportSocket *self, gint fd);
+void log_transport_dgram_socket_free_method(LogTransport *s);
 LogTransport *log_transport_dgram_socket_new(gint fd);
 
+/*
+ * Receive up to batch_size datagrams with a single recvmmsg() call, the
+ * datagrams (and their aux data) are then returned one by one by
+ * subsequent reads. log_transport_has_pending_input() returns TRUE as long
+ * as the batch is not fully consumed. The counters are optional.
+ *
+ * Does nothing if batch_size is less than 2 or recvmmsg() is not
+ * available.
+ */
+void log_transport_dgram_socket_set_receive_batch(LogTransportSocket *self, gint batch_size,
+                                                  StatsCounterItem *batches, StatsCounterItem *batched_datagrams);
+
 void log_transport_stream_socket_init_instance(LogTransportSocket *self, gint fd);
 void log_transport_stream_socket_free_method(LogTransport *s);
 LogTransport *log_transport_stream_socket_new(gint fd);
@@ -29,14 +29,55 @@
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include <errno.h>
+#include <sys/uio.h>
 
 typedef struct _LogTransportTLS
 {
   LogTransportSocket super;
   TLSSession *tls_session;
   gboolean sending_shutdown;
+  /* libssl has no write to be retried, see _can_write_plain() */
+  gboolean ssl_write_completed;
 } LogTransportTLS;
 
+/*
+ * With kTLS TX, the kernel encrypts whatever is written to the socket, so
+ * once the handshake is over and libssl has no unfinished write, data can
+ * be written to the socket directly. libssl is still used when it has
+ * something to send on its own (key update, renegotiation).
+ */
+static inline gboolean
+_can_write_plain(LogTransportTLS *self)
+{
+#ifdef SSL_OP_ENABLE_KTLS
+  SSL *ssl = self->tls_session->ssl;
+
+  if (!self->tls_session->ktls.tx || !self->ssl_write_completed)
+    return FALSE;
+
+  return SSL_get_key_update_type(ssl) == SSL_KEY_UPDATE_NONE && !SSL_renegotiate_pending(ssl);
+#else
+  return FALSE;
+#endif
+}
+
+static gssize
+_write_plain(LogTransportTLS *self, struct iovec *iov, gint iov_count)
+{
+  gssize rc;
+
+  self->super.super.cond = G_IO_OUT;
+  do
+    {
+      rc = writev(self->super.super.fd, iov, iov_count);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  if (rc >= 0)
+    self->super.super.cond = 0;
+  return rc;
+}
+
 static inline gboolean
 _is_shutdown_sent(gint shutdown_rc)
 {
@@ -171,12 +212,19 @@ log_transport_tls_write_method(LogTransport *s, const gpointer buf, gsize buflen
   gint ssl_error;
   gint rc;
 
+  if (_can_write_plain(self))
+    {
+      struct iovec iov = { .iov_base = buf, .iov_len = buflen };
+      return _write_plain(self, &iov, 1);
+    }
+
   /* assume that we need to poll our output for writing unless
    * SSL_ERROR_WANT_READ is specified by libssl */
 
   self->super.super.cond = G_IO_OUT;
 
   rc = SSL_write(self->tls_session->ssl, buf, buflen);
+  self->ssl_write_completed = (rc > 0);
 
   if (rc < 0)
     {
@@ -227,6 +275,17 @@ tls_error:
   return -1;
 }
 
+static gssize
+log_transport_tls_writev_method(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+  LogTransportTLS *self = (LogTransportTLS *) s;
+
+  if (_can_write_plain(self))
+    return _write_plain(self, iov, iov_count);
+
+  return log_transport_writev_emulated(s, iov, iov_count);
+}
+
 
 static void log_transport_tls_free_method(LogTransport *s);
 
@@ -239,6 +298,7 @@ log_transport_tls_new(TLSSession *tls_session, gint fd)
   self->super.super.cond = 0;
   self->super.super.read = log_transport_tls_read_method;
   self->super.super.write = log_transport_tls_write_method;
+  self->super.super.writev = log_transport_tls_writev_method;
   self->super.super.free_fn = log_transport_tls_free_method;
   self->tls_session = tls_session;
 
@@ -28,6 +28,8 @@
 #include "syslog-ng.h"
 #include "atomic.h"
 
+#define VP_PLAN_CACHE_MAX_SIZE 256
+
 struct _ValuePairs
 {
   GAtomicCounter ref_cnt;
@@ -47,6 +49,10 @@ struct _ValuePairs
    * strings to avoid leaking type information to callers */
   gboolean cast_to_strings;
   gboolean explicit_cast_to_strings;
+
+  /* selection plans cached by message shape, see value_pairs_foreach_sorted() */
+  GRWLock plan_cache_lock;
+  GHashTable *plan_cache;
 };
 
 
@@ -26,6 +26,7 @@
 #include <criterion/parameterized.h>
 
 #include "value-pairs/value-pairs.h"
+#include "value-pairs/internals.h"
 #include "logmsg/logmsg.h"
 #include "apphook.h"
 #include "cfg.h"
@@ -510,6 +511,147 @@ Test(value_pairs, test_include_bytes_v3)
   value_pairs_unref(vp);
 }
 
+static gboolean
+vp_pairs_foreach_format(const gchar *name, LogMessageValueType type, const gchar *value,
+                        gsize value_len, gpointer user_data)
+{
+  GString *res = (GString *) user_data;
+
+  if (res->len > 0)
+    g_string_append_c(res, ',');
+  g_string_append_printf(res, "%s=%.*s", name, (gint) value_len, value);
+  return FALSE;
+}
+
+static void
+assert_formatted_pairs(ValuePairs *vp, LogMessage *msg, const gchar *expected)
+{
+  LogTemplateEvalOptions options = {&template_options, LTZ_LOCAL, 11, NULL, LM_VT_STRING};
+  GString *res = g_string_new("");
+
+  value_pairs_foreach(vp, vp_pairs_foreach_format, msg, &options, res);
+  cr_assert_str_eq(res->str, expected);
+  g_string_free(res, TRUE);
+}
+
+static LogMessage *
+create_message_with_pairs(const gchar *pairs)
+{
+  LogMessage *msg = log_msg_new_empty();
+  gchar **kvs = g_strsplit(pairs, ",", -1);
+
+  for (gint i = 0; kvs[i]; i++)
+    {
+      gchar **kv = g_strsplit(kvs[i], "=", 2);
+
+      log_msg_set_value_by_name(msg, kv[0], kv[1], -1);
+      g_strfreev(kv);
+    }
+  g_strfreev(kvs);
+  return msg;
+}
+
+Test(value_pairs, test_messages_with_the_same_shape_get_their_own_values)
+{
+  ValuePairs *vp = value_pairs_new(configuration);
+  LogMessage *msg;
+
+  value_pairs_add_scope(vp, "nv-pairs");
+
+  msg = create_message_with_pairs("foo=1,bar=2,baz=3");
+  assert_formatted_pairs(vp, msg, "bar=2,baz=3,foo=1");
+  log_msg_unref(msg);
+
+  msg = create_message_with_pairs("foo=a,bar=b,baz=c");
+  assert_formatted_pairs(vp, msg, "bar=b,baz=c,foo=a");
+  log_msg_unref(msg);
+
+  msg = create_message_with_pairs("foo=x,bar=y");
+  assert_formatted_pairs(vp, msg, "bar=y,foo=x");
+  log_msg_unref(msg);
+
+  msg = create_message_with_pairs("foo=x,bar=,qux=z");
+  assert_formatted_pairs(vp, msg, "bar=,foo=x,qux=z");
+  log_msg_unref(msg);
+
+  value_pairs_unref(vp);
+}
+
+Test(value_pairs, test_explicit_pairs_override_message_values_unless_empty)
+{
+  ValuePairs *vp = value_pairs_new(configuration);
+  LogTemplate *template;
+  LogMessage *msg;
+
+  value_pairs_add_scope(vp, "nv-pairs");
+  template = create_template("string", "$override");
+  value_pairs_add_pair(vp, "foo", template);
+  log_template_unref(template);
+
+  msg = create_message_with_pairs("foo=1,bar=2,override=3");
+  assert_formatted_pairs(vp, msg, "bar=2,foo=3,override=3");
+  log_msg_unref(msg);
+
+  /* same shape, but the template expands to an empty string */
+  msg = create_message_with_pairs("foo=1,bar=2,override=");
+  assert_formatted_pairs(vp, msg, "bar=2,foo=,override=");
+
+  vp->omit_empty_values = TRUE;
+  assert_formatted_pairs(vp, msg, "bar=2,foo=1");
+  log_msg_unref(msg);
+
+  value_pairs_unref(vp);
+}
+
+Test(value_pairs, test_changing_the_configuration_drops_cached_selections)
+{
+  ValuePairs *vp = value_pairs_new(configuration);
+  LogMessage *msg = create_message_with_pairs("foo=1,bar=2,baz=3");
+  ValuePairsTransformSet *vpts = value_pairs_transform_set_new("b*");
+
+  value_pairs_add_scope(vp, "nv-pairs");
+  assert_formatted_pairs(vp, msg, "bar=2,baz=3,foo=1");
+
+  value_pairs_add_glob_pattern(vp, "baz", FALSE);
+  assert_formatted_pairs(vp, msg, "bar=2,foo=1");
+
+  value_pairs_transform_set_add_func(vpts, value_pairs_new_transform_add_prefix("x."));
+  value_pairs_add_transforms(vp, vpts);
+  assert_formatted_pairs(vp, msg, "foo=1,x.bar=2");
+
+  log_msg_unref(msg);
+  value_pairs_unref(vp);
+}
+
+Test(value_pairs, test_plan_cache_evicts_unused_shapes_once_full)
+{
+  ValuePairs *vp = value_pairs_new(configuration);
+  LogMessage *hot_msg = create_message_with_pairs("hot=1");
+
+  value_pairs_add_scope(vp, "nv-pairs");
+
+  for (gint i = 0; i < 3 * VP_PLAN_CACHE_MAX_SIZE; i++)
+    {
+      gchar *pairs = g_strdup_printf("shape.%d=%d", i, i);
+      LogMessage *msg = create_message_with_pairs(pairs);
+
+      assert_formatted_pairs(vp, msg, pairs);
+      assert_formatted_pairs(vp, hot_msg, "hot=1");
+      cr_assert_leq(g_hash_table_size(vp->plan_cache), VP_PLAN_CACHE_MAX_SIZE);
+
+      log_msg_unref(msg);
+      g_free(pairs);
+    }
+
+  /* a shape that is seen again after its plan was evicted gets a new one */
+  LogMessage *msg = create_message_with_pairs("shape.0=again");
+  assert_formatted_pairs(vp, msg, "shape.0=again");
+  log_msg_unref(msg);
+
+  log_msg_unref(hot_msg);
+  value_pairs_unref(vp);
+}
+
 void
 setup(void)
 {
@@ -47,24 +47,6 @@ typedef struct
   LogTemplate *template;
 } VPPairConf;
 
-typedef struct
-{
-  /* we don't own any of the fields here, it is assumed that allocations are
-   * managed by the caller */
-
-  GString *name;
-  GString *value;
-  LogMessageValueType type_hint;
-} VPResultValue;
-
-typedef struct
-{
-  GTree *result_tree;
-
-  /* array of VPResultValue instances */
-  GArray *values;
-} VPResults;
-
 
 typedef enum
 {
@@ -180,42 +162,6 @@ vp_pair_conf_free(VPPairConf *vpc)
   g_free(vpc);
 }
 
-static void
-vp_result_value_init(VPResultValue *rv, GString *name, LogMessageValueType type_hint, GString *value)
-{
-  rv->type_hint = type_hint;
-  rv->name = name;
-  rv->value = value;
-}
-
-static void
-vp_results_init(VPResults *results, GCompareFunc compare_func)
-{
-  results->values = g_array_sized_new(FALSE, FALSE, sizeof(VPResultValue), 16);
-  results->result_tree = g_tree_new_full((GCompareDataFunc) compare_func, NULL,
-                                         NULL, NULL);
-}
-
-static void
-vp_results_deinit(VPResults *results)
-{
-  g_tree_destroy(results->result_tree);
-  g_array_free(results->values, TRUE);
-}
-
-static void
-vp_results_insert(VPResults *results, GString *name, LogMessageValueType type_hint, GString *value)
-{
-  VPResultValue *rv;
-  gint ndx = results->values->len;
-
-  g_array_set_size(results->values, ndx + 1);
-  rv = &g_array_index(results->values, VPResultValue, ndx);
-  vp_result_value_init(rv, name, type_hint, value);
-  /* GTree takes over ownership of name */
-  g_tree_insert(results->result_tree, name->str, GINT_TO_POINTER(ndx));
-}
-
 static GString *
 vp_transform_apply (ValuePairs *vp, const gchar *key)
 {
@@ -237,73 +183,6 @@ vp_transform_apply (ValuePairs *vp, const gchar *key)
   return result;
 }
 
-/* runs over the name-value pairs requested by the user (e.g. with value_pairs_add_pair) */
-static void
-vp_pairs_foreach(gpointer data, gpointer user_data)
-{
-  ValuePairs *vp = ((gpointer *)user_data)[0];
-  LogMessage *msg = ((gpointer *)user_data)[2];
-  LogTemplateEvalOptions *options = ((gpointer *)user_data)[3];
-  VPResults *results = ((gpointer *)user_data)[5];
-  GString *sb = scratch_buffers_alloc();
-  VPPairConf *vpc = (VPPairConf *)data;
-  LogMessageValueType type;
-
-  log_template_append_format_value_and_type((LogTemplate *)vpc->template, msg, options, sb, &type);
-
-  if (vp->omit_empty_values && sb->len == 0)
-    return;
-  if (!vp->include_bytes && (type == LM_VT_BYTES || type == LM_VT_PROTOBUF))
-    return;
-  if (vp->cast_to_strings && vpc->template->explicit_type_hint == LM_VT_NONE)
-    type = LM_VT_STRING;
-  vp_results_insert(results, vp_transform_apply(vp, vpc->name), type, sb);
-}
-
-/* runs over the LogMessage nv-pairs, and inserts them unless excluded */
-static gboolean
-vp_msg_nvpairs_foreach(NVHandle handle, const gchar *name,
-                       const gchar *value, gssize value_len,
-                       LogMessageValueType type, gpointer user_data)
-{
-  ValuePairs *vp = ((gpointer *)user_data)[0];
-  VPResults *results = ((gpointer *)user_data)[5];
-  guint j;
-  gboolean inc;
-  GString *sb;
-
-  if (vp->omit_empty_values && value_len == 0)
-    return FALSE;
-
-  if ((type == LM_VT_BYTES || type == LM_VT_PROTOBUF) && !vp->include_bytes)
-    return FALSE;
-
-  inc = (name[0] == '.' && (vp->scopes & VPS_DOT_NV_PAIRS)) ||
-        (name[0] != '.' && (vp->scopes & VPS_NV_PAIRS)) ||
-        (log_msg_is_handle_sdata(handle) && (vp->scopes & (VPS_SDATA + VPS_RFC5424)));
-
-  for (j = 0; j < vp->patterns->len; j++)
-    {
-      VPPatternSpec *vps = (VPPatternSpec *) g_ptr_array_index(vp->patterns, j);
-      if (vp_pattern_spec_eval(vps, name))
-        inc = vps->include;
-    }
-
-  if (!inc)
-    return FALSE;
-
-  sb = scratch_buffers_alloc();
-
-  g_string_append_len(sb, value, value_len);
-
-  if (vp->cast_to_strings)
-    type = LM_VT_STRING;
-
-  vp_results_insert(results, vp_transform_apply(vp, name), type, sb);
-
-  return FALSE;
-}
-
 static gboolean
 vp_find_in_set(ValuePairs *vp, const gchar *name, gboolean exclude)
 {
@@ -353,6 +232,10 @@ vp_merge_set(ValuePairs *vp, ValuePairSpec *set)
 static void
 vp_update_builtin_list_of_values(ValuePairs *vp)
 {
+  /* the selection plans depend on the configuration */
+  g_rw_lock_writer_lock(&vp->plan_cache_lock);
+  g_hash_table_remove_all(vp->plan_cache);
+  g_rw_lock_writer_unlock(&vp->plan_cache_lock);
   g_ptr_array_set_size(vp->builtins, 0);
 
   if (vp->patterns->len > 0)
@@ -371,75 +254,447 @@ vp_update_builtin_list_of_values(ValuePairs *vp)
     vp_merge_set(vp, all_macros);
 }
 
+/*
+ * Selection plans
+ *
+ * Which values are selected, under what name and in what order only
+ * depends on the configuration and on the set of name-value pairs present
+ * in the message (its shape), not on the values themselves.  A plan records
+ * this for a shape: the transformed names in the order of the compare
+ * function, each with the sources that may provide its value.  Plans are
+ * cached by shape, so for a message with a known shape only the values
+ * need to be fetched.
+ *
+ * Whether a value is empty or of a bytes type can change from message to
+ * message, so those checks are done when the values are fetched.
+ *
+ * Lookups only take the cache lock for reading, and plans are reference
+ * counted, so a plan can be used after the lock is released even if it gets
+ * evicted in the meantime.  Once the cache is full, inserting a new shape
+ * evicts the plans that have not been used since the previous eviction.
+ */
+
+enum
+{
+  VP_SOURCE_NVPAIR,
+  VP_SOURCE_BUILTIN,
+  VP_SOURCE_PAIR,
+};
+
+typedef struct
+{
+  gint type;
+  union
+  {
+    /* index of the name-value pair in the message shape */
+    gint nvpair_index;
+    ValuePairSpec *builtin;
+    VPPairConf *pair;
+  };
+} VPSource;
+
+typedef struct
+{
+  gchar *name;
+
+  /* if the same name is selected more than once, the last source with a
+   * value wins */
+  gint first_source;
+  gint num_sources;
+} VPPlanEntry;
+
+typedef struct
+{
+  GCompareFunc compare_func;
+  const NVHandle *handles;
+  gint num_handles;
+  guint hash;
+} VPShapeKey;
+
+typedef struct
+{
+  GAtomicCounter ref_cnt;
+  /* set when the plan is used, cleared by vp_plan_cache_evict() */
+  gint used;
+
+  VPShapeKey key;
+  NVHandle *handles;
+
+  VPPlanEntry *entries;
+  gint num_entries;
+  VPSource *sources;
+} VPSelectionPlan;
+
+typedef struct
+{
+  const gchar *value;
+  gssize value_len;
+  LogMessageValueType type;
+} VPMsgValue;
+
+typedef struct
+{
+  /* in the order of log_msg_values_foreach() */
+  GArray *handles;
+  GArray *values;
+} VPMsgShape;
+
+static gboolean
+vp_msg_shape_add_value(NVHandle handle, const gchar *name,
+                       const gchar *value, gssize value_len,
+                       LogMessageValueType type, gpointer user_data)
+{
+  VPMsgShape *shape = (VPMsgShape *) user_data;
+  VPMsgValue mv = { value, value_len, type };
+
+  g_array_append_val(shape->handles, handle);
+  g_array_append_val(shape->values, mv);
+  return FALSE;
+}
+
+static void
+vp_msg_shape_init(VPMsgShape *shape, ValuePairs *vp, LogMessage *msg)
+{
+  shape->handles = g_array_sized_new(FALSE, FALSE, sizeof(NVHandle), 32);
+  shape->values = g_array_sized_new(FALSE, FALSE, sizeof(VPMsgValue), 32);
+
+  if (vp->scopes & (VPS_NV_PAIRS + VPS_DOT_NV_PAIRS + VPS_SDATA + VPS_RFC5424) ||
+      vp->patterns->len > 0)
+    log_msg_values_foreach(msg, vp_msg_shape_add_value, shape);
+}
+
+static void
+vp_msg_shape_deinit(VPMsgShape *shape)
+{
+  g_array_free(shape->handles, TRUE);
+  g_array_free(shape->values, TRUE);
+}
+
+static void
+vp_shape_key_init(VPShapeKey *key, GCompareFunc compare_func, VPMsgShape *shape)
+{
+  key->compare_func = compare_func;
+  key->handles = (const NVHandle *) shape->handles->data;
+  key->num_handles = shape->handles->len;
+
+  key->hash = g_direct_hash(compare_func);
+  for (gint i = 0; i < key->num_handles; i++)
+    key->hash = key->hash * 31 + key->handles[i];
+}
+
+static guint
+vp_shape_key_hash(gconstpointer k)
+{
+  return ((const VPShapeKey *) k)->hash;
+}
+
+static gboolean
+vp_shape_key_equal(gconstpointer a, gconstpointer b)
+{
+  const VPShapeKey *key_a = (const VPShapeKey *) a;
+  const VPShapeKey *key_b = (const VPShapeKey *) b;
+
+  return key_a->hash == key_b->hash &&
+         key_a->compare_func == key_b->compare_func &&
+         key_a->num_handles == key_b->num_handles &&
+         memcmp(key_a->handles, key_b->handles, key_a->num_handles * sizeof(NVHandle)) == 0;
+}
+
+/* decides whether a name-value pair of the message is selected, based on its name only */
+static gboolean
+vp_is_nvpair_selected(ValuePairs *vp, NVHandle handle, const gchar *name)
+{
+  guint j;
+  gboolean inc;
+
+  inc = (name[0] == '.' && (vp->scopes & VPS_DOT_NV_PAIRS)) ||
+        (name[0] != '.' && (vp->scopes & VPS_NV_PAIRS)) ||
+        (log_msg_is_handle_sdata(handle) && (vp->scopes & (VPS_SDATA + VPS_RFC5424)));
+
+  for (j = 0; j < vp->patterns->len; j++)
+    {
+      VPPatternSpec *vps = (VPPatternSpec *) g_ptr_array_index(vp->patterns, j);
+      if (vp_pattern_spec_eval(vps, name))
+        inc = vps->include;
+    }
+
+  return inc;
+}
+
+static void
+vp_free_source_array(gpointer sources)
+{
+  g_array_free((GArray *) sources, TRUE);
+}
+
 static void
-vp_merge_builtins(ValuePairs *vp, VPResults *results, LogMessage *msg, LogTemplateEvalOptions *options)
+vp_plan_select(GTree *selected, GString *name, VPSource *source)
 {
+  GArray *sources = g_tree_lookup(selected, name->str);
+
+  if (!sources)
+    {
+      sources = g_array_new(FALSE, FALSE, sizeof(VPSource));
+      g_tree_insert(selected, g_strdup(name->str), sources);
+    }
+  g_array_append_vals(sources, source, 1);
+}
+
+static gboolean
+vp_plan_add_entry(gchar *name, GArray *sources, gpointer user_data)
+{
+  VPSelectionPlan *plan = ((gpointer *) user_data)[0];
+  GArray *plan_sources = ((gpointer *) user_data)[1];
+  VPPlanEntry *entry = &plan->entries[plan->num_entries++];
+
+  entry->name = g_strdup(name);
+  entry->first_source = plan_sources->len;
+  entry->num_sources = sources->len;
+  g_array_append_vals(plan_sources, sources->data, sources->len);
+  return FALSE;
+}
+
+static VPSelectionPlan *
+vp_selection_plan_new(ValuePairs *vp, VPShapeKey *key)
+{
+  VPSelectionPlan *plan = g_new0(VPSelectionPlan, 1);
+  GTree *selected = g_tree_new_full((GCompareDataFunc) key->compare_func, NULL, g_free, vp_free_source_array);
+  GArray *plan_sources = g_array_new(FALSE, FALSE, sizeof(VPSource));
+  gpointer args[] = { plan, plan_sources };
+  ScratchBuffersMarker mark;
+  VPSource source;
   gint i;
-  GString *sb;
+
+  g_atomic_counter_set(&plan->ref_cnt, 1);
+  plan->key = *key;
+  plan->handles = g_memdup(key->handles, key->num_handles * sizeof(NVHandle));
+  plan->key.handles = plan->handles;
+
+  scratch_buffers_mark(&mark);
+
+  /* the same order as values were merged into the result set originally:
+   * nv-pairs, builtins and explicit key-value pairs */
+  for (i = 0; i < key->num_handles; i++)
+    {
+      const gchar *name = log_msg_get_value_name(key->handles[i], NULL);
+
+      if (!vp_is_nvpair_selected(vp, key->handles[i], name))
+        continue;
+
+      source.type = VP_SOURCE_NVPAIR;
+      source.nvpair_index = i;
+      vp_plan_select(selected, vp_transform_apply(vp, name), &source);
+    }
 
   for (i = 0; i < vp->builtins->len; i++)
     {
-      ValuePairSpec *spec = (ValuePairSpec *) g_ptr_array_index(vp->builtins, i);
-      LogMessageValueType type;
+      source.type = VP_SOURCE_BUILTIN;
+      source.builtin = (ValuePairSpec *) g_ptr_array_index(vp->builtins, i);
+      vp_plan_select(selected, vp_transform_apply(vp, source.builtin->name), &source);
+    }
 
-      sb = scratch_buffers_alloc();
+  for (i = 0; i < vp->vpairs->len; i++)
+    {
+      source.type = VP_SOURCE_PAIR;
+      source.pair = (VPPairConf *) g_ptr_array_index(vp->vpairs, i);
+      vp_plan_select(selected, vp_transform_apply(vp, source.pair->name), &source);
+    }
 
-      switch (spec->type)
-        {
-        case VPT_MACRO:
-          log_macro_expand(spec->id, FALSE, options, msg, sb, &type);
-          break;
-        case VPT_NVPAIR:
-        {
-          const gchar *nv;
-          gssize len;
+  plan->entries = g_new(VPPlanEntry, g_tree_nnodes(selected));
+  g_tree_foreach(selected, (GTraverseFunc) vp_plan_add_entry, args);
+  plan->sources = (VPSource *) g_array_free(plan_sources, FALSE);
 
-          nv = log_msg_get_value_with_type(msg, (NVHandle) spec->id, &len, &type);
-          g_string_append_len(sb, nv, len);
-          break;
-        }
-        default:
-          g_assert_not_reached();
-        }
+  g_tree_destroy(selected);
+  scratch_buffers_reclaim_marked(mark);
+  return plan;
+}
 
-      if (sb->len == 0)
-        {
-          continue;
-        }
+static void
+vp_selection_plan_free(VPSelectionPlan *plan)
+{
+  for (gint i = 0; i < plan->num_entries; i++)
+    g_free(plan->entries[i].name);
+  g_free(plan->entries);
+  g_free(plan->sources);
+  g_free(plan->handles);
+  g_free(plan);
+}
+
+static VPSelectionPlan *
+vp_selection_plan_ref(VPSelectionPlan *plan)
+{
+  g_atomic_counter_inc(&plan->ref_cnt);
+  g_atomic_int_set(&plan->used, TRUE);
+  return plan;
+}
+
+static void
+vp_selection_plan_unref(VPSelectionPlan *plan)
+{
+  if (g_atomic_counter_dec_and_test(&plan->ref_cnt))
+    vp_selection_plan_free(plan);
+}
+
+static gboolean
+vp_plan_cache_evict_unused(gpointer key, VPSelectionPlan *plan, gpointer user_data)
+{
+  if (!g_atomic_int_get(&plan->used))
+    return TRUE;
+
+  g_atomic_int_set(&plan->used, FALSE);
+  return FALSE;
+}
+
+/* must be called with the cache lock held for writing */
+static void
+vp_plan_cache_evict(ValuePairs *vp)
+{
+  GHashTableIter iter;
+
+  g_hash_table_foreach_remove(vp->plan_cache, (GHRFunc) vp_plan_cache_evict_unused, NULL);
+  if (g_hash_table_size(vp->plan_cache) < VP_PLAN_CACHE_MAX_SIZE)
+    return;
+
+  /* every plan was used since the last eviction, make room for one */
+  g_hash_table_iter_init(&iter, vp->plan_cache);
+  g_hash_table_iter_next(&iter, NULL, NULL);
+  g_hash_table_iter_remove(&iter);
+}
+
+/* returns a referenced plan, to be released with vp_selection_plan_unref() */
+static VPSelectionPlan *
+vp_get_selection_plan(ValuePairs *vp, VPShapeKey *key)
+{
+  VPSelectionPlan *plan, *existing_plan;
+
+  g_rw_lock_reader_lock(&vp->plan_cache_lock);
+  plan = g_hash_table_lookup(vp->plan_cache, key);
+  if (plan)
+    vp_selection_plan_ref(plan);
+  g_rw_lock_reader_unlock(&vp->plan_cache_lock);
+
+  if (plan)
+    return plan;
 
-      if (vp->cast_to_strings)
-        type = LM_VT_STRING;
+  plan = vp_selection_plan_new(vp, key);
 
-      vp_results_insert(results, vp_transform_apply(vp, spec->name), type, sb);
+  g_rw_lock_writer_lock(&vp->plan_cache_lock);
+  existing_plan = g_hash_table_lookup(vp->plan_cache, key);
+  if (existing_plan)
+    {
+      /* another thread was faster */
+      vp_selection_plan_free(plan);
+      plan = vp_selection_plan_ref(existing_plan);
     }
+  else
+    {
+      if (g_hash_table_size(vp->plan_cache) >= VP_PLAN_CACHE_MAX_SIZE)
+        vp_plan_cache_evict(vp);
+      g_hash_table_insert(vp->plan_cache, &plan->key, vp_selection_plan_ref(plan));
+    }
+  g_rw_lock_writer_unlock(&vp->plan_cache_lock);
+
+  return plan;
 }
 
 static gboolean
-vp_foreach_helper(const gchar *name, gpointer ndx_as_pointer, gpointer data)
+vp_fetch_nvpair(ValuePairs *vp, VPMsgValue *mv, GString **value, LogMessageValueType *type)
 {
-  VPResults *results = ((gpointer *)data)[0];
-  gint ndx = GPOINTER_TO_INT(ndx_as_pointer);
-  VPResultValue *rv = &g_array_index(results->values, VPResultValue, ndx);
-  VPForeachFunc func = ((gpointer *)data)[1];
-  gpointer user_data = ((gpointer *)data)[2];
-  gboolean *r = ((gpointer *)data)[3];
+  if (vp->omit_empty_values && mv->value_len == 0)
+    return FALSE;
 
-  gboolean success = !func(name, rv->type_hint,
-                           rv->value->str,
-                           rv->value->len, user_data);
+  if ((mv->type == LM_VT_BYTES || mv->type == LM_VT_PROTOBUF) && !vp->include_bytes)
+    return FALSE;
 
-  *r &= success;
+  *value = scratch_buffers_alloc();
+  g_string_append_len(*value, mv->value, mv->value_len);
+  *type = vp->cast_to_strings ? LM_VT_STRING : mv->type;
+  return TRUE;
+}
 
-  if (!success)
+static gboolean
+vp_fetch_builtin(ValuePairs *vp, ValuePairSpec *spec, LogMessage *msg, LogTemplateEvalOptions *options,
+                 GString **value, LogMessageValueType *type)
+{
+  GString *sb = scratch_buffers_alloc();
+
+  switch (spec->type)
+    {
+    case VPT_MACRO:
+      log_macro_expand(spec->id, FALSE, options, msg, sb, type);
+      break;
+    case VPT_NVPAIR:
     {
-      msg_trace("value_pairs_foreach: callback indicates failure",
-                evt_tag_str("name", name),
-                evt_tag_mem("value", rv->value->str, rv->value->len),
-                evt_tag_int("type", rv->type_hint));
+      const gchar *nv;
+      gssize len;
+
+      nv = log_msg_get_value_with_type(msg, (NVHandle) spec->id, &len, type);
+      g_string_append_len(sb, nv, len);
+      break;
+    }
+    default:
+      g_assert_not_reached();
     }
-  return !*r;
+
+  if (sb->len == 0)
+    return FALSE;
+
+  if (vp->cast_to_strings)
+    *type = LM_VT_STRING;
+
+  *value = sb;
+  return TRUE;
 }
 
+static gboolean
+vp_fetch_pair(ValuePairs *vp, VPPairConf *vpc, LogMessage *msg, LogTemplateEvalOptions *options,
+              GString **value, LogMessageValueType *type)
+{
+  GString *sb = scratch_buffers_alloc();
+
+  log_template_append_format_value_and_type(vpc->template, msg, options, sb, type);
+
+  if (vp->omit_empty_values && sb->len == 0)
+    return FALSE;
+  if (!vp->include_bytes && (*type == LM_VT_BYTES || *type == LM_VT_PROTOBUF))
+    return FALSE;
+  if (vp->cast_to_strings && vpc->template->explicit_type_hint == LM_VT_NONE)
+    *type = LM_VT_STRING;
+
+  *value = sb;
+  return TRUE;
+}
+
+static gboolean
+vp_fetch_entry_value(ValuePairs *vp, VPSelectionPlan *plan, VPPlanEntry *entry, VPMsgShape *shape,
+                     LogMessage *msg, LogTemplateEvalOptions *options,
+                     GString **value, LogMessageValueType *type)
+{
+  for (gint i = entry->first_source + entry->num_sources - 1; i >= entry->first_source; i--)
+    {
+      VPSource *source = &plan->sources[i];
+      gboolean found;
+
+      switch (source->type)
+        {
+        case VP_SOURCE_NVPAIR:
+          found = vp_fetch_nvpair(vp, &g_array_index(shape->values, VPMsgValue, source->nvpair_index), value, type);
+          break;
+        case VP_SOURCE_BUILTIN:
+          found = vp_fetch_builtin(vp, source->builtin, msg, options, value, type);
+          break;
+        case VP_SOURCE_PAIR:
+          found = vp_fetch_pair(vp, source->pair, msg, options, value, type);
+          break;
+        default:
+          g_assert_not_reached();
+        }
+
+      if (found)
+        return TRUE;
+    }
+  return FALSE;
+}
 
 gboolean
 value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
@@ -447,31 +702,39 @@ value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
                             LogMessage *msg, LogTemplateEvalOptions *options,
                             gpointer user_data)
 {
-  gpointer args[] = { vp, func, msg, options, user_data, NULL};
+  VPSelectionPlan *plan;
+  VPMsgShape shape;
+  VPShapeKey key;
   gboolean result = TRUE;
-  VPResults results;
-  gpointer helper_args[] = { &results, func, user_data, &result };
   ScratchBuffersMarker mark;
 
   scratch_buffers_mark(&mark);
-  vp_results_init(&results, compare_func);
-  args[5] = &results;
+  vp_msg_shape_init(&shape, vp, msg);
+  vp_shape_key_init(&key, compare_func, &shape);
+  plan = vp_get_selection_plan(vp, &key);
 
-  /*
-   * Build up the base set
-   */
-  if (vp->scopes & (VPS_NV_PAIRS + VPS_DOT_NV_PAIRS + VPS_SDATA + VPS_RFC5424) ||
-      vp->patterns->len > 0)
-    log_msg_values_foreach(msg, vp_msg_nvpairs_foreach, args);
+  for (gint i = 0; i < plan->num_entries; i++)
+    {
+      VPPlanEntry *entry = &plan->entries[i];
+      GString *value;
+      LogMessageValueType type;
 
-  vp_merge_builtins(vp, &results, msg, options);
+      if (!vp_fetch_entry_value(vp, plan, entry, &shape, msg, options, &value, &type))
+        continue;
 
-  /* Merge the explicit key-value pairs too */
-  g_ptr_array_foreach(vp->vpairs, (GFunc)vp_pairs_foreach, args);
+      if (func(entry->name, type, value->str, value->len, user_data))
+        {
+          msg_trace("value_pairs_foreach: callback indicates failure",
+                    evt_tag_str("name", entry->name),
+                    evt_tag_mem("value", value->str, value->len),
+                    evt_tag_int("type", type));
+          result = FALSE;
+          break;
+        }
+    }
 
-  /* Aaand we run it through the callback! */
-  g_tree_foreach(results.result_tree, (GTraverseFunc)vp_foreach_helper, helper_args);
-  vp_results_deinit(&results);
+  vp_selection_plan_unref(plan);
+  vp_msg_shape_deinit(&shape);
   scratch_buffers_reclaim_marked(mark);
 
   return result;
@@ -996,6 +1259,9 @@ value_pairs_new(GlobalConfig *cfg)
   vp->patterns = g_ptr_array_new();
   vp->transforms = g_ptr_array_new();
   vp->cfg = cfg;
+  g_rw_lock_init(&vp->plan_cache_lock);
+  vp->plan_cache = g_hash_table_new_full(vp_shape_key_hash, vp_shape_key_equal,
+                                         NULL, (GDestroyNotify) vp_selection_plan_unref);
 
   if (cfg_is_config_version_older(cfg, VERSION_VALUE_4_0))
     {
@@ -1045,6 +1311,8 @@ value_pairs_free (ValuePairs *vp)
     }
   g_ptr_array_free(vp->transforms, TRUE);
   g_ptr_array_free(vp->builtins, TRUE);
+  g_hash_table_destroy(vp->plan_cache);
+  g_rw_lock_clear(&vp->plan_cache_lock);
   g_free(vp);
 }
 
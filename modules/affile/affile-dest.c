@@ -419,6 +419,25 @@ affile_dd_set_fsync(LogDriver *s, gboolean use_fsync)
   self->use_fsync = use_fsync;
 }
 
+gboolean
+affile_dd_set_compress(LogDriver *s, const gchar *algorithm, gint level)
+{
+  AFFileDestDriver *self = (AFFileDestDriver *) s;
+  CompressionAlgorithm compression;
+
+  /* deflate is an HTTP content-coding, not a file format, lz4 only compresses independent blocks */
+  if (!compression_algorithm_lookup(algorithm, &compression)
+      || compression == COMPRESSION_DEFLATE || compression == COMPRESSION_LZ4)
+    return FALSE;
+
+  if (!compression_algorithm_is_valid_level(compression, level))
+    return FALSE;
+
+  self->compress_options.algorithm = compression;
+  self->compress_options.level = level;
+  return TRUE;
+}
+
 void
 affile_dd_set_time_reap(LogDriver *s, gint time_reap)
 {
@@ -512,6 +531,14 @@ affile_dd_init(LogPipe *s)
   file_opener_set_options(self->file_opener, &self->file_opener_options);
   log_writer_options_init(&self->writer_options, cfg, 0);
 
+  if (!compression_algorithm_is_supported(self->compress_options.algorithm))
+    {
+      msg_error("syslog-ng was compiled without support for the compression algorithm set in compress()",
+                evt_tag_str("compress", compression_algorithm_name(self->compress_options.algorithm)),
+                log_pipe_location_tag(s));
+      return FALSE;
+    }
+
   if (affile_dd_get_time_reap(self) == -1)
     affile_dd_set_time_reap(&self->super.super, cfg->time_reap);
 
@@ -808,6 +835,8 @@ affile_dd_new_instance(LogTemplate *filename_template, GlobalConfig *cfg)
       self->filename_is_a_template = TRUE;
     }
   file_opener_options_defaults(&self->file_opener_options);
+  self->compress_options.algorithm = COMPRESSION_NONE;
+  self->compress_options.level = COMPRESSION_LEVEL_DEFAULT;
 
   affile_dd_set_time_reap(&self->super.super, self->filename_is_a_template ? -1 : 0);
   g_mutex_init(&self->lock);
@@ -824,7 +853,8 @@ affile_dd_new(LogTemplate *filename_template, GlobalConfig *cfg)
 
   self->writer_flags |= LW_SOFT_FLOW_CONTROL;
   self->writer_options.stats_source = stats_register_type("file");
-  self->file_opener = file_opener_for_regular_dest_files_new(&self->writer_options, &self->use_fsync);
+  self->file_opener = file_opener_for_regular_dest_files_new(&self->writer_options, &self->use_fsync,
+                                                             &self->compress_options);
   return &self->super.super;
 }
 
@@ -27,6 +27,7 @@
 #include <string.h>
 #include <errno.h>
 #include <sys/uio.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 typedef struct _LogProtoFileWriter
@@ -40,9 +41,71 @@ typedef struct _LogProtoFileWriter
   gint fd;
   gint sum_len;
   gboolean fsync;
+  StreamCompressor *compressor;
+  /* where the compressed frame in partial starts, -1 if the file can't be truncated */
+  off_t frame_start;
   struct iovec buffer[0];
 } LogProtoFileWriter;
 
+static void
+_free_buffered_messages(LogProtoFileWriter *self)
+{
+  for (gint i = 0; i < self->buf_count; ++i)
+    g_free(self->buffer[i].iov_base);
+  self->buf_count = 0;
+  self->sum_len = 0;
+}
+
+/*
+ * Compresses the buffered messages into a complete gzip member (or zstd
+ * frame) and turns it into a partial buffer, which is then written out by
+ * the regular partial write logic.  Concatenated frames are valid
+ * gzip/zstd streams, but a frame that is only partially written makes
+ * everything after it undecodable, so the offset where the frame starts is
+ * recorded and the file is truncated back to it if the frame can't be
+ * completed (see _discard_partial_frame()).
+ */
+static gboolean
+_compress_buffered_messages(LogProtoFileWriter *self)
+{
+  GString *frame = g_string_sized_new(self->sum_len / 4 + 64);
+
+  stream_compressor_reset(self->compressor);
+  for (gint i = 0; i < self->buf_count; ++i)
+    stream_compressor_write(self->compressor, self->buffer[i].iov_base, self->buffer[i].iov_len, frame);
+
+  if (!stream_compressor_finish(self->compressor, frame))
+    {
+      g_string_free(frame, TRUE);
+      return FALSE;
+    }
+
+  self->partial_len = frame->len;
+  self->partial = (guchar *) g_string_free(frame, FALSE);
+  self->partial_pos = 0;
+  self->partial_messages = self->buf_count;
+  if (self->frame_start >= 0)
+    self->frame_start = lseek(self->fd, 0, SEEK_END);
+  _free_buffered_messages(self);
+  return TRUE;
+}
+
+/* drops the compressed frame being written, along with the part of it that is already in the file */
+static void
+_discard_partial_frame(LogProtoFileWriter *self)
+{
+  if (self->frame_start >= 0 && self->partial_pos > 0 && ftruncate(self->fd, self->frame_start) < 0)
+    {
+      msg_error("Error removing incomplete compressed frame from the end of the file, "
+                "the rest of the file can't be decompressed",
+                evt_tag_int("fd", self->fd),
+                evt_tag_error(EVT_TAG_OSERROR));
+    }
+
+  g_free(self->partial);
+  self->partial = NULL;
+}
+
 /*
  * log_proto_file_writer_flush:
  *
@@ -57,6 +120,17 @@ log_proto_file_writer_flush(LogProtoClient *s)
   LogProtoFileWriter *self = (LogProtoFileWriter *)s;
   gint rc, i, i0, sum, ofs, pos;
 
+  if (self->compressor && !self->partial && self->buf_count > 0)
+    {
+      if (!_compress_buffered_messages(self))
+        {
+          /* the messages are rewound and get posted again */
+          _free_buffered_messages(self);
+          log_proto_client_msg_rewind(&self->super);
+          return LPS_ERROR;
+        }
+    }
+
   if (self->partial)
     {
       /* there is still some data from the previous file writing process */
@@ -129,16 +203,16 @@ log_proto_file_writer_flush(LogProtoClient *s)
     }
 
   /* free the previous message strings (the remaining part has been copied to the partial buffer) */
-  for (i = 0; i < self->buf_count; ++i)
-    g_free(self->buffer[i].iov_base);
-  self->buf_count = 0;
-  self->sum_len = 0;
+  _free_buffered_messages(self);
 
   return LPS_SUCCESS;
 
 write_error:
   if (errno != EINTR && errno != EAGAIN)
     {
+      /* the frame is compressed again from the rewound messages */
+      if (self->compressor && self->partial)
+        _discard_partial_frame(self);
       log_proto_client_msg_rewind(&self->super);
       msg_error("I/O error occurred while writing",
                 evt_tag_int("fd", self->super.transport->fd),
@@ -217,6 +291,38 @@ log_proto_file_writer_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond, g
   return pending_write;
 }
 
+gboolean
+log_proto_file_writer_set_compression(LogProtoClient *s, const LogProtoFileWriterCompressOptions *options)
+{
+  LogProtoFileWriter *self = (LogProtoFileWriter *) s;
+
+  g_assert(!self->compressor);
+  if (options->algorithm == COMPRESSION_NONE)
+    return TRUE;
+
+  /* only regular files can be truncated when a frame is left incomplete */
+  struct stat st;
+  if (fstat(self->fd, &st) < 0 || !S_ISREG(st.st_mode))
+    self->frame_start = -1;
+
+  self->compressor = stream_compressor_new(options->algorithm, options->level);
+  return self->compressor != NULL;
+}
+
+static void
+log_proto_file_writer_free(LogProtoClient *s)
+{
+  LogProtoFileWriter *self = (LogProtoFileWriter *) s;
+
+  /* the messages in the unfinished frame were not acked, they are written again when the file is reopened */
+  if (self->compressor && self->partial)
+    _discard_partial_frame(self);
+
+  if (self->compressor)
+    stream_compressor_free(self->compressor);
+  log_proto_client_free_method(s);
+}
+
 LogProtoClient *
 log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *options, gint flush_lines, gint fsync_)
 {
@@ -240,5 +346,6 @@ log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *
   self->super.prepare = log_proto_file_writer_prepare;
   self->super.post = log_proto_file_writer_post;
   self->super.flush = log_proto_file_writer_flush;
+  self->super.free_fn = log_proto_file_writer_free;
   return &self->super;
 }
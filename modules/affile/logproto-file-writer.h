@@ -25,8 +25,21 @@
 #define LOG_PROTO_FILE_WRITER_H_INCLUDED
 
 #include "logproto/logproto-client.h"
+#include "compression.h"
+
+typedef struct _LogProtoFileWriterCompressOptions
+{
+  CompressionAlgorithm algorithm;
+  gint level;
+} LogProtoFileWriterCompressOptions;
 
 LogProtoClient *log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *options,
                                           gint flush_lines, gboolean fsync);
 
+/*
+ * each flush writes a self-contained gzip member/zstd frame, one that can't
+ * be written completely is truncated from the end of the file
+ */
+gboolean log_proto_file_writer_set_compression(LogProtoClient *s, const LogProtoFileWriterCompressOptions *options);
+
 #endif
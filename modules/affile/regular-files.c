@@ -29,7 +29,9 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <errno.h>
+#include <time.h>
 
 static gboolean
 _prepare_open(FileOpener *self, const gchar *name)
@@ -82,16 +84,95 @@ typedef struct _FileOpenerRegularDestFiles
   FileOpener super;
   const LogWriterOptions *writer_options;
   gboolean *use_fsync;
+  const LogProtoFileWriterCompressOptions *compress_options;
 } FileOpenerRegularDestFiles;
 
+/* moves an existing file that can't be appended to out of the way, so that a new one gets created */
+static gboolean
+_move_aside(const gchar *name)
+{
+  gchar *new_name = g_strdup_printf("%s.%ld.corrupted", name, (glong) time(NULL));
+  gboolean success = rename(name, new_name) == 0;
+
+  if (success)
+    msg_warning("Existing file can't be appended to in compressed mode, starting a new one",
+                evt_tag_str("filename", name),
+                evt_tag_str("renamed_to", new_name));
+  else
+    msg_error("Error renaming corrupted compressed file",
+              evt_tag_str("filename", name),
+              evt_tag_str("renamed_to", new_name),
+              evt_tag_error(EVT_TAG_OSERROR));
+  g_free(new_name);
+  return success;
+}
+
+/*
+ * A compressed frame left incomplete at the end of the file (e.g. by a
+ * crash) would make everything appended after it undecodable, so it is
+ * truncated before the file is reopened.  Files that can't be fixed this
+ * way (not compressed at all, or with the wrong algorithm) are renamed.
+ */
+static gboolean
+_prepare_dst_open(FileOpener *s, const gchar *name)
+{
+  FileOpenerRegularDestFiles *self = (FileOpenerRegularDestFiles *) s;
+  struct stat st;
+
+  if (self->compress_options->algorithm == COMPRESSION_NONE
+      || stat(name, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+    return TRUE;
+
+  /* if it can't be opened, opening it for writing will fail as well and report the error */
+  gint fd = open(name, O_RDWR | O_LARGEFILE);
+  if (fd < 0)
+    return TRUE;
+
+  goffset complete_len;
+  gboolean success = TRUE;
+  switch (compression_check_file(self->compress_options->algorithm, fd, &complete_len))
+    {
+    case COMPRESSED_FILE_COMPLETE:
+      break;
+    case COMPRESSED_FILE_TRUNCATED:
+      msg_warning("Removing incomplete compressed frame from the end of the file",
+                  evt_tag_str("filename", name),
+                  evt_tag_long("size", st.st_size),
+                  evt_tag_long("truncated_to", complete_len));
+      if (ftruncate(fd, complete_len) < 0)
+        success = _move_aside(name);
+      break;
+    case COMPRESSED_FILE_CORRUPTED:
+      success = _move_aside(name);
+      break;
+    case COMPRESSED_FILE_READ_ERROR:
+      msg_error("Error checking compressed file",
+                evt_tag_str("filename", name),
+                evt_tag_error(EVT_TAG_OSERROR));
+      success = FALSE;
+      break;
+    default:
+      g_assert_not_reached();
+    }
+  close(fd);
+  return success;
+}
+
 static LogProtoClient *
 _construct_dst_proto(FileOpener *s, LogTransport *transport, LogProtoClientOptions *proto_options)
 {
   FileOpenerRegularDestFiles *self = (FileOpenerRegularDestFiles *) s;
 
-  return log_proto_file_writer_new(transport, proto_options,
-                                   self->writer_options->flush_lines,
-                                   *self->use_fsync);
+  LogProtoClient *proto = log_proto_file_writer_new(transport, proto_options,
+                                                    self->writer_options->flush_lines,
+                                                    *self->use_fsync);
+
+  if (!log_proto_file_writer_set_compression(proto, self->compress_options))
+    {
+      log_proto_client_free(proto);
+      return NULL;
+    }
+  return proto;
 }
 
 static LogTransport *
@@ -101,14 +182,17 @@ _construct_transport(FileOpener *s, gint fd)
 }
 
 FileOpener *
-file_opener_for_regular_dest_files_new(const LogWriterOptions *writer_options, gboolean *use_fsync)
+file_opener_for_regular_dest_files_new(const LogWriterOptions *writer_options, gboolean *use_fsync,
+                                       const LogProtoFileWriterCompressOptions *compress_options)
 {
   FileOpenerRegularDestFiles *self = g_new0(FileOpenerRegularDestFiles, 1);
 
   file_opener_init_instance(&self->super);
+  self->super.prepare_open = _prepare_dst_open;
   self->super.construct_transport = _construct_transport;
   self->super.construct_dst_proto = _construct_dst_proto;
   self->writer_options = writer_options;
   self->use_fsync = use_fsync;
+  self->compress_options = compress_options;
   return &self->super;
 }
@@ -24,8 +24,16 @@
 #include "libtest/mock-transport.h"
 
 #include "logproto-file-writer.h"
+#include "file-specializations.h"
 #include "logmsg/logmsg.h"
 #include "apphook.h"
+#include "cfg.h"
+
+#include <unistd.h>
+
+#if SYSLOG_NG_HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 
 static void _ack_callback(gint num_acked, gpointer user_data);
@@ -162,6 +170,150 @@ Test(file_writer, batches_of_messages_are_flushed_even_if_the_underlying_transpo
   log_proto_client_free(fw);
 }
 
+#if SYSLOG_NG_HAVE_ZLIB
+
+/* decodes a series of concatenated gzip members, returns the number of members */
+static gint
+_gunzip_members(const gchar *input, gsize input_len, GString *output)
+{
+  z_stream zs = {0};
+  gchar buffer[1024];
+  gint members = 0;
+
+  cr_assert_eq(inflateInit2(&zs, 15 + 16), Z_OK);
+  zs.next_in = (Bytef *) input;
+  zs.avail_in = input_len;
+  while (zs.avail_in > 0)
+    {
+      zs.next_out = (Bytef *) buffer;
+      zs.avail_out = sizeof(buffer);
+
+      gint rc = inflate(&zs, Z_NO_FLUSH);
+      cr_assert(rc == Z_OK || rc == Z_STREAM_END, "inflate() failed: %d", rc);
+      g_string_append_len(output, buffer, sizeof(buffer) - zs.avail_out);
+
+      if (rc == Z_STREAM_END)
+        {
+          members++;
+          inflateReset(&zs);
+        }
+    }
+  inflateEnd(&zs);
+  return members;
+}
+
+Test(file_writer, compressed_batches_are_written_as_separate_gzip_members)
+{
+  const gint BATCH_SIZE = 10;
+  const gint MESSAGE_COUNT = BATCH_SIZE * 3;
+  LogProtoFileWriterCompressOptions compress_options = { COMPRESSION_GZIP, COMPRESSION_LEVEL_DEFAULT };
+  LogProtoClient *fw = log_proto_file_writer_new(transport, &options, BATCH_SIZE, FALSE);
+
+  cr_assert(log_proto_file_writer_set_compression(fw, &compress_options));
+  log_proto_client_set_client_flow_control(fw, &flow_control_funcs);
+  for (gint i = 0; i < MESSAGE_COUNT; i++)
+    {
+      status = log_proto_client_post(fw, msg, (guchar *) g_strdup("PAYLOAD\n"), 8, &consumed);
+      cr_assert(status == LPS_SUCCESS);
+      cr_assert(consumed == TRUE);
+    }
+
+  /* every batch is flushed automatically as a complete member, there's nothing left to flush */
+  cr_assert_eq(messages_acked, MESSAGE_COUNT);
+  status = log_proto_client_flush(fw);
+  cr_assert(status == LPS_SUCCESS);
+
+  count = log_transport_mock_read_from_write_buffer((LogTransportMock *) transport, output_buffer, sizeof(output_buffer));
+  cr_assert_gt(count, 0);
+
+  GString *decompressed = g_string_new("");
+  cr_assert_eq(_gunzip_members(output_buffer, count, decompressed), MESSAGE_COUNT / BATCH_SIZE);
+  cr_assert_eq(decompressed->len, MESSAGE_COUNT * 8);
+  for (gint i = 0; i < MESSAGE_COUNT; i++)
+    cr_assert_arr_eq(decompressed->str + i * 8, "PAYLOAD\n", 8);
+
+  g_string_free(decompressed, TRUE);
+  log_proto_client_free(fw);
+}
+
+static LogProtoClient *
+_open_compressed_file(const gchar *filename, LogWriterOptions *writer_options,
+                      LogProtoFileWriterCompressOptions *compress_options)
+{
+  gboolean use_fsync = FALSE;
+  FileOpener *opener = file_opener_for_regular_dest_files_new(writer_options, &use_fsync, compress_options);
+  FileOpenerOptions open_opts;
+  gint fd;
+
+  file_opener_options_defaults(&open_opts);
+  file_opener_options_init(&open_opts, configuration);
+  open_opts.needs_privileges = FALSE;
+  file_opener_set_options(opener, &open_opts);
+
+  cr_assert_eq(file_opener_open_fd(opener, filename, AFFILE_DIR_WRITE, &fd), FILE_OPENER_RESULT_SUCCESS);
+  LogProtoClient *fw = file_opener_construct_dst_proto(opener, file_opener_construct_transport(opener, fd), &options);
+  cr_assert(fw);
+  log_proto_client_set_client_flow_control(fw, &flow_control_funcs);
+
+  file_opener_free(opener);
+  return fw;
+}
+
+static void
+_write_compressed_batch(const gchar *filename, gint batch_size)
+{
+  LogWriterOptions writer_options = { .flush_lines = batch_size };
+  LogProtoFileWriterCompressOptions compress_options = { COMPRESSION_GZIP, COMPRESSION_LEVEL_DEFAULT };
+  LogProtoClient *fw = _open_compressed_file(filename, &writer_options, &compress_options);
+
+  for (gint i = 0; i < batch_size; i++)
+    {
+      status = log_proto_client_post(fw, msg, (guchar *) g_strdup("PAYLOAD\n"), 8, &consumed);
+      cr_assert(status == LPS_SUCCESS);
+      cr_assert(consumed == TRUE);
+    }
+  log_proto_client_free(fw);
+}
+
+Test(file_writer, incomplete_gzip_member_is_truncated_when_the_file_is_reopened)
+{
+  const gint BATCH_SIZE = 10;
+  const gchar *filename = "test_file_writer_incomplete_member.log.gz";
+  gchar *contents;
+  gsize len;
+
+  configuration = cfg_new_snippet();
+  unlink(filename);
+
+  _write_compressed_batch(filename, BATCH_SIZE);
+
+  /* simulate a crash in the middle of writing the next member */
+  cr_assert(g_file_get_contents(filename, &contents, &len, NULL));
+  FILE *f = fopen(filename, "a");
+  cr_assert(f);
+  cr_assert_eq(fwrite(contents, 1, len / 2, f), len / 2);
+  fclose(f);
+  g_free(contents);
+
+  _write_compressed_batch(filename, BATCH_SIZE);
+
+  cr_assert(g_file_get_contents(filename, &contents, &len, NULL));
+  GString *decompressed = g_string_new("");
+  cr_assert_eq(_gunzip_members(contents, len, decompressed), 2);
+  cr_assert_eq(decompressed->len, 2 * BATCH_SIZE * 8);
+  for (gint i = 0; i < 2 * BATCH_SIZE; i++)
+    cr_assert_arr_eq(decompressed->str + i * 8, "PAYLOAD\n", 8);
+  cr_assert_eq(messages_acked, 2 * BATCH_SIZE);
+
+  g_string_free(decompressed, TRUE);
+  g_free(contents);
+  unlink(filename);
+  cfg_free(configuration);
+  configuration = NULL;
+}
+
+#endif
+
 static void
 startup(void)
 {
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/stopwatch.h"
+#include "libtest/cr_template.h"
+
+#include "logproto-file-writer.h"
+#include "transport/transport-file.h"
+#include "logmsg/logmsg.h"
+#include "apphook.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#define BENCHMARK_MESSAGES 500000
+#define BENCHMARK_FLUSH_LINES 100
+#define BENCHMARK_FILE "test_file_writer_speed.out"
+
+static LogProtoClientOptions options = {0};
+static LogMessage *msg;
+
+static void
+_ack_callback(gint num_acked, gpointer user_data)
+{
+}
+
+static LogProtoClientFlowControlFuncs flow_control_funcs =
+{
+  .ack_callback = _ack_callback,
+};
+
+static gchar *
+_format_message(gint i, gsize *len)
+{
+  gchar *line = g_strdup_printf("2024-01-01T00:00:%02d+00:00 web%02d nginx[%d]: 10.0.%d.%d - - "
+                                "\"GET /api/v1/items/%d HTTP/1.1\" 200 %d \"-\" \"curl/8.5.0\"\n",
+                                i % 60, i % 16, 1000 + i % 8, i % 256, i % 199, i, 512 + i % 4096);
+  *len = strlen(line);
+  return line;
+}
+
+static void
+_perftest_file_writer(CompressionAlgorithm algorithm, gint level)
+{
+  LogProtoFileWriterCompressOptions compress_options = { algorithm, level };
+  gboolean consumed;
+  gsize input_size = 0;
+
+  if (!compression_algorithm_is_supported(algorithm))
+    {
+      printf("%s is not supported by this build, skipping\n", compression_algorithm_name(algorithm));
+      return;
+    }
+
+  gint fd = open(BENCHMARK_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  cr_assert_geq(fd, 0);
+
+  LogProtoClient *fw = log_proto_file_writer_new(log_transport_file_new(fd), &options, BENCHMARK_FLUSH_LINES, FALSE);
+  cr_assert(log_proto_file_writer_set_compression(fw, &compress_options));
+  log_proto_client_set_client_flow_control(fw, &flow_control_funcs);
+
+  start_stopwatch();
+  for (gint i = 0; i < BENCHMARK_MESSAGES; i++)
+    {
+      gsize len;
+      gchar *line = _format_message(i, &len);
+
+      input_size += len;
+      cr_assert_eq(log_proto_client_post(fw, msg, (guchar *) line, len, &consumed), LPS_SUCCESS);
+      cr_assert(consumed);
+    }
+  cr_assert_eq(log_proto_client_flush(fw), LPS_SUCCESS);
+  guint64 elapsed_usec = stop_stopwatch_and_get_result();
+
+  struct stat st;
+  cr_assert_eq(fstat(fd, &st), 0);
+  printf("%-8s level %2d: %8.2f MiB/s input, %10" G_GSIZE_FORMAT " bytes in, %10" G_GINT64_FORMAT
+         " bytes on disk (%5.1f%%)\n",
+         compression_algorithm_name(algorithm), level,
+         input_size / (1024.0 * 1024.0) / (elapsed_usec / 1e6),
+         input_size, (gint64) st.st_size, 100.0 * st.st_size / input_size);
+
+  log_proto_client_free(fw);
+  unlink(BENCHMARK_FILE);
+}
+
+Test(file_writer_speed, raw_and_compressed_write_throughput)
+{
+  _perftest_file_writer(COMPRESSION_NONE, COMPRESSION_LEVEL_DEFAULT);
+  _perftest_file_writer(COMPRESSION_GZIP, 1);
+  _perftest_file_writer(COMPRESSION_GZIP, COMPRESSION_LEVEL_DEFAULT);
+  _perftest_file_writer(COMPRESSION_ZSTD, 1);
+  _perftest_file_writer(COMPRESSION_ZSTD, COMPRESSION_LEVEL_DEFAULT);
+}
+
+static void
+startup(void)
+{
+  app_startup();
+  msg = create_empty_message();
+}
+
+static void
+teardown(void)
+{
+  log_msg_unref(msg);
+  app_shutdown();
+}
+
+TestSuite(file_writer_speed, .init = startup, .fini = teardown);
@@ -31,6 +31,7 @@
 #include "poll-fd-events.h"
 #include "timeutils/misc.h"
 #include "afsocket-signals.h"
+#include "transport/transport-socket.h"
 
 #include <string.h>
 #include <sys/types.h>
@@ -145,6 +146,12 @@ afsocket_sc_init(LogPipe *s)
       if (!transport)
         return FALSE;
 
+      /* datagram sources only ever have socket based transports */
+      if (self->owner->transport_mapper->sock_type == SOCK_DGRAM && self->owner->receive_batch_size > 1)
+        log_transport_dgram_socket_set_receive_batch((LogTransportSocket *) transport, self->owner->receive_batch_size,
+                                                     self->owner->metrics.receive_batches,
+                                                     self->owner->metrics.receive_batched_datagrams);
+
       proto = log_proto_server_factory_construct(self->owner->proto_factory, transport,
                                                  &self->owner->reader_options.proto_options.super);
       if (!proto)
@@ -353,6 +360,14 @@ afsocket_sd_set_dynamic_window_realloc_ticks(LogDriver *s, gint realloc_ticks)
   self->dynamic_window_realloc_ticks = realloc_ticks;
 }
 
+void
+afsocket_sd_set_receive_batch_size(LogDriver *s, gint receive_batch_size)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+
+  self->receive_batch_size = receive_batch_size;
+}
+
 static const gchar *
 afsocket_sd_format_name(const LogPipe *s)
 {
@@ -1221,16 +1236,49 @@ _unregister_stream_stats(AFSocketSourceDriver *self, StatsClusterLabel *labels,
   stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.rejected_connections);
 }
 
+static void
+_register_receive_batch_stats(AFSocketSourceDriver *self, StatsClusterLabel *labels, gsize labels_len)
+{
+  gint level = log_pipe_is_internal(&self->super.super.super) ? STATS_LEVEL3 : STATS_LEVEL1;
+  StatsClusterKey sc_key;
+
+  if (self->receive_batch_size <= 1)
+    return;
+
+  stats_cluster_single_key_set(&sc_key, "socket_receive_batches_total", labels, labels_len);
+  stats_register_counter(level, &sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.receive_batches);
+
+  stats_cluster_single_key_set(&sc_key, "socket_receive_batched_datagrams_total", labels, labels_len);
+  stats_register_counter(level, &sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.receive_batched_datagrams);
+}
+
+static void
+_unregister_receive_batch_stats(AFSocketSourceDriver *self, StatsClusterLabel *labels, gsize labels_len)
+{
+  StatsClusterKey sc_key;
+
+  if (self->receive_batch_size <= 1)
+    return;
+
+  stats_cluster_single_key_set(&sc_key, "socket_receive_batches_total", labels, labels_len);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.receive_batches);
+
+  stats_cluster_single_key_set(&sc_key, "socket_receive_batched_datagrams_total", labels, labels_len);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.receive_batched_datagrams);
+}
+
 static void
 _register_dgram_stats(AFSocketSourceDriver *self, StatsClusterLabel *labels, gsize labels_len)
 {
   _register_packet_stats(self, labels, labels_len);
+  _register_receive_batch_stats(self, labels, labels_len);
 }
 
 static void
 _unregister_dgram_stats(AFSocketSourceDriver *self, StatsClusterLabel *labels, gsize labels_len)
 {
   _unregister_packet_stats(self, labels, labels_len);
+  _unregister_receive_batch_stats(self, labels, labels_len);
 }
 
 static void
@@ -1278,6 +1326,14 @@ afsocket_sd_init_method(LogPipe *s)
   if (!afsocket_sd_setup_transport(self) || !afsocket_sd_setup_addresses(self))
     return FALSE;
 
+  if (self->receive_batch_size > 1 && self->transport_mapper->sock_type != SOCK_DGRAM)
+    {
+      msg_warning("WARNING: receive-batch-size() only applies to datagram transports, ignoring it",
+                  evt_tag_int("receive_batch_size", self->receive_batch_size),
+                  log_pipe_location_tag(s));
+      self->receive_batch_size = 1;
+    }
+
   afsocket_sd_register_stats(self);
   afsocket_sd_dynamic_window_init(self);
   afsocket_sd_restore_kept_alive_connections(self);
@@ -1355,6 +1411,7 @@ afsocket_sd_init_instance(AFSocketSourceDriver *self,
   self->listen_backlog = 255;
   self->dynamic_window_stats_freq = DYNAMIC_WINDOW_TIMER_MSECS;
   self->dynamic_window_realloc_ticks = DYNAMIC_WINDOW_REALLOC_TICKS;
+  self->receive_batch_size = 1;
   self->connections_kept_alive_across_reloads = TRUE;
   log_reader_options_defaults(&self->reader_options);
   self->reader_options.super.stats_level = STATS_LEVEL1;
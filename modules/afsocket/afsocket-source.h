@@ -48,6 +48,7 @@ struct _AFSocketSourceDriver
   gsize dynamic_window_timer_tick;
   glong dynamic_window_stats_freq;
   gint dynamic_window_realloc_ticks;
+  gint receive_batch_size;
   gint fd;
   LogReaderOptions reader_options;
   DynamicWindowPool *dynamic_window_pool;
@@ -60,6 +61,8 @@ struct _AFSocketSourceDriver
     StatsCounterItem *socket_receive_buffer_max;
     StatsCounterItem *socket_receive_buffer_used;
     StatsCounterItem *rejected_connections;
+    StatsCounterItem *receive_batches;
+    StatsCounterItem *receive_batched_datagrams;
   } metrics;
 
   GSockAddr *bind_addr;
@@ -92,6 +95,7 @@ void afsocket_sd_set_listen_backlog(LogDriver *self, gint listen_backlog);
 void afsocket_sd_set_dynamic_window_size(LogDriver *self, gint dynamic_window_size);
 void afsocket_sd_set_dynamic_window_stats_freq(LogDriver *self, gdouble stats_freq);
 void afsocket_sd_set_dynamic_window_realloc_ticks(LogDriver *self, gint realloc_ticks);
+void afsocket_sd_set_receive_batch_size(LogDriver *self, gint receive_batch_size);
 
 static inline gboolean
 afsocket_sd_acquire_socket(AFSocketSourceDriver *s, gint *fd)
@@ -26,43 +26,55 @@
 #include "timeutils/cache.h"
 #include "timeutils/misc.h"
 
+static inline CorrelationStateShard *
+_get_shard(CorrelationState *self, const CorrelationKey *key)
+{
+  if (self->num_shards == 1)
+    return &self->shards[0];
+  return &self->shards[correlation_key_hash(key) % self->num_shards];
+}
+
 void
-correlation_state_tx_begin(CorrelationState *self)
+correlation_state_tx_begin(CorrelationState *self, const CorrelationKey *key)
 {
-  g_mutex_lock(&self->lock);
+  g_mutex_lock(&_get_shard(self, key)->lock);
 }
 
 void
-correlation_state_tx_end(CorrelationState *self)
+correlation_state_tx_end(CorrelationState *self, const CorrelationKey *key)
 {
-  g_mutex_unlock(&self->lock);
+  g_mutex_unlock(&_get_shard(self, key)->lock);
 }
 
 CorrelationContext *
 correlation_state_tx_lookup_context(CorrelationState *self, const CorrelationKey *key)
 {
-  return g_hash_table_lookup(self->state, key);
+  return g_hash_table_lookup(_get_shard(self, key)->state, key);
 }
 
 void
 correlation_state_tx_store_context(CorrelationState *self, CorrelationContext *context, gint timeout)
 {
+  CorrelationStateShard *shard = _get_shard(self, &context->key);
+
   g_assert(context->timer == NULL);
 
-  g_hash_table_insert(self->state, &context->key, context);
-  context->timer = timer_wheel_add_timer(self->timer_wheel, timeout, self->expire_callback,
+  g_hash_table_insert(shard->state, &context->key, context);
+  context->timer = timer_wheel_add_timer(shard->timer_wheel, timeout, self->expire_callback,
                                          correlation_context_ref(context), (GDestroyNotify) correlation_context_unref);
 }
 
 void
 correlation_state_tx_remove_context(CorrelationState *self, CorrelationContext *context)
 {
+  CorrelationStateShard *shard = _get_shard(self, &context->key);
+
   /* NOTE: in expire callbacks our timer is already deleted and thus it is
    * set to NULL in which case we don't need to remove it again.  */
 
   if (context->timer)
-    timer_wheel_del_timer(self->timer_wheel, context->timer);
-  g_hash_table_remove(self->state, &context->key);
+    timer_wheel_del_timer(shard->timer_wheel, context->timer);
+  g_hash_table_remove(shard->state, &context->key);
 }
 
 void
@@ -70,26 +82,58 @@ correlation_state_tx_update_context(CorrelationState *self, CorrelationContext *
 {
   g_assert(context->timer != NULL);
 
-  timer_wheel_mod_timer(self->timer_wheel, context->timer, timeout);
+  timer_wheel_mod_timer(_get_shard(self, &context->key)->timer_wheel, context->timer, timeout);
 }
 
 void
 correlation_state_expire_all(CorrelationState *self, gpointer caller_context)
 {
-  g_mutex_lock(&self->lock);
-  timer_wheel_expire_all(self->timer_wheel, caller_context);
-  g_mutex_unlock(&self->lock);
+  for (gint i = 0; i < self->num_shards; i++)
+    {
+      CorrelationStateShard *shard = &self->shards[i];
+
+      g_mutex_lock(&shard->lock);
+      timer_wheel_expire_all(shard->timer_wheel, caller_context);
+      g_mutex_unlock(&shard->lock);
+    }
+}
+
+/* concurrent callers may finish in any order, keep the latest time */
+static void
+_publish_time(CorrelationState *self, guint64 now)
+{
+  gssize published = atomic_gssize_get(&self->now);
+
+  while ((guint64) published < now)
+    {
+      if (atomic_gssize_compare_and_exchange(&self->now, published, now))
+        break;
+      published = atomic_gssize_get(&self->now);
+    }
+}
+
+/* moves the time of each shard forward by @diff seconds */
+static void
+_advance_time_of_all_shards(CorrelationState *self, guint64 diff, gpointer caller_context)
+{
+  guint64 now = 0;
+
+  for (gint i = 0; i < self->num_shards; i++)
+    {
+      CorrelationStateShard *shard = &self->shards[i];
+
+      g_mutex_lock(&shard->lock);
+      timer_wheel_set_time(shard->timer_wheel, timer_wheel_get_time(shard->timer_wheel) + diff, caller_context);
+      now = timer_wheel_get_time(shard->timer_wheel);
+      g_mutex_unlock(&shard->lock);
+    }
+  _publish_time(self, now);
 }
 
 void
 correlation_state_advance_time(CorrelationState *self, gint timeout, gpointer caller_context)
 {
-  guint64  new_time;
-
-  g_mutex_lock(&self->lock);
-  new_time = timer_wheel_get_time(self->timer_wheel) + timeout;
-  timer_wheel_set_time(self->timer_wheel, new_time, caller_context);
-  g_mutex_unlock(&self->lock);
+  _advance_time_of_all_shards(self, timeout, caller_context);
 }
 
 void
@@ -108,15 +152,27 @@ correlation_state_set_time(CorrelationState *self, guint64 sec, gpointer caller_
   if (sec < now.tv_sec)
     now.tv_sec = sec;
 
-  g_mutex_lock(&self->lock);
-  timer_wheel_set_time(self->timer_wheel, now.tv_sec, caller_context);
-  g_mutex_unlock(&self->lock);
+  /* this is called for every message, but the time changes at most once
+   * a second: don't lock the shards if they are already there. The wheel
+   * does not move backwards anyway. */
+  if ((guint64) atomic_gssize_get(&self->now) >= now.tv_sec)
+    return;
+
+  for (gint i = 0; i < self->num_shards; i++)
+    {
+      CorrelationStateShard *shard = &self->shards[i];
+
+      g_mutex_lock(&shard->lock);
+      timer_wheel_set_time(shard->timer_wheel, now.tv_sec, caller_context);
+      g_mutex_unlock(&shard->lock);
+    }
+  _publish_time(self, now.tv_sec);
 }
 
 guint64
 correlation_state_get_time(CorrelationState *self)
 {
-  return timer_wheel_get_time(self->timer_wheel);
+  return atomic_gssize_get(&self->now);
 }
 
 gboolean
@@ -134,7 +190,7 @@ correlation_state_timer_tick(CorrelationState *self, gpointer caller_context)
     {
       glong diff_sec = (glong)(diff / 1e6);
 
-      timer_wheel_set_time(self->timer_wheel, timer_wheel_get_time(self->timer_wheel) + diff_sec, caller_context);
+      _advance_time_of_all_shards(self, diff_sec, caller_context);
       /* update last_tick, take the fraction of the seconds not calculated into this update into account */
 
       self->last_tick = now;
@@ -153,16 +209,45 @@ correlation_state_timer_tick(CorrelationState *self, gpointer caller_context)
   return updated;
 }
 
+/* the associated data is available to expire callbacks via
+ * timer_wheel_get_associated_data(), regardless of the shard */
+void
+correlation_state_set_associated_data(CorrelationState *self, gpointer assoc_data, GDestroyNotify assoc_data_free)
+{
+  if (self->assoc_data && self->assoc_data_free)
+    self->assoc_data_free(self->assoc_data);
+  self->assoc_data = assoc_data;
+  self->assoc_data_free = assoc_data_free;
+
+  for (gint i = 0; i < self->num_shards; i++)
+    timer_wheel_set_associated_data(self->shards[i].timer_wheel, assoc_data, NULL);
+}
+
+gint
+correlation_state_get_num_shards(CorrelationState *self)
+{
+  return self->num_shards;
+}
 
 CorrelationState *
-correlation_state_new(TWCallbackFunc expire_callback)
+correlation_state_new(TWCallbackFunc expire_callback, gint num_shards)
 {
   CorrelationState *self = g_new0(CorrelationState, 1);
 
+  g_assert(num_shards > 0);
+
   g_mutex_init(&self->lock);
-  self->state = g_hash_table_new_full(correlation_key_hash, correlation_key_equal, NULL,
-                                      (GDestroyNotify) correlation_context_unref);
-  self->timer_wheel = timer_wheel_new();
+  self->num_shards = num_shards;
+  self->shards = g_new0(CorrelationStateShard, num_shards);
+  for (gint i = 0; i < num_shards; i++)
+    {
+      CorrelationStateShard *shard = &self->shards[i];
+
+      g_mutex_init(&shard->lock);
+      shard->state = g_hash_table_new_full(correlation_key_hash, correlation_key_equal, NULL,
+                                           (GDestroyNotify) correlation_context_unref);
+      shard->timer_wheel = timer_wheel_new();
+    }
   cached_g_current_time(&self->last_tick);
   g_atomic_counter_set(&self->ref_cnt, 1);
   self->expire_callback = expire_callback;
@@ -172,9 +257,17 @@ correlation_state_new(TWCallbackFunc expire_callback)
 void
 _free(CorrelationState *self)
 {
-  if (self->state)
-    g_hash_table_destroy(self->state);
-  timer_wheel_free(self->timer_wheel);
+  for (gint i = 0; i < self->num_shards; i++)
+    {
+      CorrelationStateShard *shard = &self->shards[i];
+
+      g_hash_table_destroy(shard->state);
+      timer_wheel_free(shard->timer_wheel);
+      g_mutex_clear(&shard->lock);
+    }
+  g_free(self->shards);
+  if (self->assoc_data && self->assoc_data_free)
+    self->assoc_data_free(self->assoc_data);
   g_mutex_clear(&self->lock);
   g_free(self);
 }
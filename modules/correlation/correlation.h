@@ -28,19 +28,47 @@
 #include "correlation-context.h"
 #include "timerwheel.h"
 #include "timeutils/unixtime.h"
+#include "atomic-gssize.h"
 
-typedef struct _CorrelationState
+/*
+ * The state is split into shards, each with its own lock, context hash and
+ * timer wheel.  A context always lives in the shard selected by the hash of
+ * its key, so transactions on unrelated keys don't contend with each other.
+ *
+ * A transaction locks the shard of the key passed to
+ * correlation_state_tx_begin(), within the transaction only contexts with
+ * the same key may be looked up, stored, updated or removed.  Expire
+ * callbacks run with the shard of the expiring context locked, so they may
+ * remove the expiring context, but must not touch other keys.
+ *
+ * Time is advanced in all shards, in shard order.  Once every shard got
+ * there, the new time is published in CorrelationState->now, which can be
+ * read without locking any of the shards.
+ */
+typedef struct _CorrelationStateShard
 {
-  GAtomicCounter ref_cnt;
   GMutex lock;
   GHashTable *state;
   TimerWheel *timer_wheel;
+} CorrelationStateShard;
+
+typedef struct _CorrelationState
+{
+  GAtomicCounter ref_cnt;
+  /* protects last_tick */
+  GMutex lock;
+  CorrelationStateShard *shards;
+  gint num_shards;
+  /* the time all the shards have been moved to */
+  atomic_gssize now;
   TWCallbackFunc expire_callback;
+  gpointer assoc_data;
+  GDestroyNotify assoc_data_free;
   GTimeVal last_tick;
 } CorrelationState;
 
-void correlation_state_tx_begin(CorrelationState *self);
-void correlation_state_tx_end(CorrelationState *self);
+void correlation_state_tx_begin(CorrelationState *self, const CorrelationKey *key);
+void correlation_state_tx_end(CorrelationState *self, const CorrelationKey *key);
 CorrelationContext *correlation_state_tx_lookup_context(CorrelationState *self, const CorrelationKey *key);
 void correlation_state_tx_store_context(CorrelationState *self, CorrelationContext *context, gint timeout);
 void correlation_state_tx_remove_context(CorrelationState *self, CorrelationContext *context);
@@ -52,9 +80,12 @@ gboolean correlation_state_timer_tick(CorrelationState *self, gpointer caller_co
 void correlation_state_expire_all(CorrelationState *self, gpointer caller_context);
 void correlation_state_advance_time(CorrelationState *self, gint timeout, gpointer caller_context);
 
+void correlation_state_set_associated_data(CorrelationState *self, gpointer assoc_data, GDestroyNotify assoc_data_free);
+gint correlation_state_get_num_shards(CorrelationState *self);
+
 void correlation_state_init_instance(CorrelationState *self);
 void correlation_state_deinit_instance(CorrelationState *self);
-CorrelationState *correlation_state_new(TWCallbackFunc expire);
+CorrelationState *correlation_state_new(TWCallbackFunc expire, gint num_shards);
 CorrelationState *correlation_state_ref(CorrelationState *self);
 void correlation_state_unref(CorrelationState *self);
 
@@ -130,7 +130,11 @@ log_db_parser_init(LogPipe *s)
   self->db = cfg_persist_config_fetch(cfg, log_db_parser_format_persist_name(self));
 
   if (!self->db)
-    self->db = pattern_db_new(self->prefix);
+    self->db = pattern_db_new(self->prefix, self->super.num_shards);
+  else if (pattern_db_get_num_correlation_shards(self->db) != self->super.num_shards)
+    msg_notice("db-parser: shards() changes take effect after a restart",
+               evt_tag_int("shards", pattern_db_get_num_correlation_shards(self->db)),
+               log_pipe_location_tag(&self->super.super.super));
 
   log_db_parser_reload_database(self);
   if (self->db)
@@ -113,6 +113,8 @@ _advance_time_based_on_message(GroupingParser *self, const UnixTime *ls,
             log_pipe_location_tag(&self->super.super.super));
 }
 
+static void _expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data, gpointer caller_context);
+
 static void
 _load_correlation_state(GroupingParser *self, GlobalConfig *cfg)
 {
@@ -122,10 +124,19 @@ _load_correlation_state(GroupingParser *self, GlobalConfig *cfg)
     {
       correlation_state_unref(self->correlation);
       self->correlation = persisted_correlation;
+
+      if (correlation_state_get_num_shards(self->correlation) != self->super.num_shards)
+        msg_notice("grouping-parser: shards() changes take effect after a restart",
+                   evt_tag_int("shards", correlation_state_get_num_shards(self->correlation)),
+                   log_pipe_location_tag(&self->super.super.super));
+    }
+  else if (!self->correlation)
+    {
+      self->correlation = correlation_state_new(_expire_entry, self->super.num_shards);
     }
 
-  timer_wheel_set_associated_data(self->correlation->timer_wheel, log_pipe_ref((LogPipe *)self),
-                                  (GDestroyNotify)log_pipe_unref);
+  correlation_state_set_associated_data(self->correlation, log_pipe_ref((LogPipe *)self),
+                                        (GDestroyNotify)log_pipe_unref);
 }
 
 static void
@@ -180,6 +191,8 @@ _expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data, gpointer calle
 }
 
 
+/* NOTE: returns with the correlation transaction of the context started,
+ * it is to be finished by the caller. */
 CorrelationContext *
 grouping_parser_lookup_or_create_context(GroupingParser *self, LogMessage *msg)
 {
@@ -190,6 +203,7 @@ grouping_parser_lookup_or_create_context(GroupingParser *self, LogMessage *msg)
   log_template_format(self->key_template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer);
 
   correlation_key_init(&key, self->scope, msg, buffer->str);
+  correlation_state_tx_begin(self->correlation, &key);
   context = correlation_state_tx_lookup_context(self->correlation, &key);
   if (!context)
     {
@@ -221,7 +235,7 @@ _aggregate_and_emit(GroupingParser *self, CorrelationContext *context, StatefulP
 {
   LogMessage *genmsg = grouping_parser_aggregate_context(self, context);
   correlation_state_tx_update_context(self->correlation, context, self->timeout);
-  correlation_state_tx_end(self->correlation);
+  correlation_state_tx_end(self->correlation, &context->key);
   if (genmsg)
     {
       stateful_parser_emitted_messages_add(emitted_messages, genmsg);
@@ -232,8 +246,6 @@ _aggregate_and_emit(GroupingParser *self, CorrelationContext *context, StatefulP
 void
 grouping_parser_perform_grouping(GroupingParser *self, LogMessage *msg, StatefulParserEmittedMessages *emitted_messages)
 {
-  correlation_state_tx_begin(self->correlation);
-
   CorrelationContext *context = grouping_parser_lookup_or_create_context(self, msg);
 
   GroupingParserUpdateContextResult r = grouping_parser_update_context(self, context, msg);
@@ -246,7 +258,7 @@ grouping_parser_perform_grouping(GroupingParser *self, LogMessage *msg, Stateful
                 evt_tag_int("expiration", correlation_state_get_time(self->correlation) + self->timeout),
                 log_pipe_location_tag(&self->super.super.super));
       correlation_state_tx_update_context(self->correlation, context, self->timeout);
-      correlation_state_tx_end(self->correlation);
+      correlation_state_tx_end(self->correlation, &context->key);
     }
   else if (r == GP_CONTEXT_COMPLETE)
     {
@@ -346,7 +358,6 @@ grouping_parser_init_instance(GroupingParser *self, GlobalConfig *cfg)
   self->super.super.process = grouping_parser_process_method;
   self->scope = RCS_GLOBAL;
   self->timeout = -1;
-  self->correlation = correlation_state_new(_expire_entry);
 }
 
 void
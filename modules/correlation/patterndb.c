@@ -38,6 +38,7 @@
 #include "logpipe.h"
 #include "timeutils/cache.h"
 #include "timeutils/misc.h"
+#include "atomic.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -57,14 +58,22 @@ typedef struct _PDBProcessParams
   gpointer emitted_messages[EXPECTED_NUMBER_OF_MESSAGES_EMITTED];
   GPtrArray *emitted_messages_overflow;
   gint num_emitted_messages;
+  /* contexts created by actions, stored after the transaction ends, see
+   * _store_created_contexts() */
+  GPtrArray *created_contexts;
 } PDBProcessParams;
 
 struct _PatternDB
 {
+  /* serializes ruleset updates, lookups don't take it, see below */
   GMutex ruleset_lock;
   PDBRuleSet *ruleset;
+  gint ruleset_reader_phase;
+  GAtomicCounter ruleset_readers[2];
   CorrelationState *correlation;
+  gint num_correlation_shards;
   LogTemplate *program_template;
+  GMutex rate_limits_lock;
   GHashTable *rate_limits;
   PatternDBEmitFunc emit;
   gpointer emit_data;
@@ -132,6 +141,35 @@ _flush_emitted_messages(PatternDB *self, PDBProcessParams *process_params)
     }
 }
 
+/* Contexts created by create-context actions may belong to a different
+ * correlation shard than the one locked by the transaction (or expiration)
+ * that executes the action, so they are stored after that has finished,
+ * each in a transaction of its own.  */
+static void
+_store_created_contexts(PatternDB *self, PDBProcessParams *process_params)
+{
+  if (!process_params->created_contexts)
+    return;
+
+  for (gint i = 0; i < process_params->created_contexts->len; i++)
+    {
+      PDBContext *context = g_ptr_array_index(process_params->created_contexts, i);
+
+      correlation_state_tx_begin(self->correlation, &context->super.key);
+      correlation_state_tx_store_context(self->correlation, &context->super, context->rule->context.timeout);
+      correlation_state_tx_end(self->correlation, &context->super.key);
+    }
+  g_ptr_array_free(process_params->created_contexts, TRUE);
+  process_params->created_contexts = NULL;
+}
+
+static void
+_flush_process_params(PatternDB *self, PDBProcessParams *process_params)
+{
+  _store_created_contexts(self, process_params);
+  _flush_emitted_messages(self, process_params);
+}
+
 /*
  * Timing
  * ======
@@ -181,6 +219,7 @@ _is_action_within_rate_limit(PatternDB *db, PDBProcessParams *process_params)
   CorrelationKey key;
   PDBRateLimit *rl;
   guint64 now;
+  gboolean within_rate_limit = FALSE;
 
   if (action->rate == 0)
     return TRUE;
@@ -188,6 +227,7 @@ _is_action_within_rate_limit(PatternDB *db, PDBProcessParams *process_params)
   g_string_printf(buffer, "%s:%d", rule->rule_id, action->id);
   correlation_key_init(&key, rule->context.scope, msg, buffer->str);
 
+  g_mutex_lock(&db->rate_limits_lock);
   rl = g_hash_table_lookup(db->rate_limits, &key);
   if (!rl)
     {
@@ -224,9 +264,10 @@ _is_action_within_rate_limit(PatternDB *db, PDBProcessParams *process_params)
   if (rl->buckets)
     {
       rl->buckets--;
-      return TRUE;
+      within_rate_limit = TRUE;
     }
-  return FALSE;
+  g_mutex_unlock(&db->rate_limits_lock);
+  return within_rate_limit;
 }
 
 static gboolean
@@ -319,12 +360,15 @@ _execute_action_create_context(PatternDB *db, PDBProcessParams *process_params)
 
   correlation_key_init(&key, syn_context->scope, context_msg, buffer->str);
   new_context = pdb_context_new(&key);
-  correlation_state_tx_store_context(db->correlation, &new_context->super, rule->context.timeout);
   g_string_free(buffer, FALSE);
 
   g_ptr_array_add(new_context->super.messages, context_msg);
 
   new_context->rule = pdb_rule_ref(rule);
+
+  if (!process_params->created_contexts)
+    process_params->created_contexts = g_ptr_array_new();
+  g_ptr_array_add(process_params->created_contexts, new_context);
 }
 
 static void
@@ -372,12 +416,60 @@ _execute_rule_actions(PatternDB *db, PDBProcessParams *process_params, PDBAction
     }
 }
 
+/*
+ * Ruleset updates
+ * ===============
+ *
+ * A loaded ruleset is never changed, so lookups run without locking.  A
+ * reload publishes the new ruleset by replacing the pointer atomically and
+ * frees the old one after a grace period, once no lookup can still be
+ * using it.
+ *
+ * Lookups register in one of two reader counters, selected by the current
+ * reader phase, before loading the ruleset pointer.  After publishing the
+ * new ruleset, the writer flips the phase and waits for the readers of the
+ * previous phase to drain, and does this twice, so both counters have been
+ * seen empty after the pointer was replaced.  A lookup that loaded the old
+ * pointer has incremented one of the counters before the replacement, so it
+ * is always waited for.  Flipping the phase first means that new lookups
+ * cannot keep the counter being waited for busy forever.
+ *
+ * Rules are returned by pdb_ruleset_lookup() with a reference, so they may
+ * outlive the ruleset they were looked up in.
+ */
+
+static PDBRuleSet *
+_ruleset_reader_enter(PatternDB *self, gint *phase)
+{
+  *phase = g_atomic_int_get(&self->ruleset_reader_phase) & 1;
+  g_atomic_counter_inc(&self->ruleset_readers[*phase]);
+  return (PDBRuleSet *) g_atomic_pointer_get(&self->ruleset);
+}
+
+static void
+_ruleset_reader_leave(PatternDB *self, gint phase)
+{
+  g_atomic_counter_dec_and_test(&self->ruleset_readers[phase]);
+}
+
+static void
+_ruleset_wait_for_readers(PatternDB *self)
+{
+  for (gint i = 0; i < G_N_ELEMENTS(self->ruleset_readers); i++)
+    {
+      gint phase = g_atomic_int_add(&self->ruleset_reader_phase, 1) & 1;
+
+      while (g_atomic_counter_get(&self->ruleset_readers[phase]) != 0)
+        g_thread_yield();
+    }
+}
+
 /*********************************************************
  * PatternDB
  *********************************************************/
 
-/* NOTE: this function requires PatternDB reader/writer lock to be
- * write-locked.
+/* NOTE: this function requires the correlation shard of the context to be
+ * locked.
  *
  * Currently, it is, as timer_wheel_set_time() is only called with that
  * precondition, and timer-wheel callbacks are only called from within
@@ -426,7 +518,7 @@ pattern_db_timer_tick(PatternDB *self)
       msg_debug("Advancing patterndb current time because of timer tick",
                 evt_tag_long("utc", correlation_state_get_time(self->correlation)));
     }
-  _flush_emitted_messages(self, &process_params);
+  _flush_process_params(self, &process_params);
 }
 
 /* NOTE: lock should be acquired for writing before calling this function. */
@@ -445,7 +537,7 @@ pattern_db_advance_time(PatternDB *self, gint timeout)
   PDBProcessParams process_params= {0};
 
   correlation_state_advance_time(self->correlation, timeout, &process_params);
-  _flush_emitted_messages(self, &process_params);
+  _flush_process_params(self, &process_params);
 }
 
 gboolean
@@ -461,11 +553,16 @@ pattern_db_reload_ruleset(PatternDB *self, GlobalConfig *cfg, const gchar *pdb_f
     }
   else
     {
+      PDBRuleSet *old_ruleset;
+
       g_mutex_lock(&self->ruleset_lock);
-      if (self->ruleset)
-        pdb_rule_set_free(self->ruleset);
-      self->ruleset = new_ruleset;
+      old_ruleset = self->ruleset;
+      g_atomic_pointer_set(&self->ruleset, new_ruleset);
+      _ruleset_wait_for_readers(self);
       g_mutex_unlock(&self->ruleset_lock);
+
+      if (old_ruleset)
+        pdb_rule_set_free(old_ruleset);
       return TRUE;
     }
 }
@@ -497,6 +594,14 @@ pattern_db_get_ruleset_version(PatternDB *self)
   return self->ruleset->version;
 }
 
+gint
+pattern_db_get_num_correlation_shards(PatternDB *self)
+{
+  return self->num_correlation_shards;
+}
+
+/* NOTE: the returned ruleset is only valid until the next
+ * pattern_db_reload_ruleset() call. */
 PDBRuleSet *
 pattern_db_get_ruleset(PatternDB *self)
 {
@@ -504,9 +609,9 @@ pattern_db_get_ruleset(PatternDB *self)
 }
 
 static gboolean
-_pattern_db_is_empty(PatternDB *self)
+_ruleset_is_empty(PDBRuleSet *ruleset)
 {
-  return (G_UNLIKELY(!self->ruleset) || self->ruleset->is_empty);
+  return (G_UNLIKELY(!ruleset) || ruleset->is_empty);
 }
 
 static void
@@ -516,16 +621,15 @@ _pattern_db_process_matching_rule(PatternDB *self, PDBProcessParams *process_par
   PDBRule *rule = process_params->rule;
   LogMessage *msg = process_params->msg;
   GString *buffer = g_string_sized_new(32);
+  CorrelationKey key;
 
-  correlation_state_tx_begin(self->correlation);
   if (rule->context.id_template)
     {
-      CorrelationKey key;
-
       log_template_format(rule->context.id_template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer);
       log_msg_set_value(msg, context_id_handle, buffer->str, -1);
 
       correlation_key_init(&key, rule->context.scope, msg, buffer->str);
+      correlation_state_tx_begin(self->correlation, &key);
       context = (PDBContext *) correlation_state_tx_lookup_context(self->correlation, &key);
       if (!context)
         {
@@ -570,10 +674,13 @@ _pattern_db_process_matching_rule(PatternDB *self, PDBProcessParams *process_par
   _execute_rule_actions(self, process_params, RAT_MATCH);
 
   pdb_rule_unref(rule);
-  correlation_state_tx_end(self->correlation);
 
   if (context)
-    log_msg_write_protect(msg);
+    {
+      /* key.session_id is either still in buffer or owned by the new context */
+      correlation_state_tx_end(self->correlation, &key);
+      log_msg_write_protect(msg);
+    }
 
   g_string_free(buffer, TRUE);
 }
@@ -584,7 +691,7 @@ _pattern_db_advance_time_and_flush_expired(PatternDB *self, LogMessage *msg)
   PDBProcessParams process_params = {0};
 
   _advance_time_based_on_message(self, &process_params, &msg->timestamps[LM_TS_STAMP]);
-  _flush_emitted_messages(self, &process_params);
+  _flush_process_params(self, &process_params);
 }
 
 static gboolean
@@ -593,23 +700,25 @@ _pattern_db_process(PatternDB *self, PDBLookupParams *lookup, GArray *dbg_list)
   LogMessage *msg = lookup->msg;
   PDBProcessParams process_params_p = {0};
   PDBProcessParams *process_params = &process_params_p;
+  PDBRuleSet *ruleset;
+  gint reader_phase;
 
-  g_mutex_lock(&self->ruleset_lock);
-  if (_pattern_db_is_empty(self))
+  ruleset = _ruleset_reader_enter(self, &reader_phase);
+  if (_ruleset_is_empty(ruleset))
     {
-      g_mutex_unlock(&self->ruleset_lock);
+      _ruleset_reader_leave(self, reader_phase);
       return FALSE;
     }
-  process_params->rule = pdb_ruleset_lookup(self->ruleset, lookup, dbg_list);
+  process_params->rule = pdb_ruleset_lookup(ruleset, lookup, dbg_list);
   process_params->msg = msg;
-  g_mutex_unlock(&self->ruleset_lock);
+  _ruleset_reader_leave(self, reader_phase);
 
   _pattern_db_advance_time_and_flush_expired(self, msg);
 
   if (process_params->rule)
     _pattern_db_process_matching_rule(self, process_params);
 
-  _flush_emitted_messages(self, process_params);
+  _flush_process_params(self, process_params);
 
   return process_params->rule != NULL;
 }
@@ -633,6 +742,8 @@ pattern_db_process_with_custom_message(PatternDB *self, LogMessage *msg, const g
   return _pattern_db_process(self, &lookup, NULL);
 }
 
+/* NOTE: dbg_list points into the ruleset, so the ruleset must not be
+ * reloaded while it is in use. */
 void
 pattern_db_debug_ruleset(PatternDB *self, LogMessage *msg, GArray *dbg_list)
 {
@@ -648,7 +759,7 @@ pattern_db_expire_state(PatternDB *self)
   PDBProcessParams process_params = {0};
 
   correlation_state_expire_all(self->correlation, &process_params);
-  _flush_emitted_messages(self, &process_params);
+  _flush_process_params(self, &process_params);
 
 }
 
@@ -657,8 +768,8 @@ _init_state(PatternDB *self)
 {
   self->rate_limits = g_hash_table_new_full(correlation_key_hash, correlation_key_equal, NULL,
                                             (GDestroyNotify) pdb_rate_limit_free);
-  self->correlation = correlation_state_new(pattern_db_expire_entry);
-  timer_wheel_set_associated_data(self->correlation->timer_wheel, self, NULL);
+  self->correlation = correlation_state_new(pattern_db_expire_entry, self->num_correlation_shards);
+  correlation_state_set_associated_data(self->correlation, self, NULL);
 }
 
 static void
@@ -680,13 +791,15 @@ pattern_db_forget_state(PatternDB *self)
 }
 
 PatternDB *
-pattern_db_new(const gchar *prefix)
+pattern_db_new(const gchar *prefix, gint num_correlation_shards)
 {
   PatternDB *self = g_new0(PatternDB, 1);
 
   self->prefix = g_strdup(prefix);
   self->ruleset = pdb_rule_set_new(self->prefix);
+  self->num_correlation_shards = num_correlation_shards;
   g_mutex_init(&self->ruleset_lock);
+  g_mutex_init(&self->rate_limits_lock);
   _init_state(self);
   return self;
 }
@@ -699,6 +812,7 @@ pattern_db_free(PatternDB *self)
   if (self->ruleset)
     pdb_rule_set_free(self->ruleset);
   _destroy_state(self);
+  g_mutex_clear(&self->rate_limits_lock);
   g_mutex_clear(&self->ruleset_lock);
   g_free(self);
 }
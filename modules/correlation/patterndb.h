@@ -48,7 +48,8 @@ void pattern_db_debug_ruleset(PatternDB *self, LogMessage *msg, GArray *dbg_list
 void pattern_db_expire_state(PatternDB *self);
 void pattern_db_forget_state(PatternDB *self);
 
-PatternDB *pattern_db_new(const gchar *prefix);
+PatternDB *pattern_db_new(const gchar *prefix, gint num_correlation_shards);
+gint pattern_db_get_num_correlation_shards(PatternDB *self);
 void pattern_db_free(PatternDB *self);
 
 void pattern_db_global_init(void);
@@ -373,6 +373,8 @@ _populate_ruleset_radix(gpointer key, gpointer value, gpointer user_data)
   gchar *pattern = key;
   PDBProgram *program = (PDBProgram *) value;
 
+  /* no more rules are added to the program once the patterndb is closed */
+  program->rules = r_freeze_tree(program->rules);
   r_insert_node(state->ruleset->programs, pattern, pdb_program_ref(program),
                 state->ruleset->prefix, NULL, program->pdb_location);
 }
@@ -1230,6 +1232,8 @@ pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GLis
   if (state.load_examples)
     *examples = state.examples;
 
+  state.root_program->rules = r_freeze_tree(state.root_program->rules);
+  self->programs = r_freeze_tree(self->programs);
   success = TRUE;
 
 error:
@@ -34,6 +34,7 @@
 #include "pdb-example.h"
 #include "pdb-program.h"
 #include "pdb-load.h"
+#include "pdb-lookup-params.h"
 #include "pdb-file.h"
 #include "apphook.h"
 #include "transport/transport-file.h"
@@ -459,7 +460,7 @@ pdbtool_match(int argc, char *argv[])
   proto_options.max_msg_size = 65536;
   log_proto_server_options_init(&proto_options, configuration);
 
-  patterndb = pattern_db_new(NULL);
+  patterndb = pattern_db_new(NULL, 1);
   if (!pattern_db_reload_ruleset(patterndb, configuration, patterndb_file))
     {
       goto error;
@@ -794,7 +795,7 @@ pdbtool_test(int argc, char *argv[])
             }
         }
 
-      patterndb = pattern_db_new(NULL);
+      patterndb = pattern_db_new(NULL, 1);
       if (!pdb_rule_set_load(pattern_db_get_ruleset(patterndb), configuration, argv[arg_pos], &examples))
         {
           failed_to_load = TRUE;
@@ -898,6 +899,141 @@ static GOptionEntry test_options[] =
   { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
 };
 
+static gint benchmark_iterations = 10;
+
+static GPtrArray *
+pdbtool_benchmark_load_messages(const gchar *filename)
+{
+  MsgFormatOptions parse_options;
+  LogProtoServerOptions proto_options;
+  LogProtoServer *proto;
+  GPtrArray *msgs;
+  const guchar *buf = NULL;
+  gsize buflen;
+  gboolean may_read = TRUE;
+  gint fd;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    {
+      fprintf(stderr, "Error opening file to be processed: %s\n", g_strerror(errno));
+      return NULL;
+    }
+
+  memset(&parse_options, 0, sizeof(parse_options));
+  msg_format_options_defaults(&parse_options);
+  parse_options.flags |= LP_SYSLOG_PROTOCOL | LP_EXPECT_HOSTNAME;
+  msg_format_options_init(&parse_options, configuration);
+  log_proto_server_options_defaults(&proto_options);
+  proto_options.max_msg_size = 65536;
+  log_proto_server_options_init(&proto_options, configuration);
+
+  proto = log_proto_text_server_new(log_transport_file_new(fd), &proto_options);
+  msgs = g_ptr_array_new_with_free_func((GDestroyNotify) log_msg_unref);
+  while (log_proto_server_fetch(proto, &buf, &buflen, &may_read, NULL, NULL) == LPS_SUCCESS && buf)
+    {
+      g_ptr_array_add(msgs, msg_format_parse(&parse_options, buf, buflen));
+      buf = NULL;
+    }
+
+  log_proto_server_free(proto);
+  msg_format_options_destroy(&parse_options);
+  return msgs;
+}
+
+static gint
+pdbtool_benchmark(int argc, char *argv[])
+{
+  PatternDB *patterndb;
+  PDBRuleSet *ruleset;
+  GPtrArray *msgs;
+  guint64 num_lookups = 0, num_matches = 0;
+  gint64 start, elapsed;
+  gint iteration, i;
+
+  if (!match_file)
+    {
+      fprintf(stderr, "The -f option is required to specify the sample log file\n");
+      return 1;
+    }
+
+  if (benchmark_iterations < 1)
+    {
+      fprintf(stderr, "The number of iterations must be positive\n");
+      return 1;
+    }
+
+  msgs = pdbtool_benchmark_load_messages(match_file);
+  if (!msgs)
+    return 1;
+
+  if (msgs->len == 0)
+    {
+      fprintf(stderr, "No messages found in the sample log file\n");
+      g_ptr_array_free(msgs, TRUE);
+      return 1;
+    }
+
+  patterndb = pattern_db_new(NULL, 1);
+  if (!pattern_db_reload_ruleset(patterndb, configuration, patterndb_file))
+    {
+      pattern_db_free(patterndb);
+      g_ptr_array_free(msgs, TRUE);
+      return 1;
+    }
+  ruleset = pattern_db_get_ruleset(patterndb);
+
+  start = g_get_monotonic_time();
+  for (iteration = 0; iteration < benchmark_iterations; iteration++)
+    {
+      for (i = 0; i < msgs->len; i++)
+        {
+          LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+          LogMessage *msg = log_msg_clone_cow(g_ptr_array_index(msgs, i), &path_options);
+          PDBLookupParams lookup;
+          PDBRule *rule;
+
+          pdb_lookup_params_init(&lookup, msg, NULL);
+          rule = pdb_ruleset_lookup(ruleset, &lookup, NULL);
+          if (rule)
+            {
+              num_matches++;
+              pdb_rule_unref(rule);
+            }
+          num_lookups++;
+          log_msg_unref(msg);
+        }
+    }
+  elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+  printf("Messages: %u\n", msgs->len);
+  printf("Lookups: %" G_GUINT64_FORMAT "\n", num_lookups);
+  printf("Matches: %" G_GUINT64_FORMAT "\n", num_matches);
+  printf("Elapsed: %.3f sec\n", elapsed / (gdouble) G_USEC_PER_SEC);
+  printf("Lookups per second: %.0f\n", num_lookups * (gdouble) G_USEC_PER_SEC / elapsed);
+
+  pattern_db_free(patterndb);
+  g_ptr_array_free(msgs, TRUE);
+  return 0;
+}
+
+static GOptionEntry benchmark_options[] =
+{
+  {
+    "pdb",       'p', 0, G_OPTION_ARG_STRING, &patterndb_file,
+    "Name of the patterndb file", "<patterndb_file>"
+  },
+  {
+    "file", 'f', 0, G_OPTION_ARG_STRING, &match_file,
+    "Read the sample messages from the file specified", "<file>"
+  },
+  {
+    "iterations", 'n', 0, G_OPTION_ARG_INT, &benchmark_iterations,
+    "Number of times the sample messages are looked up (default: 10)", "<iterations>"
+  },
+  { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
+};
+
 static gboolean dump_program_tree = FALSE;
 
 void
@@ -938,7 +1074,7 @@ pdbtool_dump(int argc, char *argv[])
 {
   PatternDB *patterndb;
 
-  patterndb = pattern_db_new(NULL);
+  patterndb = pattern_db_new(NULL, 1);
   if (!pattern_db_reload_ruleset(patterndb, configuration, patterndb_file))
     return 1;
 
@@ -1224,6 +1360,7 @@ static struct
   { "test", test_options, "Test pattern databases", pdbtool_test },
   { "patternize", patternize_options, "Create a pattern database from logs", pdbtool_patternize },
   { "dictionary", dictionary_options, "Dump pattern dictionary", pdbtool_dictionary },
+  { "benchmark", benchmark_options, "Measure the lookup performance of the pattern database", pdbtool_benchmark },
   { NULL, NULL },
 };
 
@@ -22,6 +22,7 @@
  */
 
 #include "radix.h"
+#include "str-scan.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -33,15 +34,97 @@
  * Parsing nodes.
  **************************************************************/
 
+/*
+ * The parsers scan their input using the str_scan_*() functions, which are
+ * vectorized where the CPU supports it.  The character classes of the
+ * STRING, SET, OPTIONALSET and EMAIL parsers depend on their parameter and
+ * are compiled into their state when the parser node is created, if the
+ * state is NULL they are compiled on the fly.
+ */
+
+typedef struct _RParserCharClasses
+{
+  CharClass digits;
+  CharClass xdigits;
+  CharClass hostname;
+  CharClass email_local_part;
+  CharClass ipv4;
+  CharClass ipv6;
+} RParserCharClasses;
+
+static RParserCharClasses parser_char_classes;
+
+static const RParserCharClasses *
+_parser_char_classes(void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter(&initialized))
+    {
+      RParserCharClasses *classes = &parser_char_classes;
+
+      char_class_init(&classes->digits);
+      char_class_add_range(&classes->digits, '0', '9');
+
+      char_class_init(&classes->xdigits);
+      char_class_add_chars(&classes->xdigits, "0123456789abcdefABCDEF");
+
+      char_class_init(&classes->hostname);
+      char_class_add_alnum(&classes->hostname);
+      char_class_add_chars(&classes->hostname, "-");
+
+      char_class_init(&classes->email_local_part);
+      char_class_add_alnum(&classes->email_local_part);
+      char_class_add_chars(&classes->email_local_part, "!#$%&'*+-/=?^_`{|}~.");
+
+      char_class_init(&classes->ipv4);
+      char_class_add_chars(&classes->ipv4, "0123456789.");
+
+      char_class_init(&classes->ipv6);
+      char_class_add_chars(&classes->ipv6, "0123456789abcdefABCDEF:.");
+
+      g_once_init_leave(&initialized, 1);
+    }
+  return &parser_char_classes;
+}
+
+static void
+_init_param_char_class(CharClass *cls, const gchar *param, gboolean alnum)
+{
+  char_class_init(cls);
+  if (alnum)
+    char_class_add_alnum(cls);
+  if (param)
+    char_class_add_chars(cls, param);
+}
+
+static gpointer
+_compile_param_char_class(const gchar *param, gboolean alnum)
+{
+  CharClass *cls = g_new(CharClass, 1);
+
+  _init_param_char_class(cls, param, alnum);
+  return cls;
+}
+
+static const CharClass *
+_get_param_char_class(gpointer state, const gchar *param, gboolean alnum, CharClass *scratch)
+{
+  if (state)
+    return (const CharClass *) state;
+
+  _init_param_char_class(scratch, param, alnum);
+  return scratch;
+}
+
 /* FIXME: maybe we should return gchar with the result */
 
 gboolean
 r_parser_string(gchar *str, gint *len, const gchar *param, gpointer state, RParserMatch *match)
 {
-  *len = 0;
+  CharClass scratch;
 
-  while (str[*len] && (g_ascii_isalnum(str[*len]) || (param && strchr(param, str[*len]))))
-    (*len)++;
+  *len = str_scan_span(str, _get_param_char_class(state, param, TRUE, &scratch));
 
   if (*len > 0)
     {
@@ -53,9 +136,9 @@ r_parser_string(gchar *str, gint *len, const gchar *param, gpointer state, RPars
 gboolean
 r_parser_qstring(gchar *str, gint *len, const gchar *param, gpointer state, RParserMatch *match)
 {
-  gchar *end;
+  const gchar *end;
 
-  if ((end = strchr(str + 1, ((gchar *)&state)[0])) != NULL)
+  if ((end = str_scan_find_char(str + 1, ((gchar *)&state)[0])) != NULL)
     {
       *len = (end - str) + 1;
 
@@ -75,12 +158,12 @@ r_parser_qstring(gchar *str, gint *len, const gchar *param, gpointer state, RPar
 gboolean
 r_parser_estring_c(gchar *str, gint *len, const gchar *param, gpointer state, RParserMatch *match)
 {
-  gchar *end;
+  const gchar *end;
 
   if (!param)
     return FALSE;
 
-  if ((end = strchr(str, param[0])) != NULL)
+  if ((end = str_scan_find_char(str, param[0])) != NULL)
     {
       *len = (end - str) + 1;
       if (match)
@@ -94,9 +177,9 @@ r_parser_estring_c(gchar *str, gint *len, const gchar *param, gpointer state, RP
 gboolean
 r_parser_nlstring(gchar *str, gint *len, const gchar *param, gpointer state, RParserMatch *match)
 {
-  gchar *end;
+  const gchar *end;
 
-  if ((end = strchr(str, '\n')) != NULL)
+  if ((end = str_scan_find_char(str, '\n')) != NULL)
     {
       /* drop CR before to LF */
       if (end - str >= 1 && *(end - 1) == '\r')
@@ -111,12 +194,12 @@ r_parser_nlstring(gchar *str, gint *len, const gchar *param, gpointer state, RPa
 gboolean
 r_parser_estring(gchar *str, gint *len, const gchar *param, gpointer state, RParserMatch *match)
 {
-  gchar *end;
+  const gchar *end;
 
   if (!param)
     return FALSE;
 
-  if ((end = strstr(str, param)) != NULL)
+  if ((end = str_scan_find_str(str, param, GPOINTER_TO_INT(state))) != NULL)
     {
       *len = (end - str) + GPOINTER_TO_INT(state);
       if (match)
@@ -228,13 +311,14 @@ r_parser_anystring(gchar *str, gint *len, const gchar *param, gpointer state, RP
 gboolean
 r_parser_set(gchar *str, gint *len, const gchar *param, gpointer state, RParserMatch *match)
 {
+  CharClass scratch;
+
   *len = 0;
 
   if (!param)
     return FALSE;
 
-  while (strchr(param, str[*len]))
-    (*len)++;
+  *len = str_scan_span(str, _get_param_char_class(state, param, FALSE, &scratch));
 
   if (*len > 0)
     {
@@ -253,16 +337,19 @@ r_parser_optionalset(gchar *str, gint *len, const gchar *param, gpointer state,
 gboolean
 r_parser_email(gchar *str, gint *len, const gchar *param, gpointer state, RParserMatch *match)
 {
+  const RParserCharClasses *classes = _parser_char_classes();
+  const CharClass *param_class = NULL;
+  CharClass scratch;
   gint end;
   int count = 0;
 
-  const gchar *email = "!#$%&'*+-/=?^_`{|}~.";
-
   *len = 0;
 
   if (param)
-    while (strchr(param, str[*len]))
-      (*len)++;
+    {
+      param_class = _get_param_char_class(state, param, FALSE, &scratch);
+      *len = str_scan_span(str, param_class);
+    }
 
   if (match)
     match->ofs = *len;
@@ -271,10 +358,9 @@ r_parser_email(gchar *str, gint *len, const gchar *param, gpointer state, RParse
   if (str[*len] == '.')
     return FALSE;
 
-  while (g_ascii_isalnum(str[*len]) || (strchr(email, str[*len])))
-    (*len)++;
+  *len += str_scan_span(str + *len, &classes->email_local_part);
   /* last character of e-mail can not be a period */
-  if (str[*len-1] == '.')
+  if (*len > 0 && str[*len-1] == '.')
     return FALSE;
 
   if (str[*len] == '@' )
@@ -284,12 +370,10 @@ r_parser_email(gchar *str, gint *len, const gchar *param, gpointer state, RParse
 
   /* Be accepting of any hostnames - if they are in the logs, they
      probably were in the DNS */
-  while (g_ascii_isalnum(str[*len]) || (str[*len] == '-' ))
+  while (char_class_contains(&classes->hostname, str[*len]))
     {
-      (*len)++;
       count++;
-      while (g_ascii_isalnum(str[*len]) || (str[*len] == '-' ))
-        (*len)++;
+      *len += str_scan_span(str + *len, &classes->hostname);
 
       if (str[*len] == '.')
         (*len)++;
@@ -298,9 +382,8 @@ r_parser_email(gchar *str, gint *len, const gchar *param, gpointer state, RParse
     return FALSE;
 
   end = *len;
-  if (param)
-    while (strchr(param, str[*len]))
-      (*len)++;
+  if (param_class)
+    *len += str_scan_span(str + *len, param_class);
 
   if (match)
     match->len = end - *len - match->ofs;
@@ -313,16 +396,15 @@ r_parser_email(gchar *str, gint *len, const gchar *param, gpointer state, RParse
 gboolean
 r_parser_hostname(gchar *str, gint *len, const gchar *param, gpointer state, RParserMatch *match)
 {
+  const CharClass *hostname_class = &_parser_char_classes()->hostname;
   int count = 0;
 
   *len = 0;
 
-  while (g_ascii_isalnum(str[*len]) || (str[*len] == '-' ))
+  while (char_class_contains(hostname_class, str[*len]))
     {
-      (*len)++;
       count++;
-      while (g_ascii_isalnum(str[*len]) || (str[*len] == '-' ))
-        (*len)++;
+      *len += str_scan_span(str + *len, hostname_class);
 
       if (str[*len] == '.')
         (*len)++;
@@ -405,10 +487,14 @@ r_parser_ipv4(gchar *str, gint *len, const gchar *param, gpointer state, RParser
 {
   gint dots = 0;
   gint octet = -1;
+  gint candidate_len;
 
+  /* the address can only consist of the characters of the span, which
+   * leaves the digits and the dots to be told apart below */
+  candidate_len = str_scan_span(str, &_parser_char_classes()->ipv4);
   *len = 0;
 
-  while (1)
+  while (*len < candidate_len)
     {
       if (str[*len] == '.')
         {
@@ -421,7 +507,7 @@ r_parser_ipv4(gchar *str, gint *len, const gchar *param, gpointer state, RParser
           dots++;
           octet = -1;
         }
-      else if (g_ascii_isdigit(str[*len]))
+      else
         {
           if (octet == -1)
             octet = 0;
@@ -430,8 +516,6 @@ r_parser_ipv4(gchar *str, gint *len, const gchar *param, gpointer state, RParser
 
           octet += g_ascii_digit_value(str[*len]);
         }
-      else
-        break;
 
       (*len)++;
     }
@@ -450,10 +534,12 @@ r_parser_ipv6(gchar *str, gint *len, const gchar *param, gpointer state, RParser
   gint octet = 0;
   gint digit = 16;
   gboolean shortened = FALSE;
+  gint candidate_len;
 
+  candidate_len = str_scan_span(str, &_parser_char_classes()->ipv6);
   *len = 0;
 
-  while (1)
+  while (*len < candidate_len)
     {
       if (str[*len] == ':')
         {
@@ -526,8 +612,7 @@ r_parser_ip(gchar *str, gint *len, const gchar *param, gpointer state, RParserMa
 static inline void
 _scan_digits(gchar *str, gint *len)
 {
-  while (g_ascii_isdigit(str[*len]))
-    (*len)++;
+  *len += str_scan_span(str + *len, &_parser_char_classes()->digits);
 }
 
 gboolean
@@ -551,8 +636,7 @@ r_parser_float(gchar *str, gint *len, const gchar *param, gpointer state, RParse
       if (str[*len] == '-')
         (*len)++;
 
-      while (g_ascii_isdigit(str[*len]))
-        (*len)++;
+      _scan_digits(str, len);
     }
 
   if (*len)
@@ -568,12 +652,9 @@ r_parser_number(gchar *str, gint *len, const gchar *param, gpointer state, RPars
 
   if (g_str_has_prefix(str, "0x") || g_str_has_prefix(str, "0X"))
     {
-      *len = 2;
+      *len = 2 + str_scan_span(str + 2, &_parser_char_classes()->xdigits);
       min_len += 2;
 
-      while (g_ascii_isxdigit(str[*len]))
-        (*len)++;
-
     }
   else
     {
@@ -585,8 +666,7 @@ r_parser_number(gchar *str, gint *len, const gchar *param, gpointer state, RPars
           min_len++;
         }
 
-      while (g_ascii_isdigit(str[*len]))
-        (*len)++;
+      _scan_digits(str, len);
     }
 
   if (*len >= min_len)
@@ -654,6 +734,8 @@ r_new_pnode(gchar *key, const gchar *capture_prefix)
     {
       parser_node->parse = r_parser_string;
       parser_node->parser_type = RPT_STRING;
+      parser_node->state = _compile_param_char_class(params_len == 3 ? params[2] : NULL, TRUE);
+      parser_node->free_state = g_free;
     }
   else if (strcmp(params[0], "ESTRING") == 0)
     {
@@ -721,6 +803,8 @@ r_new_pnode(gchar *key, const gchar *capture_prefix)
         {
           parser_node->parse = r_parser_set;
           parser_node->parser_type = RPT_SET;
+          parser_node->state = _compile_param_char_class(params[2], FALSE);
+          parser_node->free_state = g_free;
         }
       else
         {
@@ -736,6 +820,8 @@ r_new_pnode(gchar *key, const gchar *capture_prefix)
         {
           parser_node->parse = r_parser_optionalset;
           parser_node->parser_type = RPT_OPTIONALSET;
+          parser_node->state = _compile_param_char_class(params[2], FALSE);
+          parser_node->free_state = g_free;
         }
       else
         {
@@ -749,6 +835,11 @@ r_new_pnode(gchar *key, const gchar *capture_prefix)
     {
       parser_node->parse = r_parser_email;
       parser_node->parser_type = RPT_EMAIL;
+      if (params_len == 3)
+        {
+          parser_node->state = _compile_param_char_class(params[2], FALSE);
+          parser_node->free_state = g_free;
+        }
     }
   else if (strcmp(params[0], "HOSTNAME") == 0)
     {
@@ -942,6 +1033,12 @@ r_find_child_by_first_character(RNode *root, char key)
   register gint l, u, idx;
   register char k = key;
 
+  if (root->child_index)
+    {
+      idx = root->child_index[(guint8) k];
+      return idx ? root->children[idx - 1] : NULL;
+    }
+
   l = 0;
   u = root->num_children;
 
@@ -969,6 +1066,8 @@ r_insert_node(RNode *root, gchar *key, gpointer value,
   gint nodelen = root->keylen;
   gint i = 0;
 
+  g_assert(!root->frozen);
+
   if (key[0] == '@')
     {
       gchar *end;
@@ -1571,11 +1670,21 @@ r_new_node(const gchar *key, gpointer value)
   return node;
 }
 
+static void _free_frozen_node(RNode *node, void (*free_fn)(gpointer data));
+
 void
 r_free_node(RNode *node, void (*free_fn)(gpointer data))
 {
   gint i;
 
+  if (node->frozen)
+    {
+      /* the root of a frozen tree is at the start of its arena */
+      _free_frozen_node(node, free_fn);
+      g_free(node);
+      return;
+    }
+
   for (i = 0; i < node->num_children; i++)
     r_free_node(node->children[i], free_fn);
 
@@ -1598,3 +1707,229 @@ r_free_node(RNode *node, void (*free_fn)(gpointer data))
 
   g_free(node);
 }
+
+/**************************************************************
+ * Frozen trees.
+ *
+ * Once all the patterns are inserted, a tree can be frozen: it is copied
+ * into a single, contiguous arena, where the children of a node are
+ * adjacent to each other, followed by their keys, so a lookup touches
+ * far fewer cache lines than with the individually allocated nodes.
+ * Nodes with many children get a jump table indexed by the first
+ * character instead of the binary search.  Parser children keep their
+ * order, as the first parser that leads to a match wins.
+ *
+ * Frozen trees cannot be modified and can only be freed as a whole, using
+ * r_free_node() on their root.
+ **************************************************************/
+
+#define R_ARENA_ALIGN(size) (((size) + sizeof(gpointer) - 1) & ~(sizeof(gpointer) - 1))
+
+/* below this, the binary search on the children is just as good */
+#define R_CHILD_INDEX_MIN_CHILDREN 16
+#define R_CHILD_INDEX_SIZE 256
+
+typedef struct _RArena
+{
+  gchar *base;
+  gsize size;
+  gsize used;
+} RArena;
+
+static gpointer
+_arena_alloc(RArena *arena, gsize size)
+{
+  gpointer result = arena->base + arena->used;
+
+  arena->used += R_ARENA_ALIGN(size);
+  g_assert(arena->used <= arena->size);
+  return result;
+}
+
+static gchar *
+_arena_strdup(RArena *arena, const gchar *str)
+{
+  gsize len;
+  gchar *result;
+
+  if (!str)
+    return NULL;
+
+  len = strlen(str) + 1;
+  result = _arena_alloc(arena, len);
+  memcpy(result, str, len);
+  return result;
+}
+
+static gsize
+_arena_strsize(const gchar *str)
+{
+  return str ? R_ARENA_ALIGN(strlen(str) + 1) : 0;
+}
+
+static gboolean
+_needs_child_index(RNode *node)
+{
+  /* the index stores index + 1 in a guint8 */
+  return node->num_children >= R_CHILD_INDEX_MIN_CHILDREN && node->num_children < R_CHILD_INDEX_SIZE;
+}
+
+static gsize
+_child_array_size(guint num_children)
+{
+  return R_ARENA_ALIGN(num_children * sizeof(RNode *)) + num_children * R_ARENA_ALIGN(sizeof(RNode));
+}
+
+/* the size of everything @node refers to, the RNode itself is allocated by its parent */
+static gsize
+_calculate_frozen_size(RNode *node)
+{
+  gsize size = _arena_strsize(node->key) + _arena_strsize(node->pdb_location);
+  gint i;
+
+  if (node->parser)
+    size += R_ARENA_ALIGN(sizeof(RParserNode)) + _arena_strsize(node->parser->param);
+
+  size += _child_array_size(node->num_children) + _child_array_size(node->num_pchildren);
+  if (_needs_child_index(node))
+    size += R_ARENA_ALIGN(R_CHILD_INDEX_SIZE);
+
+  for (i = 0; i < node->num_children; i++)
+    size += _calculate_frozen_size(node->children[i]);
+  for (i = 0; i < node->num_pchildren; i++)
+    size += _calculate_frozen_size(node->pchildren[i]);
+  return size;
+}
+
+/* copies the node itself, ownership of the value and the parser state moves to @dst */
+static void
+_freeze_node_contents(RArena *arena, RNode *src, RNode *dst)
+{
+  *dst = *src;
+  dst->frozen = TRUE;
+  dst->key = _arena_strdup(arena, src->key);
+  dst->pdb_location = _arena_strdup(arena, src->pdb_location);
+  dst->children = NULL;
+  dst->pchildren = NULL;
+  dst->child_index = NULL;
+
+  if (src->parser)
+    {
+      dst->parser = _arena_alloc(arena, sizeof(RParserNode));
+      *dst->parser = *src->parser;
+      dst->parser->param = _arena_strdup(arena, src->parser->param);
+    }
+}
+
+static RNode **
+_freeze_child_array(RArena *arena, RNode **src_children, guint num_children)
+{
+  RNode **children;
+  RNode *nodes;
+  gint i;
+
+  if (!num_children)
+    return NULL;
+
+  children = _arena_alloc(arena, num_children * sizeof(RNode *));
+  nodes = _arena_alloc(arena, num_children * sizeof(RNode));
+
+  /* first the siblings, so that they (and their keys) end up next to each other */
+  for (i = 0; i < num_children; i++)
+    {
+      children[i] = &nodes[i];
+      _freeze_node_contents(arena, src_children[i], children[i]);
+    }
+  return children;
+}
+
+static void
+_freeze_subtree(RArena *arena, RNode *src, RNode *dst)
+{
+  gint i;
+
+  dst->children = _freeze_child_array(arena, src->children, src->num_children);
+  if (_needs_child_index(src))
+    {
+      dst->child_index = _arena_alloc(arena, R_CHILD_INDEX_SIZE);
+      memset(dst->child_index, 0, R_CHILD_INDEX_SIZE);
+      for (i = 0; i < dst->num_children; i++)
+        dst->child_index[(guint8) dst->children[i]->key[0]] = i + 1;
+    }
+
+  dst->pchildren = _freeze_child_array(arena, src->pchildren, src->num_pchildren);
+
+  for (i = 0; i < src->num_children; i++)
+    _freeze_subtree(arena, src->children[i], dst->children[i]);
+  for (i = 0; i < src->num_pchildren; i++)
+    _freeze_subtree(arena, src->pchildren[i], dst->pchildren[i]);
+}
+
+/* frees the original nodes, without their values and parser states, which are owned by the frozen copy */
+static void
+_free_node_skeleton(RNode *node)
+{
+  gint i;
+
+  for (i = 0; i < node->num_children; i++)
+    _free_node_skeleton(node->children[i]);
+  for (i = 0; i < node->num_pchildren; i++)
+    _free_node_skeleton(node->pchildren[i]);
+
+  if (node->parser)
+    {
+      g_free(node->parser->param);
+      g_free(node->parser);
+    }
+  g_free(node->children);
+  g_free(node->pchildren);
+  g_free(node->key);
+  g_free(node->pdb_location);
+  g_free(node);
+}
+
+static void
+_free_frozen_node(RNode *node, void (*free_fn)(gpointer data))
+{
+  gint i;
+
+  for (i = 0; i < node->num_children; i++)
+    _free_frozen_node(node->children[i], free_fn);
+  for (i = 0; i < node->num_pchildren; i++)
+    _free_frozen_node(node->pchildren[i], free_fn);
+
+  if (node->parser && node->parser->state && node->parser->free_state)
+    node->parser->free_state(node->parser->state);
+
+  if (node->value && free_fn)
+    free_fn(node->value);
+}
+
+/**
+ * r_freeze_tree:
+ *
+ * Copies the tree into a single arena and frees the original tree. The
+ * values of the nodes are moved over as they are.  Returns the root of the
+ * frozen tree, which replaces @root.
+ **/
+RNode *
+r_freeze_tree(RNode *root)
+{
+  RArena arena;
+  RNode *frozen_root;
+
+  if (root->frozen)
+    return root;
+
+  arena.size = R_ARENA_ALIGN(sizeof(RNode)) + _calculate_frozen_size(root);
+  arena.base = g_malloc(arena.size);
+  arena.used = 0;
+
+  frozen_root = _arena_alloc(&arena, sizeof(RNode));
+  _freeze_node_contents(&arena, root, frozen_root);
+  _freeze_subtree(&arena, root, frozen_root);
+  g_assert(arena.used == arena.size);
+
+  _free_node_skeleton(root);
+  return frozen_root;
+}
@@ -88,18 +88,22 @@ typedef gchar *(*RNodeGetValueFunc) (gpointer value);
 
 typedef struct _RNode RNode;
 
+/* the fields used during lookups come first, so that they share a cache line */
 struct _RNode
 {
   gchar *key;
   gint keylen;
-  RParserNode *parser;
-  gpointer value;
-  gchar *pdb_location;
   guint num_children;
   RNode **children;
+  /* first character -> index + 1 in children, only set in frozen nodes with many children */
+  guint8 *child_index;
 
   guint num_pchildren;
+  gboolean frozen;
   RNode **pchildren;
+  RParserNode *parser;
+  gpointer value;
+  gchar *pdb_location;
 };
 
 typedef struct _RDebugInfo
@@ -157,6 +161,7 @@ RNode *r_new_node(const gchar *key, gpointer value);
 void r_free_node(RNode *node, void (*free_fn)(gpointer data));
 void r_insert_node(RNode *root, gchar *key, gpointer value,
                    const gchar *capture_prefix, RNodeGetValueFunc value_func, const gchar *location);
+RNode *r_freeze_tree(RNode *root);
 RNode *r_find_node(RNode *root, gchar *key, gint keylen, GArray *matches);
 RNode *r_find_node_dbg(RNode *root, gchar *key, gint keylen, GArray *matches, GArray *dbg_list);
 gchar **r_find_all_applicable_nodes(RNode *root, gchar *key, gint keylen, RNodeGetValueFunc value_func);
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "correlation.h"
+#include "apphook.h"
+
+#define NUM_SHARDS 4
+#define NUM_CONTEXTS 64
+#define CONTEXT_TIMEOUT 10
+#define START_TIME 1000000
+
+static gint num_expired;
+
+static void
+_expire_context(TimerWheel *wheel, guint64 now, gpointer user_data, gpointer caller_context)
+{
+  CorrelationContext *context = user_data;
+  CorrelationState *state = timer_wheel_get_associated_data(wheel);
+
+  cr_assert_not_null(state, "Associated data should be available in every shard");
+  context->timer = NULL;
+  correlation_state_tx_remove_context(state, context);
+  num_expired++;
+}
+
+static void
+_init_key(CorrelationKey *key, gint i)
+{
+  memset(key, 0, sizeof(*key));
+  key->scope = RCS_GLOBAL;
+  key->session_id = g_strdup_printf("session-%d", i);
+}
+
+static void
+_store_contexts(CorrelationState *state)
+{
+  for (gint i = 0; i < NUM_CONTEXTS; i++)
+    {
+      CorrelationKey key;
+
+      _init_key(&key, i);
+      correlation_state_tx_begin(state, &key);
+      cr_assert_null(correlation_state_tx_lookup_context(state, &key));
+      correlation_state_tx_store_context(state, correlation_context_new(&key), CONTEXT_TIMEOUT);
+      correlation_state_tx_end(state, &key);
+    }
+}
+
+static gint
+_count_contexts(CorrelationState *state)
+{
+  gint num_contexts = 0;
+
+  for (gint i = 0; i < correlation_state_get_num_shards(state); i++)
+    num_contexts += g_hash_table_size(state->shards[i].state);
+  return num_contexts;
+}
+
+static CorrelationState *
+_create_state(gint num_shards)
+{
+  CorrelationState *state = correlation_state_new(_expire_context, num_shards);
+
+  correlation_state_set_associated_data(state, state, NULL);
+  correlation_state_advance_time(state, START_TIME, NULL);
+  return state;
+}
+
+Test(correlation_state, contexts_are_distributed_across_shards_and_found_by_key)
+{
+  CorrelationState *state = _create_state(NUM_SHARDS);
+
+  _store_contexts(state);
+  cr_assert_eq(_count_contexts(state), NUM_CONTEXTS);
+  for (gint i = 0; i < NUM_SHARDS; i++)
+    cr_assert_gt(g_hash_table_size(state->shards[i].state), 0, "Shard %d is not used", i);
+
+  for (gint i = 0; i < NUM_CONTEXTS; i++)
+    {
+      CorrelationKey key;
+
+      _init_key(&key, i);
+      correlation_state_tx_begin(state, &key);
+      CorrelationContext *context = correlation_state_tx_lookup_context(state, &key);
+      cr_assert_not_null(context);
+      cr_assert_str_eq(context->key.session_id, key.session_id);
+      correlation_state_tx_end(state, &key);
+      g_free(key.session_id);
+    }
+
+  correlation_state_unref(state);
+}
+
+Test(correlation_state, time_is_advanced_in_all_shards)
+{
+  CorrelationState *state = _create_state(NUM_SHARDS);
+
+  _store_contexts(state);
+  correlation_state_advance_time(state, CONTEXT_TIMEOUT - 1, NULL);
+  cr_assert_eq(num_expired, 0);
+
+  correlation_state_set_time(state, START_TIME + CONTEXT_TIMEOUT + 1, NULL);
+  cr_assert_eq(num_expired, NUM_CONTEXTS);
+  cr_assert_eq(_count_contexts(state), 0);
+  for (gint i = 0; i < NUM_SHARDS; i++)
+    cr_assert_eq(timer_wheel_get_time(state->shards[i].timer_wheel), START_TIME + CONTEXT_TIMEOUT + 1);
+  cr_assert_eq(correlation_state_get_time(state), START_TIME + CONTEXT_TIMEOUT + 1);
+
+  correlation_state_unref(state);
+}
+
+Test(correlation_state, time_does_not_move_backwards)
+{
+  CorrelationState *state = _create_state(NUM_SHARDS);
+
+  cr_assert_eq(correlation_state_get_time(state), START_TIME);
+
+  correlation_state_set_time(state, START_TIME + 5, NULL);
+  cr_assert_eq(correlation_state_get_time(state), START_TIME + 5);
+
+  correlation_state_set_time(state, START_TIME + 1, NULL);
+  cr_assert_eq(correlation_state_get_time(state), START_TIME + 5);
+  for (gint i = 0; i < NUM_SHARDS; i++)
+    cr_assert_eq(timer_wheel_get_time(state->shards[i].timer_wheel), START_TIME + 5);
+
+  correlation_state_advance_time(state, 1, NULL);
+  cr_assert_eq(correlation_state_get_time(state), START_TIME + 6);
+
+  correlation_state_unref(state);
+}
+
+Test(correlation_state, expire_all_expires_every_shard)
+{
+  CorrelationState *state = _create_state(NUM_SHARDS);
+
+  _store_contexts(state);
+  correlation_state_expire_all(state, NULL);
+  cr_assert_eq(num_expired, NUM_CONTEXTS);
+  cr_assert_eq(_count_contexts(state), 0);
+  cr_assert_eq(correlation_state_get_time(state), START_TIME, "expire_all() should not move the time");
+
+  correlation_state_unref(state);
+}
+
+Test(correlation_state, single_shard_state_works_the_same)
+{
+  CorrelationState *state = _create_state(1);
+
+  _store_contexts(state);
+  cr_assert_eq(_count_contexts(state), NUM_CONTEXTS);
+  correlation_state_advance_time(state, CONTEXT_TIMEOUT + 1, NULL);
+  cr_assert_eq(num_expired, NUM_CONTEXTS);
+
+  correlation_state_unref(state);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  num_expired = 0;
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(correlation_state, .init = setup, .fini = teardown);
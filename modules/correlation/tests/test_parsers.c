@@ -145,3 +145,102 @@ ParameterizedTest(ParserQStringTestParam *param, parser, test_qstring_parser)
                    param->expected_string, result_string);
   g_free(result_string);
 }
+
+typedef struct _parser_scan_test_case
+{
+  const gchar *name;
+  gboolean (*parser)(gchar *str, gint *len, const gchar *param, gpointer state, RParserMatch *match);
+  const gchar *param;
+  gpointer state;
+} ParserScanTestCase;
+
+static const gchar *scan_test_inputs[] =
+{
+  "",
+  "foo",
+  "foo bar",
+  "foo=bar,baz=qux;; end",
+  "192.168.1.1 port 22",
+  "192.168.1.256",
+  "10.0.0.1.",
+  "fe80::1ff:fe23:4567:890a%eth0",
+  "::ffff:192.0.2.128 ok",
+  "2001:db8:85a3:8d3:1319:8a2e:370:7348",
+  "0x7fffABCD zz",
+  "-12345.678e-9 rest",
+  "<john.doe@example.com>",
+  "first.last+tag@mail.sub.example.org trailing",
+  ".leading@example.com",
+  "host-name.example.com:514",
+  "'quoted string' tail",
+  "multi\nline\ntext",
+  "a somewhat longer line of text that spans several vector blocks, to check the tail handling -- end",
+};
+
+static void
+_assert_parser_results_match_scalar(ParserScanTestCase *test_case)
+{
+  for (gint i = 0; i < G_N_ELEMENTS(scan_test_inputs); i++)
+    {
+      gchar *expected_string = NULL;
+      gboolean expected_result;
+
+      cr_assert(str_scan_set_implementation(STR_SCAN_IMPL_SCALAR));
+      expected_result = _invoke_parser(test_case->parser, scan_test_inputs[i], (gpointer) test_case->param,
+                                       test_case->state, &expected_string);
+
+      for (StrScanImplementation impl = STR_SCAN_IMPL_SSE2; impl <= STR_SCAN_IMPL_AVX2; impl++)
+        {
+          gchar *result_string = NULL;
+          gboolean result;
+
+          if (!str_scan_set_implementation(impl))
+            continue;
+
+          result = _invoke_parser(test_case->parser, scan_test_inputs[i], (gpointer) test_case->param,
+                                  test_case->state, &result_string);
+          cr_assert_eq(result, expected_result, "Mismatching %s parser result, impl=%d, input=%s",
+                       test_case->name, impl, scan_test_inputs[i]);
+          if (result)
+            cr_assert_str_eq(result_string, expected_string, "Mismatching %s parser match, impl=%d, input=%s",
+                             test_case->name, impl, scan_test_inputs[i]);
+          g_free(result_string);
+        }
+      g_free(expected_string);
+    }
+  str_scan_set_implementation(STR_SCAN_IMPL_AUTO);
+}
+
+Test(parser, test_parsers_match_the_same_with_every_scan_implementation)
+{
+  gpointer string_state = _compile_param_char_class("=,;", TRUE);
+  gpointer set_state = _compile_param_char_class("abcdefo ", FALSE);
+  gpointer email_state = _compile_param_char_class("<", FALSE);
+  ParserScanTestCase test_cases[] =
+  {
+    { "STRING", r_parser_string, NULL, NULL },
+    { "STRING", r_parser_string, "=,;", NULL },
+    { "STRING", r_parser_string, "=,;", string_state },
+    { "QSTRING", r_parser_qstring, "''", _compile_qstring_state("''") },
+    { "ESTRING", r_parser_estring_c, " ", NULL },
+    { "ESTRING", r_parser_estring, ";; ", GINT_TO_POINTER(3) },
+    { "NLSTRING", r_parser_nlstring, NULL, NULL },
+    { "SET", r_parser_set, "abcdefo ", NULL },
+    { "SET", r_parser_set, "abcdefo ", set_state },
+    { "EMAIL", r_parser_email, NULL, NULL },
+    { "EMAIL", r_parser_email, "<", email_state },
+    { "HOSTNAME", r_parser_hostname, NULL, NULL },
+    { "IPv4", r_parser_ipv4, NULL, NULL },
+    { "IPv6", r_parser_ipv6, NULL, NULL },
+    { "IPvANY", r_parser_ip, NULL, NULL },
+    { "NUMBER", r_parser_number, NULL, NULL },
+    { "FLOAT", r_parser_float, NULL, NULL },
+  };
+
+  for (gint i = 0; i < G_N_ELEMENTS(test_cases); i++)
+    _assert_parser_results_match_scalar(&test_cases[i]);
+
+  g_free(string_state);
+  g_free(set_state);
+  g_free(email_state);
+}
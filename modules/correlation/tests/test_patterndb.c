@@ -71,7 +71,7 @@ assert_pdb_file_valid(const gchar *filename_)
 static PatternDB *
 _create_pattern_db(const gchar *pdb, gchar **filename)
 {
-  PatternDB *patterndb = pattern_db_new(NULL);
+  PatternDB *patterndb = pattern_db_new(NULL, 1);
   messages = g_ptr_array_new();
 
   pattern_db_set_emit_func(patterndb, _emit_func, NULL);
@@ -683,7 +683,7 @@ ParameterizedTest(PatternDBTestParam *param, pattern_db, test_rules)
 
 Test(pattern_db, test_tag_outside_of_rule_skeleton)
 {
-  PatternDB *patterndb = pattern_db_new(NULL);
+  PatternDB *patterndb = pattern_db_new(NULL, 1);
 
   char *filename;
   g_file_open_tmp("patterndbXXXXXX.xml", &filename, NULL);
@@ -794,6 +794,66 @@ Test(pattern_db, test_program_template)
   log_template_unref(template);
 }
 
+#define RELOAD_TEST_THREADS 4
+#define RELOAD_TEST_ITERATIONS 20
+
+typedef struct _ReloadTestLookupThread
+{
+  PatternDB *patterndb;
+  volatile gint *stop;
+  gint num_mismatches;
+} ReloadTestLookupThread;
+
+static gpointer
+_lookup_while_reloading_thread(gpointer user_data)
+{
+  ReloadTestLookupThread *self = (ReloadTestLookupThread *) user_data;
+
+  while (!g_atomic_int_get(self->stop))
+    {
+      LogMessage *msg = _construct_message("sshd 5", "almafa");
+
+      if (!pattern_db_process(self->patterndb, msg))
+        self->num_mismatches++;
+      log_msg_unref(msg);
+    }
+  return NULL;
+}
+
+Test(pattern_db, test_lookups_are_not_disturbed_by_concurrent_reloads)
+{
+  gchar *filename;
+  PatternDB *patterndb = _create_pattern_db(pdb_test_match_in_program, &filename);
+  ReloadTestLookupThread lookups[RELOAD_TEST_THREADS];
+  GThread *threads[RELOAD_TEST_THREADS];
+  volatile gint stop = FALSE;
+
+  /* register the name-value pairs of the ruleset before going parallel */
+  assert_msg_with_program_matches_and_nvpair_equals(patterndb, "sshd 5", "almafa", "num", "5");
+
+  for (gint i = 0; i < RELOAD_TEST_THREADS; i++)
+    {
+      lookups[i] = (ReloadTestLookupThread)
+      {
+        .patterndb = patterndb, .stop = &stop
+      };
+      threads[i] = g_thread_new(NULL, _lookup_while_reloading_thread, &lookups[i]);
+    }
+
+  for (gint i = 0; i < RELOAD_TEST_ITERATIONS; i++)
+    cr_assert(pattern_db_reload_ruleset(patterndb, configuration, filename));
+
+  g_atomic_int_set(&stop, TRUE);
+  for (gint i = 0; i < RELOAD_TEST_THREADS; i++)
+    {
+      g_thread_join(threads[i]);
+      cr_assert_eq(lookups[i].num_mismatches, 0, "Lookups should always see a complete ruleset");
+    }
+
+  _destroy_pattern_db(patterndb, filename);
+  g_free(filename);
+}
+
 void setup(void)
 {
   app_startup();
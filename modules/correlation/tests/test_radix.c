@@ -1077,6 +1077,9 @@ ParameterizedTest(RadixTestParam *param, dbparser, test_radix_search_matches, .i
     insert_node(root, param->node_to_insert[i]);
 
   test_search_matches(root, param->key, param->expected_pattern);
+
+  root = r_freeze_tree(root);
+  test_search_matches(root, param->key, param->expected_pattern);
   r_free_node(root, NULL);
 }
 
@@ -1119,3 +1122,51 @@ Test(dbparser, test_radix_zorp_log, .init = test_setup, .fini = test_teardown)
 
   r_free_node(root, NULL);
 }
+
+Test(dbparser, test_frozen_tree_finds_the_same_nodes, .init = test_setup, .fini = test_teardown)
+{
+  RNode *root = r_new_node("", NULL);
+  const gchar *first_characters = "abcdefghijklmnopqrstuvwxyz0123456789";
+  GPtrArray *keys = g_ptr_array_new_with_free_func(g_free);
+
+  /* wide enough for the first character index */
+  for (gint i = 0; first_characters[i]; i++)
+    {
+      g_ptr_array_add(keys, g_strdup_printf("%cliteral", first_characters[i]));
+      g_ptr_array_add(keys, g_strdup_printf("%cliteral@NUMBER:number@ tail", first_characters[i]));
+    }
+  for (gint i = 0; i < keys->len; i++)
+    insert_node_with_value(root, g_ptr_array_index(keys, i), g_strdup(g_ptr_array_index(keys, i)));
+
+  /* parser children keep their insertion order in the frozen tree */
+  insert_node_with_value(root, "parsers: @IPv4:ip@", g_strdup("ipv4"));
+  insert_node_with_value(root, "parsers: @QSTRING:qstring:\"@", g_strdup("qstring"));
+  insert_node_with_value(root, "competing: @IPv4:ip@", g_strdup("ipv4"));
+  insert_node_with_value(root, "competing: @NUMBER:number@", g_strdup("number"));
+
+  root = r_freeze_tree(root);
+  cr_assert(root->frozen);
+  cr_assert_not_null(root->child_index);
+
+  for (gint i = 0; first_characters[i]; i++)
+    {
+      gchar *literal = g_strdup_printf("%cliteral", first_characters[i]);
+      gchar *with_parser = g_strdup_printf("%cliteral%d tail", first_characters[i], i);
+
+      test_search_value(root, literal, g_ptr_array_index(keys, 2 * i));
+      test_search_value(root, with_parser, g_ptr_array_index(keys, 2 * i + 1));
+      g_free(literal);
+      g_free(with_parser);
+    }
+  test_search_value(root, "Xliteral", NULL);
+  test_search_value(root, "parsers: 10.0.0.1", "ipv4");
+  test_search_value(root, "parsers: \"quoted\"", "qstring");
+  test_search_value(root, "competing: 10.0.0.1", "ipv4");
+  test_search_value(root, "competing: 10", "number");
+
+  const gchar *search_pattern[] = {"number", "42", NULL};
+  test_search_matches(root, "aliteral42 tail", search_pattern);
+
+  r_free_node(root, g_free);
+  g_ptr_array_free(keys, TRUE);
+}
@@ -117,6 +117,7 @@ _is_non_corrupted_disk_buffer_file(const gchar *dir, const gchar *filename)
 static void
 _init_abandoned_disk_buffer_sc_keys(StatsClusterKey *queued_sc_key, StatsClusterKey *capacity_sc_key,
                                     StatsClusterKey *disk_allocated_sc_key, StatsClusterKey *disk_usage_sc_key,
+                                    StatsClusterKey *disk_usage_uncompressed_sc_key,
                                     const gchar *abs_filename, gboolean reliable)
 {
   enum { labels_len = 3 };
@@ -135,6 +136,10 @@ _init_abandoned_disk_buffer_sc_keys(StatsClusterKey *queued_sc_key, StatsCluster
 
   stats_cluster_single_key_set(disk_usage_sc_key, "disk_queue_disk_usage_bytes", labels, labels_len);
   stats_cluster_single_key_add_unit(disk_usage_sc_key, SCU_KIB);
+
+  stats_cluster_single_key_set(disk_usage_uncompressed_sc_key, "disk_queue_disk_usage_uncompressed_bytes",
+                               labels, labels_len);
+  stats_cluster_single_key_add_unit(disk_usage_uncompressed_sc_key, SCU_KIB);
 }
 
 static void
@@ -172,11 +177,12 @@ _set_abandoned_disk_buffer_file_metrics(const gchar *dir, const gchar *filename)
       return;
     }
 
-  StatsCounterItem *queued, *capacity, *disk_allocated, *disk_usage;
-  StatsCluster *queued_c, *capacity_c, *disk_allocated_c, *disk_usage_c;
-  StatsClusterKey queued_sc_key, capacity_sc_key, disk_allocated_sc_key, disk_usage_sc_key;
+  StatsCounterItem *queued, *capacity, *disk_allocated, *disk_usage, *disk_usage_uncompressed;
+  StatsCluster *queued_c, *capacity_c, *disk_allocated_c, *disk_usage_c, *disk_usage_uncompressed_c;
+  StatsClusterKey queued_sc_key, capacity_sc_key, disk_allocated_sc_key, disk_usage_sc_key,
+                  disk_usage_uncompressed_sc_key;
   _init_abandoned_disk_buffer_sc_keys(&queued_sc_key, &capacity_sc_key, &disk_allocated_sc_key, &disk_usage_sc_key,
-                                      abs_filename, options.reliable);
+                                      &disk_usage_uncompressed_sc_key, abs_filename, options.reliable);
 
   stats_lock();
   {
@@ -185,16 +191,20 @@ _set_abandoned_disk_buffer_file_metrics(const gchar *dir, const gchar *filename)
     disk_allocated_c = stats_register_dynamic_counter(STATS_LEVEL1, &disk_allocated_sc_key, SC_TYPE_SINGLE_VALUE,
                                                       &disk_allocated);
     disk_usage_c = stats_register_dynamic_counter(STATS_LEVEL1, &disk_usage_sc_key, SC_TYPE_SINGLE_VALUE, &disk_usage);
+    disk_usage_uncompressed_c = stats_register_dynamic_counter(STATS_LEVEL1, &disk_usage_uncompressed_sc_key,
+                                                               SC_TYPE_SINGLE_VALUE, &disk_usage_uncompressed);
 
     stats_counter_set(queued, log_queue_get_length(&queue->super));
     stats_counter_set(capacity, B_TO_KiB(qdisk_get_max_useful_space(queue->qdisk)));
     stats_counter_set(disk_allocated, B_TO_KiB(qdisk_get_file_size(queue->qdisk)));
     stats_counter_set(disk_usage, B_TO_KiB(qdisk_get_used_useful_space(queue->qdisk)));
+    stats_counter_set(disk_usage_uncompressed, B_TO_KiB(qdisk_get_used_useful_logical_space(queue->qdisk)));
 
     stats_unregister_dynamic_counter(queued_c, SC_TYPE_SINGLE_VALUE, &queued);
     stats_unregister_dynamic_counter(capacity_c, SC_TYPE_SINGLE_VALUE, &capacity);
     stats_unregister_dynamic_counter(disk_allocated_c, SC_TYPE_SINGLE_VALUE, &disk_allocated);
     stats_unregister_dynamic_counter(disk_usage_c, SC_TYPE_SINGLE_VALUE, &disk_usage);
+    stats_unregister_dynamic_counter(disk_usage_uncompressed_c, SC_TYPE_SINGLE_VALUE, &disk_usage_uncompressed);
   }
   stats_unlock();
 
@@ -213,9 +223,10 @@ _unset_abandoned_disk_buffer_file_metrics(const gchar *dir, const gchar *filenam
   gboolean reliable;
   g_assert(qdisk_is_disk_buffer_file_reliable(filename, &reliable));
 
-  StatsClusterKey queued_sc_key, capacity_sc_key, disk_allocated_sc_key, disk_usage_sc_key;
+  StatsClusterKey queued_sc_key, capacity_sc_key, disk_allocated_sc_key, disk_usage_sc_key,
+                  disk_usage_uncompressed_sc_key;
   _init_abandoned_disk_buffer_sc_keys(&queued_sc_key, &capacity_sc_key, &disk_allocated_sc_key, &disk_usage_sc_key,
-                                      abs_filename, reliable);
+                                      &disk_usage_uncompressed_sc_key, abs_filename, reliable);
 
   stats_lock();
   {
@@ -223,6 +234,7 @@ _unset_abandoned_disk_buffer_file_metrics(const gchar *dir, const gchar *filenam
     stats_remove_cluster(&capacity_sc_key);
     stats_remove_cluster(&disk_allocated_sc_key);
     stats_remove_cluster(&disk_usage_sc_key);
+    stats_remove_cluster(&disk_usage_uncompressed_sc_key);
   }
   stats_unlock();
 
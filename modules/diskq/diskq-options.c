@@ -26,6 +26,8 @@
 #include "messages.h"
 #include "reloc.h"
 
+#include <string.h>
+
 void
 disk_queue_options_front_cache_size_set(DiskQueueOptions *self, gint front_cache_size)
 {
@@ -82,6 +84,46 @@ disk_queue_options_set_prealloc(DiskQueueOptions *self, gboolean prealloc)
   self->prealloc = prealloc;
 }
 
+gboolean
+disk_queue_options_set_io_engine(DiskQueueOptions *self, const gchar *io_engine)
+{
+  if (strcmp(io_engine, "pwrite") == 0)
+    self->io_engine = DISK_QUEUE_IO_ENGINE_PWRITE;
+  else if (strcmp(io_engine, "io-uring") == 0 || strcmp(io_engine, "io_uring") == 0)
+    self->io_engine = DISK_QUEUE_IO_ENGINE_IO_URING;
+  else if (strcmp(io_engine, "mmap") == 0)
+    self->io_engine = DISK_QUEUE_IO_ENGINE_MMAP;
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+void
+disk_queue_options_set_fdatasync(DiskQueueOptions *self, gboolean fdatasync)
+{
+  self->fdatasync = fdatasync;
+}
+
+gboolean
+disk_queue_options_set_compression(DiskQueueOptions *self, const gchar *compression)
+{
+  CompressionAlgorithm algorithm;
+
+  if (!compression_algorithm_lookup(compression, &algorithm))
+    return FALSE;
+
+  /* records are compressed one by one, which needs a block compressor */
+  if (algorithm != COMPRESSION_NONE && algorithm != COMPRESSION_LZ4 && algorithm != COMPRESSION_ZSTD)
+    return FALSE;
+
+  if (!compression_algorithm_is_supported(algorithm))
+    return FALSE;
+
+  self->compression = algorithm;
+  return TRUE;
+}
+
 void
 disk_queue_options_check_plugin_settings(DiskQueueOptions *self)
 {
@@ -91,6 +133,11 @@ disk_queue_options_check_plugin_settings(DiskQueueOptions *self)
         {
           msg_warning("WARNING: flow-control-window-size/mem-buf-length parameter was ignored as it is not compatible with reliable queue. Did you mean flow-control-window-bytes?");
         }
+      if (self->io_engine == DISK_QUEUE_IO_ENGINE_MMAP && self->compression != COMPRESSION_NONE)
+        {
+          msg_warning("WARNING: io-engine(mmap) was ignored as compressed records cannot be written in place, "
+                      "falling back to io-engine(pwrite)");
+        }
     }
   else
     {
@@ -98,6 +145,10 @@ disk_queue_options_check_plugin_settings(DiskQueueOptions *self)
         {
           msg_warning("WARNING: flow-control-window-bytes/mem-buf-size parameter was ignored as it is not compatible with non-reliable queue. Did you mean flow-control-window-size?");
         }
+      if (self->io_engine != DISK_QUEUE_IO_ENGINE_PWRITE)
+        {
+          msg_warning("WARNING: io-engine() parameter was ignored as it is only supported by reliable queues");
+        }
     }
 }
 
@@ -134,6 +185,9 @@ disk_queue_options_set_default_options(DiskQueueOptions *self)
   self->dir = g_strdup(get_installation_path_for(SYSLOG_NG_PATH_LOCALSTATEDIR));
   self->truncate_size_ratio = -1;
   self->prealloc = -1;
+  self->io_engine = DISK_QUEUE_IO_ENGINE_PWRITE;
+  self->fdatasync = FALSE;
+  self->compression = COMPRESSION_NONE;
 }
 
 void
@@ -26,9 +26,17 @@
 
 #include "syslog-ng.h"
 #include "logmsg/logmsg-serialize.h"
+#include "compression.h"
 
 #define MIN_CAPACITY_BYTES 1024*1024
 
+typedef enum
+{
+  DISK_QUEUE_IO_ENGINE_PWRITE,
+  DISK_QUEUE_IO_ENGINE_IO_URING,
+  DISK_QUEUE_IO_ENGINE_MMAP,
+} DiskQueueIOEngine;
+
 typedef struct _DiskQueueOptions
 {
   gint64 capacity_bytes;
@@ -41,6 +49,9 @@ typedef struct _DiskQueueOptions
   gchar *dir;
   gdouble truncate_size_ratio;
   gboolean prealloc;
+  DiskQueueIOEngine io_engine;
+  gboolean fdatasync;
+  CompressionAlgorithm compression;
 } DiskQueueOptions;
 
 void disk_queue_options_front_cache_size_set(DiskQueueOptions *self, gint front_cache_size);
@@ -53,6 +64,9 @@ void disk_queue_options_check_plugin_settings(DiskQueueOptions *self);
 void disk_queue_options_set_dir(DiskQueueOptions *self, const gchar *dir);
 void disk_queue_options_set_truncate_size_ratio(DiskQueueOptions *self, gdouble truncate_size_ratio);
 void disk_queue_options_set_prealloc(DiskQueueOptions *self, gboolean prealloc);
+gboolean disk_queue_options_set_io_engine(DiskQueueOptions *self, const gchar *io_engine);
+void disk_queue_options_set_fdatasync(DiskQueueOptions *self, gboolean fdatasync);
+gboolean disk_queue_options_set_compression(DiskQueueOptions *self, const gchar *compression);
 void disk_queue_options_set_default_options(DiskQueueOptions *self);
 void disk_queue_options_destroy(DiskQueueOptions *self);
 
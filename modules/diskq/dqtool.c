@@ -217,6 +217,14 @@ dqtool_info(int argc, char *argv[])
       if (!open_queue(argv[i], &lq, &options))
         continue;
 
+      QDisk *qdisk = ((LogQueueDisk *) lq)->qdisk;
+      msg_info("Disk-buffer space usage",
+               evt_tag_str("filename", argv[i]),
+               evt_tag_str("compression", compression_algorithm_name(qdisk_get_compression(qdisk))),
+               evt_tag_long("capacity_bytes", qdisk_get_max_useful_space(qdisk)),
+               evt_tag_long("used_bytes", qdisk_get_used_useful_space(qdisk)),
+               evt_tag_long("uncompressed_used_bytes", qdisk_get_used_useful_logical_space(qdisk)));
+
       gboolean persistent;
       log_queue_disk_stop(lq, &persistent);
       log_queue_unref(lq);
@@ -32,6 +32,13 @@
 #define PESSIMISTIC_FLOW_CONTROL_WINDOW_BYTES 10000 * 16 *1024
 #define ENTRIES_PER_MSG_IN_MEM_Q 3
 
+typedef struct _PendingWrite
+{
+  gint64 position;
+  LogMessage *msg;
+  LogPathOptions path_options;
+} PendingWrite;
+
 static inline void
 _push_to_memory_queue_tail(GQueue *queue, gint64 position, LogMessage *msg, const LogPathOptions *path_options)
 {
@@ -62,6 +69,86 @@ _peek_memory_queue_head_position(GQueue *queue)
   return *position;
 }
 
+static inline gboolean
+_is_reserved_buffer_size_reached(LogQueueDiskReliable *self)
+{
+  return qdisk_get_empty_space(self->super.qdisk) < qdisk_get_flow_control_window_bytes(self->super.qdisk);
+}
+
+static inline gboolean
+_is_space_available_in_front_cache(LogQueueDiskReliable *self)
+{
+  gint num_of_messages_in_front_cache = g_queue_get_length(self->front_cache) / ENTRIES_PER_MSG_IN_MEM_Q;
+  return num_of_messages_in_front_cache < self->front_cache_size;
+}
+
+/* lock must be held */
+static void
+_complete_push(LogQueueDiskReliable *self, gint64 message_position, LogMessage *msg,
+               const LogPathOptions *path_options)
+{
+  LogQueue *s = &self->super.super;
+
+  if (_is_reserved_buffer_size_reached(self))
+    {
+      /*
+       * Keep the message in memory, and do not ack it, so flow-control can kick in.
+       */
+      _push_to_memory_queue_tail(self->flow_control_window, message_position, msg, path_options);
+      log_queue_memory_usage_add(s, log_msg_get_size(msg));
+      goto exit;
+    }
+
+  log_msg_ack(msg, path_options, AT_PROCESSED);
+
+  if (_is_space_available_in_front_cache(self))
+    {
+      /*
+       * Keep the message in memory for fast-path.
+       * Set its ack_needed to FALSE, because we have already acked it.
+       */
+      LogPathOptions local_options = *path_options;
+      local_options.ack_needed = FALSE;
+      _push_to_memory_queue_tail(self->front_cache, message_position, msg, &local_options);
+      log_queue_memory_usage_add(s, log_msg_get_size(msg));
+      goto exit;
+    }
+
+  log_msg_unref(msg);
+
+exit:
+  log_queue_queued_messages_inc(s);
+}
+
+/*
+ * Flushes the records written during the current batch to the disk-buffer
+ * file and completes the push of the corresponding messages. If the flush
+ * fails, the records are lost and the messages are dropped, just like in
+ * the case of a failing unbatched write.
+ *
+ * Lock must be held.
+ */
+static void
+_flush_pending_writes(LogQueueDiskReliable *self)
+{
+  if (g_queue_is_empty(self->pending_writes))
+    return;
+
+  gboolean flushed = qdisk_flush(self->super.qdisk);
+  while (!g_queue_is_empty(self->pending_writes))
+    {
+      PendingWrite *pending = g_queue_pop_head(self->pending_writes);
+
+      if (flushed)
+        _complete_push(self, pending->position, pending->msg, &pending->path_options);
+      else
+        log_queue_disk_drop_message(&self->super, pending->msg, &pending->path_options);
+      g_free(pending);
+    }
+
+  log_queue_disk_update_disk_related_counters(&self->super);
+}
+
 static gboolean
 _start(LogQueueDisk *s)
 {
@@ -112,6 +199,7 @@ _ack_backlog(LogQueue *s, gint num_msg_to_ack)
   guint i;
 
   g_mutex_lock(&s->lock);
+  _flush_pending_writes(self);
 
   for (i = 0; i < num_msg_to_ack; i++)
     {
@@ -192,6 +280,7 @@ _rewind_backlog(LogQueue *s, guint rewind_count)
   LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
 
   g_mutex_lock(&s->lock);
+  _flush_pending_writes(self);
 
   rewind_count = MIN(rewind_count, qdisk_get_backlog_count(self->super.qdisk));
   qdisk_rewind_backlog(self->super.qdisk, rewind_count);
@@ -234,6 +323,7 @@ _pop_head(LogQueue *s, LogPathOptions *path_options)
   gboolean qdisk_corrupt = FALSE;
 
   g_mutex_lock(&s->lock);
+  _flush_pending_writes(self);
 
   if (_is_next_message_in_flow_control_window(self))
     {
@@ -291,27 +381,96 @@ exit:
   return msg;
 }
 
-static inline gboolean
-_is_reserved_buffer_size_reached(LogQueueDiskReliable *self)
+static gpointer
+_flush_batch(gpointer user_data)
 {
-  return qdisk_get_empty_space(self->super.qdisk) < qdisk_get_flow_control_window_bytes(self->super.qdisk);
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *) user_data;
+  gint thread_index;
+
+  thread_index = main_loop_worker_get_thread_index();
+  g_assert(thread_index >= 0);
+
+  g_mutex_lock(&self->super.super.lock);
+  _flush_pending_writes(self);
+  self->flush_callbacks[thread_index].registered = FALSE;
+  log_queue_push_notify(&self->super.super);
+  g_mutex_unlock(&self->super.super.lock);
+  log_queue_unref(&self->super.super);
+  return NULL;
 }
 
-static inline gboolean
-_is_space_available_in_front_cache(LogQueueDiskReliable *self)
+/* lock must be held */
+static void
+_defer_push(LogQueueDiskReliable *self, gint thread_index, gint64 message_position, LogMessage *msg,
+            const LogPathOptions *path_options)
 {
-  gint num_of_messages_in_front_cache = g_queue_get_length(self->front_cache) / ENTRIES_PER_MSG_IN_MEM_Q;
-  return num_of_messages_in_front_cache < self->front_cache_size;
+  PendingWrite *pending = g_new(PendingWrite, 1);
+
+  pending->position = message_position;
+  pending->msg = msg;
+  /* matched and parent point to the stack of the caller, only keep the flags */
+  pending->path_options = (LogPathOptions) LOG_PATH_OPTIONS_INIT;
+  pending->path_options.ack_needed = path_options->ack_needed;
+  pending->path_options.flow_control_requested = path_options->flow_control_requested;
+  g_queue_push_tail(self->pending_writes, pending);
+
+  if (thread_index < 0)
+    {
+      _flush_pending_writes(self);
+      return;
+    }
+
+  LogQueueDiskReliableFlushCallback *flush_callback = &self->flush_callbacks[thread_index];
+  if (flush_callback->registered)
+    return;
+
+  /* One reference should be held, while the callback is registered
+   * avoiding use-after-free situation */
+  main_loop_worker_register_batch_callback(&flush_callback->cb);
+  flush_callback->registered = TRUE;
+  log_queue_ref(&self->super.super);
 }
 
+/*
+ * With a mapped ring (io-engine(mmap)) the message is serialized under the
+ * lock, straight into the disk-buffer file. If it does not fit into the
+ * contiguous free space of the mapping, it falls back to the usual path.
+ *
+ * Lock must be held.
+ */
+static gboolean
+_write_message(LogQueueDiskReliable *self, LogMessage *msg, GString *serialized_msg, gboolean serialized)
+{
+  if (serialized)
+    return qdisk_push_tail(self->super.qdisk, serialized_msg);
+
+  if (log_queue_disk_push_msg_in_place(&self->super, msg))
+    return TRUE;
+
+  return log_queue_disk_serialize_msg(&self->super, msg, serialized_msg)
+         && qdisk_push_tail(self->super.qdisk, serialized_msg);
+}
+
+/*
+ * With batched writes (io-engine(io-uring)) the records are only staged by
+ * qdisk_push_tail(), they are written to the file (and the messages are
+ * acked) at the end of the worker batch, or right away if the thread_index
+ * cannot be determined.
+ */
 static void
 _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
 {
   LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
+  gint thread_index;
+
+  thread_index = main_loop_worker_get_thread_index();
+  if (thread_index >= self->num_flush_callbacks)
+    thread_index = -1;
 
   ScratchBuffersMarker marker;
   GString *serialized_msg = scratch_buffers_alloc_and_mark(&marker);
-  if (!log_queue_disk_serialize_msg(&self->super, msg, serialized_msg))
+  gboolean serialize_in_place = qdisk_is_ring_mapped(self->super.qdisk);
+  if (!serialize_in_place && !log_queue_disk_serialize_msg(&self->super, msg, serialized_msg))
     {
       msg_error("Failed to serialize message for reliable disk-buffer, dropping message",
                 evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
@@ -324,7 +483,7 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
   g_mutex_lock(&s->lock);
 
   gint64 message_position = qdisk_get_next_tail_position(self->super.qdisk);
-  if (!qdisk_push_tail(self->super.qdisk, serialized_msg))
+  if (!_write_message(self, msg, serialized_msg, !serialize_in_place))
     {
       EVTTAG *suggestion = NULL;
       if (path_options->flow_control_requested)
@@ -348,40 +507,23 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
       return;
     }
 
-  log_queue_disk_update_disk_related_counters(&self->super);
-
   scratch_buffers_reclaim_marked(marker);
 
-  if (_is_reserved_buffer_size_reached(self))
-    {
-      /*
-       * Keep the message in memory, and do not ack it, so flow-control can kick in.
-       */
-      _push_to_memory_queue_tail(self->flow_control_window, message_position, msg, path_options);
-      log_queue_memory_usage_add(s, log_msg_get_size(msg));
-      goto exit;
-    }
-
-  log_msg_ack(msg, path_options, AT_PROCESSED);
-
-  if (_is_space_available_in_front_cache(self))
+  if (qdisk_has_pending_writes(self->super.qdisk))
     {
-      /*
-       * Keep the message in memory for fast-path.
-       * Set its ack_needed to FALSE, because we have already acked it.
-       */
-      LogPathOptions local_options = *path_options;
-      local_options.ack_needed = FALSE;
-      _push_to_memory_queue_tail(self->front_cache, message_position, msg, &local_options);
-      log_queue_memory_usage_add(s, log_msg_get_size(msg));
+      _defer_push(self, thread_index, message_position, msg, path_options);
+      if (thread_index >= 0)
+        {
+          g_mutex_unlock(&s->lock);
+          return;
+        }
       goto exit;
     }
 
-  log_msg_unref(msg);
+  log_queue_disk_update_disk_related_counters(&self->super);
+  _complete_push(self, message_position, msg, path_options);
 
 exit:
-  log_queue_queued_messages_inc(s);
-
   /* this releases the queue's lock for a short time, which may violate the
    * consistency of the disk-buffer, so it must be the last call under lock in this function
    */
@@ -400,6 +542,16 @@ _free(LogQueue *s)
 {
   LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
 
+  for (gint i = 0; i < self->num_flush_callbacks; i++)
+    g_assert(self->flush_callbacks[i].registered == FALSE);
+  g_free(self->flush_callbacks);
+
+  if (self->pending_writes)
+    {
+      g_assert(g_queue_is_empty(self->pending_writes));
+      g_queue_free(self->pending_writes);
+      self->pending_writes = NULL;
+    }
 
   if (self->flow_control_window)
     {
@@ -432,6 +584,7 @@ _stop(LogQueueDisk *s, gboolean *persistent)
 
   gboolean result = FALSE;
 
+  _flush_pending_writes(self);
   if (qdisk_stop(s->qdisk, NULL, NULL, NULL))
     {
       *persistent = TRUE;
@@ -489,6 +642,16 @@ log_queue_disk_reliable_new(DiskQueueOptions *options, const gchar *filename, co
   self->backlog = g_queue_new();
   self->front_cache = g_queue_new();
   self->front_cache_size = options->front_cache_size;
+  self->pending_writes = g_queue_new();
+
+  self->num_flush_callbacks = main_loop_worker_get_max_number_of_threads();
+  self->flush_callbacks = g_new0(LogQueueDiskReliableFlushCallback, self->num_flush_callbacks);
+  for (gint i = 0; i < self->num_flush_callbacks; i++)
+    {
+      worker_batch_callback_init(&self->flush_callbacks[i].cb);
+      self->flush_callbacks[i].cb.func = _flush_batch;
+      self->flush_callbacks[i].cb.user_data = self;
+    }
   _set_virtual_functions(self);
   return &self->super.super;
 }
@@ -25,6 +25,13 @@
 #define LOGQUEUE_DISK_RELIABLE_H_
 
 #include "logqueue-disk.h"
+#include "mainloop-worker.h"
+
+typedef struct _LogQueueDiskReliableFlushCallback
+{
+  WorkerBatchCallback cb;
+  gboolean registered;
+} LogQueueDiskReliableFlushCallback;
 
 typedef struct _LogQueueDiskReliable
 {
@@ -33,6 +40,12 @@ typedef struct _LogQueueDiskReliable
   GQueue *backlog;
   GQueue *front_cache;
   gint front_cache_size;
+
+  /* with batched writes, messages whose records have not been flushed to
+   * the disk-buffer file yet, they are acked at the end of the batch */
+  GQueue *pending_writes;
+  gint num_flush_callbacks;
+  LogQueueDiskReliableFlushCallback *flush_callbacks;
 } LogQueueDiskReliable;
 
 LogQueue *log_queue_disk_reliable_new(DiskQueueOptions *options, const gchar *filename, const gchar *persist_name,
@@ -110,6 +110,14 @@ _unregister_counters(LogQueueDisk *self)
         stats_cluster_key_free(self->metrics.disk_usage_sc_key);
       }
 
+    if (self->metrics.disk_usage_uncompressed_sc_key)
+      {
+        stats_unregister_counter(self->metrics.disk_usage_uncompressed_sc_key, SC_TYPE_SINGLE_VALUE,
+                                 &self->metrics.disk_usage_uncompressed);
+
+        stats_cluster_key_free(self->metrics.disk_usage_uncompressed_sc_key);
+      }
+
     if (self->metrics.disk_allocated_sc_key)
       {
         stats_unregister_counter(self->metrics.disk_allocated_sc_key, SC_TYPE_SINGLE_VALUE,
@@ -136,15 +144,56 @@ void
 log_queue_disk_update_disk_related_counters(LogQueueDisk *self)
 {
   stats_counter_set(self->metrics.disk_usage, B_TO_KiB(qdisk_get_used_useful_space(self->qdisk)));
+  stats_counter_set(self->metrics.disk_usage_uncompressed, B_TO_KiB(qdisk_get_used_useful_logical_space(self->qdisk)));
   stats_counter_set(self->metrics.disk_allocated, B_TO_KiB(qdisk_get_file_size(self->qdisk)));
 }
 
+static gboolean
+_deserialize_msg(SerializeArchive *sa, gpointer user_data)
+{
+  LogMessage *msg = user_data;
+
+  return log_msg_deserialize(msg, sa);
+}
+
+static gboolean
+_pop_disk_in_place(LogQueueDisk *self, LogMessage **msg)
+{
+  LogMessage *local_msg = log_msg_new_empty();
+  gboolean deserialized = FALSE;
+  gint64 read_head = qdisk_get_next_head_position(self->qdisk);
+
+  if (!qdisk_pop_head_in_place(self->qdisk, _deserialize_msg, local_msg, &deserialized))
+    {
+      msg_error("Cannot read correct message from disk-queue file",
+                evt_tag_str("filename", qdisk_get_filename(self->qdisk)),
+                evt_tag_int("read_head", read_head));
+      log_msg_unref(local_msg);
+      return FALSE;
+    }
+
+  if (!deserialized)
+    {
+      msg_error("Cannot read correct message from disk-queue file",
+                evt_tag_str("filename", qdisk_get_filename(self->qdisk)),
+                evt_tag_int("read_head", read_head));
+      log_msg_unref(local_msg);
+      local_msg = NULL;
+    }
+
+  *msg = local_msg;
+  return TRUE;
+}
+
 static gboolean
 _pop_disk(LogQueueDisk *self, LogMessage **msg)
 {
   if (!qdisk_started(self->qdisk))
     return FALSE;
 
+  if (qdisk_is_ring_mapped(self->qdisk))
+    return _pop_disk_in_place(self, msg);
+
   ScratchBuffersMarker marker;
   GString *read_serialized = scratch_buffers_alloc_and_mark(&marker);
 
@@ -306,6 +355,10 @@ _register_counters(LogQueueDisk *self, gint stats_level, StatsClusterKeyBuilder
   stats_cluster_key_builder_set_name(local_builder, "disk_usage_bytes");
   self->metrics.disk_usage_sc_key = stats_cluster_key_builder_build_single(local_builder);
 
+  /* same as disk_usage_bytes, unless compression() is set */
+  stats_cluster_key_builder_set_name(local_builder, "disk_usage_uncompressed_bytes");
+  self->metrics.disk_usage_uncompressed_sc_key = stats_cluster_key_builder_build_single(local_builder);
+
   stats_cluster_key_builder_set_name(local_builder, "disk_allocated_bytes");
   self->metrics.disk_allocated_sc_key = stats_cluster_key_builder_build_single(local_builder);
 
@@ -315,6 +368,8 @@ _register_counters(LogQueueDisk *self, gint stats_level, StatsClusterKeyBuilder
                            &self->metrics.capacity);
     stats_register_counter(stats_level, self->metrics.disk_usage_sc_key, SC_TYPE_SINGLE_VALUE,
                            &self->metrics.disk_usage);
+    stats_register_counter(stats_level, self->metrics.disk_usage_uncompressed_sc_key, SC_TYPE_SINGLE_VALUE,
+                           &self->metrics.disk_usage_uncompressed);
     stats_register_counter(stats_level, self->metrics.disk_allocated_sc_key, SC_TYPE_SINGLE_VALUE,
                            &self->metrics.disk_allocated);
   }
@@ -373,12 +428,16 @@ log_queue_disk_serialize_msg(LogQueueDisk *self, LogMessage *msg, GString *seria
   return TRUE;
 }
 
-static gboolean
-_deserialize_msg(SerializeArchive *sa, gpointer user_data)
+/*
+ * Serializes the message straight into the mapped ring of the disk-buffer
+ * file, see qdisk_push_tail_in_place().
+ */
+gboolean
+log_queue_disk_push_msg_in_place(LogQueueDisk *self, LogMessage *msg)
 {
-  LogMessage *msg = user_data;
+  gpointer user_data[] = { self, msg };
 
-  return log_msg_deserialize(msg, sa);
+  return qdisk_push_tail_in_place(self->qdisk, _serialize_msg, user_data);
 }
 
 gboolean
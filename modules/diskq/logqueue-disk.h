@@ -45,10 +45,12 @@ struct _LogQueueDisk
   {
     StatsClusterKey *capacity_sc_key;
     StatsClusterKey *disk_usage_sc_key;
+    StatsClusterKey *disk_usage_uncompressed_sc_key;
     StatsClusterKey *disk_allocated_sc_key;
 
     StatsCounterItem *capacity;
     StatsCounterItem *disk_usage;
+    StatsCounterItem *disk_usage_uncompressed;
     StatsCounterItem *disk_allocated;
   } metrics;
 
@@ -75,5 +77,6 @@ LogMessage *log_queue_disk_read_message(LogQueueDisk *self, LogPathOptions *path
 void log_queue_disk_drop_message(LogQueueDisk *self, LogMessage *msg, const LogPathOptions *path_options);
 gboolean log_queue_disk_serialize_msg(LogQueueDisk *self, LogMessage *msg, GString *serialized);
 gboolean log_queue_disk_deserialize_msg(LogQueueDisk *self, GString *serialized, LogMessage **msg);
+gboolean log_queue_disk_push_msg_in_place(LogQueueDisk *self, LogMessage *msg);
 
 #endif
@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "qdisk-write-batch.h"
+#include "messages.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+
+#if SYSLOG_NG_ENABLE_IO_URING
+#include <liburing.h>
+
+/* one write per segment plus the linked fdatasync() */
+#define QDISK_WRITE_BATCH_RING_ENTRIES (QDISK_WRITE_BATCH_MAX_SEGMENTS + 1)
+#endif
+
+typedef struct _QDiskWriteSegment
+{
+  gint64 offset;
+  gsize buffer_offset;
+  gsize len;
+} QDiskWriteSegment;
+
+struct _QDiskWriteBatch
+{
+  gint fd;
+  gboolean fdatasync;
+
+  gchar *buffer;
+  gsize buffer_len;
+  QDiskWriteSegment segments[QDISK_WRITE_BATCH_MAX_SEGMENTS];
+  gint num_segments;
+
+  gboolean use_io_uring;
+#if SYSLOG_NG_ENABLE_IO_URING
+  struct io_uring ring;
+#endif
+};
+
+static gboolean
+_pwrite_segment(QDiskWriteBatch *self, QDiskWriteSegment *segment, gsize already_written)
+{
+  const gchar *data = self->buffer + segment->buffer_offset;
+  gsize written = already_written;
+
+  while (written < segment->len)
+    {
+      gssize rc = pwrite(self->fd, data + written, segment->len - written, segment->offset + written);
+      if (rc < 0 && errno == EINTR)
+        continue;
+
+      if (rc <= 0)
+        {
+          msg_error("Error writing disk-queue file",
+                    evt_tag_str("error", rc < 0 ? g_strerror(errno) : "short write"),
+                    evt_tag_long("offset", segment->offset + written),
+                    evt_tag_long("bytes_to_write", segment->len - written));
+          return FALSE;
+        }
+      written += rc;
+    }
+  return TRUE;
+}
+
+static gboolean
+_sync_data(QDiskWriteBatch *self)
+{
+  if (fdatasync(self->fd) < 0)
+    {
+      msg_error("Error syncing disk-queue file", evt_tag_error("error"));
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_flush_with_pwrite(QDiskWriteBatch *self)
+{
+  for (gint i = 0; i < self->num_segments; i++)
+    {
+      if (!_pwrite_segment(self, &self->segments[i], 0))
+        return FALSE;
+    }
+
+  if (self->fdatasync)
+    return _sync_data(self);
+  return TRUE;
+}
+
+#if SYSLOG_NG_ENABLE_IO_URING
+
+static gboolean
+_init_io_uring(QDiskWriteBatch *self)
+{
+  gint rc = io_uring_queue_init(QDISK_WRITE_BATCH_RING_ENTRIES, &self->ring, 0);
+  if (rc < 0)
+    {
+      msg_warning("WARNING: io_uring is not available for disk-buffer, falling back to pwrite()",
+                  evt_tag_str("error", g_strerror(-rc)));
+      return FALSE;
+    }
+
+  struct iovec iov = { .iov_base = self->buffer, .iov_len = QDISK_WRITE_BATCH_BUFFER_SIZE };
+  rc = io_uring_register_buffers(&self->ring, &iov, 1);
+  if (rc < 0)
+    {
+      msg_warning("WARNING: Cannot register disk-buffer write buffer with io_uring, falling back to pwrite()",
+                  evt_tag_str("error", g_strerror(-rc)));
+      io_uring_queue_exit(&self->ring);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+_deinit_io_uring(QDiskWriteBatch *self)
+{
+  if (!self->use_io_uring)
+    return;
+
+  io_uring_queue_exit(&self->ring);
+  self->use_io_uring = FALSE;
+}
+
+static gint
+_submit_batch(QDiskWriteBatch *self)
+{
+  gint num_sqes = 0;
+
+  for (gint i = 0; i < self->num_segments; i++)
+    {
+      QDiskWriteSegment *segment = &self->segments[i];
+      struct io_uring_sqe *sqe = io_uring_get_sqe(&self->ring);
+
+      io_uring_prep_write_fixed(sqe, self->fd, self->buffer + segment->buffer_offset, segment->len,
+                                segment->offset, 0);
+      io_uring_sqe_set_data(sqe, segment);
+
+      /* fdatasync() must not be started before all the writes are complete */
+      if (self->fdatasync)
+        sqe->flags |= IOSQE_IO_LINK;
+      num_sqes++;
+    }
+
+  if (self->fdatasync)
+    {
+      struct io_uring_sqe *sqe = io_uring_get_sqe(&self->ring);
+
+      io_uring_prep_fsync(sqe, self->fd, IORING_FSYNC_DATASYNC);
+      io_uring_sqe_set_data(sqe, NULL);
+      num_sqes++;
+    }
+
+  gint rc;
+  do
+    {
+      rc = io_uring_submit_and_wait(&self->ring, num_sqes);
+    }
+  while (rc == -EINTR);
+
+  return rc < 0 ? rc : num_sqes;
+}
+
+static gboolean
+_flush_with_io_uring(QDiskWriteBatch *self)
+{
+  gint num_sqes = _submit_batch(self);
+  if (num_sqes < 0)
+    {
+      msg_warning("WARNING: io_uring submission failed for disk-buffer, falling back to pwrite()",
+                  evt_tag_str("error", g_strerror(-num_sqes)));
+      _deinit_io_uring(self);
+      return _flush_with_pwrite(self);
+    }
+
+  gboolean result = TRUE;
+  gboolean synced = FALSE;
+  for (gint i = 0; i < num_sqes; i++)
+    {
+      struct io_uring_cqe *cqe;
+      gint rc;
+
+      do
+        {
+          rc = io_uring_wait_cqe(&self->ring, &cqe);
+        }
+      while (rc == -EINTR);
+
+      if (rc < 0)
+        {
+          /* we lost track of the batch, writing the segments again is harmless */
+          msg_warning("WARNING: Error waiting for io_uring completion in disk-buffer, falling back to pwrite()",
+                      evt_tag_str("error", g_strerror(-rc)));
+          _deinit_io_uring(self);
+          return _flush_with_pwrite(self);
+        }
+
+      QDiskWriteSegment *segment = io_uring_cqe_get_data(cqe);
+      gint res = cqe->res;
+      io_uring_cqe_seen(&self->ring, cqe);
+
+      if (!segment)
+        {
+          synced = (res == 0);
+          if (res < 0 && res != -ECANCELED)
+            msg_error("Error syncing disk-queue file", evt_tag_str("error", g_strerror(-res)));
+          continue;
+        }
+
+      /* short writes break the link chain, the rest of the segments are
+       * cancelled, complete them (and the sync below) synchronously */
+      if (res < 0 || (gsize) res < segment->len)
+        result &= _pwrite_segment(self, segment, res < 0 ? 0 : res);
+    }
+
+  if (result && self->fdatasync && !synced)
+    result = _sync_data(self);
+
+  return result;
+}
+
+#endif
+
+gboolean
+qdisk_write_batch_add(QDiskWriteBatch *self, const gchar *data, gsize len, gint64 offset)
+{
+  if (self->buffer_len + len > QDISK_WRITE_BATCH_BUFFER_SIZE)
+    return FALSE;
+
+  QDiskWriteSegment *segment = self->num_segments > 0 ? &self->segments[self->num_segments - 1] : NULL;
+  if (!segment || segment->offset + segment->len != offset)
+    {
+      if (self->num_segments == QDISK_WRITE_BATCH_MAX_SEGMENTS)
+        return FALSE;
+
+      segment = &self->segments[self->num_segments++];
+      segment->offset = offset;
+      segment->buffer_offset = self->buffer_len;
+      segment->len = 0;
+    }
+
+  memcpy(self->buffer + self->buffer_len, data, len);
+  self->buffer_len += len;
+  segment->len += len;
+  return TRUE;
+}
+
+gboolean
+qdisk_write_batch_flush(QDiskWriteBatch *self)
+{
+  if (qdisk_write_batch_is_empty(self))
+    return TRUE;
+
+  gboolean result;
+#if SYSLOG_NG_ENABLE_IO_URING
+  if (self->use_io_uring)
+    result = _flush_with_io_uring(self);
+  else
+#endif
+    result = _flush_with_pwrite(self);
+
+  self->buffer_len = 0;
+  self->num_segments = 0;
+  return result;
+}
+
+gboolean
+qdisk_write_batch_is_empty(QDiskWriteBatch *self)
+{
+  return self->num_segments == 0;
+}
+
+gboolean
+qdisk_write_batch_uses_io_uring(QDiskWriteBatch *self)
+{
+  return self->use_io_uring;
+}
+
+void
+qdisk_write_batch_free(QDiskWriteBatch *self)
+{
+  g_assert(qdisk_write_batch_is_empty(self));
+
+#if SYSLOG_NG_ENABLE_IO_URING
+  _deinit_io_uring(self);
+#endif
+  g_free(self->buffer);
+  g_free(self);
+}
+
+QDiskWriteBatch *
+qdisk_write_batch_new(gint fd, gboolean use_io_uring, gboolean fdatasync)
+{
+  QDiskWriteBatch *self = g_new0(QDiskWriteBatch, 1);
+
+  self->fd = fd;
+  self->fdatasync = fdatasync;
+  self->buffer = g_malloc(QDISK_WRITE_BATCH_BUFFER_SIZE);
+
+#if SYSLOG_NG_ENABLE_IO_URING
+  if (use_io_uring)
+    self->use_io_uring = _init_io_uring(self);
+#else
+  if (use_io_uring)
+    msg_warning("WARNING: syslog-ng was compiled without io_uring support, disk-buffer falls back to pwrite()");
+#endif
+
+  return self;
+}
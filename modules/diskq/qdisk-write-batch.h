@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef QDISK_WRITE_BATCH_H_
+#define QDISK_WRITE_BATCH_H_
+
+#include "syslog-ng.h"
+
+/*
+ * Collects the records written to a disk-buffer file and writes them out
+ * in one go. Records appended at consecutive offsets are coalesced into a
+ * single segment.
+ *
+ * With io_uring, the staging buffer is registered with the ring, each
+ * segment becomes a fixed-buffer write and the optional fdatasync() is
+ * linked after them, so the whole batch costs a single submission. If
+ * io_uring is not available (or fails at runtime), the segments are written
+ * with pwrite().
+ *
+ * qdisk_write_batch_add() returns FALSE if the record does not fit into the
+ * batch, in which case the caller has to flush it first.
+ */
+
+#define QDISK_WRITE_BATCH_BUFFER_SIZE (1024 * 1024)
+#define QDISK_WRITE_BATCH_MAX_SEGMENTS 16
+
+typedef struct _QDiskWriteBatch QDiskWriteBatch;
+
+QDiskWriteBatch *qdisk_write_batch_new(gint fd, gboolean use_io_uring, gboolean fdatasync);
+gboolean qdisk_write_batch_add(QDiskWriteBatch *self, const gchar *data, gsize len, gint64 offset);
+gboolean qdisk_write_batch_flush(QDiskWriteBatch *self);
+gboolean qdisk_write_batch_is_empty(QDiskWriteBatch *self);
+gboolean qdisk_write_batch_uses_io_uring(QDiskWriteBatch *self);
+void qdisk_write_batch_free(QDiskWriteBatch *self);
+
+#endif /* QDISK_WRITE_BATCH_H_ */
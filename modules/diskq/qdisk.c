@@ -22,6 +22,7 @@
  */
 
 #include "qdisk.h"
+#include "qdisk-write-batch.h"
 #include "logpipe.h"
 #include "messages.h"
 #include "serialize.h"
@@ -30,6 +31,7 @@
 #include "reloc.h"
 #include "compat/lfs.h"
 #include "scratch-buffers.h"
+#include "compression.h"
 
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -48,10 +50,24 @@
 #endif
 
 #define MAX_RECORD_LENGTH 100 * 1024 * 1024
+#define QDISK_RING_DEFAULT_SYNC_THRESHOLD (16 * 1024 * 1024)
 
 #define PATH_QDISK              PATH_LOCALSTATEDIR
 
-#define QDISK_HDR_VERSION_CURRENT 3
+#define QDISK_HDR_VERSION_CURRENT 4
+
+/*
+ * compression(): the payload of each record starts with a frame header:
+ *
+ *   [u8 method][u32 BE payload length][payload]
+ *
+ * method is QDISK_FRAME_COMPRESSED or QDISK_FRAME_RAW, records that do not
+ * shrink are stored raw. The record length in front of the frame covers
+ * the frame header too, so records can be skipped without decompressing.
+ */
+#define QDISK_FRAME_HEADER_LEN (sizeof(guint8) + sizeof(guint32))
+#define QDISK_FRAME_RAW 0
+#define QDISK_FRAME_COMPRESSED 1
 
 #define QDISK_FILENAME_PREFIX "syslog-ng-"
 #define QDISK_FILENAME_IDX_FMT "%05d"
@@ -90,6 +106,13 @@ typedef union _QDiskFileHeader
 
     guint8 use_v1_wrap_condition;
     gint64 capacity_bytes;
+
+    /* CompressionAlgorithm of the records, COMPRESSION_NONE means unframed records */
+    guint8 compression;
+    /* uncompressed size of [read_head, write_head) and [backlog_head, read_head),
+     * only maintained for compressed files */
+    gint64 logical_queue_bytes;
+    gint64 logical_backlog_bytes;
   };
   gchar _pad2[QDISK_RESERVED_SPACE];
 } QDiskFileHeader;
@@ -102,6 +125,28 @@ struct _QDisk
   gint64 cached_file_size;
   QDiskFileHeader *hdr;
   DiskQueueOptions *options;
+
+  /* Batched writes (io-engine(io-uring)): while records are waiting in
+   * write_batch, hdr points to staged_hdr and the mmapped header is kept
+   * in committed_hdr, so the header in the file never refers to data that
+   * has not been written yet. */
+  QDiskWriteBatch *write_batch;
+  QDiskFileHeader *staged_hdr;
+  QDiskFileHeader *committed_hdr;
+
+  /* Mapped ring (io-engine(mmap)): the first capacity_bytes of the file
+   * are mapped, records inside it are serialized and deserialized in
+   * place. Records crossing the end of the mapping use pwrite()/pread().
+   * [dirty_start, dirty_end) is the range written since the last msync(). */
+  gchar *ring;
+  gint64 ring_size;
+  gint64 dirty_start;
+  gint64 dirty_end;
+
+  /* compression(): the compressor of hdr->compression and a buffer for
+   * the framed form of the record being pushed or popped */
+  BlockCompressor *compressor;
+  GString *framed_record;
 };
 
 #define QDISK_ERROR qdisk_error_quark()
@@ -425,6 +470,14 @@ _possible_size_reduction_reaches_truncate_threshold(QDisk *self, gint64 expected
 static void
 _maybe_truncate_file(QDisk *self, gint64 expected_size)
 {
+  /* the mapped ring must stay backed by the file */
+  if (self->ring && expected_size < self->ring_size)
+    {
+      if (self->cached_file_size <= self->ring_size)
+        return;
+      expected_size = self->ring_size;
+    }
+
   if (_ftruncate_would_reduce_file(self, expected_size) &&
       !_possible_size_reduction_reaches_truncate_threshold(self, expected_size) &&
       G_LIKELY(!self->hdr->use_v1_wrap_condition))
@@ -671,6 +724,16 @@ qdisk_get_used_useful_space(QDisk *self)
   return qdisk_get_max_useful_space(self) - qdisk_get_empty_space(self);
 }
 
+/* the space the records would take without compression() */
+gint64
+qdisk_get_used_useful_logical_space(QDisk *self)
+{
+  if (self->hdr->compression == COMPRESSION_NONE)
+    return qdisk_get_used_useful_space(self);
+
+  return self->hdr->logical_queue_bytes + self->hdr->logical_backlog_bytes;
+}
+
 static inline gboolean
 _could_not_wrap_write_head_last_push_but_now_can(QDisk *self)
 {
@@ -678,6 +741,180 @@ _could_not_wrap_write_head_last_push_but_now_can(QDisk *self)
          && _is_able_to_reset_write_head_to_beginning_of_qdisk(self);
 }
 
+static inline gboolean
+_has_pending_writes(QDisk *self)
+{
+  return self->committed_hdr != NULL;
+}
+
+static void
+_stage_header(QDisk *self)
+{
+  if (!self->write_batch || _has_pending_writes(self))
+    return;
+
+  memcpy(self->staged_hdr, self->hdr, sizeof(QDiskFileHeader));
+  self->committed_hdr = self->hdr;
+  self->hdr = self->staged_hdr;
+}
+
+static void
+_unstage_header(QDisk *self)
+{
+  self->hdr = self->committed_hdr;
+  self->committed_hdr = NULL;
+}
+
+static gboolean
+_write_record(QDisk *self, GString *record)
+{
+  gint64 position = self->hdr->write_head;
+
+  if (!self->write_batch)
+    return pwrite_strict(self->fd, record->str, record->len, position);
+
+  if (qdisk_write_batch_add(self->write_batch, record->str, record->len, position))
+    return TRUE;
+
+  /* writing the data ahead of the header is safe, the header is only
+   * committed in qdisk_flush() */
+  if (!qdisk_write_batch_flush(self->write_batch))
+    return FALSE;
+
+  if (qdisk_write_batch_add(self->write_batch, record->str, record->len, position))
+    return TRUE;
+
+  return pwrite_strict(self->fd, record->str, record->len, position);
+}
+
+static inline gboolean
+_is_compressed(QDisk *self)
+{
+  return self->hdr->compression != COMPRESSION_NONE;
+}
+
+/* the compressor follows hdr->compression, which only changes while the file is empty */
+static BlockCompressor *
+_get_compressor(QDisk *self)
+{
+  CompressionAlgorithm algorithm = self->hdr->compression;
+
+  if (self->compressor && block_compressor_get_algorithm(self->compressor) == algorithm)
+    return self->compressor;
+
+  block_compressor_free(self->compressor);
+  self->compressor = block_compressor_new(algorithm, COMPRESSION_LEVEL_DEFAULT);
+  return self->compressor;
+}
+
+/* record is a serialized record (length + payload) as produced by qdisk_serialize() */
+static gboolean
+_frame_record(QDisk *self, GString *record, GString *framed)
+{
+  const gsize frame_start = sizeof(guint32) + QDISK_FRAME_HEADER_LEN;
+  const gchar *payload = record->str + sizeof(guint32);
+  guint32 payload_len = record->len - sizeof(guint32);
+
+  BlockCompressor *compressor = _get_compressor(self);
+  if (!compressor)
+    return FALSE;
+
+  g_string_set_size(framed, frame_start);
+  if (!block_compressor_compress(compressor, payload, payload_len, framed))
+    return FALSE;
+
+  guint8 method = QDISK_FRAME_COMPRESSED;
+  if (framed->len - frame_start >= payload_len)
+    {
+      g_string_truncate(framed, frame_start);
+      g_string_append_len(framed, payload, payload_len);
+      method = QDISK_FRAME_RAW;
+    }
+
+  guint32 record_len = GUINT32_TO_BE(framed->len - sizeof(guint32));
+  guint32 payload_len_be = GUINT32_TO_BE(payload_len);
+  memcpy(framed->str, &record_len, sizeof(record_len));
+  framed->str[sizeof(guint32)] = method;
+  memcpy(framed->str + sizeof(guint32) + sizeof(guint8), &payload_len_be, sizeof(payload_len_be));
+  return TRUE;
+}
+
+static inline gboolean
+_parse_frame_header(const gchar *frame_header, guint8 *method, guint32 *payload_len)
+{
+  *method = frame_header[0];
+  memcpy(payload_len, frame_header + sizeof(guint8), sizeof(*payload_len));
+  *payload_len = GUINT32_FROM_BE(*payload_len);
+
+  return (*method == QDISK_FRAME_RAW || *method == QDISK_FRAME_COMPRESSED)
+         && *payload_len > 0 && *payload_len <= MAX_RECORD_LENGTH;
+}
+
+/* framed is the record payload read from the file, the original payload is stored into record */
+static gboolean
+_unframe_record(QDisk *self, GString *framed, GString *record, gint64 position)
+{
+  guint8 method;
+  guint32 payload_len;
+
+  if (framed->len < QDISK_FRAME_HEADER_LEN || !_parse_frame_header(framed->str, &method, &payload_len))
+    goto invalid;
+
+  const gchar *data = framed->str + QDISK_FRAME_HEADER_LEN;
+  gsize data_len = framed->len - QDISK_FRAME_HEADER_LEN;
+
+  g_string_truncate(record, 0);
+  if (method == QDISK_FRAME_RAW)
+    {
+      if (data_len != payload_len)
+        goto invalid;
+      g_string_append_len(record, data, data_len);
+      return TRUE;
+    }
+
+  BlockCompressor *compressor = _get_compressor(self);
+  if (compressor && block_compressor_decompress(compressor, data, data_len, payload_len, record))
+    return TRUE;
+
+invalid:
+  msg_error("Disk-queue file contains invalid compressed record",
+            evt_tag_str("filename", self->filename),
+            evt_tag_str("compression", compression_algorithm_name(self->hdr->compression)),
+            evt_tag_long("offset", position));
+  return FALSE;
+}
+
+/*
+ * Writes out the records collected since the last flush and commits the
+ * header. If the records cannot be written, the header is reverted to its
+ * last committed state, which drops every record pushed since then.
+ */
+gboolean
+qdisk_flush(QDisk *self)
+{
+  if (!_has_pending_writes(self))
+    return TRUE;
+
+  if (!qdisk_write_batch_flush(self->write_batch))
+    {
+      msg_error("Error writing disk-queue file, dropping records written since the last flush",
+                evt_tag_str("filename", self->filename),
+                evt_tag_long("dropped_records", self->hdr->length - self->committed_hdr->length));
+      _unstage_header(self);
+      return FALSE;
+    }
+
+  memcpy(self->committed_hdr, self->hdr, sizeof(QDiskFileHeader));
+  _unstage_header(self);
+  return TRUE;
+}
+
+gboolean
+qdisk_has_pending_writes(QDisk *self)
+{
+  return _has_pending_writes(self);
+}
+
 gint64
 qdisk_get_next_tail_position(QDisk *self)
 {
@@ -687,12 +924,9 @@ qdisk_get_next_tail_position(QDisk *self)
   return self->hdr->write_head;
 }
 
-gboolean
-qdisk_push_tail(QDisk *self, GString *record)
+static gboolean
+_prepare_push(QDisk *self, gsize record_len)
 {
-  if (!qdisk_started(self))
-    return FALSE;
-
   if (_could_not_wrap_write_head_last_push_but_now_can(self))
     {
       /*
@@ -703,18 +937,13 @@ qdisk_push_tail(QDisk *self, GString *record)
       self->hdr->write_head = QDISK_RESERVED_SPACE;
     }
 
-  if (!qdisk_is_space_avail(self, record->len))
-    return FALSE;
-
-  if (!pwrite_strict(self->fd, record->str, record->len, self->hdr->write_head))
-    {
-      msg_error("Error writing disk-queue file",
-                evt_tag_error("error"));
-      return FALSE;
-    }
-
-  self->hdr->write_head = self->hdr->write_head + record->len;
+  return qdisk_is_space_avail(self, record_len);
+}
 
+static void
+_finish_push(QDisk *self, gsize record_len)
+{
+  self->hdr->write_head = self->hdr->write_head + record_len;
 
   /* NOTE: we only wrap around if the read head is before the write,
    * otherwise we'd truncate the data the read head is still processing, e.g.
@@ -765,6 +994,153 @@ qdisk_push_tail(QDisk *self, GString *record)
         }
     }
   self->hdr->length++;
+}
+
+gboolean
+qdisk_push_tail(QDisk *self, GString *record)
+{
+  if (!qdisk_started(self))
+    return FALSE;
+
+  _stage_header(self);
+
+  GString *record_to_write = record;
+  if (_is_compressed(self))
+    {
+      if (!_frame_record(self, record, self->framed_record))
+        {
+          msg_error("Error compressing disk-queue record",
+                    evt_tag_str("filename", self->filename),
+                    evt_tag_str("compression", compression_algorithm_name(self->hdr->compression)));
+          return FALSE;
+        }
+      record_to_write = self->framed_record;
+    }
+
+  if (!_prepare_push(self, record_to_write->len))
+    return FALSE;
+
+  if (!_write_record(self, record_to_write))
+    {
+      msg_error("Error writing disk-queue file",
+                evt_tag_error("error"));
+      return FALSE;
+    }
+
+  _finish_push(self, record_to_write->len);
+  if (_is_compressed(self))
+    self->hdr->logical_queue_bytes += record->len;
+  return TRUE;
+}
+
+static gint64
+_get_ring_free_space_end(QDisk *self, gint64 position)
+{
+  if (position < self->hdr->backlog_head)
+    return MIN(self->hdr->backlog_head, self->ring_size);
+
+  return self->ring_size;
+}
+
+static gsize
+_get_system_page_size(void)
+{
+  static gsize page_size;
+
+  if (!page_size)
+    page_size = sysconf(_SC_PAGESIZE);
+  return page_size;
+}
+
+static void
+_sync_ring(QDisk *self, gint flags)
+{
+  if (self->dirty_end <= self->dirty_start)
+    return;
+
+  gint64 start = self->dirty_start - self->dirty_start % _get_system_page_size();
+  if (msync(self->ring + start, self->dirty_end - start, flags) < 0)
+    msg_error("Error syncing disk-queue file",
+              evt_tag_str("filename", self->filename),
+              evt_tag_error("error"));
+
+  self->dirty_start = self->dirty_end = 0;
+}
+
+static gint64
+_get_ring_sync_threshold(QDisk *self)
+{
+  if (self->options->flow_control_window_bytes > 0)
+    return self->options->flow_control_window_bytes;
+  return QDISK_RING_DEFAULT_SYNC_THRESHOLD;
+}
+
+/*
+ * Written data is flushed with an asynchronous msync() each time the
+ * range written since the last sync reaches flow-control-window-bytes(),
+ * which is the amount of data that is kept in memory anyway, or when the
+ * write head wraps around.
+ */
+static void
+_mark_ring_dirty(QDisk *self, gint64 position, gsize len)
+{
+  if (self->dirty_end > self->dirty_start && position < self->dirty_start)
+    _sync_ring(self, MS_ASYNC);
+
+  if (self->dirty_end <= self->dirty_start)
+    self->dirty_start = position;
+  self->dirty_end = MAX(self->dirty_end, position + (gint64) len);
+
+  if (self->dirty_end - self->dirty_start >= _get_ring_sync_threshold(self))
+    _sync_ring(self, MS_ASYNC);
+}
+
+gboolean
+qdisk_is_ring_mapped(QDisk *self)
+{
+  return self->ring != NULL;
+}
+
+/*
+ * Serializes a record straight into the mapped ring at the write head,
+ * saving the copy through an intermediate GString. Returns FALSE without
+ * changing the queue if the ring is not mapped, the record does not fit
+ * into the contiguous free space of the mapping, there is no space left or
+ * the records are compressed, in which case the caller should fall back to
+ * qdisk_serialize() and qdisk_push_tail().
+ */
+gboolean
+qdisk_push_tail_in_place(QDisk *self, QDiskSerializeFunc serialize_func, gpointer user_data)
+{
+  if (!qdisk_started(self) || !self->ring || _is_compressed(self))
+    return FALSE;
+
+  gint64 position = qdisk_get_next_tail_position(self);
+  gint64 free_space_end = _get_ring_free_space_end(self, position);
+  if (position + (gint64) sizeof(guint32) >= free_space_end)
+    return FALSE;
+
+  gchar *record = self->ring + position;
+  SerializeArchive *sa = serialize_buffer_archive_new(record, free_space_end - position);
+  sa->silent = TRUE;
+  gboolean serialized = serialize_write_uint32(sa, 0) && serialize_func(sa, user_data);
+  gsize record_len = serialize_buffer_archive_get_pos(sa);
+  serialize_archive_free(sa);
+
+  if (!serialized || record_len <= sizeof(guint32))
+    return FALSE;
+
+  /* we have only written free space so far, nothing to undo if this fails */
+  if (!_prepare_push(self, record_len))
+    return FALSE;
+
+  g_assert(self->hdr->write_head == position);
+
+  guint32 payload_len = GUINT32_TO_BE(record_len - sizeof(guint32));
+  memcpy(record, &payload_len, sizeof(payload_len));
+
+  _mark_ring_dirty(self, position, record_len);
+  _finish_push(self, record_len);
   return TRUE;
 }
 
@@ -830,6 +1206,24 @@ _try_reading_record_length(QDisk *self, gint64 position, guint32 *record_length)
   return TRUE;
 }
 
+static inline gboolean
+_read_frame_header_from_disk(QDisk *self, gint64 position, guint32 *payload_len)
+{
+  gchar frame_header[QDISK_FRAME_HEADER_LEN];
+  guint8 method;
+
+  gssize bytes_read = pread(self->fd, frame_header, sizeof(frame_header), position + sizeof(guint32));
+  if (bytes_read != sizeof(frame_header) || !_parse_frame_header(frame_header, &method, payload_len))
+    {
+      msg_error("Error reading disk-queue file, invalid compressed record header",
+                evt_tag_str("error", bytes_read < 0 ? g_strerror(errno) : "short read or invalid header"),
+                evt_tag_str("filename", self->filename),
+                evt_tag_long("offset", position));
+      return FALSE;
+    }
+  return TRUE;
+}
+
 static inline gboolean
 _read_record_from_disk(QDisk *self, GString *record, guint32 record_length)
 {
@@ -872,6 +1266,13 @@ _update_position_after_read(QDisk *self, guint32 record_length, gint64 *position
   *position = new_position;
 }
 
+static inline void
+_move_logical_bytes_to_backlog(QDisk *self, gint64 logical_len)
+{
+  self->hdr->logical_queue_bytes -= logical_len;
+  self->hdr->logical_backlog_bytes += logical_len;
+}
+
 gint64
 qdisk_get_next_head_position(QDisk *self)
 {
@@ -885,6 +1286,9 @@ qdisk_get_next_head_position(QDisk *self)
 gboolean
 qdisk_pop_head(QDisk *self, GString *record)
 {
+  if (!qdisk_flush(self))
+    return FALSE;
+
   if (self->hdr->read_head == self->hdr->write_head)
     return FALSE;
 
@@ -895,9 +1299,86 @@ qdisk_pop_head(QDisk *self, GString *record)
   if (!_try_reading_record_length(self, self->hdr->read_head, &record_length))
     return FALSE;
 
-  if (!_read_record_from_disk(self, record, record_length))
+  if (_is_compressed(self))
+    {
+      if (!_read_record_from_disk(self, self->framed_record, record_length))
+        return FALSE;
+
+      if (!_unframe_record(self, self->framed_record, record, self->hdr->read_head))
+        return FALSE;
+
+      _move_logical_bytes_to_backlog(self, sizeof(guint32) + record->len);
+    }
+  else if (!_read_record_from_disk(self, record, record_length))
+    {
+      return FALSE;
+    }
+
+  _update_position_after_read(self, record_length, &self->hdr->read_head);
+  self->hdr->length--;
+  self->hdr->backlog_len++;
+
+  _maybe_apply_non_reliable_corrections(self);
+  return TRUE;
+}
+
+static gboolean
+_pop_head_and_deserialize(QDisk *self, QDiskDeSerializeFunc deserialize_func, gpointer user_data,
+                          gboolean *deserialized)
+{
+  ScratchBuffersMarker marker;
+  GString *record = scratch_buffers_alloc_and_mark(&marker);
+  GError *error = NULL;
+
+  gboolean result = qdisk_pop_head(self, record);
+  if (result)
+    {
+      *deserialized = qdisk_deserialize(record, deserialize_func, user_data, &error);
+      g_clear_error(&error);
+    }
+
+  scratch_buffers_reclaim_marked(marker);
+  return result;
+}
+
+/*
+ * Pops the next record and deserializes it straight from the mapped ring.
+ * Records outside of the mapping (or all of them, if the ring is not
+ * mapped, or the records are compressed) are read through a temporary
+ * buffer. Returns FALSE if the record could not be read, otherwise
+ * *deserialized tells if deserialize_func succeeded.
+ */
+gboolean
+qdisk_pop_head_in_place(QDisk *self, QDiskDeSerializeFunc deserialize_func, gpointer user_data,
+                        gboolean *deserialized)
+{
+  if (!self->ring || _is_compressed(self))
+    return _pop_head_and_deserialize(self, deserialize_func, user_data, deserialized);
+
+  if (self->hdr->read_head == self->hdr->write_head)
+    return FALSE;
+
+  if (self->hdr->read_head > self->hdr->write_head)
+    self->hdr->read_head = _correct_position_if_max_size_is_reached(self, self->hdr->read_head);
+
+  gint64 position = self->hdr->read_head;
+  if (position + (gint64) sizeof(guint32) > self->ring_size)
+    return _pop_head_and_deserialize(self, deserialize_func, user_data, deserialized);
+
+  guint32 record_length;
+  memcpy(&record_length, self->ring + position, sizeof(record_length));
+  record_length = GUINT32_FROM_BE(record_length);
+  if (!_is_record_length_valid(self, sizeof(record_length), record_length, position))
     return FALSE;
 
+  gint64 record_start = position + sizeof(record_length);
+  if (record_start + record_length > self->ring_size)
+    return _pop_head_and_deserialize(self, deserialize_func, user_data, deserialized);
+
+  SerializeArchive *sa = serialize_buffer_archive_new(self->ring + record_start, record_length);
+  *deserialized = deserialize_func(sa, user_data);
+  serialize_archive_free(sa);
+
   _update_position_after_read(self, record_length, &self->hdr->read_head);
   self->hdr->length--;
   self->hdr->backlog_len++;
@@ -906,8 +1387,9 @@ qdisk_pop_head(QDisk *self, GString *record)
   return TRUE;
 }
 
+/* logical_len is the uncompressed size of the record, only filled for compressed files */
 static gboolean
-_skip_record(QDisk *self, gint64 position, gint64 *new_position)
+_skip_record(QDisk *self, gint64 position, gint64 *new_position, gint64 *logical_len)
 {
   if (position == self->hdr->write_head)
     return FALSE;
@@ -921,6 +1403,14 @@ _skip_record(QDisk *self, gint64 position, gint64 *new_position)
   if (!_try_reading_record_length(self, *new_position, &record_length))
     return FALSE;
 
+  if (_is_compressed(self))
+    {
+      guint32 payload_len;
+      if (!_read_frame_header_from_disk(self, *new_position, &payload_len))
+        return FALSE;
+      *logical_len = sizeof(guint32) + payload_len;
+    }
+
   _update_position_after_read(self, record_length, new_position);
   return TRUE;
 }
@@ -928,10 +1418,15 @@ _skip_record(QDisk *self, gint64 position, gint64 *new_position)
 gboolean
 qdisk_remove_head(QDisk *self)
 {
-  gboolean success = _skip_record(self, self->hdr->read_head, &self->hdr->read_head);
+  if (!qdisk_flush(self))
+    return FALSE;
+
+  gint64 logical_len = 0;
+  gboolean success = _skip_record(self, self->hdr->read_head, &self->hdr->read_head, &logical_len);
 
   if (success)
     {
+      _move_logical_bytes_to_backlog(self, logical_len);
       self->hdr->length--;
       self->hdr->backlog_len++;
       _maybe_apply_non_reliable_corrections(self);
@@ -943,15 +1438,20 @@ qdisk_remove_head(QDisk *self)
 gboolean
 qdisk_ack_backlog(QDisk *self)
 {
+  if (!qdisk_flush(self))
+    return FALSE;
+
   if (self->hdr->backlog_len == 0)
     return FALSE;
 
-  if (!_skip_record(self, self->hdr->backlog_head, &self->hdr->backlog_head))
+  gint64 logical_len = 0;
+  if (!_skip_record(self, self->hdr->backlog_head, &self->hdr->backlog_head, &logical_len))
     {
       msg_error("Error acking in disk-queue file", evt_tag_str("filename", qdisk_get_filename(self)));
       return FALSE;
     }
 
+  self->hdr->logical_backlog_bytes -= logical_len;
   self->hdr->backlog_len--;
   return TRUE;
 }
@@ -960,22 +1460,29 @@ qdisk_ack_backlog(QDisk *self)
 gboolean
 qdisk_rewind_backlog(QDisk *self, guint rewind_count)
 {
+  if (!qdisk_flush(self))
+    return FALSE;
+
   if (rewind_count > self->hdr->backlog_len)
     return FALSE;
 
   gint64 number_of_messages_stay_in_backlog = self->hdr->backlog_len - rewind_count;
 
   gint64 new_read_head = self->hdr->backlog_head;
+  gint64 logical_backlog_bytes = 0;
   for (gint64 i = 0; i < number_of_messages_stay_in_backlog; i++)
     {
-      if (!_skip_record(self, new_read_head, &new_read_head))
+      gint64 logical_len = 0;
+      if (!_skip_record(self, new_read_head, &new_read_head, &logical_len))
         {
           msg_error("Error rewinding backlog in disk-queue file",
                     evt_tag_str("filename", qdisk_get_filename(self)));
           return FALSE;
         }
+      logical_backlog_bytes += logical_len;
     }
 
+  _move_logical_bytes_to_backlog(self, logical_backlog_bytes - self->hdr->logical_backlog_bytes);
   self->hdr->backlog_len = number_of_messages_stay_in_backlog;
   self->hdr->read_head = new_read_head;
   self->hdr->length = self->hdr->length + rewind_count;
@@ -987,6 +1494,7 @@ qdisk_empty_backlog(QDisk *self)
 {
   self->hdr->backlog_head = self->hdr->read_head;
   self->hdr->backlog_len = 0;
+  self->hdr->logical_backlog_bytes = 0;
 }
 
 static gboolean
@@ -1322,6 +1830,25 @@ _save_state(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_cont
 static void
 _close_file(QDisk *self)
 {
+  if (self->ring)
+    {
+      munmap(self->ring, self->ring_size);
+      self->ring = NULL;
+      self->ring_size = 0;
+      self->dirty_start = self->dirty_end = 0;
+    }
+
+  /* the records have to hit the disk before the header referring to them */
+  qdisk_flush(self);
+
+  if (self->write_batch)
+    {
+      qdisk_write_batch_free(self->write_batch);
+      self->write_batch = NULL;
+      g_free(self->staged_hdr);
+      self->staged_hdr = NULL;
+    }
+
   if (self->hdr)
     {
       if (self->options->read_only)
@@ -1338,6 +1865,9 @@ _close_file(QDisk *self)
       self->fd = -1;
     }
 
+  block_compressor_free(self->compressor);
+  self->compressor = NULL;
+
   self->cached_file_size = 0;
 }
 
@@ -1362,6 +1892,8 @@ _ensure_header_byte_order(QDisk *self)
       self->hdr->backlog_head = GUINT64_SWAP_LE_BE(self->hdr->backlog_head);
       self->hdr->backlog_len = GUINT64_SWAP_LE_BE(self->hdr->backlog_len);
       self->hdr->capacity_bytes = GUINT64_SWAP_LE_BE(self->hdr->capacity_bytes);
+      self->hdr->logical_queue_bytes = GUINT64_SWAP_LE_BE(self->hdr->logical_queue_bytes);
+      self->hdr->logical_backlog_bytes = GUINT64_SWAP_LE_BE(self->hdr->logical_backlog_bytes);
       self->hdr->big_endian = (G_BYTE_ORDER == G_BIG_ENDIAN);
     }
 }
@@ -1395,6 +1927,15 @@ _open_file(const gchar *filename, gboolean read_only, gint *fd)
   return TRUE;
 }
 
+/* must only be called while the file is empty */
+static void
+_reset_compression(QDisk *self)
+{
+  self->hdr->compression = self->options->compression;
+  self->hdr->logical_queue_bytes = 0;
+  self->hdr->logical_backlog_bytes = 0;
+}
+
 static gboolean
 _create_header(QDisk *self)
 {
@@ -1432,6 +1973,7 @@ _create_header(QDisk *self)
   self->hdr->length = 0;
   self->hdr->use_v1_wrap_condition = FALSE;
   self->hdr->capacity_bytes = self->options->capacity_bytes;
+  _reset_compression(self);
 
   return TRUE;
 }
@@ -1463,6 +2005,13 @@ _upgrade_header(QDisk *self)
       self->hdr->capacity_bytes = self->options->capacity_bytes;
     }
 
+  if (self->hdr->version < 4)
+    {
+      self->hdr->compression = COMPRESSION_NONE;
+      self->hdr->logical_queue_bytes = 0;
+      self->hdr->logical_backlog_bytes = 0;
+    }
+
   self->hdr->version = QDISK_HDR_VERSION_CURRENT;
 }
 
@@ -1504,6 +2053,15 @@ _load_header(QDisk *self)
       return FALSE;
     }
 
+  if (self->hdr->compression != COMPRESSION_NONE && self->hdr->compression != COMPRESSION_LZ4
+      && self->hdr->compression != COMPRESSION_ZSTD)
+    {
+      msg_error("Error reading disk-queue file header. Invalid compression",
+                evt_tag_str("filename", self->filename),
+                evt_tag_int("compression", self->hdr->compression));
+      return FALSE;
+    }
+
   if (qdisk_header_is_inconsistent(self))
     {
       msg_error("Inconsistent header data in disk-queue file, ignoring",
@@ -1546,7 +2104,8 @@ _load_state(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_cont
                 evt_tag_long("qdisk_length", self->hdr->length),
                 evt_tag_long("read_head", self->hdr->read_head),
                 evt_tag_long("write_head", self->hdr->write_head),
-                evt_tag_long("capacity_bytes", self->hdr->capacity_bytes));
+                evt_tag_long("capacity_bytes", self->hdr->capacity_bytes),
+                evt_tag_str("compression", compression_algorithm_name(self->hdr->compression)));
 
       _reset_queue_pointers(self);
     }
@@ -1566,7 +2125,8 @@ _load_state(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_cont
                 evt_tag_long("backlog_head", self->hdr->backlog_head),
                 evt_tag_long("read_head", self->hdr->read_head),
                 evt_tag_long("write_head", self->hdr->write_head),
-                evt_tag_long("capacity_bytes", self->hdr->capacity_bytes));
+                evt_tag_long("capacity_bytes", self->hdr->capacity_bytes),
+                evt_tag_str("compression", compression_algorithm_name(self->hdr->compression)));
     }
 
   return TRUE;
@@ -1631,6 +2191,36 @@ _ensure_capacity_bytes(QDisk *self)
   return TRUE;
 }
 
+static gboolean
+_ensure_compression(QDisk *self)
+{
+  CompressionAlgorithm compression = self->hdr->compression;
+
+  if (!compression_algorithm_is_supported(compression))
+    {
+      msg_error("Disk-queue file is compressed with an algorithm that is not supported by this build of syslog-ng",
+                evt_tag_str("filename", self->filename),
+                evt_tag_str("compression", compression_algorithm_name(compression)));
+      return FALSE;
+    }
+
+  if (self->options->read_only || compression == self->options->compression)
+    return TRUE;
+
+  if (qdisk_is_file_empty(self))
+    {
+      _reset_compression(self);
+      return TRUE;
+    }
+
+  msg_warning("WARNING: compression() has changed since the last syslog-ng run. The new setting takes effect "
+              "once the disk-queue becomes empty",
+              evt_tag_str("filename", self->filename),
+              evt_tag_str("active_old_compression", compression_algorithm_name(compression)),
+              evt_tag_str("new_compression", compression_algorithm_name(self->options->compression)));
+  return TRUE;
+}
+
 static gboolean
 _load_qdisk_file(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_control_window)
 {
@@ -1643,6 +2233,9 @@ _load_qdisk_file(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow
   if (!_ensure_capacity_bytes(self))
     goto error;
 
+  if (!_ensure_compression(self))
+    goto error;
+
   return TRUE;
 
 error:
@@ -1706,12 +2299,60 @@ error:
   return FALSE;
 }
 
-gboolean
-qdisk_start(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_control_window)
+static inline gboolean
+_is_write_batching_enabled(QDisk *self)
 {
-  g_assert(!qdisk_started(self));
-  g_assert(self->filename);
+  return self->options->reliable
+         && !self->options->read_only
+         && self->options->io_engine == DISK_QUEUE_IO_ENGINE_IO_URING;
+}
+
+static inline gboolean
+_is_ring_mapping_enabled(QDisk *self)
+{
+  /* compressed records cannot be serialized in place */
+  return self->options->reliable
+         && !self->options->read_only
+         && self->options->io_engine == DISK_QUEUE_IO_ENGINE_MMAP
+         && self->options->compression == COMPRESSION_NONE;
+}
+
+static void
+_map_ring(QDisk *self)
+{
+  gint64 ring_size = self->hdr->capacity_bytes;
+
+  if (ring_size > G_MAXSIZE)
+    {
+      msg_warning("WARNING: disk-buffer is too large to be mapped, falling back to pwrite()",
+                  evt_tag_str("filename", self->filename),
+                  evt_tag_long("capacity_bytes", ring_size));
+      return;
+    }
+
+  /* writing into a hole through the mapping would raise SIGBUS when the disk is full */
+  if (self->cached_file_size < ring_size && !_preallocate_qdisk_file(self, ring_size))
+    return;
+
+  gchar *ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, self->fd, 0);
+  if (ring == MAP_FAILED)
+    {
+      msg_warning("WARNING: Cannot map disk-buffer file, falling back to pwrite()",
+                  evt_tag_str("filename", self->filename),
+                  evt_tag_error("error"));
+      return;
+    }
 
+  madvise(ring, ring_size, MADV_SEQUENTIAL);
+
+  self->ring = ring;
+  self->ring_size = ring_size;
+  self->dirty_start = self->dirty_end = 0;
+}
+
+static gboolean
+_start_file(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_control_window)
+{
   struct stat st;
   gboolean file_exists = stat(self->filename, &st) != -1;
 
@@ -1724,13 +2365,41 @@ qdisk_start(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_cont
   return _init_qdisk_file_from_empty_file(self);
 }
 
+gboolean
+qdisk_start(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_control_window)
+{
+  g_assert(!qdisk_started(self));
+  g_assert(self->filename);
+
+  if (!_start_file(self, front_cache, backlog, flow_control_window))
+    return FALSE;
+
+  if (_is_write_batching_enabled(self))
+    {
+      self->write_batch = qdisk_write_batch_new(self->fd, TRUE, self->options->fdatasync);
+      self->staged_hdr = g_new0(QDiskFileHeader, 1);
+      msg_debug("Batched writes enabled for disk-buffer",
+                evt_tag_str("filename", self->filename),
+                evt_tag_str("io_engine", qdisk_write_batch_uses_io_uring(self->write_batch) ? "io-uring" : "pwrite"),
+                evt_tag_int("fdatasync", self->options->fdatasync));
+    }
+
+  if (_is_ring_mapping_enabled(self))
+    _map_ring(self);
+
+  return TRUE;
+}
+
 gboolean
 qdisk_stop(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_control_window)
 {
-  gboolean result = TRUE;
+  gboolean result = qdisk_flush(self);
+
+  if (self->ring)
+    _sync_ring(self, MS_SYNC);
 
   if (!self->options->read_only)
-    result = _save_state(self, front_cache, backlog, flow_control_window);
+    result &= _save_state(self, front_cache, backlog, flow_control_window);
 
   _close_file(self);
 
@@ -1746,6 +2415,8 @@ qdisk_reset_file_if_empty(QDisk *self)
   self->hdr->read_head = QDISK_RESERVED_SPACE;
   self->hdr->write_head = QDISK_RESERVED_SPACE;
   self->hdr->backlog_head = QDISK_RESERVED_SPACE;
+  if (!self->options->read_only)
+    _reset_compression(self);
 
   _maybe_truncate_file(self, QDISK_RESERVED_SPACE);
 }
@@ -1780,6 +2451,12 @@ qdisk_get_file_size(QDisk *self)
   return self->cached_file_size;
 }
 
+CompressionAlgorithm
+qdisk_get_compression(QDisk *self)
+{
+  return self->hdr->compression;
+}
+
 gint64
 qdisk_get_writer_head(QDisk *self)
 {
@@ -1820,6 +2497,7 @@ void
 qdisk_free(QDisk *self)
 {
   self->options = NULL;
+  g_string_free(self->framed_record, TRUE);
   g_free(self->filename);
   g_free(self);
 }
@@ -1835,6 +2513,7 @@ qdisk_new(DiskQueueOptions *options, const gchar *file_id, const gchar *filename
 
   self->file_id = file_id;
   self->filename = g_strdup(filename);
+  self->framed_record = g_string_sized_new(4096);
 
   return self;
 }
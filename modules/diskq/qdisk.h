@@ -60,8 +60,15 @@ gboolean qdisk_is_space_avail(QDisk *self, gint at_least);
 gint64 qdisk_get_max_useful_space(QDisk *self);
 gint64 qdisk_get_empty_space(QDisk *self);
 gint64 qdisk_get_used_useful_space(QDisk *self);
+gint64 qdisk_get_used_useful_logical_space(QDisk *self);
 gboolean qdisk_push_tail(QDisk *self, GString *record);
+gboolean qdisk_flush(QDisk *self);
+gboolean qdisk_has_pending_writes(QDisk *self);
 gboolean qdisk_pop_head(QDisk *self, GString *record);
+gboolean qdisk_is_ring_mapped(QDisk *self);
+gboolean qdisk_push_tail_in_place(QDisk *self, QDiskSerializeFunc serialize_func, gpointer user_data);
+gboolean qdisk_pop_head_in_place(QDisk *self, QDiskDeSerializeFunc deserialize_func, gpointer user_data,
+                                 gboolean *deserialized);
 gboolean qdisk_remove_head(QDisk *self);
 gboolean qdisk_ack_backlog(QDisk *self);
 gboolean qdisk_rewind_backlog(QDisk *self, guint rewind_count);
@@ -85,6 +92,7 @@ gint qdisk_get_flow_control_window_bytes(QDisk *self);
 gboolean qdisk_is_read_only(QDisk *self);
 const gchar *qdisk_get_filename(QDisk *self);
 gint64 qdisk_get_file_size(QDisk *self);
+CompressionAlgorithm qdisk_get_compression(QDisk *self);
 
 gchar *qdisk_get_next_filename(const gchar *dir, gboolean reliable);
 gboolean qdisk_is_file_a_disk_buffer_file(const gchar *filename);
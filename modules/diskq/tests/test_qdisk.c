@@ -377,6 +377,106 @@ Test(qdisk, prealloc)
   cleanup_qdisk(filename, qdisk);
 }
 
+static gint64
+_get_real_file_size(const gchar *filename)
+{
+  struct stat file_stats;
+  cr_assert(stat(filename, &file_stats) == 0, "Stat call failed, errno: %d", errno);
+  return file_stats.st_size;
+}
+
+Test(qdisk, batched_writes_are_written_on_flush)
+{
+  const gchar *filename = "test_batched_writes.rqf";
+  const guint record_size = 100;
+
+  DiskQueueOptions *opts = construct_diskq_options(TDISKQ_RELIABLE, MIN_CAPACITY_BYTES);
+  disk_queue_options_set_prealloc(opts, FALSE);
+  disk_queue_options_set_truncate_size_ratio(opts, 1);
+  cr_assert(disk_queue_options_set_io_engine(opts, "io-uring"));
+  QDisk *qdisk = qdisk_new(opts, "TEST", filename);
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  for (gint i = 0; i < 3; i++)
+    cr_assert(push_dummy_record(qdisk, record_size));
+
+  cr_assert(qdisk_has_pending_writes(qdisk));
+  cr_assert_eq(qdisk_get_length(qdisk), 3);
+  cr_assert_eq(qdisk_get_writer_head(qdisk), QDISK_RESERVED_SPACE + 3 * (FRAME_LENGTH + record_size));
+  cr_assert_eq(_get_real_file_size(filename), QDISK_RESERVED_SPACE, "Records were written before the flush");
+
+  cr_assert(qdisk_flush(qdisk));
+  cr_assert_not(qdisk_has_pending_writes(qdisk));
+  cr_assert_eq(_get_real_file_size(filename), QDISK_RESERVED_SPACE + 3 * (FRAME_LENGTH + record_size));
+
+  /* reading flushes implicitly */
+  cr_assert(push_dummy_record(qdisk, record_size));
+  cr_assert(qdisk_has_pending_writes(qdisk));
+
+  GString *popped_data = g_string_new(NULL);
+  for (gint i = 0; i < 4; i++)
+    {
+      cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+      assert_dummy_record(popped_data, record_size);
+    }
+  cr_assert_not(qdisk_has_pending_writes(qdisk));
+  cr_assert_eq(qdisk_get_length(qdisk), 0);
+
+  g_string_free(popped_data, TRUE);
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+static gboolean
+_deserialize_dummy_payload(SerializeArchive *sa, gpointer user_data)
+{
+  guint size = GPOINTER_TO_UINT(user_data);
+  gchar *data = g_malloc(size);
+
+  gboolean result = serialize_archive_read_bytes(sa, data, size);
+  for (guint i = 0; result && i < size; ++i)
+    result = (data[i] == DUMMY_RECORD_PATTERN);
+
+  g_free(data);
+  return result;
+}
+
+Test(qdisk, mapped_ring_push_and_pop_in_place)
+{
+  const gchar *filename = "test_mapped_ring.rqf";
+  const guint record_size = 100;
+
+  DiskQueueOptions *opts = construct_diskq_options(TDISKQ_RELIABLE, MIN_CAPACITY_BYTES);
+  disk_queue_options_set_prealloc(opts, FALSE);
+  disk_queue_options_set_truncate_size_ratio(opts, 1);
+  cr_assert(disk_queue_options_set_io_engine(opts, "mmap"));
+  QDisk *qdisk = qdisk_new(opts, "TEST", filename);
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  cr_assert(qdisk_is_ring_mapped(qdisk));
+  cr_assert_eq(_get_real_file_size(filename), MIN_CAPACITY_BYTES, "The mapped ring should be preallocated");
+
+  cr_assert(qdisk_push_tail_in_place(qdisk, generate_dummy_payload, GUINT_TO_POINTER(record_size)));
+  cr_assert(push_dummy_record(qdisk, record_size));
+  cr_assert(qdisk_push_tail_in_place(qdisk, generate_dummy_payload, GUINT_TO_POINTER(record_size)));
+  cr_assert_eq(qdisk_get_length(qdisk), 3);
+  cr_assert_eq(qdisk_get_writer_head(qdisk), QDISK_RESERVED_SPACE + 3 * (FRAME_LENGTH + record_size));
+
+  for (gint i = 0; i < 3; i++)
+    {
+      gboolean deserialized = FALSE;
+      cr_assert(qdisk_pop_head_in_place(qdisk, _deserialize_dummy_payload, GUINT_TO_POINTER(record_size),
+                                        &deserialized));
+      cr_assert(deserialized);
+      qdisk_empty_backlog(qdisk);
+    }
+  cr_assert_eq(qdisk_get_length(qdisk), 0);
+  cr_assert_eq(_get_real_file_size(filename), MIN_CAPACITY_BYTES, "The mapped ring must not be truncated");
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
 static gboolean
 _serialize_len_of_zeroes(SerializeArchive *sa, gpointer user_data)
 {
@@ -574,6 +674,142 @@ Test(qdisk, get_empty_space_wrapped)
   cleanup_qdisk(filename, qdisk);
 }
 
+#if SYSLOG_NG_HAVE_LZ4 || SYSLOG_NG_HAVE_ZSTD
+
+/* QDisk-internal: compressed records start with a method byte and the uncompressed length */
+#define COMPRESSION_FRAME_LENGTH 5
+
+static gboolean
+generate_incompressible_payload(SerializeArchive *sa, gpointer user_data)
+{
+  guint size = GPOINTER_TO_UINT(user_data);
+  GRand *rand = g_rand_new_with_seed(size);
+
+  for (guint i = 0; i < size; ++i)
+    {
+      guint8 byte = g_rand_int(rand);
+      serialize_archive_write_bytes(sa, (const gchar *) &byte, 1);
+    }
+
+  g_rand_free(rand);
+  return TRUE;
+}
+
+static void
+_assert_pop_dummy_record(QDisk *qdisk, guint expected_size)
+{
+  GString *record = g_string_new(NULL);
+  cr_assert(qdisk_pop_head(qdisk, record));
+  assert_dummy_record(record, expected_size);
+  g_string_free(record, TRUE);
+}
+
+static void
+_test_compressed_records(const gchar *compression)
+{
+  const gchar *filename = "test_qdisk_compressed_records.rqf";
+  const guint record_len = 1000;
+  const gint64 logical_record_len = record_len + FRAME_LENGTH;
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  cr_assert(disk_queue_options_set_compression(qdisk_get_options(qdisk), compression));
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  for (gint i = 0; i < 10; i++)
+    cr_assert(push_dummy_record(qdisk, record_len));
+
+  cr_assert_eq(qdisk_get_used_useful_logical_space(qdisk), 10 * logical_record_len);
+  cr_assert_lt(qdisk_get_used_useful_space(qdisk), qdisk_get_used_useful_logical_space(qdisk));
+
+  /* the header (compression, logical sizes) survives a restart */
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+  cr_assert_str_eq(compression_algorithm_name(qdisk_get_compression(qdisk)), compression);
+  cr_assert_eq(qdisk_get_used_useful_logical_space(qdisk), 10 * logical_record_len);
+
+  for (gint i = 0; i < 5; i++)
+    _assert_pop_dummy_record(qdisk, record_len);
+  cr_assert(qdisk_remove_head(qdisk));
+
+  /* popped records stay in the backlog until they are acked */
+  cr_assert_eq(qdisk_get_used_useful_logical_space(qdisk), 10 * logical_record_len);
+  for (gint i = 0; i < 4; i++)
+    cr_assert(qdisk_ack_backlog(qdisk));
+  cr_assert_eq(qdisk_get_used_useful_logical_space(qdisk), 6 * logical_record_len);
+
+  cr_assert(qdisk_rewind_backlog(qdisk, 2));
+  cr_assert_eq(qdisk_get_used_useful_logical_space(qdisk), 6 * logical_record_len);
+
+  for (gint i = 0; i < 6; i++)
+    _assert_pop_dummy_record(qdisk, record_len);
+  for (gint i = 0; i < 6; i++)
+    cr_assert(qdisk_ack_backlog(qdisk));
+
+  cr_assert_eq(qdisk_get_length(qdisk), 0);
+  cr_assert_eq(qdisk_get_used_useful_logical_space(qdisk), 0);
+
+  /* records that do not shrink are stored as they are */
+  GString *data = g_string_new(NULL);
+  GError *error = NULL;
+  cr_assert(qdisk_serialize(data, generate_incompressible_payload, GUINT_TO_POINTER(record_len), &error));
+  cr_assert(qdisk_push_tail(qdisk, data));
+  cr_assert_eq(qdisk_get_used_useful_space(qdisk), data->len + COMPRESSION_FRAME_LENGTH);
+  cr_assert_eq(qdisk_get_used_useful_logical_space(qdisk), data->len);
+
+  GString *popped = g_string_new(NULL);
+  cr_assert(qdisk_pop_head(qdisk, popped));
+  cr_assert_eq(popped->len, data->len - FRAME_LENGTH);
+  cr_assert_arr_eq(popped->str, data->str + FRAME_LENGTH, popped->len);
+  g_string_free(popped, TRUE);
+  g_string_free(data, TRUE);
+
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cleanup_qdisk(filename, qdisk);
+}
+
+#endif
+
+#if SYSLOG_NG_HAVE_LZ4
+Test(qdisk, lz4_compressed_records)
+{
+  _test_compressed_records("lz4");
+}
+#endif
+
+#if SYSLOG_NG_HAVE_ZSTD
+Test(qdisk, zstd_compressed_records)
+{
+  _test_compressed_records("zstd");
+}
+#endif
+
+#if SYSLOG_NG_HAVE_LZ4
+Test(qdisk, compression_change_takes_effect_when_the_file_becomes_empty)
+{
+  const gchar *filename = "test_qdisk_compression_change.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  cr_assert(push_dummy_record(qdisk, 128));
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+
+  cr_assert(disk_queue_options_set_compression(qdisk_get_options(qdisk), "lz4"));
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+  cr_assert_eq(qdisk_get_compression(qdisk), COMPRESSION_NONE);
+  cr_assert_eq(qdisk_get_used_useful_logical_space(qdisk), qdisk_get_used_useful_space(qdisk));
+
+  _assert_pop_dummy_record(qdisk, 128);
+  cr_assert(qdisk_ack_backlog(qdisk));
+  qdisk_reset_file_if_empty(qdisk);
+  cr_assert_eq(qdisk_get_compression(qdisk), COMPRESSION_LZ4);
+
+  cr_assert(push_dummy_record(qdisk, 128));
+  _assert_pop_dummy_record(qdisk, 128);
+
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cleanup_qdisk(filename, qdisk);
+}
+#endif
+
 static void
 setup(void)
 {
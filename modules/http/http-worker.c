@@ -27,6 +27,9 @@
 #include "syslog-names.h"
 #include "scratch-buffers.h"
 #include "http-signals.h"
+#include "timeutils/misc.h"
+
+#include <poll.h>
 
 #define HTTP_HEADER_FORMAT_ERROR http_header_format_error_quark()
 
@@ -101,76 +104,76 @@ _curl_write_function(char *ptr, size_t size, size_t nmemb, void *userdata)
  * request specific options will be set separately
  */
 static void
-_setup_static_options_in_curl(HTTPDestinationWorker *self)
+_setup_static_options_in_curl(HTTPDestinationWorker *self, CURL *curl)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
-  curl_easy_reset(self->curl);
+  curl_easy_reset(curl);
 
-  curl_easy_setopt(self->curl, CURLOPT_WRITEFUNCTION, _curl_write_function);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _curl_write_function);
 
-  curl_easy_setopt(self->curl, CURLOPT_URL, owner->url);
+  curl_easy_setopt(curl, CURLOPT_URL, owner->url);
 
   if (owner->user)
-    curl_easy_setopt(self->curl, CURLOPT_USERNAME, owner->user);
+    curl_easy_setopt(curl, CURLOPT_USERNAME, owner->user);
 
   if (owner->password)
-    curl_easy_setopt(self->curl, CURLOPT_PASSWORD, owner->password);
+    curl_easy_setopt(curl, CURLOPT_PASSWORD, owner->password);
 
   if (owner->user_agent)
-    curl_easy_setopt(self->curl, CURLOPT_USERAGENT, owner->user_agent);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, owner->user_agent);
 
   if (owner->ca_dir)
-    curl_easy_setopt(self->curl, CURLOPT_CAPATH, owner->ca_dir);
+    curl_easy_setopt(curl, CURLOPT_CAPATH, owner->ca_dir);
 
   if (owner->ca_file)
-    curl_easy_setopt(self->curl, CURLOPT_CAINFO, owner->ca_file);
+    curl_easy_setopt(curl, CURLOPT_CAINFO, owner->ca_file);
 
   if (owner->cert_file)
-    curl_easy_setopt(self->curl, CURLOPT_SSLCERT, owner->cert_file);
+    curl_easy_setopt(curl, CURLOPT_SSLCERT, owner->cert_file);
 
   if (owner->key_file)
-    curl_easy_setopt(self->curl, CURLOPT_SSLKEY, owner->key_file);
+    curl_easy_setopt(curl, CURLOPT_SSLKEY, owner->key_file);
 
   if (owner->ciphers)
-    curl_easy_setopt(self->curl, CURLOPT_SSL_CIPHER_LIST, owner->ciphers);
+    curl_easy_setopt(curl, CURLOPT_SSL_CIPHER_LIST, owner->ciphers);
 
 #if SYSLOG_NG_HAVE_DECL_CURLOPT_TLS13_CIPHERS
   if (owner->tls13_ciphers)
-    curl_easy_setopt(self->curl, CURLOPT_TLS13_CIPHERS, owner->tls13_ciphers);
+    curl_easy_setopt(curl, CURLOPT_TLS13_CIPHERS, owner->tls13_ciphers);
 #endif
 
 #if SYSLOG_NG_HAVE_DECL_CURLOPT_SSL_VERIFYSTATUS
   if (owner->ocsp_stapling_verify)
-    curl_easy_setopt(self->curl, CURLOPT_SSL_VERIFYSTATUS, 1L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYSTATUS, 1L);
 #endif
 
   if (owner->proxy)
-    curl_easy_setopt(self->curl, CURLOPT_PROXY, owner->proxy);
+    curl_easy_setopt(curl, CURLOPT_PROXY, owner->proxy);
 
-  curl_easy_setopt(self->curl, CURLOPT_SSLVERSION, owner->ssl_version);
-  curl_easy_setopt(self->curl, CURLOPT_SSL_VERIFYHOST, owner->peer_verify ? 2L : 0L);
-  curl_easy_setopt(self->curl, CURLOPT_SSL_VERIFYPEER, owner->peer_verify ? 1L : 0L);
+  curl_easy_setopt(curl, CURLOPT_SSLVERSION, owner->ssl_version);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, owner->peer_verify ? 2L : 0L);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, owner->peer_verify ? 1L : 0L);
 
-  curl_easy_setopt(self->curl, CURLOPT_DEBUGFUNCTION, _curl_debug_function);
-  curl_easy_setopt(self->curl, CURLOPT_DEBUGDATA, self);
-  curl_easy_setopt(self->curl, CURLOPT_VERBOSE, 1L);
+  curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, _curl_debug_function);
+  curl_easy_setopt(curl, CURLOPT_DEBUGDATA, self);
+  curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
 
   if (owner->accept_redirects)
     {
-      curl_easy_setopt(self->curl, CURLOPT_FOLLOWLOCATION, 1);
-      curl_easy_setopt(self->curl, CURLOPT_POSTREDIR, CURL_REDIR_POST_ALL);
+      curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
+      curl_easy_setopt(curl, CURLOPT_POSTREDIR, CURL_REDIR_POST_ALL);
 #if SYSLOG_NG_HAVE_DECL_CURLOPT_REDIR_PROTOCOLS_STR
-      curl_easy_setopt(self->curl, CURLOPT_REDIR_PROTOCOLS_STR, "http,https");
+      curl_easy_setopt(curl, CURLOPT_REDIR_PROTOCOLS_STR, "http,https");
 #else
-      curl_easy_setopt(self->curl, CURLOPT_REDIR_PROTOCOLS, CURLPROTO_HTTP | CURLPROTO_HTTPS);
+      curl_easy_setopt(curl, CURLOPT_REDIR_PROTOCOLS, CURLPROTO_HTTP | CURLPROTO_HTTPS);
 #endif
-      curl_easy_setopt(self->curl, CURLOPT_MAXREDIRS, 3);
+      curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 3);
     }
-  curl_easy_setopt(self->curl, CURLOPT_TIMEOUT, owner->timeout);
+  curl_easy_setopt(curl, CURLOPT_TIMEOUT, owner->timeout);
 
   if (owner->method_type == METHOD_TYPE_PUT)
-    curl_easy_setopt(self->curl, CURLOPT_CUSTOMREQUEST, "PUT");
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
 }
 
 
@@ -260,6 +263,8 @@ _add_common_headers(HTTPDestinationWorker *self)
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
   _add_header(self->request_headers, "Expect", "");
+  if (owner->compression != COMPRESSION_NONE)
+    _add_header(self->request_headers, "Content-Encoding", compression_algorithm_name(owner->compression));
   for (GList *l = owner->headers; l; l = l->next)
     list_append(self->request_headers, l->data);
 }
@@ -274,26 +279,53 @@ _try_format_request_headers(HTTPDestinationWorker *self, GError **error)
   return (*error == NULL);
 }
 
+static void
+_append_to_request_body(HTTPDestinationWorker *self, const gchar *data, gsize len)
+{
+  /* errors are sticky in the compressor, they are reported when the body is finished */
+  if (self->compressor)
+    stream_compressor_write(self->compressor, data, len, self->request_body);
+  else
+    g_string_append_len(self->request_body, data, len);
+}
+
+/* batch-bytes() and the msg length stats are based on the uncompressed size */
+static gsize
+_get_uncompressed_request_body_size(HTTPDestinationWorker *self)
+{
+  if (self->compressor)
+    return stream_compressor_get_input_size(self->compressor);
+  return self->request_body->len;
+}
+
 static void
 _add_message_to_batch(HTTPDestinationWorker *self, LogMessage *msg)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
+  /* with compression() the message is formatted into a scratch buffer and
+   * fed to the compressor right away, so the batch is never held in its
+   * uncompressed form */
+  GString *buffer = self->compressor ? scratch_buffers_alloc() : self->request_body;
+
   if (self->super.batch_size > 1)
     {
-      g_string_append_len(self->request_body, owner->delimiter->str, owner->delimiter->len);
+      g_string_append_len(buffer, owner->delimiter->str, owner->delimiter->len);
     }
   if (owner->body_template)
     {
       LogTemplateEvalOptions options = {&owner->template_options, LTZ_SEND,
                                         self->super.seq_num, NULL, LM_VT_STRING
                                        };
-      log_template_append_format(owner->body_template, msg, &options, self->request_body);
+      log_template_append_format(owner->body_template, msg, &options, buffer);
     }
   else
     {
-      g_string_append(self->request_body, log_msg_get_value(msg, LM_V_MESSAGE, NULL));
+      g_string_append(buffer, log_msg_get_value(msg, LM_V_MESSAGE, NULL));
     }
+
+  if (self->compressor)
+    stream_compressor_write(self->compressor, buffer->str, buffer->len, self->request_body);
 }
 
 static gboolean
@@ -422,35 +454,56 @@ _reinit_request_body(HTTPDestinationWorker *self)
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
   g_string_truncate(self->request_body, 0);
+  if (self->compressor)
+    stream_compressor_reset(self->compressor);
+
   if (owner->body_prefix->len > 0)
-    g_string_append_len(self->request_body, owner->body_prefix->str, owner->body_prefix->len);
+    _append_to_request_body(self, owner->body_prefix->str, owner->body_prefix->len);
 
 }
 
-static void
+static gboolean
 _finish_request_body(HTTPDestinationWorker *self)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
   if (owner->body_suffix->len > 0)
-    g_string_append_len(self->request_body, owner->body_suffix->str, owner->body_suffix->len);
+    _append_to_request_body(self, owner->body_suffix->str, owner->body_suffix->len);
+
+  if (self->compressor)
+    return stream_compressor_finish(self->compressor, self->request_body);
+  return TRUE;
+}
+
+static void
+_update_written_bytes_stats(HTTPDestinationWorker *self, gsize body_size, gsize uncompressed_body_size)
+{
+  log_threaded_dest_worker_written_bytes_add(&self->super, body_size);
+  log_threaded_dest_driver_insert_batch_length_stats(self->super.owner, body_size);
+
+  if (self->compressor)
+    {
+      stats_byte_counter_add(&self->metrics.compressed_bytes, body_size);
+      stats_byte_counter_add(&self->metrics.uncompressed_bytes, uncompressed_body_size);
+    }
 }
 
 static void
-_debug_response_info(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target, glong http_code)
+_debug_response_info(HTTPDestinationWorker *self, CURL *curl, HTTPLoadBalancerTarget *target, glong http_code,
+                     gsize body_size, gint batch_size)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
   gdouble total_time = 0;
   glong redirect_count = 0;
 
-  curl_easy_getinfo(self->curl, CURLINFO_TOTAL_TIME, &total_time);
-  curl_easy_getinfo(self->curl, CURLINFO_REDIRECT_COUNT, &redirect_count);
+  curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total_time);
+  curl_easy_getinfo(curl, CURLINFO_REDIRECT_COUNT, &redirect_count);
   msg_debug("curl: HTTP response received",
             evt_tag_str("url", target->url),
             evt_tag_int("status_code", http_code),
-            evt_tag_int("body_size", self->request_body->len),
-            evt_tag_int("batch_size", self->super.batch_size),
+            evt_tag_int("body_size", body_size),
+            evt_tag_int("batch_size", batch_size),
             evt_tag_int("redirected", redirect_count != 0),
             evt_tag_printf("total_time", "%.3f", total_time),
             evt_tag_int("worker_index", self->super.worker_index),
@@ -511,27 +564,42 @@ _custom_map_http_result(HTTPDestinationWorker *self, const gchar *url, HttpRespo
   return LTR_MAX;
 }
 
-static gboolean
-_curl_perform_request(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target)
+static void
+_setup_request_options_in_curl(CURL *curl, HTTPLoadBalancerTarget *target, List *request_headers,
+                               GString *request_body)
+{
+  curl_easy_setopt(curl, CURLOPT_URL, target->url);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, http_curl_header_list_as_slist(request_headers));
+  /* the body may be compressed and contain NUL bytes, so curl must not strlen() it */
+  curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t) request_body->len);
+  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request_body->str);
+}
+
+static void
+_report_curl_request_error(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target, CURLcode ret)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
+  msg_error("curl: error sending HTTP request",
+            evt_tag_str("url", target->url),
+            evt_tag_str("error", curl_easy_strerror(ret)),
+            evt_tag_int("worker_index", self->super.worker_index),
+            evt_tag_str("driver", owner->super.super.super.id),
+            log_pipe_location_tag(&owner->super.super.super.super));
+}
+
+static gboolean
+_curl_perform_request(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target)
+{
   msg_trace("Sending HTTP request",
             evt_tag_str("url", target->url));
 
-  curl_easy_setopt(self->curl, CURLOPT_URL, target->url);
-  curl_easy_setopt(self->curl, CURLOPT_HTTPHEADER, http_curl_header_list_as_slist(self->request_headers));
-  curl_easy_setopt(self->curl, CURLOPT_POSTFIELDS, self->request_body->str);
+  _setup_request_options_in_curl(self->curl, target, self->request_headers, self->request_body);
 
   CURLcode ret = curl_easy_perform(self->curl);
   if (ret != CURLE_OK)
     {
-      msg_error("curl: error sending HTTP request",
-                evt_tag_str("url", target->url),
-                evt_tag_str("error", curl_easy_strerror(ret)),
-                evt_tag_int("worker_index", self->super.worker_index),
-                evt_tag_str("driver", owner->super.super.super.id),
-                log_pipe_location_tag(&owner->super.super.super.super));
+      _report_curl_request_error(self, target, ret);
       return FALSE;
     }
 
@@ -539,10 +607,10 @@ _curl_perform_request(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *targe
 }
 
 static gboolean
-_curl_get_status_code(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target, glong *http_code)
+_curl_get_status_code(HTTPDestinationWorker *self, CURL *curl, HTTPLoadBalancerTarget *target, glong *http_code)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
-  CURLcode ret = curl_easy_getinfo(self->curl, CURLINFO_RESPONSE_CODE, http_code);
+  CURLcode ret = curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, http_code);
 
   if (ret != CURLE_OK)
     {
@@ -583,20 +651,17 @@ _map_http_status_code(HTTPDestinationWorker *self, const gchar *url, glong http_
 }
 
 static LogThreadedResult
-_flush_on_target(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target)
+_process_response(HTTPDestinationWorker *self, CURL *curl, HTTPLoadBalancerTarget *target,
+                  gsize body_size, gint batch_size)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
-
-  if (!_curl_perform_request(self, target))
-    return LTR_NOT_CONNECTED;
-
   glong http_code = 0;
 
-  if (!_curl_get_status_code(self, target, &http_code))
+  if (!_curl_get_status_code(self, curl, target, &http_code))
     return LTR_NOT_CONNECTED;
 
   if (debug_flag)
-    _debug_response_info(self, target, http_code);
+    _debug_response_info(self, curl, target, http_code, body_size, batch_size);
 
   HttpResponseReceivedSignalData signal_data =
   {
@@ -616,6 +681,15 @@ _flush_on_target(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target)
   return _map_http_status_code(self, target->url, http_code);
 }
 
+static LogThreadedResult
+_flush_on_target(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target)
+{
+  if (!_curl_perform_request(self, target))
+    return LTR_NOT_CONNECTED;
+
+  return _process_response(self, self->curl, target, self->request_body->len, self->super.batch_size);
+}
+
 static gboolean
 _format_request_headers_error_is_critical(GError *error)
 {
@@ -651,6 +725,31 @@ _format_request_headers_catch_error(GError **error)
   return !unhandled;
 }
 
+static HTTPLoadBalancerTarget *
+_choose_alternative_target(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *failed_target)
+{
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+  HTTPLoadBalancerTarget *alt_target = http_load_balancer_choose_target(owner->load_balancer, &self->lbc);
+
+  if (alt_target == failed_target)
+    {
+      msg_debug("Target server down, but no alternative server available. Falling back to retrying after time-reopen()",
+                evt_tag_str("url", failed_target->url),
+                evt_tag_int("worker_index", self->super.worker_index),
+                evt_tag_str("driver", owner->super.super.super.id),
+                log_pipe_location_tag(&owner->super.super.super.super));
+      return NULL;
+    }
+
+  msg_debug("Target server down, trying an alternative server",
+            evt_tag_str("url", failed_target->url),
+            evt_tag_str("alternative_url", alt_target->url),
+            evt_tag_int("worker_index", self->super.worker_index),
+            evt_tag_str("driver", owner->super.super.super.id),
+            log_pipe_location_tag(&owner->super.super.super.super));
+  return alt_target;
+}
+
 /* we flush the accumulated data if
  *   1) we reach batch_size,
  *   2) the message queue becomes empty
@@ -671,7 +770,12 @@ _flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
   if (mode == LTF_FLUSH_EXPEDITE)
     return LTR_RETRY;
 
-  _finish_request_body(self);
+  if (!_finish_request_body(self))
+    {
+      _reinit_request_headers(self);
+      _reinit_request_body(self);
+      return LTR_ERROR;
+    }
 
   if (!_try_format_request_headers(self, &error))
     {
@@ -686,40 +790,491 @@ _flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
       retval = _flush_on_target(self, target);
       if (retval == LTR_SUCCESS)
         {
-          gsize msg_length = self->request_body->len;
-          log_threaded_dest_worker_written_bytes_add(&self->super, msg_length);
-          log_threaded_dest_driver_insert_batch_length_stats(self->super.owner, msg_length);
+          _update_written_bytes_stats(self, self->request_body->len, _get_uncompressed_request_body_size(self));
 
           http_load_balancer_set_target_successful(owner->load_balancer, target);
           break;
         }
       http_load_balancer_set_target_failed(owner->load_balancer, target);
 
-      alt_target = http_load_balancer_choose_target(owner->load_balancer, &self->lbc);
-      if (alt_target == target)
+      alt_target = _choose_alternative_target(self, target);
+      if (!alt_target)
+        break;
+
+      target = alt_target;
+    }
+
+  _reinit_request_headers(self);
+  _reinit_request_body(self);
+
+  return retval;
+}
+
+/* max-in-flight()
+ *
+ * Each request slot has its own easy handle, body and header list, the
+ * open batch is swapped into an idle slot when it is flushed.  The multi
+ * handle is driven from the ivykis loop of the worker: curl's sockets are
+ * registered as iv_fd's and its timeout as an iv_timer.  Connections are
+ * cached by the multi handle, so they are kept alive between requests, and
+ * HTTP/2 requests are multiplexed over a single connection.
+ *
+ * Responses may arrive in any order, batches are acked or failed in the
+ * order they were sent (see log_threaded_dest_worker_ack_in_flight()).
+ */
+
+#define HTTP_MULTI_MAX_WAIT_MSEC 1000
+
+struct _HTTPInFlightRequest
+{
+  CURL *curl;
+  GString *body;
+  List *headers;
+  HTTPLoadBalancerTarget *target;
+  gint batch_size;
+  gsize uncompressed_size;
+  gint attempts_left;
+  gboolean completed;
+  LogThreadedResult result;
+};
+
+typedef struct _HTTPMultiSocket
+{
+  HTTPDestinationWorker *worker;
+  struct iv_fd fd;
+  gint what;
+} HTTPMultiSocket;
+
+static void
+_multi_start_request(HTTPDestinationWorker *self, HTTPInFlightRequest *request, HTTPLoadBalancerTarget *target)
+{
+  msg_trace("Sending HTTP request",
+            evt_tag_str("url", target->url),
+            evt_tag_int("batch_size", request->batch_size),
+            evt_tag_int("in_flight", g_queue_get_length(&self->multi.pending)));
+
+  request->target = target;
+  request->completed = FALSE;
+  _setup_request_options_in_curl(request->curl, target, request->headers, request->body);
+  curl_multi_add_handle(self->multi.handle, request->curl);
+}
+
+static void
+_multi_release_request(HTTPDestinationWorker *self, HTTPInFlightRequest *request)
+{
+  if (!request->completed)
+    curl_multi_remove_handle(self->multi.handle, request->curl);
+  g_queue_push_tail(&self->multi.idle, request);
+}
+
+static void
+_multi_cancel_requests(HTTPDestinationWorker *self)
+{
+  HTTPInFlightRequest *request;
+
+  while ((request = g_queue_pop_head(&self->multi.pending)))
+    _multi_release_request(self, request);
+}
+
+static void
+_multi_submit_batch(HTTPDestinationWorker *self)
+{
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+  HTTPInFlightRequest *request = g_queue_pop_head(&self->multi.idle);
+
+  GString *request_body = request->body;
+  request->body = self->request_body;
+  self->request_body = request_body;
+
+  List *request_headers = request->headers;
+  request->headers = self->request_headers;
+  self->request_headers = request_headers;
+
+  request->batch_size = self->super.batch_size;
+  request->uncompressed_size = _get_uncompressed_request_body_size(self);
+  request->attempts_left = owner->load_balancer->num_targets;
+  g_queue_push_tail(&self->multi.pending, request);
+  _multi_start_request(self, request, http_load_balancer_choose_target(owner->load_balancer, &self->lbc));
+
+  log_threaded_dest_worker_mark_batch_in_flight(&self->super);
+  _reinit_request_headers(self);
+  _reinit_request_body(self);
+}
+
+static void
+_multi_complete_request(HTTPDestinationWorker *self, HTTPInFlightRequest *request, CURLcode ret)
+{
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+  LogThreadedResult result;
+
+  if (ret != CURLE_OK)
+    {
+      _report_curl_request_error(self, request->target, ret);
+      result = LTR_NOT_CONNECTED;
+    }
+  else
+    {
+      result = _process_response(self, request->curl, request->target, request->body->len, request->batch_size);
+    }
+
+  if (result == LTR_SUCCESS)
+    {
+      http_load_balancer_set_target_successful(owner->load_balancer, request->target);
+    }
+  else
+    {
+      http_load_balancer_set_target_failed(owner->load_balancer, request->target);
+
+      HTTPLoadBalancerTarget *alt_target;
+      if (--request->attempts_left > 0 && (alt_target = _choose_alternative_target(self, request->target)))
         {
-          msg_debug("Target server down, but no alternative server available. Falling back to retrying after time-reopen()",
-                    evt_tag_str("url", target->url),
-                    evt_tag_int("worker_index", self->super.worker_index),
-                    evt_tag_str("driver", owner->super.super.super.id),
-                    log_pipe_location_tag(&owner->super.super.super.super));
-          break;
+          _multi_start_request(self, request, alt_target);
+          return;
         }
+    }
 
-      msg_debug("Target server down, trying an alternative server",
-                evt_tag_str("url", target->url),
-                evt_tag_str("alternative_url", alt_target->url),
+  request->result = result;
+  request->completed = TRUE;
+}
+
+static void
+_multi_fail_requests(HTTPDestinationWorker *self, gint batch_size, LogThreadedResult result)
+{
+  /* everything sent after the failed batch is abandoned, along with the
+   * open batch, these are rewound by the fail/rewind call below */
+  _multi_cancel_requests(self);
+  _reinit_request_headers(self);
+  _reinit_request_body(self);
+
+  if (self->super.owner->under_termination)
+    log_threaded_dest_worker_rewind_in_flight(&self->super);
+  else
+    log_threaded_dest_worker_fail_in_flight(&self->super, batch_size, result);
+}
+
+static void
+_multi_process_completed_requests(HTTPDestinationWorker *self)
+{
+  HTTPInFlightRequest *request;
+
+  while ((request = g_queue_peek_head(&self->multi.pending)) && request->completed)
+    {
+      g_queue_pop_head(&self->multi.pending);
+
+      gint batch_size = request->batch_size;
+      LogThreadedResult result = request->result;
+      gsize msg_length = request->body->len;
+      gsize uncompressed_msg_length = request->uncompressed_size;
+      _multi_release_request(self, request);
+
+      if (result != LTR_SUCCESS)
+        {
+          _multi_fail_requests(self, batch_size, result);
+          return;
+        }
+
+      _update_written_bytes_stats(self, msg_length, uncompressed_msg_length);
+      log_threaded_dest_worker_ack_in_flight(&self->super, batch_size);
+    }
+}
+
+static void
+_multi_check_completions(HTTPDestinationWorker *self)
+{
+  CURLMsg *msg;
+  gint msgs_left;
+
+  while ((msg = curl_multi_info_read(self->multi.handle, &msgs_left)))
+    {
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+
+      HTTPInFlightRequest *request = NULL;
+      CURLcode ret = msg->data.result;
+
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (gchar **) &request);
+      curl_multi_remove_handle(self->multi.handle, request->curl);
+      _multi_complete_request(self, request, ret);
+    }
+
+  _multi_process_completed_requests(self);
+}
+
+static void
+_multi_socket_action(HTTPDestinationWorker *self, curl_socket_t fd, gint ev_bitmask)
+{
+  gint running_handles;
+
+  curl_multi_socket_action(self->multi.handle, fd, ev_bitmask, &running_handles);
+  _multi_check_completions(self);
+}
+
+static void
+_multi_socket_in(gpointer cookie)
+{
+  HTTPMultiSocket *sock = (HTTPMultiSocket *) cookie;
+
+  _multi_socket_action(sock->worker, sock->fd.fd, CURL_CSELECT_IN);
+}
+
+static void
+_multi_socket_out(gpointer cookie)
+{
+  HTTPMultiSocket *sock = (HTTPMultiSocket *) cookie;
+
+  _multi_socket_action(sock->worker, sock->fd.fd, CURL_CSELECT_OUT);
+}
+
+static void
+_multi_socket_err(gpointer cookie)
+{
+  HTTPMultiSocket *sock = (HTTPMultiSocket *) cookie;
+
+  _multi_socket_action(sock->worker, sock->fd.fd, CURL_CSELECT_ERR);
+}
+
+static void
+_multi_free_socket(HTTPDestinationWorker *self, HTTPMultiSocket *sock)
+{
+  iv_fd_unregister(&sock->fd);
+  self->multi.sockets = g_list_remove(self->multi.sockets, sock);
+  g_free(sock);
+}
+
+static gint
+_multi_socket_cb(CURL *easy, curl_socket_t fd, gint what, gpointer user_data, gpointer socket_data)
+{
+  HTTPDestinationWorker *self = (HTTPDestinationWorker *) user_data;
+  HTTPMultiSocket *sock = (HTTPMultiSocket *) socket_data;
+
+  if (what == CURL_POLL_REMOVE)
+    {
+      if (sock)
+        _multi_free_socket(self, sock);
+      return 0;
+    }
+
+  if (!sock)
+    {
+      sock = g_new0(HTTPMultiSocket, 1);
+      sock->worker = self;
+      IV_FD_INIT(&sock->fd);
+      sock->fd.fd = fd;
+      sock->fd.cookie = sock;
+      sock->fd.handler_err = _multi_socket_err;
+      iv_fd_register(&sock->fd);
+
+      curl_multi_assign(self->multi.handle, fd, sock);
+      self->multi.sockets = g_list_prepend(self->multi.sockets, sock);
+    }
+
+  sock->what = what;
+  iv_fd_set_handler_in(&sock->fd, (what & CURL_POLL_IN) ? _multi_socket_in : NULL);
+  iv_fd_set_handler_out(&sock->fd, (what & CURL_POLL_OUT) ? _multi_socket_out : NULL);
+  return 0;
+}
+
+static void
+_multi_timer_expired(gpointer cookie)
+{
+  HTTPDestinationWorker *self = (HTTPDestinationWorker *) cookie;
+
+  self->multi.timeout_ms = -1;
+  _multi_socket_action(self, CURL_SOCKET_TIMEOUT, 0);
+}
+
+static gint
+_multi_timer_cb(CURLM *multi, glong timeout_ms, gpointer user_data)
+{
+  HTTPDestinationWorker *self = (HTTPDestinationWorker *) user_data;
+
+  if (iv_timer_registered(&self->multi.timer))
+    iv_timer_unregister(&self->multi.timer);
+
+  self->multi.timeout_ms = timeout_ms;
+  if (timeout_ms >= 0)
+    {
+      iv_validate_now();
+      self->multi.timer.expires = iv_now;
+      timespec_add_msec(&self->multi.timer.expires, timeout_ms);
+      iv_timer_register(&self->multi.timer);
+    }
+  return 0;
+}
+
+/* Drives the requests synchronously, outside of the ivykis loop.  This is
+ * used when all request slots are busy and when draining the requests on
+ * shutdown. */
+static void
+_multi_wait(HTTPDestinationWorker *self)
+{
+  gint num_fds = g_list_length(self->multi.sockets);
+  struct pollfd *pfds = g_newa(struct pollfd, MAX(num_fds, 1));
+  gint i = 0;
+
+  for (GList *l = self->multi.sockets; l; l = l->next, i++)
+    {
+      HTTPMultiSocket *sock = (HTTPMultiSocket *) l->data;
+
+      pfds[i].fd = sock->fd.fd;
+      pfds[i].events = ((sock->what & CURL_POLL_IN) ? POLLIN : 0) | ((sock->what & CURL_POLL_OUT) ? POLLOUT : 0);
+      pfds[i].revents = 0;
+    }
+
+  glong timeout_ms = self->multi.timeout_ms;
+  if (timeout_ms < 0 || timeout_ms > HTTP_MULTI_MAX_WAIT_MSEC)
+    timeout_ms = HTTP_MULTI_MAX_WAIT_MSEC;
+
+  if (poll(pfds, num_fds, timeout_ms) <= 0)
+    {
+      _multi_socket_action(self, CURL_SOCKET_TIMEOUT, 0);
+      return;
+    }
+
+  for (i = 0; i < num_fds; i++)
+    {
+      gint ev_bitmask = 0;
+
+      if (pfds[i].revents & POLLIN)
+        ev_bitmask |= CURL_CSELECT_IN;
+      if (pfds[i].revents & POLLOUT)
+        ev_bitmask |= CURL_CSELECT_OUT;
+      if (pfds[i].revents & (POLLERR | POLLHUP))
+        ev_bitmask |= CURL_CSELECT_ERR;
+
+      if (ev_bitmask)
+        _multi_socket_action(self, pfds[i].fd, ev_bitmask);
+    }
+}
+
+static LogThreadedResult
+_flush_in_flight(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
+{
+  HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
+  GError *error = NULL;
+
+  if (mode == LTF_FLUSH_EXPEDITE)
+    {
+      _multi_cancel_requests(self);
+      log_threaded_dest_worker_rewind_in_flight(&self->super);
+      return LTR_EXPLICIT_ACK_MGMT;
+    }
+
+  if (self->super.batch_size > 0)
+    {
+      if (!_finish_request_body(self))
+        {
+          _reinit_request_headers(self);
+          _reinit_request_body(self);
+          return LTR_ERROR;
+        }
+
+      if (!_try_format_request_headers(self, &error) && !_format_request_headers_catch_error(&error))
+        {
+          _reinit_request_headers(self);
+          _reinit_request_body(self);
+          return LTR_NOT_CONNECTED;
+        }
+
+      while (g_queue_is_empty(&self->multi.idle))
+        {
+          _multi_wait(self);
+
+          /* the open batch was rewound along with a failed one */
+          if (self->super.batch_size == 0)
+            return LTR_EXPLICIT_ACK_MGMT;
+        }
+
+      _multi_submit_batch(self);
+    }
+
+  if (self->super.owner->under_termination)
+    {
+      while (!g_queue_is_empty(&self->multi.pending))
+        _multi_wait(self);
+    }
+
+  return LTR_EXPLICIT_ACK_MGMT;
+}
+
+static gboolean
+_multi_init(HTTPDestinationWorker *self)
+{
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+
+  if (!(self->multi.handle = curl_multi_init()))
+    {
+      msg_error("curl: cannot initialize libcurl multi handle",
                 evt_tag_int("worker_index", self->super.worker_index),
                 evt_tag_str("driver", owner->super.super.super.id),
                 log_pipe_location_tag(&owner->super.super.super.super));
+      return FALSE;
+    }
 
-      target = alt_target;
+  curl_multi_setopt(self->multi.handle, CURLMOPT_SOCKETFUNCTION, _multi_socket_cb);
+  curl_multi_setopt(self->multi.handle, CURLMOPT_SOCKETDATA, self);
+  curl_multi_setopt(self->multi.handle, CURLMOPT_TIMERFUNCTION, _multi_timer_cb);
+  curl_multi_setopt(self->multi.handle, CURLMOPT_TIMERDATA, self);
+#ifdef CURLPIPE_MULTIPLEX
+  curl_multi_setopt(self->multi.handle, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+
+  IV_TIMER_INIT(&self->multi.timer);
+  self->multi.timer.cookie = self;
+  self->multi.timer.handler = _multi_timer_expired;
+  self->multi.timeout_ms = -1;
+
+  self->multi.requests = g_new0(HTTPInFlightRequest, owner->max_in_flight);
+  for (gint i = 0; i < owner->max_in_flight; i++)
+    {
+      HTTPInFlightRequest *request = &self->multi.requests[i];
+
+      if (!(request->curl = curl_easy_init()))
+        {
+          msg_error("curl: cannot initialize libcurl",
+                    evt_tag_int("worker_index", self->super.worker_index),
+                    evt_tag_str("driver", owner->super.super.super.id),
+                    log_pipe_location_tag(&owner->super.super.super.super));
+          return FALSE;
+        }
+      _setup_static_options_in_curl(self, request->curl);
+      curl_easy_setopt(request->curl, CURLOPT_PRIVATE, request);
+      request->body = g_string_sized_new(32768);
+      request->headers = http_curl_header_list_new();
+      g_queue_push_tail(&self->multi.idle, request);
     }
 
-  _reinit_request_headers(self);
-  _reinit_request_body(self);
+  return TRUE;
+}
 
-  return retval;
+static void
+_multi_deinit(HTTPDestinationWorker *self)
+{
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+
+  _multi_cancel_requests(self);
+
+  /* cached connections are closed by curl_multi_cleanup(), we don't want
+   * to hear about those */
+  curl_multi_setopt(self->multi.handle, CURLMOPT_SOCKETFUNCTION, NULL);
+  while (self->multi.sockets)
+    _multi_free_socket(self, (HTTPMultiSocket *) self->multi.sockets->data);
+
+  if (iv_timer_registered(&self->multi.timer))
+    iv_timer_unregister(&self->multi.timer);
+
+  curl_multi_cleanup(self->multi.handle);
+
+  for (gint i = 0; i < owner->max_in_flight; i++)
+    {
+      HTTPInFlightRequest *request = &self->multi.requests[i];
+
+      curl_easy_cleanup(request->curl);
+      g_string_free(request->body, TRUE);
+      list_free(request->headers);
+    }
+  g_queue_clear(&self->multi.idle);
+  g_free(self->multi.requests);
 }
 
 static gboolean
@@ -727,8 +1282,12 @@ _should_initiate_flush(HTTPDestinationWorker *self)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
-  return (owner->batch_bytes && self->request_body->len + owner->body_suffix->len >= owner->batch_bytes);
+  if (owner->batch_bytes && _get_uncompressed_request_body_size(self) + owner->body_suffix->len >= owner->batch_bytes)
+    return TRUE;
 
+  /* the compressor holds back some of its input, so the compressed size
+   * lags behind, by at most the size of its internal buffers */
+  return (owner->compressed_batch_bytes && self->request_body->len >= owner->compressed_batch_bytes);
 }
 
 static LogThreadedResult
@@ -736,9 +1295,9 @@ _insert_batched(LogThreadedDestWorker *s, LogMessage *msg)
 {
   HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
 
-  gsize orig_msg_len = self->request_body->len;
+  gsize orig_msg_len = _get_uncompressed_request_body_size(self);
   _add_message_to_batch(self, msg);
-  gsize diff_msg_len = self->request_body->len - orig_msg_len;
+  gsize diff_msg_len = _get_uncompressed_request_body_size(self) - orig_msg_len;
   log_threaded_dest_driver_insert_msg_length_stats(self->super.owner, diff_msg_len);
 
   if (_should_initiate_flush(self))
@@ -753,9 +1312,9 @@ _insert_single(LogThreadedDestWorker *s, LogMessage *msg)
 {
   HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
 
-  gsize orig_msg_len = self->request_body->len;
+  gsize orig_msg_len = _get_uncompressed_request_body_size(self);
   _add_message_to_batch(self, msg);
-  gsize diff_msg_len = self->request_body->len - orig_msg_len;
+  gsize diff_msg_len = _get_uncompressed_request_body_size(self) - orig_msg_len;
   log_threaded_dest_driver_insert_msg_length_stats(self->super.owner, diff_msg_len);
 
   _add_msg_specific_headers(self, msg);
@@ -763,6 +1322,44 @@ _insert_single(LogThreadedDestWorker *s, LogMessage *msg)
   return log_threaded_dest_worker_flush(&self->super, LTF_FLUSH_NORMAL);
 }
 
+static void
+_register_compression_stats(HTTPDestinationWorker *self)
+{
+  LogThreadedDestDriver *owner = self->super.owner;
+  StatsClusterLabel labels[] =
+  {
+    stats_cluster_label("id", owner->super.super.id ? : ""),
+    stats_cluster_label("driver_instance", owner->format_stats_instance(owner)),
+  };
+
+  gint level = log_pipe_is_internal(&owner->super.super.super) ? STATS_LEVEL3 : STATS_LEVEL1;
+
+  StatsClusterKey key;
+  stats_cluster_single_key_set(&key, "output_event_compressed_bytes_total", labels, G_N_ELEMENTS(labels));
+  stats_byte_counter_init(&self->metrics.compressed_bytes, &key, level, SBCP_KIB);
+
+  stats_cluster_single_key_set(&key, "output_event_uncompressed_bytes_total", labels, G_N_ELEMENTS(labels));
+  stats_byte_counter_init(&self->metrics.uncompressed_bytes, &key, level, SBCP_KIB);
+}
+
+static void
+_unregister_compression_stats(HTTPDestinationWorker *self)
+{
+  LogThreadedDestDriver *owner = self->super.owner;
+  StatsClusterLabel labels[] =
+  {
+    stats_cluster_label("id", owner->super.super.id ? : ""),
+    stats_cluster_label("driver_instance", owner->format_stats_instance(owner)),
+  };
+
+  StatsClusterKey key;
+  stats_cluster_single_key_set(&key, "output_event_compressed_bytes_total", labels, G_N_ELEMENTS(labels));
+  stats_byte_counter_deinit(&self->metrics.compressed_bytes, &key);
+
+  stats_cluster_single_key_set(&key, "output_event_uncompressed_bytes_total", labels, G_N_ELEMENTS(labels));
+  stats_byte_counter_deinit(&self->metrics.uncompressed_bytes, &key);
+}
+
 static gboolean
 _init(LogThreadedDestWorker *s)
 {
@@ -779,9 +1376,20 @@ _init(LogThreadedDestWorker *s)
                 log_pipe_location_tag(&owner->super.super.super.super));
       return FALSE;
     }
-  _setup_static_options_in_curl(self);
+  _setup_static_options_in_curl(self, self->curl);
+
+  if (owner->compression != COMPRESSION_NONE)
+    {
+      if (!(self->compressor = stream_compressor_new(owner->compression, COMPRESSION_LEVEL_DEFAULT)))
+        return FALSE;
+    }
+
   _reinit_request_headers(self);
   _reinit_request_body(self);
+
+  if (owner->max_in_flight > 1 && !_multi_init(self))
+    return FALSE;
+
   return log_threaded_dest_worker_init_method(s);
 }
 
@@ -789,6 +1397,16 @@ static void
 _deinit(LogThreadedDestWorker *s)
 {
   HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+
+  if (owner->max_in_flight > 1)
+    _multi_deinit(self);
+
+  if (self->compressor)
+    {
+      stream_compressor_free(self->compressor);
+      self->compressor = NULL;
+    }
 
   g_string_free(self->request_body, TRUE);
   list_free(self->request_headers);
@@ -800,6 +1418,10 @@ static void
 http_dw_free(LogThreadedDestWorker *s)
 {
   HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) s->owner;
+
+  if (owner->compression != COMPRESSION_NONE)
+    _unregister_compression_stats(self);
 
   http_lb_client_deinit(&self->lbc);
   log_threaded_dest_worker_free_method(s);
@@ -814,14 +1436,18 @@ http_dw_new(LogThreadedDestDriver *o, gint worker_index)
   log_threaded_dest_worker_init_instance(&self->super, o, worker_index);
   self->super.init = _init;
   self->super.deinit = _deinit;
-  self->super.flush = _flush;
+  self->super.flush = owner->max_in_flight > 1 ? _flush_in_flight : _flush;
   self->super.free_fn = http_dw_free;
 
-  if (owner->super.batch_lines > 0 || owner->batch_bytes > 0)
+  if (owner->super.batch_lines > 0 || owner->batch_bytes > 0 || owner->compressed_batch_bytes > 0)
     self->super.insert = _insert_batched;
   else
     self->super.insert = _insert_single;
 
+  /* StatsByteCounter is not thread-safe, see log_threaded_dest_worker_init_instance() */
+  if (owner->compression != COMPRESSION_NONE)
+    _register_compression_stats(self);
+
   http_lb_client_init(&self->lbc, owner->load_balancer);
   return &self->super;
 }
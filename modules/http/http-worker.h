@@ -28,6 +28,9 @@
 #include "logthrdest/logthrdestdrv.h"
 #include "http-loadbalancer.h"
 #include "http-curl-header-list.h"
+#include "compression.h"
+
+typedef struct _HTTPInFlightRequest HTTPInFlightRequest;
 
 typedef struct _HTTPDestinationWorker
 {
@@ -36,6 +39,27 @@ typedef struct _HTTPDestinationWorker
   CURL *curl;
   GString *request_body;
   List *request_headers;
+
+  /* compression(): request_body is compressed as messages are added */
+  StreamCompressor *compressor;
+  struct
+  {
+    StatsByteCounter compressed_bytes;
+    StatsByteCounter uncompressed_bytes;
+  } metrics;
+
+  /* max-in-flight() > 1: requests are sent through a curl multi handle */
+  struct
+  {
+    CURLM *handle;
+    HTTPInFlightRequest *requests;
+    /* requests in the order they were sent */
+    GQueue pending;
+    GQueue idle;
+    GList *sockets;
+    struct iv_timer timer;
+    glong timeout_ms;
+  } multi;
 } HTTPDestinationWorker;
 
 LogThreadedResult default_map_http_status_to_worker_status(HTTPDestinationWorker *self, const gchar *url,
@@ -306,6 +306,36 @@ http_dd_set_batch_bytes(LogDriver *d, glong batch_bytes)
   self->batch_bytes = batch_bytes;
 }
 
+void
+http_dd_set_max_in_flight(LogDriver *d, gint max_in_flight)
+{
+  HTTPDestinationDriver *self = (HTTPDestinationDriver *) d;
+
+  self->max_in_flight = max_in_flight;
+}
+
+gboolean
+http_dd_set_compression(LogDriver *d, const gchar *compression)
+{
+  HTTPDestinationDriver *self = (HTTPDestinationDriver *) d;
+  CompressionAlgorithm algorithm;
+
+  /* lz4 has no HTTP content-coding */
+  if (!compression_algorithm_lookup(compression, &algorithm) || algorithm == COMPRESSION_LZ4)
+    return FALSE;
+
+  self->compression = algorithm;
+  return TRUE;
+}
+
+void
+http_dd_set_compressed_batch_bytes(LogDriver *d, glong compressed_batch_bytes)
+{
+  HTTPDestinationDriver *self = (HTTPDestinationDriver *) d;
+
+  self->compressed_batch_bytes = compressed_batch_bytes;
+}
+
 void
 http_dd_set_body_prefix(LogDriver *d, const gchar *body_prefix)
 {
@@ -383,6 +413,14 @@ http_dd_init(LogPipe *s)
                   evt_tag_int("workers", self->super.num_workers),
                   log_pipe_location_tag(&self->super.super.super.super));
     }
+  if (!compression_algorithm_is_supported(self->compression))
+    {
+      msg_error("http: syslog-ng was compiled without support for the configured compression() algorithm",
+                evt_tag_str("compression", compression_algorithm_name(self->compression)),
+                log_pipe_location_tag(&self->super.super.super.super));
+      return FALSE;
+    }
+
   /* we need to set up url before we call the inherited init method, so our stats key is correct */
   self->url = self->load_balancer->targets[0].url;
 
@@ -452,6 +490,8 @@ http_dd_new(GlobalConfig *cfg)
   /* disable batching even if the global batch_lines is specified */
   self->super.batch_lines = 0;
   self->batch_bytes = 0;
+  self->max_in_flight = 1;
+  self->compression = COMPRESSION_NONE;
   self->body_prefix = g_string_new("");
   self->body_suffix = g_string_new("");
   self->delimiter = g_string_new("\n");
@@ -31,6 +31,7 @@
 #include "logthrdest/logthrdestdrv.h"
 #include "http-loadbalancer.h"
 #include "response-handler.h"
+#include "compression.h"
 
 typedef struct
 {
@@ -61,6 +62,9 @@ typedef struct
   short int method_type;
   glong timeout;
   glong batch_bytes;
+  gint max_in_flight;
+  CompressionAlgorithm compression;
+  glong compressed_batch_bytes;
   LogTemplate *body_template;
   LogTemplateOptions template_options;
   HttpResponseHandlers *response_handlers;
@@ -90,6 +94,9 @@ void http_dd_set_peer_verify(LogDriver *d, gboolean verify);
 gboolean http_dd_set_ocsp_stapling_verify(LogDriver *d, gboolean verify);
 void http_dd_set_timeout(LogDriver *d, glong timeout);
 void http_dd_set_batch_bytes(LogDriver *d, glong batch_bytes);
+void http_dd_set_max_in_flight(LogDriver *d, gint max_in_flight);
+gboolean http_dd_set_compression(LogDriver *d, const gchar *compression);
+void http_dd_set_compressed_batch_bytes(LogDriver *d, glong compressed_batch_bytes);
 void http_dd_set_body_prefix(LogDriver *d, const gchar *body_prefix);
 void http_dd_set_body_suffix(LogDriver *d, const gchar *body_suffix);
 void http_dd_set_delimiter(LogDriver *d, const gchar *delimiter);
@@ -35,6 +35,7 @@ static CfgLexerKeyword metrics_probe_keywords[] =
   { "labels",                      KW_LABELS },
   { "increment",                   KW_INCREMENT },
   { "level",                       KW_LEVEL },
+  { "max_cardinality",             KW_MAX_CARDINALITY },
   { NULL }
 };
 
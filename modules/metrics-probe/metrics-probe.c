@@ -27,7 +27,63 @@
 #include "apphook.h"
 #include "tls-support.h"
 
+#include <string.h>
+
 #define NUM_OF_LABELS_MAX (128)
+#define METRICS_PROBE_OVERFLOW_LABEL_VALUE "__overflow__"
+
+/*
+ * Each thread keeps the clusters it has registered in a bounded LRU cache,
+ * keyed by the formatted label values and a hash calculated while they are
+ * formatted. Hits do not touch the stats registry at all. A miss takes
+ * stats_lock() once, to register the new cluster and to unregister the
+ * entries evicted to make room for it.
+ *
+ * The cardinality state is shared with the cache entries, as they may
+ * outlive the metrics-probe instance (e.g. after a reload).  It counts the
+ * label value combinations of its own instance: a combination is acquired
+ * when a cache entry is created for it (in any thread) and released when
+ * the last such entry is evicted, so the count only ever changes on the
+ * owner it belongs to.  Combinations above max-cardinality() never get a
+ * cache entry, they are counted in the overflow counter of the instance.
+ */
+typedef struct _MetricsProbeCardinality
+{
+  GAtomicCounter ref_cnt;
+  gint max_cardinality;
+
+  /* MetricsProbeSeries instances keyed by their label values, protected by lock */
+  GMutex lock;
+  GHashTable *series;
+} MetricsProbeCardinality;
+
+typedef struct _MetricsProbeCacheKey
+{
+  guint hash;
+  MetricsProbeCardinality *owner;
+  gint num_values;
+  const gchar **values;
+} MetricsProbeCacheKey;
+
+typedef struct _MetricsProbeSeries
+{
+  MetricsProbeCacheKey key;
+  /* the number of cache entries referencing this series */
+  gint ref_cnt;
+} MetricsProbeSeries;
+
+typedef struct _MetricsProbeCacheEntry
+{
+  MetricsProbeCacheKey key;
+  GList lru_link;
+  StatsCluster *cluster;
+} MetricsProbeCacheEntry;
+
+typedef struct _MetricsProbeCache
+{
+  GHashTable *entries;
+  GQueue lru;
+} MetricsProbeCache;
 
 typedef struct _MetricsProbe
 {
@@ -38,42 +94,289 @@ typedef struct _MetricsProbe
   guint8 num_of_labels;
   LogTemplate *increment_template;
   gint level;
+  MetricsProbeCardinality *cardinality;
+  /* registered on the first overflow, shared by all threads */
+  StatsCluster *overflow_cluster;
 
   LogTemplateOptions template_options;
 } MetricsProbe;
 
 TLS_BLOCK_START
 {
-  GHashTable *clusters;
+  MetricsProbeCache *probe_cache;
 }
 TLS_BLOCK_END;
 
-#define clusters __tls_deref(clusters)
+#define probe_cache __tls_deref(probe_cache)
 
-static StatsCluster *
-_register_single_cluster_locked(StatsClusterKey *key, gint stats_level)
+static guint
+_cache_key_hash(const MetricsProbeCacheKey *key)
 {
-  StatsCluster *cluster;
+  return key->hash;
+}
+
+static gboolean
+_cache_key_equal(const MetricsProbeCacheKey *key1, const MetricsProbeCacheKey *key2)
+{
+  if (key1->hash != key2->hash || key1->owner != key2->owner || key1->num_values != key2->num_values)
+    return FALSE;
+
+  for (gint i = 0; i < key1->num_values; i++)
+    {
+      if (strcmp(key1->values[i], key2->values[i]) != 0)
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static void
+_cache_key_copy(MetricsProbeCacheKey *dst, const MetricsProbeCacheKey *src)
+{
+  dst->hash = src->hash;
+  dst->owner = src->owner;
+  dst->num_values = src->num_values;
+  dst->values = g_new(const gchar *, src->num_values);
+  for (gint i = 0; i < src->num_values; i++)
+    dst->values[i] = g_strdup(src->values[i]);
+}
+
+static void
+_cache_key_destroy(MetricsProbeCacheKey *self)
+{
+  for (gint i = 0; i < self->num_values; i++)
+    g_free((gchar *) self->values[i]);
+  g_free(self->values);
+}
+
+static void
+_series_free(MetricsProbeSeries *self)
+{
+  _cache_key_destroy(&self->key);
+  g_free(self);
+}
+
+static MetricsProbeCardinality *
+_cardinality_new(void)
+{
+  MetricsProbeCardinality *self = g_new0(MetricsProbeCardinality, 1);
+
+  g_atomic_counter_set(&self->ref_cnt, 1);
+  g_mutex_init(&self->lock);
+  self->series = g_hash_table_new_full((GHashFunc) _cache_key_hash, (GEqualFunc) _cache_key_equal,
+                                       NULL, (GDestroyNotify) _series_free);
+  return self;
+}
+
+static MetricsProbeCardinality *
+_cardinality_ref(MetricsProbeCardinality *self)
+{
+  g_atomic_counter_inc(&self->ref_cnt);
+  return self;
+}
+
+static void
+_cardinality_unref(MetricsProbeCardinality *self)
+{
+  if (g_atomic_counter_dec_and_test(&self->ref_cnt))
+    {
+      g_hash_table_destroy(self->series);
+      g_mutex_clear(&self->lock);
+      g_free(self);
+    }
+}
+
+/* returns FALSE if a new label combination would exceed max-cardinality() */
+static gboolean
+_cardinality_acquire_series(MetricsProbeCardinality *self, const MetricsProbeCacheKey *key)
+{
+  gboolean acquired = TRUE;
+
+  if (self->max_cardinality <= 0)
+    return TRUE;
+
+  g_mutex_lock(&self->lock);
+  {
+    MetricsProbeSeries *series = g_hash_table_lookup(self->series, key);
+
+    if (series)
+      {
+        series->ref_cnt++;
+      }
+    else if (g_hash_table_size(self->series) < (guint) self->max_cardinality)
+      {
+        series = g_new0(MetricsProbeSeries, 1);
+        _cache_key_copy(&series->key, key);
+        series->ref_cnt = 1;
+        g_hash_table_insert(self->series, &series->key, series);
+      }
+    else
+      {
+        acquired = FALSE;
+      }
+  }
+  g_mutex_unlock(&self->lock);
+
+  return acquired;
+}
+
+static void
+_cardinality_release_series(MetricsProbeCardinality *self, const MetricsProbeCacheKey *key)
+{
+  if (self->max_cardinality <= 0)
+    return;
+
+  g_mutex_lock(&self->lock);
+  {
+    MetricsProbeSeries *series = g_hash_table_lookup(self->series, key);
+
+    g_assert(series);
+    if (--series->ref_cnt == 0)
+      g_hash_table_remove(self->series, key);
+  }
+  g_mutex_unlock(&self->lock);
+}
+
+static MetricsProbeCacheEntry *
+_cache_entry_new(const MetricsProbeCacheKey *key, StatsCluster *cluster)
+{
+  MetricsProbeCacheEntry *self = g_new0(MetricsProbeCacheEntry, 1);
+
+  _cache_key_copy(&self->key, key);
+  _cardinality_ref(self->key.owner);
 
+  self->lru_link.data = self;
+  self->cluster = cluster;
+  return self;
+}
+
+static void
+_cache_entry_free(MetricsProbeCacheEntry *self)
+{
+  MetricsProbeCardinality *owner = self->key.owner;
+
+  _cardinality_release_series(owner, &self->key);
+  _cache_key_destroy(&self->key);
+  _cardinality_unref(owner);
+  g_free(self);
+}
+
+/* must be called with stats_lock() held */
+static void
+_cache_entry_unregister(MetricsProbeCacheEntry *self)
+{
+  StatsCounterItem *counter = stats_cluster_single_get_counter(self->cluster);
+  stats_unregister_dynamic_counter(self->cluster, SC_TYPE_SINGLE_VALUE, &counter);
+}
+
+/* must be called with stats_lock() held */
+static void
+_cache_evict_oldest(MetricsProbeCache *self)
+{
+  GList *link = g_queue_pop_tail_link(&self->lru);
+  MetricsProbeCacheEntry *entry = link->data;
+
+  g_hash_table_remove(self->entries, &entry->key);
+  _cache_entry_unregister(entry);
+  _cache_entry_free(entry);
+}
+
+static void
+_cache_touch(MetricsProbeCache *self, MetricsProbeCacheEntry *entry)
+{
+  g_queue_unlink(&self->lru, &entry->lru_link);
+  g_queue_push_head_link(&self->lru, &entry->lru_link);
+}
+
+static void
+_cache_insert(MetricsProbeCache *self, MetricsProbeCacheEntry *entry)
+{
+  g_hash_table_insert(self->entries, &entry->key, entry);
+  g_queue_push_head_link(&self->lru, &entry->lru_link);
+}
+
+static MetricsProbeCache *
+_cache_new(void)
+{
+  MetricsProbeCache *self = g_new0(MetricsProbeCache, 1);
+
+  self->entries = g_hash_table_new((GHashFunc) _cache_key_hash, (GEqualFunc) _cache_key_equal);
+  g_queue_init(&self->lru);
+  return self;
+}
+
+static void
+_cache_free(MetricsProbeCache *self)
+{
   stats_lock();
   {
-    StatsCounterItem *counter;
-    cluster = stats_register_dynamic_counter(stats_level, key, SC_TYPE_SINGLE_VALUE, &counter);
+    while (!g_queue_is_empty(&self->lru))
+      _cache_evict_oldest(self);
   }
   stats_unlock();
 
-  return cluster;
+  g_hash_table_destroy(self->entries);
+  g_free(self);
 }
 
-static void
-_unregister_single_cluster_locked(StatsCluster *cluster)
+/* the caller must have acquired the series of cache_key */
+static MetricsProbeCacheEntry *
+_register_cache_entry(MetricsProbe *self, const MetricsProbeCacheKey *cache_key, StatsClusterLabel *labels)
 {
+  StatsClusterKey key;
+  StatsCounterItem *counter;
+  StatsCluster *cluster;
+
+  stats_cluster_single_key_set(&key, self->key, labels, cache_key->num_values);
+
   stats_lock();
   {
-    StatsCounterItem *counter = stats_cluster_single_get_counter(cluster);
-    stats_unregister_dynamic_counter(cluster, SC_TYPE_SINGLE_VALUE, &counter);
+    while (g_hash_table_size(probe_cache->entries) >= METRICS_PROBE_CACHE_SIZE)
+      _cache_evict_oldest(probe_cache);
+
+    cluster = stats_register_dynamic_counter(self->level, &key, SC_TYPE_SINGLE_VALUE, &counter);
   }
   stats_unlock();
+
+  if (!cluster)
+    {
+      _cardinality_release_series(self->cardinality, cache_key);
+      return NULL;
+    }
+
+  MetricsProbeCacheEntry *entry = _cache_entry_new(cache_key, cluster);
+  _cache_insert(probe_cache, entry);
+  return entry;
+}
+
+/* overflowed label combinations don't get a cache entry, they all share a
+ * single counter, so only its first use takes stats_lock() */
+static StatsCounterItem *
+_get_overflow_counter(MetricsProbe *self, StatsClusterLabel *labels, gint num_labels)
+{
+  StatsCluster *cluster = g_atomic_pointer_get(&self->overflow_cluster);
+
+  if (G_UNLIKELY(!cluster))
+    {
+      StatsClusterKey key;
+      StatsCounterItem *counter;
+
+      for (gint i = 0; i < num_labels; i++)
+        labels[i].value = METRICS_PROBE_OVERFLOW_LABEL_VALUE;
+      stats_cluster_single_key_set(&key, self->key, labels, num_labels);
+
+      stats_lock();
+      {
+        cluster = self->overflow_cluster;
+        if (!cluster)
+          {
+            cluster = stats_register_dynamic_counter(self->level, &key, SC_TYPE_SINGLE_VALUE, &counter);
+            g_atomic_pointer_set(&self->overflow_cluster, cluster);
+          }
+      }
+      stats_unlock();
+    }
+
+  return cluster ? stats_cluster_single_get_counter(cluster) : NULL;
 }
 
 void
@@ -116,6 +419,14 @@ metrics_probe_set_level(LogParser *s, gint level)
   self->level = level;
 }
 
+void
+metrics_probe_set_max_cardinality(LogParser *s, gint max_cardinality)
+{
+  MetricsProbe *self = (MetricsProbe *) s;
+
+  self->cardinality->max_cardinality = max_cardinality;
+}
+
 LogTemplateOptions *
 metrics_probe_get_template_options(LogParser *s)
 {
@@ -124,42 +435,61 @@ metrics_probe_get_template_options(LogParser *s)
   return &self->template_options;
 }
 
+static guint
+_hash_label_value(guint hash, const gchar *value)
+{
+  for (const gchar *p = value; *p; p++)
+    hash = (hash << 5) + hash + *p;
+  return (hash << 5) + hash;
+}
+
 static void
-_calculate_stats_cluster_key(MetricsProbe *self, LogMessage *msg, StatsClusterLabel *labels, StatsClusterKey *key)
+_format_labels(MetricsProbe *self, LogMessage *msg, StatsClusterLabel *labels, MetricsProbeCacheKey *cache_key)
 {
+  guint hash = g_direct_hash(self->cardinality);
   gint label_idx = 0;
+
   for (GList *elem = g_list_first(self->label_templates); elem; elem = elem->next)
     {
       LabelTemplate *label_template = (LabelTemplate *) elem->data;
       GString *value_buffer = scratch_buffers_alloc();
 
-      label_template_format(label_template, &self->template_options, msg, value_buffer, &labels[label_idx++]);
+      label_template_format(label_template, &self->template_options, msg, value_buffer, &labels[label_idx]);
+      cache_key->values[label_idx] = labels[label_idx].value;
+      hash = _hash_label_value(hash, labels[label_idx].value);
+      label_idx++;
     }
 
-  stats_cluster_single_key_set(key, self->key, labels, label_idx);
+  cache_key->hash = hash;
+  cache_key->owner = self->cardinality;
+  cache_key->num_values = label_idx;
 }
 
 static StatsCounterItem *
 _lookup_stats_counter(MetricsProbe *self, LogMessage *msg)
 {
   StatsClusterLabel *labels = g_alloca(self->num_of_labels * sizeof(StatsClusterLabel));
-  StatsClusterKey key;
+  MetricsProbeCacheKey cache_key = { .values = g_alloca(self->num_of_labels * sizeof(const gchar *)) };
   ScratchBuffersMarker marker;
 
   scratch_buffers_mark(&marker);
-  _calculate_stats_cluster_key(self, msg, labels, &key);
+  _format_labels(self, msg, labels, &cache_key);
 
-  StatsCluster *cluster = g_hash_table_lookup(clusters, &key);
-  if (!cluster)
-    {
-      cluster = _register_single_cluster_locked(&key, self->level);
-      if (cluster)
-        g_hash_table_insert(clusters, &cluster->key, cluster);
-    }
+  StatsCounterItem *counter = NULL;
+  MetricsProbeCacheEntry *entry = g_hash_table_lookup(probe_cache->entries, &cache_key);
+  if (entry)
+    _cache_touch(probe_cache, entry);
+  else if (_cardinality_acquire_series(self->cardinality, &cache_key))
+    entry = _register_cache_entry(self, &cache_key, labels);
+  else
+    counter = _get_overflow_counter(self, labels, cache_key.num_values);
+
+  if (entry)
+    counter = stats_cluster_single_get_counter(entry->cluster);
 
   scratch_buffers_reclaim_marked(marker);
 
-  return stats_cluster_single_get_counter(cluster);
+  return counter;
 }
 
 static const gchar *
@@ -225,18 +555,16 @@ _add_default_label_template(MetricsProbe *self, const gchar *label, const gchar
 static void
 _init_tls_clusters_map_thread_init_hook(gpointer user_data)
 {
-  g_assert(!clusters);
+  g_assert(!probe_cache);
 
-  clusters = g_hash_table_new_full((GHashFunc) stats_cluster_key_hash,
-                                   (GEqualFunc) stats_cluster_key_equal,
-                                   NULL,
-                                   (GDestroyNotify) _unregister_single_cluster_locked);
+  probe_cache = _cache_new();
 }
 
 static void
 _deinit_tls_clusters_map_thread_init_hook(gpointer user_data)
 {
-  g_hash_table_destroy(clusters);
+  _cache_free(probe_cache);
+  probe_cache = NULL;
 }
 
 static void
@@ -298,6 +626,25 @@ _init(LogPipe *s)
   return log_parser_init_method(s);
 }
 
+static gboolean
+_deinit(LogPipe *s)
+{
+  MetricsProbe *self = (MetricsProbe *) s;
+
+  if (self->overflow_cluster)
+    {
+      stats_lock();
+      {
+        StatsCounterItem *counter = stats_cluster_single_get_counter(self->overflow_cluster);
+        stats_unregister_dynamic_counter(self->overflow_cluster, SC_TYPE_SINGLE_VALUE, &counter);
+      }
+      stats_unlock();
+      self->overflow_cluster = NULL;
+    }
+
+  return log_parser_deinit_method(s);
+}
+
 static LogPipe *
 _clone(LogPipe *s)
 {
@@ -316,6 +663,7 @@ _clone(LogPipe *s)
 
   metrics_probe_set_increment_template(&cloned->super, self->increment_template);
   metrics_probe_set_level(&cloned->super, self->level);
+  metrics_probe_set_max_cardinality(&cloned->super, self->cardinality->max_cardinality);
   log_template_options_clone(&self->template_options, &cloned->template_options);
 
   return &cloned->super.super;
@@ -329,6 +677,7 @@ _free(LogPipe *s)
   g_free(self->key);
   g_list_free_full(self->label_templates, (GDestroyNotify) label_template_free);
   log_template_unref(self->increment_template);
+  _cardinality_unref(self->cardinality);
   log_template_options_destroy(&self->template_options);
 
   log_parser_free_method(s);
@@ -341,9 +690,11 @@ metrics_probe_new(GlobalConfig *cfg)
 
   log_parser_init_instance(&self->super, cfg);
   self->super.super.init = _init;
+  self->super.super.deinit = _deinit;
   self->super.super.free_fn = _free;
   self->super.super.clone = _clone;
   self->super.process = _process;
+  self->cardinality = _cardinality_new();
 
   log_template_options_defaults(&self->template_options);
 
@@ -26,12 +26,16 @@
 #include "parser/parser-expr.h"
 #include "template/templates.h"
 
+/* the number of clusters each thread keeps registered */
+#define METRICS_PROBE_CACHE_SIZE (4096)
+
 LogParser *metrics_probe_new(GlobalConfig *cfg);
 
 void metrics_probe_set_key(LogParser *s, const gchar *key);
 gboolean metrics_probe_add_label_template(LogParser *s, const gchar *label, LogTemplate *value_template);
 void metrics_probe_set_increment_template(LogParser *s, LogTemplate *increment_template);
 void metrics_probe_set_level(LogParser *s, gint level);
+void metrics_probe_set_max_cardinality(LogParser *s, gint max_cardinality);
 
 LogTemplateOptions *metrics_probe_get_template_options(LogParser *s);
 
@@ -52,6 +52,24 @@ _stats_cluster_exists(const gchar *key, StatsClusterLabel *labels, gsize labels_
   return cluster != NULL;
 }
 
+static gboolean
+_stats_cluster_is_live(const gchar *key, StatsClusterLabel *labels, gsize labels_len)
+{
+  gboolean live;
+
+  StatsClusterKey sc_key;
+  stats_cluster_single_key_set(&sc_key, key, labels, labels_len);
+
+  stats_lock();
+  {
+    StatsCluster *cluster = stats_get_cluster(&sc_key);
+    live = cluster && !stats_cluster_is_orphaned(cluster);
+  }
+  stats_unlock();
+
+  return live;
+}
+
 static gsize
 _get_stats_counter_value(const gchar *key, StatsClusterLabel *labels, gsize labels_len)
 {
@@ -378,6 +396,197 @@ Test(metrics_probe, test_metrics_probe_level)
   log_pipe_unref(&metrics_probe->super);
 }
 
+Test(metrics_probe, test_metrics_probe_max_cardinality)
+{
+  LogParser *tmp_metrics_probe = metrics_probe_new(configuration);
+  metrics_probe_set_key(tmp_metrics_probe, "custom_key");
+  _add_label(tmp_metrics_probe, "test_label", "${test_field}");
+  metrics_probe_set_max_cardinality(tmp_metrics_probe, 1);
+
+  LogParser *metrics_probe = (LogParser *) log_pipe_clone(&tmp_metrics_probe->super);
+  log_pipe_unref(&tmp_metrics_probe->super);
+  cr_assert(log_pipe_init(&metrics_probe->super), "Failed to init metrics-probe");
+
+  const gchar *values[] = { "test_value_1", "test_value_2", "test_value_3", "test_value_1" };
+  for (gint i = 0; i < G_N_ELEMENTS(values); i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+      log_msg_set_value_by_name(msg, "test_field", values[i], -1);
+      cr_assert(log_parser_process(metrics_probe, &msg, NULL, "", -1), "Failed to apply metrics-probe");
+      log_msg_unref(msg);
+    }
+
+  StatsClusterLabel expected_labels_1[] =
+  {
+    stats_cluster_label("test_label", "test_value_1"),
+  };
+  _assert_counter_value("custom_key",
+                        expected_labels_1,
+                        G_N_ELEMENTS(expected_labels_1),
+                        2);
+
+  StatsClusterLabel overflow_labels[] =
+  {
+    stats_cluster_label("test_label", "__overflow__"),
+  };
+  _assert_counter_value("custom_key",
+                        overflow_labels,
+                        G_N_ELEMENTS(overflow_labels),
+                        2);
+
+  StatsClusterLabel expected_labels_2[] =
+  {
+    stats_cluster_label("test_label", "test_value_2"),
+  };
+  cr_assert_not(_stats_cluster_exists("custom_key", expected_labels_2, G_N_ELEMENTS(expected_labels_2)));
+
+  log_pipe_deinit(&metrics_probe->super);
+  log_pipe_unref(&metrics_probe->super);
+}
+
+static LogParser *
+_create_metrics_probe(const gchar *key, gint max_cardinality)
+{
+  LogParser *tmp_metrics_probe = metrics_probe_new(configuration);
+  metrics_probe_set_key(tmp_metrics_probe, key);
+  _add_label(tmp_metrics_probe, "test_label", "${test_field}");
+  metrics_probe_set_max_cardinality(tmp_metrics_probe, max_cardinality);
+
+  LogParser *metrics_probe = (LogParser *) log_pipe_clone(&tmp_metrics_probe->super);
+  log_pipe_unref(&tmp_metrics_probe->super);
+  cr_assert(log_pipe_init(&metrics_probe->super), "Failed to init metrics-probe");
+
+  return metrics_probe;
+}
+
+static void
+_destroy_metrics_probe(LogParser *metrics_probe)
+{
+  log_pipe_deinit(&metrics_probe->super);
+  log_pipe_unref(&metrics_probe->super);
+}
+
+static void
+_process_value(LogParser *metrics_probe, const gchar *value)
+{
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_value_by_name(msg, "test_field", value, -1);
+  cr_assert(log_parser_process(metrics_probe, &msg, NULL, "", -1), "Failed to apply metrics-probe");
+  log_msg_unref(msg);
+}
+
+static void
+_process_numbered_values(LogParser *metrics_probe, gint first, gint last)
+{
+  for (gint i = first; i <= last; i++)
+    {
+      gchar value[32];
+
+      g_snprintf(value, sizeof(value), "value_%d", i);
+      _process_value(metrics_probe, value);
+    }
+}
+
+static gboolean
+_numbered_value_is_live(const gchar *key, gint i)
+{
+  gchar value[32];
+
+  g_snprintf(value, sizeof(value), "value_%d", i);
+  StatsClusterLabel labels[] =
+  {
+    stats_cluster_label("test_label", value),
+  };
+  return _stats_cluster_is_live(key, labels, G_N_ELEMENTS(labels));
+}
+
+Test(metrics_probe, test_metrics_probe_cache_evicts_least_recently_used)
+{
+  LogParser *metrics_probe = _create_metrics_probe("lru_key", 0);
+
+  _process_numbered_values(metrics_probe, 0, METRICS_PROBE_CACHE_SIZE - 1);
+  /* touch value_0, value_1 is the least recently used now */
+  _process_value(metrics_probe, "value_0");
+  _process_numbered_values(metrics_probe, METRICS_PROBE_CACHE_SIZE, METRICS_PROBE_CACHE_SIZE);
+
+  cr_assert(_numbered_value_is_live("lru_key", 0));
+  cr_assert_not(_numbered_value_is_live("lru_key", 1), "least recently used cluster was not unregistered");
+  cr_assert(_numbered_value_is_live("lru_key", 2));
+  cr_assert(_numbered_value_is_live("lru_key", METRICS_PROBE_CACHE_SIZE));
+
+  /* an evicted series is registered again, the counter is kept by the registry */
+  _process_value(metrics_probe, "value_1");
+  cr_assert(_numbered_value_is_live("lru_key", 1));
+  cr_assert_not(_numbered_value_is_live("lru_key", 2));
+
+  StatsClusterLabel labels[] =
+  {
+    stats_cluster_label("test_label", "value_1"),
+  };
+  _assert_counter_value("lru_key", labels, G_N_ELEMENTS(labels), 2);
+
+  _destroy_metrics_probe(metrics_probe);
+}
+
+Test(metrics_probe, test_metrics_probe_evicted_series_no_longer_count_against_max_cardinality)
+{
+  LogParser *metrics_probe = _create_metrics_probe("evicted_key", 2);
+  LogParser *filler = _create_metrics_probe("filler_key", 0);
+
+  _process_numbered_values(metrics_probe, 0, 2);
+  cr_assert(_numbered_value_is_live("evicted_key", 0));
+  cr_assert(_numbered_value_is_live("evicted_key", 1));
+  cr_assert_not(_numbered_value_is_live("evicted_key", 2));
+
+  /* push every entry of metrics_probe out of the cache */
+  _process_numbered_values(filler, 0, METRICS_PROBE_CACHE_SIZE - 1);
+  cr_assert_not(_numbered_value_is_live("evicted_key", 0));
+
+  _process_numbered_values(metrics_probe, 3, 5);
+  cr_assert(_numbered_value_is_live("evicted_key", 3));
+  cr_assert(_numbered_value_is_live("evicted_key", 4));
+  cr_assert_not(_numbered_value_is_live("evicted_key", 5));
+
+  StatsClusterLabel overflow_labels[] =
+  {
+    stats_cluster_label("test_label", "__overflow__"),
+  };
+  _assert_counter_value("evicted_key", overflow_labels, G_N_ELEMENTS(overflow_labels), 2);
+
+  _destroy_metrics_probe(filler);
+  _destroy_metrics_probe(metrics_probe);
+}
+
+Test(metrics_probe, test_metrics_probe_max_cardinality_is_kept_across_reload)
+{
+  LogParser *old_metrics_probe = _create_metrics_probe("reload_key", 1);
+  _process_value(old_metrics_probe, "value_0");
+  /* reload: the cache entries of the old instance outlive it */
+  _destroy_metrics_probe(old_metrics_probe);
+
+  LogParser *metrics_probe = _create_metrics_probe("reload_key", 1);
+  _process_value(metrics_probe, "value_0");
+
+  /* both instances release value_0, each from its own count */
+  LogParser *filler = _create_metrics_probe("filler_key", 0);
+  _process_numbered_values(filler, 0, METRICS_PROBE_CACHE_SIZE - 1);
+  _destroy_metrics_probe(filler);
+  cr_assert_not(_numbered_value_is_live("reload_key", 0));
+
+  _process_numbered_values(metrics_probe, 1, 3);
+  cr_assert(_numbered_value_is_live("reload_key", 1));
+  cr_assert_not(_numbered_value_is_live("reload_key", 2), "max-cardinality() was exceeded after a reload");
+  cr_assert_not(_numbered_value_is_live("reload_key", 3), "max-cardinality() was exceeded after a reload");
+
+  StatsClusterLabel overflow_labels[] =
+  {
+    stats_cluster_label("test_label", "__overflow__"),
+  };
+  _assert_counter_value("reload_key", overflow_labels, G_N_ELEMENTS(overflow_labels), 2);
+
+  _destroy_metrics_probe(metrics_probe);
+}
+
 void setup(void)
 {
   app_startup();
@@ -25,18 +25,38 @@ from log import *
 from messagegen import *
 from messagecheck import *
 
-config = """@version: %(syslog_ng_version)s
+config_header = """@version: %(syslog_ng_version)s
 
 options { ts_format(iso); chain_hostnames(no); keep_hostname(yes); threaded(yes); };
 
 source s_int { internal(); };
 source s_tcp { tcp(port(%(port_number)d)); };
+""" % locals()
 
+# fanout exercises the multiplexer and filter hops between the source and
+# the destination queues, where batched ingestion (queue_batch) matters most
+config = {
+    'file': config_header + """
 destination d_messages { file("test-performance.log"); };
 
 log { source(s_tcp); destination(d_messages); };
 
-""" % locals()
+""",
+    'fanout': config_header + """
+destination d_messages { file("test-performance.log"); };
+destination d_errors { file("test-performance-errors.log"); };
+destination d_loggen { file("test-performance-loggen.log"); };
+
+filter f_errors { level(err..emerg); };
+filter f_loggen { program("prg" type(string) flags(prefix)); };
+filter f_not_kern { not facility(kern); };
+
+log { source(s_tcp); filter(f_not_kern); destination(d_messages); };
+log { source(s_tcp); filter(f_errors); destination(d_errors); };
+log { source(s_tcp); filter(f_loggen); destination(d_loggen); };
+
+""",
+}
 
 def test_performance():
     expected_rate = {
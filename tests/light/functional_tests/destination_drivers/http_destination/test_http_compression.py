@@ -0,0 +1,84 @@
+#!/usr/bin/env python
+#############################################################################
+# Copyright (c) 2024 One Identity
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License version 2 as published
+# by the Free Software Foundation, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As an additional exemption you are allowed to compile & link against the
+# OpenSSL libraries as published by the OpenSSL project. See the file
+# COPYING for details.
+#
+#############################################################################
+import pytest
+
+from src.helpers.http_server.conftest import *  # noqa:F403, F401
+
+
+def _skip_if_decoder_is_missing(compression):
+    if compression == "zstd":
+        pytest.importorskip("zstandard")
+
+
+@pytest.mark.parametrize("compression", ["gzip", "deflate", "zstd"])
+def test_http_compression(config, syslog_ng, http_server, compression):
+    _skip_if_decoder_is_missing(compression)
+    counter = 1000
+    message = "message text"
+
+    generator_source = config.create_example_msg_generator_source(num=counter, freq=0.0001, template=config.stringify(message))
+    http_destination = config.create_http_destination(
+        url=config.stringify(http_server.get_url()),
+        body=config.stringify("$MSG"),
+        batch_lines=100,
+        batch_timeout=100,
+        compression=compression,
+    )
+    config.create_logpath(statements=[generator_source, http_destination])
+
+    syslog_ng.start(config)
+
+    assert http_server.wait_for_lines(counter)
+    assert http_server.get_body_lines() == [message] * counter
+
+    requests = http_server.get_requests()
+    assert all(request.headers.get("Content-Encoding") == compression for request in requests)
+    assert sum(len(request.raw_body) for request in requests) < counter * len(message)
+
+
+@pytest.mark.parametrize("compression", ["gzip", "deflate", "zstd"])
+def test_http_compressed_body_is_sent_in_full(config, syslog_ng, http_server, compression):
+    _skip_if_decoder_is_missing(compression)
+    counter = 200
+    message = "message text with some padding to compress " * 4
+
+    generator_source = config.create_example_msg_generator_source(num=counter, freq=0.0001, template=config.stringify(message))
+    http_destination = config.create_http_destination(
+        url=config.stringify(http_server.get_url()),
+        body=config.stringify("$MSG"),
+        batch_lines=50,
+        batch_timeout=100,
+        compression=compression,
+    )
+    config.create_logpath(statements=[generator_source, http_destination])
+
+    syslog_ng.start(config)
+
+    assert http_server.wait_for_lines(counter)
+
+    # compressed output contains NUL bytes, a body truncated at the first
+    # one would not decompress at all
+    for request in http_server.get_requests():
+        assert int(request.headers.get("Content-Length")) == len(request.raw_body)
+        num_lines = len(request.body.splitlines())
+        assert request.decoded_body == b"\n".join([message.encode("utf-8")] * num_lines)
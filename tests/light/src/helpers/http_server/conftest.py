@@ -0,0 +1,113 @@
+#!/usr/bin/env python
+#############################################################################
+# Copyright (c) 2024 One Identity
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License version 2 as published
+# by the Free Software Foundation, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As an additional exemption you are allowed to compile & link against the
+# OpenSSL libraries as published by the OpenSSL project. See the file
+# COPYING for details.
+#
+#############################################################################
+import gzip
+import threading
+import zlib
+from http.server import BaseHTTPRequestHandler
+from http.server import ThreadingHTTPServer
+
+import pytest
+
+from src.common.blocking import wait_until_true
+
+
+def decode_body(content_encoding, body):
+    if content_encoding == "gzip":
+        return gzip.decompress(body)
+    if content_encoding == "deflate":
+        return zlib.decompress(body)
+    if content_encoding == "zstd":
+        import zstandard
+        return zstandard.ZstdDecompressor().decompressobj().decompress(body)
+    if content_encoding is None:
+        return body
+    raise ValueError("Unsupported Content-Encoding: {}".format(content_encoding))
+
+
+class HttpRequest(object):
+    def __init__(self, path, headers, body):
+        self.path = path
+        self.headers = headers
+        self.raw_body = body
+        self.decoded_body = decode_body(headers.get("Content-Encoding"), body)
+        self.body = self.decoded_body.decode("utf-8")
+
+
+class HttpServer(object):
+    def __init__(self, port):
+        self.port = port
+        self.requests = []
+        self.lock = threading.Lock()
+        self.server = None
+        self.thread = None
+
+    def get_url(self):
+        return "http://127.0.0.1:{}/".format(self.port)
+
+    def start(self):
+        server = self
+
+        class RequestHandler(BaseHTTPRequestHandler):
+            def do_POST(self):
+                body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+                with server.lock:
+                    server.requests.append(HttpRequest(self.path, self.headers, body))
+                self.send_response(200)
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+
+            do_PUT = do_POST
+
+            def log_message(self, format, *args):
+                pass
+
+        self.server = ThreadingHTTPServer(("127.0.0.1", self.port), RequestHandler)
+        self.thread = threading.Thread(target=self.server.serve_forever, daemon=True)
+        self.thread.start()
+
+    def stop(self):
+        if self.server is None:
+            return
+
+        self.server.shutdown()
+        self.server.server_close()
+        self.thread.join()
+        self.server = None
+
+    def get_requests(self):
+        with self.lock:
+            return list(self.requests)
+
+    def get_body_lines(self):
+        return [line for request in self.get_requests() for line in request.body.splitlines()]
+
+    def wait_for_lines(self, counter):
+        return wait_until_true(lambda: len(self.get_body_lines()) >= counter)
+
+
+@pytest.fixture
+def http_server(port_allocator):
+    server = HttpServer(port_allocator())
+    server.start()
+    yield server
+    server.stop()
@@ -28,6 +28,7 @@ from src.syslog_ng_config.renderer import ConfigRenderer
 from src.syslog_ng_config.statement_group import StatementGroup
 from src.syslog_ng_config.statements.destinations.example_destination import ExampleDestination
 from src.syslog_ng_config.statements.destinations.file_destination import FileDestination
+from src.syslog_ng_config.statements.destinations.http_destination import HttpDestination
 from src.syslog_ng_config.statements.destinations.network_destination import NetworkDestination
 from src.syslog_ng_config.statements.destinations.snmp_destination import SnmpDestination
 from src.syslog_ng_config.statements.destinations.unix_dgram_destination import UnixDgramDestination
@@ -160,6 +161,9 @@ class SyslogNgConfig(object):
     def create_snmp_destination(self, **options):
         return SnmpDestination(**options)
 
+    def create_http_destination(self, **options):
+        return HttpDestination(**options)
+
     def create_network_destination(self, **options):
         network_destination = NetworkDestination(**options)
         self.teardown.register(network_destination.stop_listener)